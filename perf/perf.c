@@ -50,6 +50,8 @@ static void do_remote_thr(int argc, char **argv);
 static void do_local_thr(int argc, char **argv);
 static void do_inproc_thr(int argc, char **argv);
 static void do_inproc_lat(int argc, char **argv);
+static void do_aio_contend(int argc, char **argv);
+static void do_mtx_contend(int argc, char **argv);
 static void die(const char *, ...);
 
 // perf implements the same performance tests found in the standard
@@ -65,6 +67,8 @@ static void die(const char *, ...);
 // - remote_thr - remote throughput side
 // - inproc_lat - inproc latency
 // - inproc_thr - inproc throughput
+// - aio_contend - aio bookkeeping with concurrent, independent aios
+// - mtx_contend - message queue operations, all on one contended lock
 //
 
 int
@@ -104,6 +108,10 @@ main(int argc, char **argv)
 		do_inproc_thr(argc, argv);
 	} else if ((strcmp(prog, "inproc_lat") == 0)) {
 		do_inproc_lat(argc, argv);
+	} else if ((strcmp(prog, "aio_contend") == 0)) {
+		do_aio_contend(argc, argv);
+	} else if ((strcmp(prog, "mtx_contend") == 0)) {
+		do_mtx_contend(argc, argv);
 	} else {
 		die("Unknown program mode? Use -m <mode>.");
 	}
@@ -274,6 +282,197 @@ do_inproc_thr(int argc, char **argv)
 	nni_thr_fini(&thr);
 }
 
+static void
+aio_contend_cb(void *arg)
+{
+	NNI_ARG_UNUSED(arg);
+}
+
+struct aio_contend_args {
+	int count;
+	int timeout; // milliseconds, or 0 for none
+};
+
+// aio_contend runs the life cycle of an aio (start, finish, and wait)
+// over and over.  Each thread has its own aio, so any lack of scaling
+// as threads are added is due to shared state in the aio framework (or
+// the taskq that runs the callbacks).  With a timeout, each operation
+// also goes on (and comes off) the expiration wheel.
+static void
+aio_contend(void *arg)
+{
+	struct aio_contend_args *args = arg;
+	nni_aio *                aio;
+	int                      rv;
+	int                      i;
+
+	if ((rv = nni_aio_init(&aio, aio_contend_cb, NULL)) != 0) {
+		die("nni_aio_init: %s", nng_strerror(rv));
+	}
+	for (i = 0; i < args->count; i++) {
+		if (args->timeout > 0) {
+			nni_aio_set_timeout(aio, nni_clock() + args->timeout);
+		}
+		if ((rv = nni_aio_start(aio, NULL, NULL)) != 0) {
+			die("nni_aio_start: %s", nng_strerror(rv));
+		}
+		nni_aio_finish(aio, 0, 0);
+		nni_aio_wait(aio);
+	}
+	nni_aio_fini(aio);
+}
+
+void
+do_aio_contend(int argc, char **argv)
+{
+	nni_thr *               thrs;
+	int                     nthrs;
+	struct aio_contend_args args;
+	int                     rv;
+	int                     i;
+	uint64_t                start, end;
+	float                   total, opspersec;
+
+	nni_init();
+	if ((argc != 2) && (argc != 3)) {
+		die("Usage: aio_contend <threads> <count> [<timeout-ms>]");
+	}
+	nthrs        = parse_int(argv[0], "thread count");
+	args.count   = parse_int(argv[1], "count");
+	args.timeout = argc > 2 ? parse_int(argv[2], "timeout") : 0;
+	if (nthrs < 1) {
+		die("Invalid thread count");
+	}
+	if ((thrs = calloc(nthrs, sizeof(nni_thr))) == NULL) {
+		die("Out of memory");
+	}
+	for (i = 0; i < nthrs; i++) {
+		if ((rv = nni_thr_init(&thrs[i], aio_contend, &args)) != 0) {
+			die("Cannot create thread: %s", nng_strerror(rv));
+		}
+	}
+
+	start = nni_clock();
+	for (i = 0; i < nthrs; i++) {
+		nni_thr_run(&thrs[i]);
+	}
+	for (i = 0; i < nthrs; i++) {
+		nni_thr_fini(&thrs[i]);
+	}
+	end = nni_clock();
+	free(thrs);
+
+	total     = (float) ((end - start)) / 1000;
+	opspersec = (float) nthrs * args.count / total;
+	printf("total time: %.3f [s]\n", total);
+	printf("thread count: %d\n", nthrs);
+	printf("operation count: %d\n", args.count);
+	printf("throughput: %.f [op/s]\n", opspersec);
+}
+
+#define MTX_CONTEND_NMSGS 8
+
+#ifdef NNG_ADAPTIVE_MUTEX
+extern int nni_plat_mtx_maxspin;
+#endif
+
+struct mtx_contend_args {
+	nni_msgq *mq;
+	int       count;
+};
+
+// mtx_contend passes messages around through a single small message
+// queue, so that nearly every operation contends for the queue lock.
+// With adaptive mutexes, the spin limit may be given, to compare.
+static void
+mtx_contend(void *arg)
+{
+	struct mtx_contend_args *args = arg;
+	nni_msg *                msg;
+	int                      rv;
+	int                      i;
+
+	for (i = 0; i < args->count;) {
+		if (nni_msgq_get_batch(args->mq, &msg, 1) != 1) {
+			continue;
+		}
+		if ((rv = nni_msgq_tryput(args->mq, msg)) != 0) {
+			die("nni_msgq_tryput: %s", nng_strerror(rv));
+		}
+		i++;
+	}
+}
+
+void
+do_mtx_contend(int argc, char **argv)
+{
+	nni_thr *               thrs;
+	int                     nthrs;
+	struct mtx_contend_args args;
+	nni_msg *               msg;
+	int                     rv;
+	int                     i;
+	uint64_t                start, end;
+	float                   total, opspersec;
+
+	nni_init();
+	if ((argc != 2) && (argc != 3)) {
+		die("Usage: mtx_contend <threads> <count> [<max-spins>]");
+	}
+	nthrs      = parse_int(argv[0], "thread count");
+	args.count = parse_int(argv[1], "count");
+	if (argc > 2) {
+#ifdef NNG_ADAPTIVE_MUTEX
+		nni_plat_mtx_maxspin = parse_int(argv[2], "spin count");
+#else
+		die("Adaptive mutexes are not enabled");
+#endif
+	}
+	if (nthrs < 1) {
+		die("Invalid thread count");
+	}
+	if ((rv = nni_msgq_init(&args.mq, MTX_CONTEND_NMSGS)) != 0) {
+		die("nni_msgq_init: %s", nng_strerror(rv));
+	}
+	for (i = 0; i < MTX_CONTEND_NMSGS; i++) {
+		if ((rv = nni_msg_alloc(&msg, 0)) != 0) {
+			die("nni_msg_alloc: %s", nng_strerror(rv));
+		}
+		if ((rv = nni_msgq_tryput(args.mq, msg)) != 0) {
+			die("nni_msgq_tryput: %s", nng_strerror(rv));
+		}
+	}
+	if ((thrs = calloc(nthrs, sizeof(nni_thr))) == NULL) {
+		die("Out of memory");
+	}
+	for (i = 0; i < nthrs; i++) {
+		if ((rv = nni_thr_init(&thrs[i], mtx_contend, &args)) != 0) {
+			die("Cannot create thread: %s", nng_strerror(rv));
+		}
+	}
+
+	start = nni_clock();
+	for (i = 0; i < nthrs; i++) {
+		nni_thr_run(&thrs[i]);
+	}
+	for (i = 0; i < nthrs; i++) {
+		nni_thr_fini(&thrs[i]);
+	}
+	end = nni_clock();
+	free(thrs);
+	nni_msgq_fini(args.mq);
+
+	total     = (float) ((end - start)) / 1000;
+	opspersec = (float) nthrs * args.count / total;
+	printf("total time: %.3f [s]\n", total);
+	printf("thread count: %d\n", nthrs);
+#ifdef NNG_ADAPTIVE_MUTEX
+	printf("max spins: %d\n", nni_plat_mtx_maxspin);
+#endif
+	printf("operation count: %d\n", args.count);
+	printf("throughput: %.f [op/s]\n", opspersec);
+}
+
 void
 latency_client(const char *addr, int msgsize, int trips)
 {
@@ -11,12 +11,47 @@
 #include "core/nng_impl.h"
 #include <string.h>
 
-static nni_mtx nni_aio_lk;
-// These are used for expiration.
-static nni_cv   nni_aio_expire_cv;
-static int      nni_aio_expire_run;
-static nni_thr  nni_aio_expire_thr;
-static nni_list nni_aio_expire_aios;
+// Expirations are kept in a hierarchical timing wheel, with one
+// millisecond ticks.  Level 0 has a slot for each of the next 64 ticks;
+// each level above covers 64 times the span of the one below it, and its
+// slots are moved down a level ("cascaded") as time reaches them.  Aios
+// too far out for even the top level wait on a separate list, which is
+// revisited whenever the top level wraps.  Insertion and removal are
+// O(1), and the expire thread only visits the ticks where something can
+// actually happen.
+#define NNI_AIO_WHEEL_BITS 6
+#define NNI_AIO_WHEEL_SIZE (1 << NNI_AIO_WHEEL_BITS)
+#define NNI_AIO_WHEEL_MASK (NNI_AIO_WHEEL_SIZE - 1)
+#define NNI_AIO_WHEEL_LEVELS 4
+
+// NNI_AIO_WHEEL_SPAN returns the number of ticks covered by one slot of
+// the given level.
+#define NNI_AIO_WHEEL_SPAN(l) (((nni_time) 1) << (NNI_AIO_WHEEL_BITS * (l)))
+
+// These are used for expiration.  So that unrelated AIOs do not contend
+// for them, there is one of these per CPU, each with its own wheel, lock,
+// and thread.  An AIO always uses the one chosen by its address.
+typedef struct nni_aio_expire_q {
+	nni_mtx  eq_lk;
+	nni_cv   eq_cv;
+	int      eq_run;
+	nni_thr  eq_thr;
+	nni_list eq_aios; // expired, to be canceled
+	nni_time eq_wake; // when the expire thread wakes
+	nni_list eq_wheel[NNI_AIO_WHEEL_LEVELS][NNI_AIO_WHEEL_SIZE];
+	nni_list eq_far; // beyond the top level
+	nni_time eq_now; // last tick processed
+} nni_aio_expire_q;
+
+static nni_aio_expire_q *nni_aio_expire_qs;
+static int               nni_aio_expire_nqs;
+
+// The inline completion list of the calling thread, if any.  The lists
+// are guarded by a small set of locks, chosen by the list's address.
+#define NNI_AIO_INLINE_LOCKS 16
+static nni_plat_tls nni_aio_inline_tls;
+static int          nni_aio_inline_inited;
+static nni_mtx      nni_aio_inline_lk[NNI_AIO_INLINE_LOCKS];
 
 // Design notes.
 //
@@ -32,9 +67,17 @@ static nni_list nni_aio_expire_aios;
 // free to examine the aio for list membership, etc.  The provider must
 // not call finish more than once though.
 //
-// A single lock, nni_aio_lk, is used to protect the flags on the AIO,
-// as well as the expire list on the AIOs.  We will not permit an AIO
-// to be marked done if an expiration is outstanding.
+// Each AIO has its own lock, a_lk, which protects its flags, so that
+// unrelated AIOs never contend with one another.  Each expiration wheel,
+// and each AIO's place in it, is protected by the eq_lk of its queue.
+// An AIO that has no timeout is never on a wheel, and a_inwheel (under
+// a_lk) lets it skip that lock altogether.  When both are needed, the
+// AIO lock is acquired first.  The expire thread
+// works in the other direction, so it marks an AIO as expiring while
+// holding only the expiration lock, and then drops it before taking the
+// AIO lock.  We will not permit an AIO to be marked done if an
+// expiration is outstanding, so the AIO remains valid until the expire
+// thread is done with it.
 //
 // In order to synchronize with the expiration, we set a flag when we
 // are going to cancel due to expiration, and then let the expiration
@@ -47,6 +90,16 @@ static nni_list nni_aio_expire_aios;
 // Provided, of course, that the consumer does not reuse the aio for
 // another operation in the callback.)
 //
+// Completions for AIOs whose consumers have marked them inline are not
+// dispatched when the completing thread has an inline list (see
+// nni_aio_inline_begin).  Instead they are queued on that list, and run
+// by the thread when it calls nni_aio_inline_end, by which time it holds
+// no locks.  The a_deferred flag holds off waiters until the callback
+// has run, much like a_synch.  The thread that deferred a completion
+// may block before it gets around to running it (possibly on this very
+// AIO), so nni_aio_wait hands any deferred completion that has not yet
+// started back to the taskq.
+//
 // In order to guard against aio reuse during teardown, we set a fini
 // flag.  Any attempt to initialize for a new operation after that point
 // will fail and the caller will get NNG_ESTATE indicating this.  The
@@ -54,19 +107,29 @@ static nni_list nni_aio_expire_aios;
 // if it comes back nonzero (NNG_ESTATE) then it must simply discard the
 // request and return.
 
-static void nni_aio_expire_add(nni_aio *);
+static void nni_aio_expire_add(nni_aio_expire_q *, nni_aio *);
 
 int
 nni_aio_init(nni_aio **aiop, nni_cb cb, void *arg)
 {
-	nni_aio *aio;
+	nni_aio * aio;
+	uintptr_t h;
 
 	if ((aio = NNI_ALLOC_STRUCT(aio)) == NULL) {
 		return (NNG_ENOMEM);
 	}
 	memset(aio, 0, sizeof(*aio));
-	nni_cv_init(&aio->a_cv, &nni_aio_lk);
+	nni_mtx_init(&aio->a_lk);
+	nni_cv_init(&aio->a_cv, &aio->a_lk);
 	aio->a_expire = NNI_TIME_NEVER;
+	aio->a_iov    = aio->a_iovinl;
+	nni_plat_atomic_init(&aio->a_spindone, 0);
+
+	// AIOs tend to be allocated alike, so fold in the higher bits too.
+	h = (uintptr_t) aio;
+	h ^= (h >> 13) ^ (h >> 23);
+	h %= (uintptr_t) nni_aio_expire_nqs;
+	aio->a_expire_q = &nni_aio_expire_qs[h];
 	if (arg == NULL) {
 		arg = aio;
 	}
@@ -83,6 +146,7 @@ nni_aio_fini(nni_aio *aio)
 
 		// At this point the AIO is done.
 		nni_cv_fini(&aio->a_cv);
+		nni_mtx_fini(&aio->a_lk);
 
 		NNI_FREE_STRUCT(aio);
 	}
@@ -92,6 +156,7 @@ void
 nni_aio_fini_cb(nni_aio *aio)
 {
 	nni_cv_fini(&aio->a_cv);
+	nni_mtx_fini(&aio->a_lk);
 	NNI_FREE_STRUCT(aio);
 }
 
@@ -105,9 +170,9 @@ void
 nni_aio_stop(nni_aio *aio)
 {
 	if (aio != NULL) {
-		nni_mtx_lock(&nni_aio_lk);
+		nni_mtx_lock(&aio->a_lk);
 		aio->a_fini = 1;
-		nni_mtx_unlock(&nni_aio_lk);
+		nni_mtx_unlock(&aio->a_lk);
 
 		nni_aio_cancel(aio, NNG_ECANCELED);
 
@@ -187,29 +252,70 @@ nni_aio_set_synch(nni_aio *aio)
 	aio->a_synch = 1;
 }
 
+void
+nni_aio_set_inline(nni_aio *aio)
+{
+	aio->a_inline = 1;
+}
+
 void
 nni_aio_wait(nni_aio *aio)
 {
-	nni_mtx_lock(&nni_aio_lk);
+	nni_mtx_lock(&aio->a_lk);
+	if (aio->a_deferred) {
+		nni_aio_inline *ai = aio->a_inline_ctx;
+
+		nni_mtx_lock(ai->ai_lk);
+		if (nni_list_node_active(&aio->a_inline_node)) {
+			// Not started yet, so let the taskq run it instead.
+			nni_list_remove(&ai->ai_aios, aio);
+			aio->a_deferred   = 0;
+			aio->a_inline_ctx = NULL;
+			nni_task_dispatch(&aio->a_task);
+		}
+		nni_mtx_unlock(ai->ai_lk);
+	}
 	// Wait until we're done, and the synchronous completion flag
 	// is cleared (meaning any synch completion is finished).
-	while ((aio->a_active) && ((!aio->a_done) || (aio->a_synch))) {
+	while ((aio->a_active) &&
+	    ((!aio->a_done) || (aio->a_synch) || (aio->a_deferred))) {
 		aio->a_waiting = 1;
 		nni_cv_wait(&aio->a_cv);
 	}
-	nni_mtx_unlock(&nni_aio_lk);
+	nni_mtx_unlock(&aio->a_lk);
 	nni_task_wait(&aio->a_task);
 }
 
+int
+nni_aio_spin(nni_aio *aio, int usec)
+{
+	uint64_t end = 0;
+
+	for (;;) {
+		// Polling the flag, rather than the state behind a_lk, keeps
+		// the spinning thread off the lock the completer needs.  Any
+		// callback still to run is left to nni_aio_wait.
+		if (nni_plat_atomic_get(&aio->a_spindone) != 0) {
+			return (1);
+		}
+		if (end == 0) {
+			end = nni_plat_clock_us() + usec;
+		} else if (nni_plat_clock_us() >= end) {
+			return (0);
+		}
+	}
+}
+
 int
 nni_aio_start(nni_aio *aio, nni_aio_cancelfn cancelfn, void *data)
 {
-	nni_mtx_lock(&nni_aio_lk);
+	nni_mtx_lock(&aio->a_lk);
 	if (aio->a_fini) {
 		// We should not reschedule anything at this point.
 		aio->a_active = 0;
 		aio->a_result = NNG_ECANCELED;
-		nni_mtx_unlock(&nni_aio_lk);
+		nni_plat_atomic_set(&aio->a_spindone, 1);
+		nni_mtx_unlock(&aio->a_lk);
 		return (NNG_ECANCELED);
 	}
 	aio->a_done        = 0;
@@ -219,10 +325,16 @@ nni_aio_start(nni_aio *aio, nni_aio_cancelfn cancelfn, void *data)
 	aio->a_prov_cancel = cancelfn;
 	aio->a_prov_data   = data;
 	aio->a_active      = 1;
+	nni_plat_atomic_set(&aio->a_spindone, 0);
 	if (aio->a_expire != NNI_TIME_NEVER) {
-		nni_aio_expire_add(aio);
+		nni_aio_expire_q *eq = aio->a_expire_q;
+
+		nni_mtx_lock(&eq->eq_lk);
+		nni_aio_expire_add(eq, aio);
+		nni_mtx_unlock(&eq->eq_lk);
+		aio->a_inwheel = 1;
 	}
-	nni_mtx_unlock(&nni_aio_lk);
+	nni_mtx_unlock(&aio->a_lk);
 	return (0);
 }
 
@@ -233,9 +345,9 @@ nni_aio_cancel(nni_aio *aio, int rv)
 {
 	nni_aio_cancelfn cancelfn;
 
-	nni_mtx_lock(&nni_aio_lk);
+	nni_mtx_lock(&aio->a_lk);
 	cancelfn = aio->a_prov_cancel;
-	nni_mtx_unlock(&nni_aio_lk);
+	nni_mtx_unlock(&aio->a_lk);
 
 	// Stop any I/O at the provider level.
 	if (cancelfn != NULL) {
@@ -249,11 +361,24 @@ static void
 nni_aio_finish_impl(
     nni_aio *aio, int result, size_t count, void *pipe, nni_msg *msg)
 {
-	nni_mtx_lock(&nni_aio_lk);
+	int expiring = 0;
+
+	nni_mtx_lock(&aio->a_lk);
 
 	NNI_ASSERT(aio->a_pend == 0); // provider only calls us *once*
 
-	nni_list_node_remove(&aio->a_expire_node);
+	// Only an AIO placed on the wheel can be there, or be expiring.
+	if (aio->a_inwheel) {
+		nni_aio_expire_q *eq = aio->a_expire_q;
+
+		nni_mtx_lock(&eq->eq_lk);
+		nni_list_node_remove(&aio->a_expire_node);
+		expiring = aio->a_expiring;
+		nni_mtx_unlock(&eq->eq_lk);
+		aio->a_inwheel = 0;
+	}
+	aio->a_expire = NNI_TIME_NEVER;
+
 	aio->a_pend        = 1;
 	aio->a_result      = result;
 	aio->a_count       = count;
@@ -265,20 +390,99 @@ nni_aio_finish_impl(
 		aio->a_msg = msg;
 	}
 
-	aio->a_expire = NNI_TIME_NEVER;
-
 	// If we are expiring, then we rely on the expiration thread to
 	// complete this; we must not because the expiration thread is
 	// still holding the reference.
-	if (!aio->a_expiring) {
+	if (!expiring) {
+		nni_aio_inline *ai = NULL;
+
 		aio->a_done = 1;
+		nni_plat_atomic_set(&aio->a_spindone, 1);
+		if (aio->a_inline && nni_aio_inline_inited) {
+			ai = nni_plat_tls_get(&nni_aio_inline_tls);
+		}
+		if ((ai != NULL) && (ai->ai_count < NNI_AIO_INLINE_MAX) &&
+		    (aio->a_task.task_cb != NULL) && (!aio->a_deferred)) {
+			ai->ai_count++;
+			aio->a_deferred   = 1;
+			aio->a_inline_ctx = ai;
+			nni_mtx_lock(ai->ai_lk);
+			nni_list_append(&ai->ai_aios, aio);
+			nni_mtx_unlock(ai->ai_lk);
+		} else {
+			if (aio->a_waiting) {
+				aio->a_waiting = 0;
+				nni_cv_wake(&aio->a_cv);
+			}
+			nni_task_dispatch(&aio->a_task);
+		}
+	}
+	nni_mtx_unlock(&aio->a_lk);
+}
+
+void
+nni_aio_inline_begin(nni_aio_inline *ai)
+{
+	uintptr_t h;
+
+	if (!nni_aio_inline_inited) {
+		return;
+	}
+	if (nni_plat_tls_get(&nni_aio_inline_tls) != NULL) {
+		ai->ai_nested = 1;
+		return;
+	}
+	// These live on thread stacks, which tend to be aligned alike, so
+	// fold in the higher bits too.
+	h = (uintptr_t) ai;
+	h ^= (h >> 13) ^ (h >> 23);
+	ai->ai_lk = &nni_aio_inline_lk[h % NNI_AIO_INLINE_LOCKS];
+	NNI_LIST_INIT(&ai->ai_aios, nni_aio, a_inline_node);
+	ai->ai_count  = 0;
+	ai->ai_nested = 0;
+	nni_plat_tls_set(&nni_aio_inline_tls, ai);
+}
+
+void
+nni_aio_inline_end(nni_aio_inline *ai)
+{
+	nni_aio *aio;
+
+	if ((!nni_aio_inline_inited) || ai->ai_nested) {
+		return;
+	}
+
+	// Only this thread adds to the list, so if it never did we can
+	// skip the lock.  Pollers can get here after the aio framework has
+	// been torn down, so this also keeps them away from the AIOs.
+	if (ai->ai_count == 0) {
+		nni_plat_tls_set(&nni_aio_inline_tls, NULL);
+		return;
+	}
+	for (;;) {
+		nni_mtx_lock(ai->ai_lk);
+		if ((aio = nni_list_first(&ai->ai_aios)) != NULL) {
+			nni_list_remove(&ai->ai_aios, aio);
+		}
+		nni_mtx_unlock(ai->ai_lk);
+		if (aio == NULL) {
+			break;
+		}
+
+		// Callbacks run here may complete further inline AIOs,
+		// which land on our list (up to the limit).
+		aio->a_task.task_cb(aio->a_task.task_arg);
+
+		nni_mtx_lock(&aio->a_lk);
+		aio->a_deferred   = 0;
+		aio->a_inline_ctx = NULL;
 		if (aio->a_waiting) {
 			aio->a_waiting = 0;
 			nni_cv_wake(&aio->a_cv);
 		}
-		nni_task_dispatch(&aio->a_task);
+		nni_mtx_unlock(&aio->a_lk);
 	}
-	nni_mtx_unlock(&nni_aio_lk);
+	nni_plat_tls_set(&nni_aio_inline_tls, NULL);
 }
 
 void
@@ -339,58 +543,175 @@ nni_aio_list_active(nni_aio *aio)
 	return (nni_list_node_active(&aio->a_prov_node));
 }
 
+// nni_aio_wheel_insert places the aio in the wheel, relative to the last
+// tick processed.  Aios already due are placed in the slot for that tick,
+// so callers other than the expire thread must adjust those first.
+static void
+nni_aio_wheel_insert(nni_aio_expire_q *eq, nni_aio *aio)
+{
+	nni_time now   = eq->eq_now;
+	nni_time when  = aio->a_expire;
+	nni_time delta = when > now ? when - now : 0;
+	int      slot;
+
+	for (int l = 0; l < NNI_AIO_WHEEL_LEVELS; l++) {
+		if (delta < NNI_AIO_WHEEL_SPAN(l + 1)) {
+			if (when < now) {
+				when = now;
+			}
+			slot = (int) ((when / NNI_AIO_WHEEL_SPAN(l)) &
+			    NNI_AIO_WHEEL_MASK);
+			nni_list_append(&eq->eq_wheel[l][slot], aio);
+			return;
+		}
+	}
+	nni_list_append(&eq->eq_far, aio);
+}
+
+// nni_aio_wheel_level returns the lowest level holding any aios, or
+// NNI_AIO_WHEEL_LEVELS if only the far list does, or -1 if the wheel
+// is empty.
+static int
+nni_aio_wheel_level(nni_aio_expire_q *eq)
+{
+	for (int l = 0; l < NNI_AIO_WHEEL_LEVELS; l++) {
+		for (int i = 0; i < NNI_AIO_WHEEL_SIZE; i++) {
+			if (!nni_list_empty(&eq->eq_wheel[l][i])) {
+				return (l);
+			}
+		}
+	}
+	return (nni_list_empty(&eq->eq_far) ? -1 : NNI_AIO_WHEEL_LEVELS);
+}
+
 static void
-nni_aio_expire_add(nni_aio *aio)
+nni_aio_wheel_cascade(nni_aio_expire_q *eq, nni_list *list)
 {
-	nni_list *list = &nni_aio_expire_aios;
-	nni_aio * naio;
+	nni_aio *aio;
 
-	// This is a reverse walk of the list.  We're more likely to find
-	// a match at the end of the list.
-	for (naio = nni_list_last(list); naio != NULL;
-	     naio = nni_list_prev(list, naio)) {
-		if (aio->a_expire >= naio->a_expire) {
-			nni_list_insert_after(list, aio, naio);
-			break;
+	while ((aio = nni_list_first(list)) != NULL) {
+		nni_list_remove(list, aio);
+		nni_aio_wheel_insert(eq, aio);
+	}
+}
+
+// nni_aio_wheel_advance processes ticks up to and including now, moving
+// aios that are due to the expired list.
+static void
+nni_aio_wheel_advance(nni_aio_expire_q *eq, nni_time now)
+{
+	nni_list *slot;
+	nni_aio * aio;
+	nni_time  t;
+	int       l;
+
+	while (eq->eq_now < now) {
+		// Nothing happens before the next boundary of the lowest
+		// level in use, so skip straight to it.
+		if ((l = nni_aio_wheel_level(eq)) < 0) {
+			eq->eq_now = now;
+			return;
+		}
+		t = ((eq->eq_now / NNI_AIO_WHEEL_SPAN(l)) + 1) *
+		    NNI_AIO_WHEEL_SPAN(l);
+		if (t > now) {
+			eq->eq_now = now;
+			return;
+		}
+		eq->eq_now = t;
+
+		if ((t % NNI_AIO_WHEEL_SPAN(NNI_AIO_WHEEL_LEVELS)) == 0) {
+			nni_aio_wheel_cascade(eq, &eq->eq_far);
+		}
+		for (l = NNI_AIO_WHEEL_LEVELS - 1; l > 0; l--) {
+			if ((t % NNI_AIO_WHEEL_SPAN(l)) == 0) {
+				int i = (int) ((t / NNI_AIO_WHEEL_SPAN(l)) &
+				    NNI_AIO_WHEEL_MASK);
+				nni_aio_wheel_cascade(eq, &eq->eq_wheel[l][i]);
+			}
+		}
+		slot = &eq->eq_wheel[0][t & NNI_AIO_WHEEL_MASK];
+		while ((aio = nni_list_first(slot)) != NULL) {
+			nni_list_remove(slot, aio);
+			nni_list_append(&eq->eq_aios, aio);
 		}
 	}
-	if (naio == NULL) {
-		// This has the shortest time, so insert at the start.
-		nni_list_prepend(list, aio);
-		// And, as we are the latest, kick the thing.
-		nni_cv_wake(&nni_aio_expire_cv);
+}
+
+// nni_aio_wheel_next returns the next tick at which the wheel needs
+// attention.  This is exact for level 0, and the next cascade otherwise.
+static nni_time
+nni_aio_wheel_next(nni_aio_expire_q *eq)
+{
+	nni_time now = eq->eq_now;
+	int      l;
+
+	if ((l = nni_aio_wheel_level(eq)) < 0) {
+		return (NNI_TIME_NEVER);
+	}
+	if (l == 0) {
+		for (int i = 1; i <= NNI_AIO_WHEEL_SIZE; i++) {
+			nni_time t = now + i;
+			if (!nni_list_empty(
+			        &eq->eq_wheel[0][t & NNI_AIO_WHEEL_MASK])) {
+				return (t);
+			}
+		}
 	}
+	return (((now / NNI_AIO_WHEEL_SPAN(l)) + 1) * NNI_AIO_WHEEL_SPAN(l));
 }
 
 static void
-nni_aio_expire_loop(void *arg)
+nni_aio_expire_add(nni_aio_expire_q *eq, nni_aio *aio)
 {
-	nni_list *       aios = &nni_aio_expire_aios;
-	nni_aio *        aio;
-	nni_time         now;
-	nni_aio_cancelfn cancelfn;
+	nni_time when = aio->a_expire;
 
-	NNI_ARG_UNUSED(arg);
+	// Anything already due goes in the very next tick.
+	if (aio->a_expire <= eq->eq_now) {
+		aio->a_expire = eq->eq_now + 1;
+	}
+	nni_aio_wheel_insert(eq, aio);
+	aio->a_expire = when;
+
+	// If the expire thread is asleep, and would sleep past us, then
+	// wake it up.  (While it is awake, it checks the wheel anyway.)
+	if (when < eq->eq_wake) {
+		eq->eq_wake = when;
+		nni_cv_wake(&eq->eq_cv);
+	}
+}
+
+static void
+nni_aio_expire_loop(void *arg)
+{
+	nni_aio_expire_q *eq   = arg;
+	nni_list *        aios = &eq->eq_aios;
+	nni_aio *         aio;
+	nni_time          next;
+	nni_aio_cancelfn  cancelfn;
 
 	for (;;) {
-		nni_mtx_lock(&nni_aio_lk);
+		nni_mtx_lock(&eq->eq_lk);
 
-		if (nni_aio_expire_run == 0) {
-			nni_mtx_unlock(&nni_aio_lk);
+		if (eq->eq_run == 0) {
+			nni_mtx_unlock(&eq->eq_lk);
 			return;
 		}
 
-		if ((aio = nni_list_first(aios)) == NULL) {
-			nni_cv_wait(&nni_aio_expire_cv);
-			nni_mtx_unlock(&nni_aio_lk);
-			continue;
+		if (nni_list_empty(aios)) {
+			nni_aio_wheel_advance(eq, nni_clock());
 		}
-
-		now = nni_clock();
-		if (now < aio->a_expire) {
-			// Unexpired; the list is ordered, so we just wait.
-			nni_cv_until(&nni_aio_expire_cv, aio->a_expire);
-			nni_mtx_unlock(&nni_aio_lk);
+		if ((aio = nni_list_first(aios)) == NULL) {
+			// Nothing due; sleep until the wheel needs us.
+			next        = nni_aio_wheel_next(eq);
+			eq->eq_wake = next;
+			if (next == NNI_TIME_NEVER) {
+				nni_cv_wait(&eq->eq_cv);
+			} else {
+				nni_cv_until(&eq->eq_cv, next);
+			}
+			eq->eq_wake = 0;
+			nni_mtx_unlock(&eq->eq_lk);
 			continue;
 		}
 
@@ -403,74 +724,127 @@ nni_aio_expire_loop(void *arg)
 		// dispatch on completion won't occur until this is cleared,
 		// and the done flag won't be set either.
 		aio->a_expiring = 1;
-		cancelfn        = aio->a_prov_cancel;
+		nni_mtx_unlock(&eq->eq_lk);
+
+		nni_mtx_lock(&aio->a_lk);
+		cancelfn = aio->a_prov_cancel;
 
 		// Cancel any outstanding activity.  This is always non-NULL
 		// for a valid aio, and becomes NULL only when an AIO is
 		// already being canceled or finished.
 		if (cancelfn != NULL) {
-			nni_mtx_unlock(&nni_aio_lk);
+			nni_mtx_unlock(&aio->a_lk);
 			cancelfn(aio, NNG_ETIMEDOUT);
-			nni_mtx_lock(&nni_aio_lk);
+			nni_mtx_lock(&aio->a_lk);
 		}
 
-		NNI_ASSERT(aio->a_pend); // nni_aio_finish was run
-		NNI_ASSERT(aio->a_prov_cancel == NULL);
+		nni_mtx_lock(&eq->eq_lk);
 		aio->a_expiring = 0;
-		aio->a_done     = 1;
+		nni_mtx_unlock(&eq->eq_lk);
+		if (!aio->a_pend) {
+			// The provider cannot stop the I/O at once, as the
+			// kernel still has the buffers.  It finishes the aio
+			// when the kernel lets go, and that completes it.
+			nni_mtx_unlock(&aio->a_lk);
+			continue;
+		}
+		NNI_ASSERT(aio->a_prov_cancel == NULL);
+		aio->a_done = 1;
+		nni_plat_atomic_set(&aio->a_spindone, 1);
 		if (!aio->a_synch) {
 			nni_task_dispatch(&aio->a_task);
 		} else {
-			nni_mtx_unlock(&nni_aio_lk);
+			nni_mtx_unlock(&aio->a_lk);
 			aio->a_task.task_cb(aio->a_task.task_arg);
-			nni_mtx_lock(&nni_aio_lk);
+			nni_mtx_lock(&aio->a_lk);
 			aio->a_synch = 0;
 		}
 		if (aio->a_waiting) {
 			aio->a_waiting = 0;
 			nni_cv_wake(&aio->a_cv);
 		}
-		nni_mtx_unlock(&nni_aio_lk);
+		nni_mtx_unlock(&aio->a_lk);
 	}
 }
 
 void
 nni_aio_sys_fini(void)
 {
-	nni_mtx *mtx = &nni_aio_lk;
-	nni_cv * cv  = &nni_aio_expire_cv;
-	nni_thr *thr = &nni_aio_expire_thr;
+	for (int i = 0; i < nni_aio_expire_nqs; i++) {
+		nni_aio_expire_q *eq = &nni_aio_expire_qs[i];
 
-	if (nni_aio_expire_run) {
-		nni_mtx_lock(mtx);
-		nni_aio_expire_run = 0;
-		nni_cv_wake(cv);
-		nni_mtx_unlock(mtx);
+		if (eq->eq_run) {
+			nni_mtx_lock(&eq->eq_lk);
+			eq->eq_run = 0;
+			nni_cv_wake(&eq->eq_cv);
+			nni_mtx_unlock(&eq->eq_lk);
+		}
+		nni_thr_fini(&eq->eq_thr);
+		nni_cv_fini(&eq->eq_cv);
+		nni_mtx_fini(&eq->eq_lk);
 	}
-
-	nni_thr_fini(thr);
-	nni_cv_fini(cv);
-	nni_mtx_fini(mtx);
+	if (nni_aio_expire_qs != NULL) {
+		nni_free(nni_aio_expire_qs,
+		    nni_aio_expire_nqs * sizeof(nni_aio_expire_q));
+		nni_aio_expire_qs = NULL;
+	}
+	nni_aio_expire_nqs = 0;
 }
 
 int
 nni_aio_sys_init(void)
 {
-	int      rv;
-	nni_mtx *mtx = &nni_aio_lk;
-	nni_cv * cv  = &nni_aio_expire_cv;
-	nni_thr *thr = &nni_aio_expire_thr;
+	int               rv;
+	int               n;
+	nni_aio_expire_q *eq;
 
-	NNI_LIST_INIT(&nni_aio_expire_aios, nni_aio, a_expire_node);
-	nni_mtx_init(mtx);
-	nni_cv_init(cv, mtx);
+	// The thread local key and the inline list locks are created once
+	// and never destroyed, since pollers may still use them during
+	// shutdown.
+	if (!nni_aio_inline_inited) {
+		if ((rv = nni_plat_tls_init(&nni_aio_inline_tls, NULL)) != 0) {
+			return (rv);
+		}
+		for (int i = 0; i < NNI_AIO_INLINE_LOCKS; i++) {
+			nni_mtx_init(&nni_aio_inline_lk[i]);
+		}
+		nni_aio_inline_inited = 1;
+	}
 
-	if ((rv = nni_thr_init(thr, nni_aio_expire_loop, NULL)) != 0) {
-		nni_aio_sys_fini();
-		return (rv);
+	if ((n = nni_plat_ncpu()) < 1) {
+		n = 1;
+	}
+	if ((nni_aio_expire_qs = nni_alloc(n * sizeof(*eq))) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	memset(nni_aio_expire_qs, 0, n * sizeof(*eq));
+	nni_aio_expire_nqs = n;
+
+	for (int q = 0; q < n; q++) {
+		eq = &nni_aio_expire_qs[q];
+		NNI_LIST_INIT(&eq->eq_aios, nni_aio, a_expire_node);
+		NNI_LIST_INIT(&eq->eq_far, nni_aio, a_expire_node);
+		for (int l = 0; l < NNI_AIO_WHEEL_LEVELS; l++) {
+			for (int i = 0; i < NNI_AIO_WHEEL_SIZE; i++) {
+				nni_list *slot = &eq->eq_wheel[l][i];
+				NNI_LIST_INIT(slot, nni_aio, a_expire_node);
+			}
+		}
+		eq->eq_now  = nni_clock();
+		eq->eq_wake = 0;
+		nni_mtx_init(&eq->eq_lk);
+		nni_cv_init(&eq->eq_cv, &eq->eq_lk);
 	}
 
-	nni_aio_expire_run = 1;
-	nni_thr_run(thr);
+	for (int q = 0; q < n; q++) {
+		eq = &nni_aio_expire_qs[q];
+		rv = nni_thr_init(&eq->eq_thr, nni_aio_expire_loop, eq);
+		if (rv != 0) {
+			nni_aio_sys_fini();
+			return (rv);
+		}
+		eq->eq_run = 1;
+		nni_thr_run(&eq->eq_thr);
+	}
 	return (0);
 }
@@ -20,6 +20,11 @@ typedef struct nni_aio_ops nni_aio_ops;
 
 typedef void (*nni_aio_cancelfn)(nni_aio *, int);
 
+// NNI_AIO_MAX_IOV is the maximum number of I/O vector elements that may
+// be used with an aio.  This needs to be enough for a protocol header,
+// the message header, and several message body segments.
+#define NNI_AIO_MAX_IOV 8
+
 // An nni_aio is an async I/O handle.
 struct nni_aio {
 	int      a_result; // Result code (nng_errno)
@@ -27,21 +32,39 @@ struct nni_aio {
 	nni_time a_expire;
 
 	// These fields are private to the aio framework.
+	nni_mtx  a_lk;
 	nni_cv   a_cv;
 	unsigned a_fini : 1;     // shutting down (no new operations)
 	unsigned a_done : 1;     // operation has completed
 	unsigned a_pend : 1;     // completion routine pending
 	unsigned a_active : 1;   // aio was started
-	unsigned a_expiring : 1; // expiration callback in progress
 	unsigned a_waiting : 1;  // a thread is waiting for this to finish
 	unsigned a_synch : 1;    // run completion synchronously
 	unsigned a_reltime : 1;  // expiration time is relative
-	unsigned a_pad : 25;     // ensure 32-bit alignment
+	unsigned a_inline : 1;   // completion may run on finishing thread
+	unsigned a_deferred : 1; // inline completion queued or running
+	unsigned a_inwheel : 1;  // placed on the expiration wheel
+	unsigned a_pad : 23;     // ensure 32-bit alignment
 	nni_task a_task;
 
-	// Read/write operations.
-	nni_iov a_iov[4];
-	int     a_niov;
+	// Set along with a_done (or when the aio fails to start), so that
+	// nni_aio_spin can poll for completion without taking a_lk.
+	nni_plat_atomic a_spindone;
+
+	// Expiration, protected by the expiration lock rather than a_lk.
+	// a_expiring is kept out of the bit fields above for that reason.
+	int                      a_expiring; // expiration callback in progress
+	struct nni_aio_expire_q *a_expire_q; // fixed at init
+
+	// Inline completion.
+	nni_list_node          a_inline_node;
+	struct nni_aio_inline *a_inline_ctx;
+
+	// Read/write operations.  a_iov normally points at a_iovinl, but a
+	// provider may point it at a longer vector of its own.
+	nni_iov *a_iov;
+	int      a_niov;
+	nni_iov  a_iovinl[NNI_AIO_MAX_IOV];
 
 	// Message operations.
 	nni_msg *a_msg;
@@ -53,6 +76,11 @@ struct nni_aio {
 	// Resolver operations.
 	nni_sockaddr *a_addr;
 
+	// Datagram operations.  When non-zero, the payload holds several
+	// datagrams of this size (the last may be shorter).  See
+	// nni_plat_udp_segment.
+	size_t a_segsz;
+
 	// Extra user data.
 	void *a_data;
 
@@ -60,6 +88,7 @@ struct nni_aio {
 	nni_aio_cancelfn a_prov_cancel;
 	void *           a_prov_data;
 	nni_list_node    a_prov_node;
+	uint32_t         a_prov_seq;
 
 	// Expire node.
 	nni_list_node a_expire_node;
@@ -122,6 +151,43 @@ extern void *   nni_aio_get_ep(nni_aio *);
 // completion callback.
 void nni_aio_set_synch(nni_aio *);
 
+// nni_aio_set_inline marks the AIO's completion callback as short and
+// non-blocking.  Such callbacks may be run directly on the thread that
+// completed the operation, once that thread has dropped its locks,
+// rather than being handed to the taskq.  The callback must not free
+// the AIO, and must not wait for other I/O.  This is a property of the
+// consumer's callback, and remains set for the life of the AIO.
+extern void nni_aio_set_inline(nni_aio *);
+
+// NNI_AIO_INLINE_MAX bounds the number of completions that may be run
+// inline by a thread before it returns to its own work.  Completions
+// that run inline frequently start new operations that complete inline
+// in turn; this keeps such chains from starving the thread.  Once the
+// limit is reached, further completions go to the taskq.
+#ifndef NNI_AIO_INLINE_MAX
+#define NNI_AIO_INLINE_MAX 16
+#endif
+
+// nni_aio_inline holds completions deferred by a thread for inline
+// execution.  It is private to the aio framework, but is declared here
+// so that callers of nni_aio_inline_begin can keep it on the stack.
+typedef struct nni_aio_inline {
+	nni_mtx *ai_lk; // protects ai_aios
+	nni_list ai_aios;
+	int      ai_count;
+	int      ai_nested;
+} nni_aio_inline;
+
+// nni_aio_inline_begin and nni_aio_inline_end bracket work done by a
+// completion thread (a taskq thread or a poller, for example).  Between
+// them, AIOs marked with nni_aio_set_inline that finish on this thread
+// are recorded rather than dispatched, and nni_aio_inline_end runs their
+// callbacks.  The caller must not hold any locks when calling
+// nni_aio_inline_end.  These calls may nest, in which case only the
+// outermost pair has any effect.
+extern void nni_aio_inline_begin(nni_aio_inline *);
+extern void nni_aio_inline_end(nni_aio_inline *);
+
 // nni_aio_set_timeout sets the timeout (absolute) when the AIO will
 // be canceled.  The cancelation does not happen until after nni_aio_start
 // is called.
@@ -146,6 +212,12 @@ extern size_t nni_aio_count(nni_aio *);
 // lieu of a callback to build synchronous constructs on top of AIOs.
 extern void nni_aio_wait(nni_aio *);
 
+// nni_aio_spin busy-waits, without sleeping, for up to the given number
+// of microseconds for the operation to complete.  It returns nonzero if
+// it did, in which case nni_aio_wait will not block for long.  This
+// trades CPU time for the latency of a sleep and wakeup.
+extern int nni_aio_spin(nni_aio *, int);
+
 // nni_aio_list_init creates a list suitable for use by providers using
 // the a_prov_node member of the aio.  These operations are not locked,
 // but they do have some extra checks -- remove is idempotent for example,
@@ -165,6 +237,8 @@ extern void nni_aio_finish_msg(nni_aio *, nni_msg *);
 // nni_aio_cancel is used to cancel an operation.  Any pending I/O or
 // timeouts are canceled if possible, and the callback will be returned
 // with the indicated result (NNG_ECLOSED or NNG_ECANCELED is recommended.)
+// A provider whose I/O is already in the kernel's hands may be unable to
+// stop it; it then finishes the aio once the kernel is done with it.
 extern void nni_aio_cancel(nni_aio *, int rv);
 
 extern int nni_aio_start(nni_aio *, nni_aio_cancelfn, void *);
@@ -15,6 +15,13 @@
 
 extern nni_time nni_clock(void);
 
+// nni_clock_coarse returns a cheaper approximation of nni_clock, which
+// may be ahead of it by a few milliseconds (up to two scheduler ticks),
+// but is never behind.  Use it to compute deadlines and to age things on
+// hot paths.  Use nni_clock when deciding whether a deadline has passed,
+// or when measuring short intervals.
+extern nni_time nni_clock_coarse(void);
+
 extern void nni_msleep(nni_duration);
 
 #endif // CORE_CLOCK_H
@@ -18,7 +18,8 @@ nni_init_helper(void)
 {
 	int rv;
 
-	if (((rv = nni_taskq_sys_init()) != 0) ||
+	if (((rv = nni_msgpool_sys_init()) != 0) ||
+	    ((rv = nni_taskq_sys_init()) != 0) ||
 	    ((rv = nni_timer_sys_init()) != 0) ||
 	    ((rv = nni_aio_sys_init()) != 0) ||
 	    ((rv = nni_random_sys_init()) != 0) ||
@@ -50,5 +51,6 @@ nni_fini(void)
 	nni_aio_sys_fini();
 	nni_timer_sys_fini();
 	nni_taskq_sys_fini();
+	nni_msgpool_sys_fini();
 	nni_plat_fini();
 }
@@ -16,18 +16,57 @@
 
 // Message API.
 
+// Shared chunk buffer.  This tracks the users of a buffer that is
+// referenced by more than one chunk, or that belongs to the application
+// (an "external" buffer).  External buffers are released by calling the
+// application supplied function, and are never modified by us.
+typedef struct {
+	nni_plat_atomic cr_refcnt;
+	void (*cr_free)(void *, size_t, void *); // NULL unless external
+	void *cr_arg;
+} nni_chunk_ref;
+
 // Message chunk, internal to the message implementation.
+//
+// The underlying buffer of a chunk may be shared by several messages,
+// which happens when messages are duplicated (e.g. for fanout by pub/sub,
+// bus, or survey).  In that case ch_ref points to a reference count for the
+// buffer.  Every sharer has its own view (ch_ptr and ch_len) of the data,
+// so operations that merely adjust the view, such as trimming, can be done
+// without copying.  Anything that writes to the buffer must first obtain a
+// private copy with nni_chunk_unshare.
 typedef struct {
-	size_t   ch_cap; // allocated size
-	size_t   ch_len; // length in use
-	uint8_t *ch_buf; // underlying buffer
-	uint8_t *ch_ptr; // pointer to actual data
+	size_t         ch_cap; // allocated size
+	size_t         ch_len; // length in use
+	uint8_t *      ch_buf; // underlying buffer
+	uint8_t *      ch_ptr; // pointer to actual data
+	nni_chunk_ref *ch_ref; // reference count if shared or external
 } nni_chunk;
 
+// Additional body segment.  Large message bodies that are built up by
+// appending are not reallocated and copied each time they grow; instead
+// further data is placed in a list of segments following the main body
+// chunk.  Transports can send the segments directly with scatter/gather
+// I/O (see nni_msg_body_iov), and the body is only flattened into a single
+// contiguous buffer when someone asks for a pointer to it.
+typedef struct {
+	nni_chunk     ms_chunk;
+	nni_list_node ms_node;
+} nni_msgseg;
+
+// Appends that would grow the main body chunk beyond this size (and which
+// do not fit in it already) go to segments instead.  Each new segment is at
+// least this big, and at least as big as the message so far, so that the
+// number of segments grows only logarithmically.
+#define NNI_MSG_SEGSZ 65536
+
 // Underlying message structure.
 struct nng_msg {
 	nni_chunk m_header;
 	nni_chunk m_body;
+	nni_list  m_segs;   // more body data, after m_body
+	size_t    m_seglen; // total length of data in m_segs
+	int       m_nsegs;  // number of segments in m_segs
 	nni_time  m_expire; // usec
 	nni_list  m_options;
 	uint32_t  m_pipe; // set on receive
@@ -100,10 +139,14 @@ nni_msg_dump(const char *banner, const nni_msg *msg)
 // Note that having some headroom is useful when data must be prepended
 // to a message - it avoids having to perform extra data copies, so we
 // encourage initial allocations to start with sufficient room.
+//
+// The new space is not initialized; callers that need zeroed data must
+// clear it themselves.
 static int
 nni_chunk_grow(nni_chunk *ch, size_t newsz, size_t headwanted)
 {
 	size_t   headroom = 0;
+	size_t   newcap;
 	uint8_t *newbuf;
 
 	// We assume that if the pointer is a valid pointer, and inside
@@ -138,15 +181,16 @@ nni_chunk_grow(nni_chunk *ch, size_t newsz, size_t headwanted)
 			newsz = ch->ch_cap - headroom;
 		}
 
-		if ((newbuf = nni_alloc(newsz + headwanted)) == NULL) {
+		newcap = nni_msgpool_size(newsz + headwanted);
+		if ((newbuf = nni_msgpool_alloc_uninit(newcap)) == NULL) {
 			return (NNG_ENOMEM);
 		}
 		// Copy all the data, but not header or trailer.
 		memcpy(newbuf + headwanted, ch->ch_ptr, ch->ch_len);
-		nni_free(ch->ch_buf, ch->ch_cap);
+		nni_msgpool_free(ch->ch_buf, ch->ch_cap);
 		ch->ch_buf = newbuf;
 		ch->ch_ptr = newbuf + headwanted;
-		ch->ch_cap = newsz + headwanted;
+		ch->ch_cap = newcap;
 		return (0);
 	}
 
@@ -154,11 +198,12 @@ nni_chunk_grow(nni_chunk *ch, size_t newsz, size_t headwanted)
 	// the backing store.  In this case, we just check against the
 	// allocated capacity and grow, or don't grow.
 	if ((newsz + headwanted) >= ch->ch_cap) {
-		if ((newbuf = nni_alloc(newsz + headwanted)) == NULL) {
+		newcap = nni_msgpool_size(newsz + headwanted);
+		if ((newbuf = nni_msgpool_alloc_uninit(newcap)) == NULL) {
 			return (NNG_ENOMEM);
 		}
-		nni_free(ch->ch_buf, ch->ch_cap);
-		ch->ch_cap = newsz + headwanted;
+		nni_msgpool_free(ch->ch_buf, ch->ch_cap);
+		ch->ch_cap = newcap;
 		ch->ch_buf = newbuf;
 	}
 
@@ -169,9 +214,24 @@ nni_chunk_grow(nni_chunk *ch, size_t newsz, size_t headwanted)
 static void
 nni_chunk_free(nni_chunk *ch)
 {
+	nni_chunk_ref *ref;
+
+	if ((ref = ch->ch_ref) != NULL) {
+		if (nni_plat_atomic_dec(&ref->cr_refcnt) != 0) {
+			// Someone else still has it.
+			ch->ch_buf = NULL;
+		} else {
+			if (ref->cr_free != NULL) {
+				ref->cr_free(ch->ch_buf, ch->ch_cap, ref->cr_arg);
+				ch->ch_buf = NULL;
+			}
+			nni_msgpool_free(ref, sizeof(*ref));
+		}
+	}
 	if ((ch->ch_cap != 0) && (ch->ch_buf != NULL)) {
-		nni_free(ch->ch_buf, ch->ch_cap);
+		nni_msgpool_free(ch->ch_buf, ch->ch_cap);
 	}
+	ch->ch_ref = NULL;
 	ch->ch_ptr = NULL;
 	ch->ch_buf = NULL;
 	ch->ch_len = 0;
@@ -217,16 +277,68 @@ nni_chunk_trim(nni_chunk *ch, size_t len)
 static int
 nni_chunk_dup(nni_chunk *dst, const nni_chunk *src)
 {
-	if ((dst->ch_buf = nni_alloc(src->ch_cap)) == NULL) {
+	if ((dst->ch_buf = nni_msgpool_alloc_uninit(src->ch_cap)) == NULL) {
 		return (NNG_ENOMEM);
 	}
 	dst->ch_cap = src->ch_cap;
 	dst->ch_len = src->ch_len;
 	dst->ch_ptr = dst->ch_buf + (src->ch_ptr - src->ch_buf);
+	dst->ch_ref = NULL;
 	memcpy(dst->ch_ptr, src->ch_ptr, dst->ch_len);
 	return (0);
 }
 
+// nni_chunk_share makes the destination chunk refer to the same buffer
+// as the source, without copying the data.  The source chunk is modified
+// to note that its buffer is now shared.
+static int
+nni_chunk_share(nni_chunk *dst, nni_chunk *src)
+{
+	if (src->ch_buf == NULL) {
+		// Nothing to share, just copy the (empty) view.
+		*dst = *src;
+		return (0);
+	}
+	if (src->ch_ref == NULL) {
+		src->ch_ref = nni_msgpool_alloc(sizeof(*src->ch_ref));
+		if (src->ch_ref == NULL) {
+			return (NNG_ENOMEM);
+		}
+		nni_plat_atomic_init(&src->ch_ref->cr_refcnt, 1);
+	}
+	nni_plat_atomic_inc(&src->ch_ref->cr_refcnt);
+	*dst = *src;
+	return (0);
+}
+
+// nni_chunk_unshare ensures that the chunk has a private copy of its
+// buffer, so that it is safe to modify.  If we are the only remaining user
+// of a shared buffer, then we just take ownership of it, unless it is an
+// external buffer, which we always copy.
+static int
+nni_chunk_unshare(nni_chunk *ch)
+{
+	nni_chunk_ref *ref;
+	nni_chunk      copy;
+	int            rv;
+
+	if ((ref = ch->ch_ref) == NULL) {
+		return (0);
+	}
+	if ((ref->cr_free == NULL) &&
+	    (nni_plat_atomic_get(&ref->cr_refcnt) == 1)) {
+		nni_msgpool_free(ref, sizeof(*ref));
+		ch->ch_ref = NULL;
+		return (0);
+	}
+	if ((rv = nni_chunk_dup(&copy, ch)) != 0) {
+		return (rv);
+	}
+	nni_chunk_free(ch);
+	*ch = copy;
+	return (0);
+}
+
 // nni_chunk_append appends the data to the chunk, growing as necessary.
 // If the data pointer is NULL, then the chunk data region is allocated,
 // but uninitialized.
@@ -238,6 +350,9 @@ nni_chunk_append(nni_chunk *ch, const void *data, size_t len)
 	if (len == 0) {
 		return (0);
 	}
+	if ((rv = nni_chunk_unshare(ch)) != 0) {
+		return (rv);
+	}
 	if ((rv = nni_chunk_grow(ch, len + ch->ch_len, 0)) != 0) {
 		return (rv);
 	}
@@ -259,6 +374,9 @@ nni_chunk_insert(nni_chunk *ch, const void *data, size_t len)
 {
 	int rv;
 
+	if ((rv = nni_chunk_unshare(ch)) != 0) {
+		return (rv);
+	}
 	if (ch->ch_ptr == NULL) {
 		ch->ch_ptr = ch->ch_buf;
 	}
@@ -324,19 +442,20 @@ nni_chunk_chop_u32(nni_chunk *ch)
 }
 
 int
-nni_msg_alloc(nni_msg **mp, size_t sz)
+nni_msg_alloc_uninit(nni_msg **mp, size_t sz)
 {
 	nni_msg *m;
+	size_t   tail;
 	int      rv;
 
-	if ((m = NNI_ALLOC_STRUCT(m)) == NULL) {
+	if ((m = nni_msgpool_alloc(sizeof(*m))) == NULL) {
 		return (NNG_ENOMEM);
 	}
 
 	// 64-bytes of header, including room for 32 bytes
 	// of headroom and 32 bytes of trailer.
 	if ((rv = nni_chunk_grow(&m->m_header, 32, 32)) != 0) {
-		NNI_FREE_STRUCT(m);
+		nni_msgpool_free(m, sizeof(*m));
 		return (rv);
 	}
 
@@ -352,42 +471,225 @@ nni_msg_alloc(nni_msg **mp, size_t sz)
 	}
 	if (rv != 0) {
 		nni_chunk_free(&m->m_header);
-		NNI_FREE_STRUCT(m);
+		nni_msgpool_free(m, sizeof(*m));
+		return (rv);
 	}
 	if ((rv = nni_chunk_append(&m->m_body, NULL, sz)) != 0) {
 		// Should not happen since we just grew it to fit.
 		nni_panic("chunk_append failed");
 	}
 
+	// We clear a little of the space past the end of the body, so
+	// that there is always a terminating zero following the data.
+	// Clearing the entire buffer would defeat the purpose.
+	tail = m->m_body.ch_cap - (size_t)(m->m_body.ch_ptr - m->m_body.ch_buf);
+	tail -= sz;
+	memset(m->m_body.ch_ptr + sz, 0, tail < 32 ? tail : 32);
+
+	NNI_LIST_INIT(&m->m_options, nni_msgopt, mo_node);
+	NNI_LIST_INIT(&m->m_segs, nni_msgseg, ms_node);
+	*mp = m;
+	return (0);
+}
+
+// nni_chunk_room returns the space available for appending to the chunk
+// without having to reallocate or copy it.
+static size_t
+nni_chunk_room(const nni_chunk *ch)
+{
+	if (ch->ch_ref != NULL) {
+		return (0); // Shared, so it must be copied.
+	}
+	if (ch->ch_ptr == NULL) {
+		return (ch->ch_cap);
+	}
+	return (ch->ch_cap - (size_t)(ch->ch_ptr - ch->ch_buf) - ch->ch_len);
+}
+
+static void
+nni_msg_seg_free(nni_msg *m, nni_msgseg *seg)
+{
+	nni_list_remove(&m->m_segs, seg);
+	m->m_nsegs--;
+	m->m_seglen -= seg->ms_chunk.ch_len;
+	nni_chunk_free(&seg->ms_chunk);
+	nni_msgpool_free(seg, sizeof(*seg));
+}
+
+static void
+nni_msg_segs_free(nni_msg *m)
+{
+	nni_msgseg *seg;
+
+	while ((seg = nni_list_first(&m->m_segs)) != NULL) {
+		nni_msg_seg_free(m, seg);
+	}
+}
+
+// nni_msg_flatten moves any segments into the main body chunk, so that the
+// body is contiguous.
+static int
+nni_msg_flatten(nni_msg *m)
+{
+	nni_chunk * ch = &m->m_body;
+	nni_msgseg *seg;
+	int         rv;
+
+	if (m->m_nsegs == 0) {
+		return (0);
+	}
+	if (((rv = nni_chunk_unshare(ch)) != 0) ||
+	    ((rv = nni_chunk_grow(ch, ch->ch_len + m->m_seglen, 0)) != 0)) {
+		return (rv);
+	}
+	if (ch->ch_ptr == NULL) {
+		ch->ch_ptr = ch->ch_buf;
+	}
+	while ((seg = nni_list_first(&m->m_segs)) != NULL) {
+		memcpy(ch->ch_ptr + ch->ch_len, seg->ms_chunk.ch_ptr,
+		    seg->ms_chunk.ch_len);
+		ch->ch_len += seg->ms_chunk.ch_len;
+		nni_msg_seg_free(m, seg);
+	}
+	return (0);
+}
+
+// nni_msg_copyout copies data out of the body, which may span segments,
+// without flattening it.  The range must be valid.
+static void
+nni_msg_copyout(nni_msg *m, size_t off, void *buf, size_t len)
+{
+	uint8_t *   dst = buf;
+	nni_chunk * ch  = &m->m_body;
+	nni_msgseg *seg = nni_list_first(&m->m_segs);
+	size_t      n;
+
+	while (len > 0) {
+		if (off < ch->ch_len) {
+			n = ch->ch_len - off;
+			if (n > len) {
+				n = len;
+			}
+			memcpy(dst, ch->ch_ptr + off, n);
+			dst += n;
+			len -= n;
+			off = 0;
+		} else {
+			off -= ch->ch_len;
+		}
+		if (len > 0) {
+			NNI_ASSERT(seg != NULL);
+			ch  = &seg->ms_chunk;
+			seg = nni_list_next(&m->m_segs, seg);
+		}
+	}
+}
+
+// nni_msg_ext_nofree is used for external buffers where the caller did
+// not supply a function, because the memory does not need to be freed.
+static void
+nni_msg_ext_nofree(void *ptr, size_t len, void *arg)
+{
+	NNI_ARG_UNUSED(ptr);
+	NNI_ARG_UNUSED(len);
+	NNI_ARG_UNUSED(arg);
+}
+
+int
+nni_msg_alloc_external(nni_msg **mp, void *ptr, size_t len,
+    void (*fn)(void *, size_t, void *), void *arg)
+{
+	nni_msg *      m;
+	nni_chunk_ref *ref;
+	int            rv;
+
+	if ((m = nni_msgpool_alloc(sizeof(*m))) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	if ((ref = nni_msgpool_alloc(sizeof(*ref))) == NULL) {
+		nni_msgpool_free(m, sizeof(*m));
+		return (NNG_ENOMEM);
+	}
+	if ((rv = nni_chunk_grow(&m->m_header, 32, 32)) != 0) {
+		nni_msgpool_free(ref, sizeof(*ref));
+		nni_msgpool_free(m, sizeof(*m));
+		return (rv);
+	}
+
+	nni_plat_atomic_init(&ref->cr_refcnt, 1);
+	ref->cr_free = fn != NULL ? fn : nni_msg_ext_nofree;
+	ref->cr_arg  = arg;
+
+	m->m_body.ch_buf = ptr;
+	m->m_body.ch_ptr = ptr;
+	m->m_body.ch_cap = len;
+	m->m_body.ch_len = len;
+	m->m_body.ch_ref = ref;
+
 	NNI_LIST_INIT(&m->m_options, nni_msgopt, mo_node);
+	NNI_LIST_INIT(&m->m_segs, nni_msgseg, ms_node);
 	*mp = m;
 	return (0);
 }
 
+int
+nni_msg_alloc(nni_msg **mp, size_t sz)
+{
+	int rv;
+
+	if ((rv = nni_msg_alloc_uninit(mp, sz)) == 0) {
+		memset(nni_msg_body(*mp), 0, sz);
+	}
+	return (rv);
+}
+
 int
 nni_msg_dup(nni_msg **dup, const nni_msg *src)
 {
 	nni_msg *   m;
 	nni_msgopt *mo;
 	nni_msgopt *newmo;
+	nni_msgseg *seg;
+	nni_msgseg *newseg;
 	int         rv;
 
-	if ((m = NNI_ALLOC_STRUCT(m)) == NULL) {
+	if ((m = nni_msgpool_alloc(sizeof(*m))) == NULL) {
 		return (NNG_ENOMEM);
 	}
 	memset(m, 0, sizeof(*m));
 	NNI_LIST_INIT(&m->m_options, nni_msgopt, mo_node);
+	NNI_LIST_INIT(&m->m_segs, nni_msgseg, ms_node);
 
 	if ((rv = nni_chunk_dup(&m->m_header, &src->m_header)) != 0) {
-		NNI_FREE_STRUCT(m);
+		nni_msgpool_free(m, sizeof(*m));
 		return (rv);
 	}
-	if ((rv = nni_chunk_dup(&m->m_body, &src->m_body)) != 0) {
+	// The body is shared rather than copied; it will be copied later
+	// only if one of the messages is modified.  This changes the source
+	// message, but only in a way that is invisible to its owner.
+	rv = nni_chunk_share(&m->m_body, (nni_chunk *) &src->m_body);
+	if (rv != 0) {
 		nni_chunk_free(&m->m_header);
-		NNI_FREE_STRUCT(m);
+		nni_msgpool_free(m, sizeof(*m));
 		return (rv);
 	}
 
+	NNI_LIST_FOREACH (&src->m_segs, seg) {
+		if ((newseg = nni_msgpool_alloc(sizeof(*newseg))) == NULL) {
+			nni_msg_free(m);
+			return (NNG_ENOMEM);
+		}
+		if ((rv = nni_chunk_share(&newseg->ms_chunk, &seg->ms_chunk)) !=
+		    0) {
+			nni_msgpool_free(newseg, sizeof(*newseg));
+			nni_msg_free(m);
+			return (rv);
+		}
+		nni_list_append(&m->m_segs, newseg);
+		m->m_nsegs++;
+		m->m_seglen += newseg->ms_chunk.ch_len;
+	}
+
 	NNI_LIST_FOREACH (&src->m_options, mo) {
 		newmo = nni_alloc(sizeof(*newmo) + mo->mo_sz);
 		if (newmo == NULL) {
@@ -413,11 +715,12 @@ nni_msg_free(nni_msg *m)
 	if (m != NULL) {
 		nni_chunk_free(&m->m_header);
 		nni_chunk_free(&m->m_body);
+		nni_msg_segs_free(m);
 		while ((mo = nni_list_first(&m->m_options)) != NULL) {
 			nni_list_remove(&m->m_options, mo);
 			nni_free(mo, sizeof(*mo) + mo->mo_sz);
 		}
-		NNI_FREE_STRUCT(m);
+		nni_msgpool_free(m, sizeof(*m));
 	}
 }
 
@@ -475,18 +778,13 @@ nni_msg_getopt(nni_msg *m, int opt, void *val, size_t *szp)
 int
 nni_msg_realloc(nni_msg *m, size_t sz)
 {
-	int rv = 0;
+	size_t len = nni_msg_len(m);
 
-	if (m->m_body.ch_len < sz) {
-		rv = nni_chunk_append(&m->m_body, NULL, sz - m->m_body.ch_len);
-		if (rv != 0) {
-			return (rv);
-		}
-	} else {
-		// "Shrinking", just mark bytes at end usable again.
-		nni_chunk_chop(&m->m_body, m->m_body.ch_len - sz);
+	if (len < sz) {
+		return (nni_msg_append(m, NULL, sz - len));
 	}
-	return (0);
+	// "Shrinking", just mark bytes at end usable again.
+	return (nni_msg_chop(m, len - sz));
 }
 
 void *
@@ -504,19 +802,118 @@ nni_msg_header_len(const nni_msg *m)
 void *
 nni_msg_body(nni_msg *m)
 {
+	// Callers expect a contiguous body.
+	if (nni_msg_flatten(m) != 0) {
+		return (NULL);
+	}
 	return (m->m_body.ch_ptr);
 }
 
+int
+nni_msg_body_iov(nni_msg *m, nni_iov *iov, int *niovp)
+{
+	nni_msgseg *seg;
+	int         niov;
+	int         rv;
+
+	niov = m->m_nsegs + 1;
+	if ((niov > *niovp) && ((rv = nni_msg_flatten(m)) != 0)) {
+		return (rv);
+	}
+	niov = 0;
+	if (m->m_body.ch_len > 0) {
+		iov[niov].iov_buf = m->m_body.ch_ptr;
+		iov[niov].iov_len = m->m_body.ch_len;
+		niov++;
+	}
+	NNI_LIST_FOREACH (&m->m_segs, seg) {
+		if (seg->ms_chunk.ch_len > 0) {
+			iov[niov].iov_buf = seg->ms_chunk.ch_ptr;
+			iov[niov].iov_len = seg->ms_chunk.ch_len;
+			niov++;
+		}
+	}
+	*niovp = niov;
+	return (0);
+}
+
+int
+nni_msg_unshare(nni_msg *m)
+{
+	int rv;
+
+	if ((rv = nni_msg_flatten(m)) != 0) {
+		return (rv);
+	}
+	return (nni_chunk_unshare(&m->m_body));
+}
+
 size_t
 nni_msg_len(const nni_msg *m)
 {
-	return (m->m_body.ch_len);
+	return (m->m_body.ch_len + m->m_seglen);
 }
 
 int
 nni_msg_append(nni_msg *m, const void *data, size_t len)
 {
-	return (nni_chunk_append(&m->m_body, data, len));
+	nni_msgseg *seg = NULL;
+	nni_chunk * ch;
+	size_t      n;
+	int         rv;
+
+	if (m->m_nsegs == 0) {
+		ch = &m->m_body;
+		// If it fits, or the body is still small, then just grow it.
+		if ((len <= nni_chunk_room(ch)) ||
+		    ((ch->ch_len + len) <= NNI_MSG_SEGSZ)) {
+			return (nni_chunk_append(ch, data, len));
+		}
+	} else {
+		ch = &((nni_msgseg *) nni_list_last(&m->m_segs))->ms_chunk;
+	}
+
+	// Fill any room left in the last chunk, and put the rest in a new
+	// segment.  We allocate the segment first, so that we do not have
+	// to undo anything if that fails.
+	if ((n = nni_chunk_room(ch)) > len) {
+		n = len;
+	}
+	if (n < len) {
+		size_t sz = nni_msg_len(m);
+
+		if (sz < (len - n)) {
+			sz = len - n;
+		}
+		if (sz < NNI_MSG_SEGSZ) {
+			sz = NNI_MSG_SEGSZ;
+		}
+		if ((seg = nni_msgpool_alloc(sizeof(*seg))) == NULL) {
+			return (NNG_ENOMEM);
+		}
+		if ((rv = nni_chunk_grow(&seg->ms_chunk, sz, 0)) != 0) {
+			nni_msgpool_free(seg, sizeof(*seg));
+			return (rv);
+		}
+	}
+	if (n > 0) {
+		// This cannot fail, as there is room for it.
+		(void) nni_chunk_append(ch, data, n);
+		if (ch != &m->m_body) {
+			m->m_seglen += n;
+		}
+		if (data != NULL) {
+			data = ((const uint8_t *) data) + n;
+		}
+		len -= n;
+	}
+	if (seg != NULL) {
+		(void) nni_chunk_append(&seg->ms_chunk, data, len);
+		nni_list_append(&m->m_segs, seg);
+		m->m_nsegs++;
+		m->m_seglen += len;
+	}
+	return (0);
 }
 
 int
@@ -528,12 +925,49 @@ nni_msg_insert(nni_msg *m, const void *data, size_t len)
 int
 nni_msg_trim(nni_msg *m, size_t len)
 {
-	return (nni_chunk_trim(&m->m_body, len));
+	nni_msgseg *seg;
+	size_t      n;
+
+	if (m->m_nsegs == 0) {
+		return (nni_chunk_trim(&m->m_body, len));
+	}
+	if (len > nni_msg_len(m)) {
+		return (NNG_EINVAL);
+	}
+	n = len < m->m_body.ch_len ? len : m->m_body.ch_len;
+	(void) nni_chunk_trim(&m->m_body, n);
+	len -= n;
+	while (len > 0) {
+		seg = nni_list_first(&m->m_segs);
+		n   = len < seg->ms_chunk.ch_len ? len : seg->ms_chunk.ch_len;
+		(void) nni_chunk_trim(&seg->ms_chunk, n);
+		m->m_seglen -= n;
+		len -= n;
+		if (seg->ms_chunk.ch_len == 0) {
+			nni_msg_seg_free(m, seg);
+		}
+	}
+	return (0);
 }
 
 int
 nni_msg_chop(nni_msg *m, size_t len)
 {
+	nni_msgseg *seg;
+	size_t      n;
+
+	if (len > nni_msg_len(m)) {
+		return (NNG_EINVAL);
+	}
+	while ((len > 0) && ((seg = nni_list_last(&m->m_segs)) != NULL)) {
+		n = len < seg->ms_chunk.ch_len ? len : seg->ms_chunk.ch_len;
+		(void) nni_chunk_chop(&seg->ms_chunk, n);
+		m->m_seglen -= n;
+		len -= n;
+		if (seg->ms_chunk.ch_len == 0) {
+			nni_msg_seg_free(m, seg);
+		}
+	}
 	return (nni_chunk_chop(&m->m_body, len));
 }
 
@@ -564,7 +998,9 @@ nni_msg_header_chop(nni_msg *m, size_t len)
 int
 nni_msg_append_u32(nni_msg *m, uint32_t val)
 {
-	return (nni_chunk_append_u32(&m->m_body, val));
+	unsigned char buf[sizeof(uint32_t)];
+	NNI_PUT32(buf, val);
+	return (nni_msg_append(m, buf, sizeof(buf)));
 }
 
 int
@@ -588,13 +1024,33 @@ nni_msg_header_insert_u32(nni_msg *m, uint32_t val)
 uint32_t
 nni_msg_chop_u32(nni_msg *m)
 {
-	return (nni_chunk_chop_u32(&m->m_body));
+	unsigned char buf[sizeof(uint32_t)];
+	uint32_t      v;
+
+	if (m->m_nsegs == 0) {
+		return (nni_chunk_chop_u32(&m->m_body));
+	}
+	NNI_ASSERT(nni_msg_len(m) >= sizeof(v));
+	nni_msg_copyout(m, nni_msg_len(m) - sizeof(v), buf, sizeof(buf));
+	(void) nni_msg_chop(m, sizeof(v));
+	NNI_GET32(buf, v);
+	return (v);
 }
 
 uint32_t
 nni_msg_trim_u32(nni_msg *m)
 {
-	return (nni_chunk_trim_u32(&m->m_body));
+	unsigned char buf[sizeof(uint32_t)];
+	uint32_t      v;
+
+	if (m->m_nsegs == 0) {
+		return (nni_chunk_trim_u32(&m->m_body));
+	}
+	NNI_ASSERT(nni_msg_len(m) >= sizeof(v));
+	nni_msg_copyout(m, 0, buf, sizeof(buf));
+	(void) nni_msg_trim(m, sizeof(v));
+	NNI_GET32(buf, v);
+	return (v);
 }
 
 uint32_t
@@ -612,6 +1068,7 @@ void
 nni_msg_clear(nni_msg *m)
 {
 	nni_chunk_clear(&m->m_body);
+	nni_msg_segs_free(m);
 }
 
 void
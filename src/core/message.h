@@ -18,6 +18,38 @@ extern int      nni_msg_alloc(nni_msg **, size_t);
 extern void     nni_msg_free(nni_msg *);
 extern int      nni_msg_realloc(nni_msg *, size_t);
 extern int      nni_msg_dup(nni_msg **, const nni_msg *);
+
+// nni_msg_alloc_external creates a message whose body is the supplied
+// buffer, which is not copied.  The buffer belongs to the caller, and must
+// remain valid until the function is called (with the buffer, its length,
+// and the argument), which happens when the last reference to it, possibly
+// by a duplicate of the message, is released.  The buffer is never
+// modified; changes to the body are made to a private copy.  The function
+// may be NULL if the buffer need not be released.
+extern int nni_msg_alloc_external(
+    nni_msg **, void *, size_t, void (*)(void *, size_t, void *), void *);
+
+// nni_msg_body_iov fills in an I/O vector describing the body, which may be
+// made up of several segments.  On entry the integer holds the number of
+// elements available, and on return it holds the number used (which may be
+// zero for an empty body).  If the body has more segments than will fit,
+// it is flattened first, which can fail with NNG_ENOMEM.  Note that
+// nni_msg_body always flattens the body, and returns NULL if that fails;
+// callers must check for this.
+extern int nni_msg_body_iov(nni_msg *, nni_iov *, int *);
+
+// nni_msg_dup does not copy the body, but shares it with the original
+// until either message is modified.  The internal message functions that
+// change the body take care of this, but nni_msg_body only returns a
+// pointer to the shared data; callers that wish to modify the data
+// directly must call nni_msg_unshare first.
+extern int nni_msg_unshare(nni_msg *);
+
+// nni_msg_alloc_uninit is like nni_msg_alloc, but the body is not zeroed.
+// This is intended for receive paths that will immediately overwrite the
+// entire body.
+extern int nni_msg_alloc_uninit(nni_msg **, size_t);
+
 extern void *   nni_msg_header(nni_msg *);
 extern size_t   nni_msg_header_len(const nni_msg *);
 extern void *   nni_msg_body(nni_msg *);
@@ -0,0 +1,407 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include <string.h>
+
+#include "core/nng_impl.h"
+
+// Message buffer pool.  This is a fairly classic magazine allocator, in
+// the spirit of the Solaris/illumos kmem and libumem allocators, although
+// much simpler.  Every buffer is really just an nni_alloc() of the class
+// size; the pool only caches freed buffers so that they can be handed
+// out again without a trip through the system allocator.
+//
+// Each thread has a magazine per size class, which is only ever touched
+// by that thread, and hence needs no locking.  When a magazine runs dry,
+// it is refilled (by half) from the depot for the class; when it fills
+// up, half of it is returned to the depot.  The depot itself is bounded,
+// and buffers beyond that bound are given back with nni_free().  Magazines
+// are returned to the depot when their thread exits.
+
+#ifdef NNG_ENABLE_MSGPOOL
+
+#define NNI_MSGPOOL_NCLASS 11 // 64, 128, ..., 65536
+#define NNI_MSGPOOL_MAGMAX 32
+#define NNI_MSGPOOL_MAGBYTES (128 * 1024)
+#define NNI_MSGPOOL_DEPOTBYTES (2 * 1024 * 1024)
+
+typedef struct nni_msgpool_link {
+	struct nni_msgpool_link *l_next;
+} nni_msgpool_link;
+
+typedef struct {
+	nni_mtx           d_mtx;
+	nni_msgpool_link *d_head;
+	size_t            d_count;
+	size_t            d_limit;
+	size_t            d_size;
+	int               d_rounds;
+	int               d_live;
+	uint64_t          d_hits;
+	uint64_t          d_misses;
+} nni_msgpool_depot;
+
+typedef struct {
+	int      m_count;
+	uint64_t m_hits;
+	uint64_t m_misses;
+	void *   m_rounds[NNI_MSGPOOL_MAGMAX];
+} nni_msgpool_mag;
+
+typedef struct {
+	nni_msgpool_mag c_mags[NNI_MSGPOOL_NCLASS];
+} nni_msgpool_cache;
+
+static nni_msgpool_depot nni_msgpool_depots[NNI_MSGPOOL_NCLASS];
+static nni_plat_tls      nni_msgpool_tls;
+static int               nni_msgpool_inited = 0;
+
+static int
+nni_msgpool_class(size_t sz)
+{
+	int    c = 0;
+	size_t s = NNI_MSGPOOL_MINSZ;
+
+	while (s < sz) {
+		s <<= 1;
+		c++;
+	}
+	return (c);
+}
+
+size_t
+nni_msgpool_size(size_t sz)
+{
+	if (sz > NNI_MSGPOOL_MAXSZ) {
+		return (sz);
+	}
+	return ((size_t) NNI_MSGPOOL_MINSZ << nni_msgpool_class(sz));
+}
+
+// nni_msgpool_flush moves the thread local counters into the depot.
+// The depot lock must be held.
+static void
+nni_msgpool_flush(nni_msgpool_depot *d, nni_msgpool_mag *mag)
+{
+	d->d_hits += mag->m_hits;
+	d->d_misses += mag->m_misses;
+	mag->m_hits   = 0;
+	mag->m_misses = 0;
+}
+
+static void
+nni_msgpool_refill(nni_msgpool_depot *d, nni_msgpool_mag *mag)
+{
+	nni_msgpool_link *l;
+
+	nni_mtx_lock(&d->d_mtx);
+	nni_msgpool_flush(d, mag);
+	while ((mag->m_count < (d->d_rounds / 2)) &&
+	    ((l = d->d_head) != NULL)) {
+		d->d_head = l->l_next;
+		d->d_count--;
+		mag->m_rounds[mag->m_count++] = l;
+	}
+	nni_mtx_unlock(&d->d_mtx);
+}
+
+// nni_msgpool_drain returns the given number of buffers from the magazine
+// to the depot.  Anything the depot cannot hold is freed.
+static void
+nni_msgpool_drain(nni_msgpool_depot *d, nni_msgpool_mag *mag, int n)
+{
+	nni_msgpool_link *extra = NULL;
+	nni_msgpool_link *l;
+
+	nni_mtx_lock(&d->d_mtx);
+	nni_msgpool_flush(d, mag);
+	while ((n > 0) && (mag->m_count > 0)) {
+		l = mag->m_rounds[--mag->m_count];
+		n--;
+		if (d->d_live && (d->d_count < d->d_limit)) {
+			l->l_next = d->d_head;
+			d->d_head = l;
+			d->d_count++;
+		} else {
+			l->l_next = extra;
+			extra     = l;
+		}
+	}
+	nni_mtx_unlock(&d->d_mtx);
+
+	while ((l = extra) != NULL) {
+		extra = l->l_next;
+		nni_free(l, d->d_size);
+	}
+}
+
+// nni_msgpool_cache_fini is called when a thread exits, to give back
+// any cached buffers.
+static void
+nni_msgpool_cache_fini(void *arg)
+{
+	nni_msgpool_cache *cache = arg;
+	int                i;
+
+	for (i = 0; i < NNI_MSGPOOL_NCLASS; i++) {
+		nni_msgpool_mag *mag = &cache->c_mags[i];
+		nni_msgpool_drain(&nni_msgpool_depots[i], mag, mag->m_count);
+	}
+	NNI_FREE_STRUCT(cache);
+}
+
+static nni_msgpool_cache *
+nni_msgpool_cache_get(void)
+{
+	nni_msgpool_cache *cache;
+
+	if (!nni_msgpool_inited) {
+		return (NULL);
+	}
+	if ((cache = nni_plat_tls_get(&nni_msgpool_tls)) == NULL) {
+		if ((cache = NNI_ALLOC_STRUCT(cache)) != NULL) {
+			nni_plat_tls_set(&nni_msgpool_tls, cache);
+		}
+	}
+	return (cache);
+}
+
+static void *
+nni_msgpool_get(size_t sz, int zero)
+{
+	nni_msgpool_cache *cache;
+	nni_msgpool_depot *d;
+	nni_msgpool_mag *  mag;
+	void *             buf;
+	int                c;
+
+	if (sz > NNI_MSGPOOL_MAXSZ) {
+		return (zero ? nni_alloc(sz) : nni_alloc_uninit(sz));
+	}
+	c  = nni_msgpool_class(sz);
+	d  = &nni_msgpool_depots[c];
+	sz = (size_t) NNI_MSGPOOL_MINSZ << c;
+	if ((cache = nni_msgpool_cache_get()) == NULL) {
+		return (zero ? nni_alloc(sz) : nni_alloc_uninit(sz));
+	}
+	mag = &cache->c_mags[c];
+	if (mag->m_count == 0) {
+		nni_msgpool_refill(d, mag);
+	}
+	if (mag->m_count > 0) {
+		buf = mag->m_rounds[--mag->m_count];
+		mag->m_hits++;
+		if (zero) {
+			memset(buf, 0, sz);
+		}
+		return (buf);
+	}
+	mag->m_misses++;
+	return (zero ? nni_alloc(sz) : nni_alloc_uninit(sz));
+}
+
+void *
+nni_msgpool_alloc(size_t sz)
+{
+	return (nni_msgpool_get(sz, 1));
+}
+
+void *
+nni_msgpool_alloc_uninit(size_t sz)
+{
+	return (nni_msgpool_get(sz, 0));
+}
+
+void
+nni_msgpool_free(void *buf, size_t sz)
+{
+	nni_msgpool_cache *cache;
+	nni_msgpool_depot *d;
+	nni_msgpool_mag *  mag;
+	int                c;
+
+	if (buf == NULL) {
+		return;
+	}
+	if (sz > NNI_MSGPOOL_MAXSZ) {
+		nni_free(buf, sz);
+		return;
+	}
+	c = nni_msgpool_class(sz);
+	d = &nni_msgpool_depots[c];
+	if ((cache = nni_msgpool_cache_get()) == NULL) {
+		nni_free(buf, (size_t) NNI_MSGPOOL_MINSZ << c);
+		return;
+	}
+	mag = &cache->c_mags[c];
+	if (mag->m_count >= d->d_rounds) {
+		nni_msgpool_drain(d, mag, d->d_rounds / 2);
+	}
+	mag->m_rounds[mag->m_count++] = buf;
+}
+
+int
+nni_msgpool_stat(int idx, size_t *szp, uint64_t *hitsp, uint64_t *missp)
+{
+	nni_msgpool_cache *cache;
+	nni_msgpool_depot *d;
+
+	if ((idx < 0) || (idx >= NNI_MSGPOOL_NCLASS)) {
+		return (NNG_ENOENT);
+	}
+	d = &nni_msgpool_depots[idx];
+	if (!nni_msgpool_inited) {
+		*szp   = (size_t) NNI_MSGPOOL_MINSZ << idx;
+		*hitsp = 0;
+		*missp = 0;
+		return (0);
+	}
+
+	// We include the counters of the calling thread, so that a single
+	// threaded caller sees accurate results.
+	cache = nni_plat_tls_get(&nni_msgpool_tls);
+	nni_mtx_lock(&d->d_mtx);
+	if (cache != NULL) {
+		nni_msgpool_flush(d, &cache->c_mags[idx]);
+	}
+	*szp   = d->d_size;
+	*hitsp = d->d_hits;
+	*missp = d->d_misses;
+	nni_mtx_unlock(&d->d_mtx);
+	return (0);
+}
+
+int
+nni_msgpool_sys_init(void)
+{
+	int i;
+	int rv;
+
+	// The thread local key and the depot locks are created just once,
+	// and never destroyed, as threads may exit (and return their caches)
+	// after the library has been finalized.
+	if (!nni_msgpool_inited) {
+		rv = nni_plat_tls_init(&nni_msgpool_tls, nni_msgpool_cache_fini);
+		if (rv != 0) {
+			return (rv);
+		}
+		for (i = 0; i < NNI_MSGPOOL_NCLASS; i++) {
+			nni_msgpool_depot *d = &nni_msgpool_depots[i];
+			size_t             rounds;
+
+			nni_mtx_init(&d->d_mtx);
+			d->d_size = (size_t) NNI_MSGPOOL_MINSZ << i;
+			d->d_limit = NNI_MSGPOOL_DEPOTBYTES / d->d_size;
+			rounds     = NNI_MSGPOOL_MAGBYTES / d->d_size;
+			if (rounds > NNI_MSGPOOL_MAGMAX) {
+				rounds = NNI_MSGPOOL_MAGMAX;
+			}
+			if (rounds < 2) {
+				rounds = 2;
+			}
+			d->d_rounds = (int) rounds;
+		}
+		nni_msgpool_inited = 1;
+	}
+	for (i = 0; i < NNI_MSGPOOL_NCLASS; i++) {
+		nni_msgpool_depot *d = &nni_msgpool_depots[i];
+		nni_mtx_lock(&d->d_mtx);
+		d->d_live = 1;
+		nni_mtx_unlock(&d->d_mtx);
+	}
+	return (0);
+}
+
+void
+nni_msgpool_sys_fini(void)
+{
+	nni_msgpool_cache *cache;
+	nni_msgpool_link * l;
+	int                i;
+
+	if (!nni_msgpool_inited) {
+		return;
+	}
+	for (i = 0; i < NNI_MSGPOOL_NCLASS; i++) {
+		nni_msgpool_depot *d = &nni_msgpool_depots[i];
+		nni_msgpool_link * head;
+
+		nni_mtx_lock(&d->d_mtx);
+		d->d_live  = 0;
+		head       = d->d_head;
+		d->d_head  = NULL;
+		d->d_count = 0;
+		nni_mtx_unlock(&d->d_mtx);
+
+		while ((l = head) != NULL) {
+			head = l->l_next;
+			nni_free(l, d->d_size);
+		}
+	}
+
+	// Give back whatever the calling thread has cached too; with the
+	// depot closed, this frees them.  Other threads will do the same
+	// as they exit.
+	if ((cache = nni_plat_tls_get(&nni_msgpool_tls)) != NULL) {
+		nni_plat_tls_set(&nni_msgpool_tls, NULL);
+		nni_msgpool_cache_fini(cache);
+	}
+}
+
+#else // NNG_ENABLE_MSGPOOL
+
+size_t
+nni_msgpool_size(size_t sz)
+{
+	return (sz);
+}
+
+void *
+nni_msgpool_alloc(size_t sz)
+{
+	return (nni_alloc(sz));
+}
+
+void *
+nni_msgpool_alloc_uninit(size_t sz)
+{
+	return (nni_alloc_uninit(sz));
+}
+
+void
+nni_msgpool_free(void *buf, size_t sz)
+{
+	if (buf != NULL) {
+		nni_free(buf, sz);
+	}
+}
+
+int
+nni_msgpool_stat(int idx, size_t *szp, uint64_t *hitsp, uint64_t *missp)
+{
+	NNI_ARG_UNUSED(idx);
+	NNI_ARG_UNUSED(szp);
+	NNI_ARG_UNUSED(hitsp);
+	NNI_ARG_UNUSED(missp);
+	return (NNG_ENOTSUP);
+}
+
+int
+nni_msgpool_sys_init(void)
+{
+	return (0);
+}
+
+void
+nni_msgpool_sys_fini(void)
+{
+}
+
+#endif // NNG_ENABLE_MSGPOOL
@@ -0,0 +1,55 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#ifndef CORE_MSGPOOL_H
+#define CORE_MSGPOOL_H
+
+#include "core/defs.h"
+
+// The message pool is a size-class allocator used for message structures
+// and message data.  Requests are rounded up to a power of two between
+// NNI_MSGPOOL_MINSZ and NNI_MSGPOOL_MAXSZ; larger requests are passed
+// directly to nni_alloc.  Each thread keeps a small cache (a "magazine")
+// of free buffers per size class, so that the common case of allocating
+// and freeing messages on the same thread takes no locks at all.  Threads
+// exchange buffers in bulk with a shared, locked depot.
+//
+// When NNG_ENABLE_MSGPOOL is not defined, these routines are thin wrappers
+// around nni_alloc and nni_free.
+//
+// Memory returned by nni_msgpool_alloc is zeroed, as with nni_alloc, whereas
+// nni_msgpool_alloc_uninit makes no such promise.  Note that any buffer must
+// be returned with the same size it was requested with (or any size that
+// rounds to the same class, see nni_msgpool_size).
+
+#define NNI_MSGPOOL_MINSZ 64
+#define NNI_MSGPOOL_MAXSZ 65536
+
+extern int  nni_msgpool_sys_init(void);
+extern void nni_msgpool_sys_fini(void);
+
+// nni_msgpool_size returns the actual size of buffer that would be used
+// to satisfy an allocation of the given size.  Callers that can make use
+// of the extra space (such as message chunks) should use this to record
+// their capacity.
+extern size_t nni_msgpool_size(size_t);
+
+extern void *nni_msgpool_alloc(size_t);
+extern void *nni_msgpool_alloc_uninit(size_t);
+extern void  nni_msgpool_free(void *, size_t);
+
+// nni_msgpool_stat obtains the statistics for the given size class index.
+// A hit is an allocation satisfied from a cache, a miss is one that had
+// to go to nni_alloc.  It returns NNG_ENOENT if the index is out of range,
+// which makes it possible to iterate over all classes.  When the pool is
+// disabled, this always returns NNG_ENOTSUP.
+extern int nni_msgpool_stat(int, size_t *, uint64_t *, uint64_t *);
+
+#endif // CORE_MSGPOOL_H
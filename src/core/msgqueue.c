@@ -14,21 +14,39 @@
 // but as we have access to the internals, we have made some fundamental
 // differences and improvements.  For example, these can grow, and either
 // side can close, and they may be closed more than once.
+//
+// Locking is split three ways.  The mq_put_lock owns the tail of the ring
+// (mq_put and the free slots), and the mq_get_lock owns the head (mq_get
+// and the filled slots).  The message count is an atomic counter, which
+// each side updates only after it is done with its slot.  When nobody is
+// waiting on either side, and there is no callback, filter, byte budget,
+// error, or close to honor, the queue is "fast": nni_msgq_tryput takes
+// only mq_put_lock, and the immediate completion case of nni_msgq_aio_get
+// takes only mq_get_lock, so a writer and a reader never contend.
+// Everything else runs under mq_lock, and nni_msgq_lock takes both ring
+// locks along with it, so the slow paths own the whole ring.  The fast
+// gate only changes with all three held, so either ring lock is enough to
+// read it.  Lock order is mq_lock, mq_put_lock, then mq_get_lock.
 
 struct nni_msgq {
-	nni_mtx   mq_lock;
-	nni_cv    mq_drained;
-	int       mq_cap;
-	int       mq_alloc; // alloc is cap + 2...
-	int       mq_len;
-	int       mq_get;
-	int       mq_put;
-	int       mq_closed;
-	int       mq_puterr;
-	int       mq_geterr;
-	int       mq_draining;
-	int       mq_besteffort;
-	nni_msg **mq_msgs;
+	nni_mtx         mq_lock;
+	nni_mtx         mq_put_lock;
+	nni_mtx         mq_get_lock;
+	nni_cv          mq_drained;
+	int             mq_fast;
+	int             mq_cap;
+	int             mq_alloc; // alloc is cap + 2...
+	nni_plat_atomic mq_len;
+	int             mq_get; // protected by mq_get_lock
+	int             mq_put; // protected by mq_put_lock
+	int             mq_closed;
+	int             mq_puterr;
+	int             mq_geterr;
+	int             mq_draining;
+	int             mq_besteffort;
+	nni_msg **      mq_msgs;
+	size_t          mq_bytes;    // only counted with a byte budget
+	size_t          mq_maxbytes; // byte budget, 0 for none
 
 	nni_list mq_aio_putq;
 	nni_list mq_aio_getq;
@@ -44,6 +62,105 @@ struct nni_msgq {
 	void *          mq_filter_arg;
 };
 
+static void
+nni_msgq_lock(nni_msgq *mq)
+{
+	nni_mtx_lock(&mq->mq_lock);
+	nni_mtx_lock(&mq->mq_put_lock);
+	nni_mtx_lock(&mq->mq_get_lock);
+}
+
+static void
+nni_msgq_unlock(nni_msgq *mq)
+{
+	mq->mq_fast = (!mq->mq_closed) && (!mq->mq_draining) &&
+	    (!mq->mq_puterr) && (!mq->mq_geterr) && (mq->mq_cb_fn == NULL) &&
+	    (mq->mq_filter_fn == NULL) && (mq->mq_maxbytes == 0) &&
+	    nni_list_empty(&mq->mq_aio_getq) &&
+	    nni_list_empty(&mq->mq_aio_putq);
+
+	nni_mtx_unlock(&mq->mq_get_lock);
+	nni_mtx_unlock(&mq->mq_put_lock);
+	nni_mtx_unlock(&mq->mq_lock);
+}
+
+// nni_msgq_ring_len returns the number of messages in the ring.  A side
+// holding only its own ring lock may see a stale value, but only ever
+// one that errs towards the ring being fuller (for the writer) or emptier
+// (for the reader) than it really is.
+static int
+nni_msgq_ring_len(nni_msgq *mq)
+{
+	return (nni_plat_atomic_get(&mq->mq_len));
+}
+
+// nni_msgq_msgsize is what a message counts against the byte budget.
+static size_t
+nni_msgq_msgsize(nni_msg *msg)
+{
+	return (nni_msg_len(msg) + nni_msg_header_len(msg));
+}
+
+// nni_msgq_ring_full reports whether the ring is at either its message
+// or its byte limit.
+static int
+nni_msgq_ring_full(nni_msgq *mq)
+{
+	return ((nni_msgq_ring_len(mq) >= mq->mq_cap) ||
+	    ((mq->mq_maxbytes != 0) && (mq->mq_bytes >= mq->mq_maxbytes)));
+}
+
+// nni_msgq_ring_room reports whether the message fits in the ring.  The
+// byte budget never refuses a message to an empty queue, so that a
+// message larger than the budget can still make progress.
+static int
+nni_msgq_ring_room(nni_msgq *mq, nni_msg *msg)
+{
+	int len = nni_msgq_ring_len(mq);
+
+	if (len >= mq->mq_cap) {
+		return (0);
+	}
+	if ((mq->mq_maxbytes != 0) && (len != 0) &&
+	    ((mq->mq_bytes + nni_msgq_msgsize(msg)) > mq->mq_maxbytes)) {
+		return (0);
+	}
+	return (1);
+}
+
+// nni_msgq_ring_put and nni_msgq_ring_get move a single message in or
+// out of the ring.  The caller must own its end of the ring, either by
+// holding that end's lock with the fast gate open, or by holding mq_lock.
+// The count is changed last, which publishes the slot to the other end.
+static void
+nni_msgq_ring_put(nni_msgq *mq, nni_msg *msg)
+{
+	mq->mq_msgs[mq->mq_put++] = msg;
+	if (mq->mq_put == mq->mq_alloc) {
+		mq->mq_put = 0;
+	}
+	if (mq->mq_maxbytes != 0) {
+		mq->mq_bytes += nni_msgq_msgsize(msg);
+	}
+	nni_plat_atomic_inc(&mq->mq_len);
+}
+
+static nni_msg *
+nni_msgq_ring_get(nni_msgq *mq)
+{
+	nni_msg *msg;
+
+	msg = mq->mq_msgs[mq->mq_get++];
+	if (mq->mq_get == mq->mq_alloc) {
+		mq->mq_get = 0;
+	}
+	if (mq->mq_maxbytes != 0) {
+		mq->mq_bytes -= nni_msgq_msgsize(msg);
+	}
+	(void) nni_plat_atomic_dec(&mq->mq_len);
+	return (msg);
+}
+
 int
 nni_msgq_init(nni_msgq **mqp, unsigned cap)
 {
@@ -68,17 +185,20 @@ nni_msgq_init(nni_msgq **mqp, unsigned cap)
 	nni_aio_list_init(&mq->mq_aio_putq);
 	nni_aio_list_init(&mq->mq_aio_getq);
 	nni_mtx_init(&mq->mq_lock);
+	nni_mtx_init(&mq->mq_put_lock);
+	nni_mtx_init(&mq->mq_get_lock);
+	nni_plat_atomic_init(&mq->mq_len, 0);
 	nni_cv_init(&mq->mq_drained, &mq->mq_lock);
 
 	mq->mq_cap      = cap;
 	mq->mq_alloc    = alloc;
-	mq->mq_len      = 0;
 	mq->mq_get      = 0;
 	mq->mq_put      = 0;
 	mq->mq_closed   = 0;
 	mq->mq_puterr   = 0;
 	mq->mq_geterr   = 0;
 	mq->mq_draining = 0;
+	mq->mq_fast     = 1;
 	*mqp            = mq;
 
 	return (0);
@@ -93,16 +213,13 @@ nni_msgq_fini(nni_msgq *mq)
 		return;
 	}
 	nni_cv_fini(&mq->mq_drained);
+	nni_mtx_fini(&mq->mq_get_lock);
+	nni_mtx_fini(&mq->mq_put_lock);
 	nni_mtx_fini(&mq->mq_lock);
 
 	/* Free any orphaned messages. */
-	while (mq->mq_len > 0) {
-		msg = mq->mq_msgs[mq->mq_get];
-		mq->mq_get++;
-		if (mq->mq_get >= mq->mq_alloc) {
-			mq->mq_get = 0;
-		}
-		mq->mq_len--;
+	while (nni_msgq_ring_len(mq) > 0) {
+		msg = nni_msgq_ring_get(mq);
 		nni_msg_free(msg);
 	}
 
@@ -116,7 +233,7 @@ nni_msgq_set_get_error(nni_msgq *mq, int error)
 	nni_aio *aio;
 
 	// Let all pending blockers know we are closing the queue.
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msgq_lock(mq);
 	if (error != 0) {
 		while ((aio = nni_list_first(&mq->mq_aio_getq)) != NULL) {
 			nni_aio_list_remove(aio);
@@ -124,7 +241,7 @@ nni_msgq_set_get_error(nni_msgq *mq, int error)
 		}
 	}
 	mq->mq_geterr = error;
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 }
 
 void
@@ -133,7 +250,7 @@ nni_msgq_set_put_error(nni_msgq *mq, int error)
 	nni_aio *aio;
 
 	// Let all pending blockers know we are closing the queue.
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msgq_lock(mq);
 	if (error != 0) {
 		while ((aio = nni_list_first(&mq->mq_aio_putq)) != NULL) {
 			nni_aio_list_remove(aio);
@@ -141,7 +258,7 @@ nni_msgq_set_put_error(nni_msgq *mq, int error)
 		}
 	}
 	mq->mq_puterr = error;
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 }
 
 void
@@ -150,7 +267,7 @@ nni_msgq_set_error(nni_msgq *mq, int error)
 	nni_aio *aio;
 
 	// Let all pending blockers know we are closing the queue.
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msgq_lock(mq);
 	if (error != 0) {
 		while (((aio = nni_list_first(&mq->mq_aio_getq)) != NULL) ||
 		    ((aio = nni_list_first(&mq->mq_aio_putq)) != NULL)) {
@@ -160,14 +277,16 @@ nni_msgq_set_error(nni_msgq *mq, int error)
 	}
 	mq->mq_puterr = error;
 	mq->mq_geterr = error;
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 }
 
 void
 nni_msgq_set_filter(nni_msgq *mq, nni_msgq_filter filter, void *arg)
 {
+	nni_msgq_lock(mq);
 	mq->mq_filter_fn  = filter;
 	mq->mq_filter_arg = arg;
+	nni_msgq_unlock(mq);
 }
 
 static void
@@ -203,13 +322,9 @@ nni_msgq_run_putq(nni_msgq *mq)
 		}
 
 		// Otherwise if we have room in the buffer, just queue it.
-		if (mq->mq_len < mq->mq_cap) {
+		if (nni_msgq_ring_room(mq, msg)) {
 			nni_list_remove(&mq->mq_aio_putq, waio);
-			mq->mq_msgs[mq->mq_put++] = msg;
-			if (mq->mq_put == mq->mq_alloc) {
-				mq->mq_put = 0;
-			}
-			mq->mq_len++;
+			nni_msgq_ring_put(mq, msg);
 			nni_aio_set_msg(waio, NULL);
 			nni_aio_finish(waio, 0, len);
 			continue;
@@ -233,12 +348,12 @@ nni_msgq_run_putq(nni_msgq *mq)
 void
 nni_msgq_set_best_effort(nni_msgq *mq, int on)
 {
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msgq_lock(mq);
 	mq->mq_besteffort = on;
 	if (on) {
 		nni_msgq_run_putq(mq);
 	}
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 }
 
 static void
@@ -249,12 +364,8 @@ nni_msgq_run_getq(nni_msgq *mq)
 
 	while ((raio = nni_list_first(&mq->mq_aio_getq)) != NULL) {
 		// If anything is waiting in the queue, get it first.
-		if (mq->mq_len != 0) {
-			nni_msg *msg = mq->mq_msgs[mq->mq_get++];
-			if (mq->mq_get == mq->mq_alloc) {
-				mq->mq_get = 0;
-			}
-			mq->mq_len--;
+		if (nni_msgq_ring_len(mq) != 0) {
+			nni_msg *msg = nni_msgq_ring_get(mq);
 
 			if (mq->mq_filter_fn != NULL) {
 				msg = mq->mq_filter_fn(mq->mq_filter_arg, msg);
@@ -303,23 +414,25 @@ nni_msgq_run_notify(nni_msgq *mq)
 		if (mq->mq_closed) {
 			flags |= nni_msgq_f_closed;
 		}
-		if (mq->mq_len == 0) {
+		if (nni_msgq_ring_len(mq) == 0) {
 			flags |= nni_msgq_f_empty;
-		} else if (mq->mq_len == mq->mq_cap) {
+		} else if (nni_msgq_ring_full(mq)) {
 			flags |= nni_msgq_f_full;
 		}
-		if (mq->mq_len < mq->mq_cap ||
+		if (!nni_msgq_ring_full(mq) ||
 		    !nni_list_empty(&mq->mq_aio_getq)) {
 			flags |= nni_msgq_f_can_put;
 		}
-		if ((mq->mq_len != 0) || !nni_list_empty(&mq->mq_aio_putq)) {
+		if ((nni_msgq_ring_len(mq) != 0) ||
+		    !nni_list_empty(&mq->mq_aio_putq)) {
 			flags |= nni_msgq_f_can_get;
 		}
 		mq->mq_cb_fn(mq->mq_cb_arg, flags);
 	}
 
 	if (mq->mq_draining) {
-		if ((mq->mq_len == 0) && !nni_list_empty(&mq->mq_aio_putq)) {
+		if ((nni_msgq_ring_len(mq) == 0) &&
+		    !nni_list_empty(&mq->mq_aio_putq)) {
 			nni_cv_wake(&mq->mq_drained);
 		}
 	}
@@ -328,11 +441,11 @@ nni_msgq_run_notify(nni_msgq *mq)
 void
 nni_msgq_set_cb(nni_msgq *mq, nni_msgq_cb fn, void *arg)
 {
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msgq_lock(mq);
 	mq->mq_cb_fn  = fn;
 	mq->mq_cb_arg = arg;
 	nni_msgq_run_notify(mq);
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 }
 
 static void
@@ -340,30 +453,30 @@ nni_msgq_cancel(nni_aio *aio, int rv)
 {
 	nni_msgq *mq = aio->a_prov_data;
 
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msgq_lock(mq);
 	if (nni_aio_list_active(aio)) {
 		nni_aio_list_remove(aio);
 		nni_aio_finish_error(aio, rv);
 	}
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 }
 
 void
 nni_msgq_aio_put(nni_msgq *mq, nni_aio *aio)
 {
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msgq_lock(mq);
 	if (nni_aio_start(aio, nni_msgq_cancel, mq) != 0) {
-		nni_mtx_unlock(&mq->mq_lock);
+		nni_msgq_unlock(mq);
 		return;
 	}
 	if (mq->mq_closed) {
 		nni_aio_finish_error(aio, NNG_ECLOSED);
-		nni_mtx_unlock(&mq->mq_lock);
+		nni_msgq_unlock(mq);
 		return;
 	}
 	if (mq->mq_puterr) {
 		nni_aio_finish_error(aio, mq->mq_puterr);
-		nni_mtx_unlock(&mq->mq_lock);
+		nni_msgq_unlock(mq);
 		return;
 	}
 
@@ -371,25 +484,43 @@ nni_msgq_aio_put(nni_msgq *mq, nni_aio *aio)
 	nni_msgq_run_putq(mq);
 	nni_msgq_run_notify(mq);
 
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 }
 
 void
 nni_msgq_aio_get(nni_msgq *mq, nni_aio *aio)
 {
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msg *msg;
+
+	// Fast path: a message is sitting in the ring and nothing else
+	// needs attention, so take it without touching the waiter lists.
+	// Completion is done outside the ring lock.
+	nni_mtx_lock(&mq->mq_get_lock);
+	if (mq->mq_fast && (nni_msgq_ring_len(mq) != 0)) {
+		if (nni_aio_start(aio, nni_msgq_cancel, mq) != 0) {
+			nni_mtx_unlock(&mq->mq_get_lock);
+			return;
+		}
+		msg = nni_msgq_ring_get(mq);
+		nni_mtx_unlock(&mq->mq_get_lock);
+		nni_aio_finish_msg(aio, msg);
+		return;
+	}
+	nni_mtx_unlock(&mq->mq_get_lock);
+
+	nni_msgq_lock(mq);
 	if (nni_aio_start(aio, nni_msgq_cancel, mq) != 0) {
-		nni_mtx_unlock(&mq->mq_lock);
+		nni_msgq_unlock(mq);
 		return;
 	}
 	if (mq->mq_closed) {
 		nni_aio_finish_error(aio, NNG_ECLOSED);
-		nni_mtx_unlock(&mq->mq_lock);
+		nni_msgq_unlock(mq);
 		return;
 	}
 	if (mq->mq_geterr) {
 		nni_aio_finish_error(aio, mq->mq_geterr);
-		nni_mtx_unlock(&mq->mq_lock);
+		nni_msgq_unlock(mq);
 		return;
 	}
 
@@ -397,56 +528,171 @@ nni_msgq_aio_get(nni_msgq *mq, nni_aio *aio)
 	nni_msgq_run_getq(mq);
 	nni_msgq_run_notify(mq);
 
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 }
 
-int
-nni_msgq_tryput(nni_msgq *mq, nni_msg *msg)
+// nni_msgq_tryput_locked places one message, either by handing it
+// directly to a blocked reader, or by queueing it.  It returns
+// NNG_EAGAIN if there is no room.  The mq_lock must be held.
+static int
+nni_msgq_tryput_locked(nni_msgq *mq, nni_msg *msg)
 {
 	nni_aio *raio;
 
-	nni_mtx_lock(&mq->mq_lock);
-	if (mq->mq_closed) {
-		nni_mtx_unlock(&mq->mq_lock);
-		return (NNG_ECLOSED);
-	}
-
 	// The presence of any blocked reader indicates that
 	// the queue is empty, otherwise it would have just taken
 	// data from the queue.
 	if ((raio = nni_list_first(&mq->mq_aio_getq)) != NULL) {
-		nni_list_remove(&mq->mq_aio_getq, raio);
-
-		nni_aio_finish_msg(raio, msg);
-		nni_mtx_unlock(&mq->mq_lock);
+		if (mq->mq_filter_fn != NULL) {
+			msg = mq->mq_filter_fn(mq->mq_filter_arg, msg);
+		}
+		if (msg != NULL) {
+			nni_list_remove(&mq->mq_aio_getq, raio);
+			nni_aio_finish_msg(raio, msg);
+		}
 		return (0);
 	}
 
 	// Otherwise if we have room in the buffer, just queue it.
-	if (mq->mq_len < mq->mq_cap) {
-		mq->mq_msgs[mq->mq_put++] = msg;
-		if (mq->mq_put == mq->mq_alloc) {
-			mq->mq_put = 0;
-		}
-		mq->mq_len++;
-		nni_mtx_unlock(&mq->mq_lock);
+	if (nni_msgq_ring_room(mq, msg)) {
+		nni_msgq_ring_put(mq, msg);
 		return (0);
 	}
-
-	nni_mtx_unlock(&mq->mq_lock);
 	return (NNG_EAGAIN);
 }
 
+int
+nni_msgq_tryput(nni_msgq *mq, nni_msg *msg)
+{
+	int rv;
+
+	// Fast path: nobody is waiting, so if there is room in the ring
+	// we can just drop the message in.
+	nni_mtx_lock(&mq->mq_put_lock);
+	if (mq->mq_fast && nni_msgq_ring_room(mq, msg)) {
+		nni_msgq_ring_put(mq, msg);
+		nni_mtx_unlock(&mq->mq_put_lock);
+		return (0);
+	}
+	nni_mtx_unlock(&mq->mq_put_lock);
+
+	nni_msgq_lock(mq);
+	if (mq->mq_closed) {
+		nni_msgq_unlock(mq);
+		return (NNG_ECLOSED);
+	}
+	if (mq->mq_puterr) {
+		rv = mq->mq_puterr;
+		nni_msgq_unlock(mq);
+		return (rv);
+	}
+	if ((rv = nni_msgq_tryput_locked(mq, msg)) == 0) {
+		nni_msgq_run_notify(mq);
+	}
+	nni_msgq_unlock(mq);
+	return (rv);
+}
+
+int
+nni_msgq_put_batch(nni_msgq *mq, nni_msg **msgs, int n)
+{
+	int i = 0;
+
+	nni_mtx_lock(&mq->mq_put_lock);
+	if (mq->mq_fast) {
+		while ((i < n) && nni_msgq_ring_room(mq, msgs[i])) {
+			nni_msgq_ring_put(mq, msgs[i++]);
+		}
+		nni_mtx_unlock(&mq->mq_put_lock);
+		return (i);
+	}
+	nni_mtx_unlock(&mq->mq_put_lock);
+
+	nni_msgq_lock(mq);
+	if ((!mq->mq_closed) && (!mq->mq_puterr)) {
+		while ((i < n) && (nni_msgq_tryput_locked(mq, msgs[i]) == 0)) {
+			i++;
+		}
+		if (i != 0) {
+			nni_msgq_run_notify(mq);
+		}
+	}
+	nni_msgq_unlock(mq);
+	return (i);
+}
+
+int
+nni_msgq_get_batch(nni_msgq *mq, nni_msg **msgs, int max)
+{
+	nni_aio *waio;
+	nni_msg *msg;
+	int      n = 0;
+
+	nni_mtx_lock(&mq->mq_get_lock);
+	if (mq->mq_fast) {
+		while ((n < max) && (nni_msgq_ring_len(mq) != 0)) {
+			msgs[n++] = nni_msgq_ring_get(mq);
+		}
+		nni_mtx_unlock(&mq->mq_get_lock);
+		return (n);
+	}
+	nni_mtx_unlock(&mq->mq_get_lock);
+
+	nni_msgq_lock(mq);
+	// Readers that are already blocked have first claim on anything
+	// that is (or becomes) available.
+	if (mq->mq_closed || mq->mq_geterr ||
+	    !nni_list_empty(&mq->mq_aio_getq)) {
+		nni_msgq_unlock(mq);
+		return (0);
+	}
+	while (n < max) {
+		// Queued messages are older than any blocked writer's.
+		if (nni_msgq_ring_len(mq) != 0) {
+			msg = nni_msgq_ring_get(mq);
+		} else if ((waio = nni_list_first(&mq->mq_aio_putq)) != NULL) {
+			msg = nni_aio_get_msg(waio);
+			nni_aio_set_msg(waio, NULL);
+			nni_aio_list_remove(waio);
+			nni_aio_finish(waio, 0, nni_msg_len(msg));
+		} else {
+			break;
+		}
+		if (mq->mq_filter_fn != NULL) {
+			msg = mq->mq_filter_fn(mq->mq_filter_arg, msg);
+		}
+		if (msg != NULL) {
+			msgs[n++] = msg;
+		}
+	}
+	// Room may have opened up for blocked writers.
+	nni_msgq_run_putq(mq);
+	nni_msgq_run_notify(mq);
+	nni_msgq_unlock(mq);
+	return (n);
+}
+
 void
 nni_msgq_drain(nni_msgq *mq, nni_time expire)
 {
 	nni_aio *aio;
 
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msgq_lock(mq);
 	mq->mq_closed   = 1;
 	mq->mq_draining = 1;
-	while ((mq->mq_len > 0) || !nni_list_empty(&mq->mq_aio_putq)) {
-		if (nni_cv_until(&mq->mq_drained, expire) != 0) {
+	mq->mq_fast     = 0;
+	while ((nni_msgq_ring_len(mq) > 0) ||
+	    !nni_list_empty(&mq->mq_aio_putq)) {
+		int rv;
+
+		// Readers need the ring while we wait.  With the fast gate
+		// shut they come through mq_lock, which the wait releases.
+		nni_mtx_unlock(&mq->mq_get_lock);
+		nni_mtx_unlock(&mq->mq_put_lock);
+		rv = nni_cv_until(&mq->mq_drained, expire);
+		nni_mtx_lock(&mq->mq_put_lock);
+		nni_mtx_lock(&mq->mq_get_lock);
+		if (rv != 0) {
 			break;
 		}
 	}
@@ -460,15 +706,11 @@ nni_msgq_drain(nni_msgq *mq, nni_time expire)
 	}
 
 	// Free any remaining messages in the queue.
-	while (mq->mq_len > 0) {
-		nni_msg *msg = mq->mq_msgs[mq->mq_get++];
-		if (mq->mq_get >= mq->mq_alloc) {
-			mq->mq_get = 0;
-		}
-		mq->mq_len--;
+	while (nni_msgq_ring_len(mq) > 0) {
+		nni_msg *msg = nni_msgq_ring_get(mq);
 		nni_msg_free(msg);
 	}
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 }
 
 void
@@ -476,16 +718,12 @@ nni_msgq_close(nni_msgq *mq)
 {
 	nni_aio *aio;
 
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msgq_lock(mq);
 	mq->mq_closed = 1;
 
 	// Free the messages orphaned in the queue.
-	while (mq->mq_len > 0) {
-		nni_msg *msg = mq->mq_msgs[mq->mq_get++];
-		if (mq->mq_get >= mq->mq_alloc) {
-			mq->mq_get = 0;
-		}
-		mq->mq_len--;
+	while (nni_msgq_ring_len(mq) > 0) {
+		nni_msg *msg = nni_msgq_ring_get(mq);
 		nni_msg_free(msg);
 	}
 
@@ -496,18 +734,13 @@ nni_msgq_close(nni_msgq *mq)
 		nni_aio_finish_error(aio, NNG_ECLOSED);
 	}
 
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 }
 
 int
 nni_msgq_len(nni_msgq *mq)
 {
-	int rv;
-
-	nni_mtx_lock(&mq->mq_lock);
-	rv = mq->mq_len;
-	nni_mtx_unlock(&mq->mq_lock);
-	return (rv);
+	return (nni_msgq_ring_len(mq));
 }
 
 int
@@ -515,9 +748,43 @@ nni_msgq_cap(nni_msgq *mq)
 {
 	int rv;
 
-	nni_mtx_lock(&mq->mq_lock);
+	nni_msgq_lock(mq);
 	rv = mq->mq_cap;
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
+	return (rv);
+}
+
+void
+nni_msgq_set_maxbytes(nni_msgq *mq, size_t maxbytes)
+{
+	nni_msgq_lock(mq);
+	if ((mq->mq_maxbytes == 0) && (maxbytes != 0)) {
+		// Bytes are not counted without a budget, so catch up.
+		int i = mq->mq_get;
+
+		mq->mq_bytes = 0;
+		for (int n = nni_msgq_ring_len(mq); n > 0; n--) {
+			mq->mq_bytes += nni_msgq_msgsize(mq->mq_msgs[i]);
+			if (++i == mq->mq_alloc) {
+				i = 0;
+			}
+		}
+	}
+	mq->mq_maxbytes = maxbytes;
+	// The budget may have grown, letting blocked writers in.
+	nni_msgq_run_putq(mq);
+	nni_msgq_run_notify(mq);
+	nni_msgq_unlock(mq);
+}
+
+size_t
+nni_msgq_maxbytes(nni_msgq *mq)
+{
+	size_t rv;
+
+	nni_msgq_lock(mq);
+	rv = mq->mq_maxbytes;
+	nni_msgq_unlock(mq);
 	return (rv);
 }
 
@@ -544,16 +811,12 @@ nni_msgq_resize(nni_msgq *mq, int cap)
 		newq = NULL;
 	}
 
-	nni_mtx_lock(&mq->mq_lock);
-	while (mq->mq_len > (cap + 1)) {
+	nni_msgq_lock(mq);
+	while (nni_msgq_ring_len(mq) > (cap + 1)) {
 		// too many messages -- we allow that one for
 		// the case of pushback or cap == 0.
 		// we delete the oldest messages first
-		msg = mq->mq_msgs[mq->mq_get++];
-		if (mq->mq_get > mq->mq_alloc) {
-			mq->mq_get = 0;
-		}
-		mq->mq_len--;
+		msg = nni_msgq_ring_get(mq);
 		nni_msg_free(msg);
 	}
 	if (newq == NULL) {
@@ -567,12 +830,14 @@ nni_msgq_resize(nni_msgq *mq, int cap)
 	oldput   = mq->mq_put;
 	oldcap   = mq->mq_cap;
 	oldalloc = mq->mq_alloc;
-	oldlen   = mq->mq_len;
+	oldlen   = nni_msgq_ring_len(mq);
 
-	mq->mq_msgs = newq;
-	mq->mq_len = mq->mq_get = mq->mq_put = 0;
-	mq->mq_cap                           = cap;
-	mq->mq_alloc                         = alloc;
+	// The count is unchanged; only the slots move.
+	mq->mq_msgs  = newq;
+	mq->mq_get   = 0;
+	mq->mq_put   = 0;
+	mq->mq_cap   = cap;
+	mq->mq_alloc = alloc;
 
 	while (oldlen) {
 		mq->mq_msgs[mq->mq_put++] = oldq[oldget++];
@@ -582,7 +847,6 @@ nni_msgq_resize(nni_msgq *mq, int cap)
 		if (mq->mq_put == mq->mq_alloc) {
 			mq->mq_put = 0;
 		}
-		mq->mq_len++;
 		oldlen--;
 	}
 	nni_free(oldq, sizeof(nni_msg *) * oldalloc);
@@ -590,6 +854,6 @@ nni_msgq_resize(nni_msgq *mq, int cap)
 out:
 	// Wake everyone up -- we changed everything.
 	nni_cv_wake(&mq->mq_drained);
-	nni_mtx_unlock(&mq->mq_lock);
+	nni_msgq_unlock(mq);
 	return (0);
 }
@@ -44,6 +44,28 @@ extern void nni_msgq_aio_get(nni_msgq *, nni_aio *);
 // a zero time.
 extern int nni_msgq_tryput(nni_msgq *, nni_msg *);
 
+// NNI_MSGQ_BATCH is the number of messages protocols move at a time
+// with the batch operations below.  Larger values amortize more, but
+// let a single pipe hold back more messages from its siblings.
+#define NNI_MSGQ_BATCH 8
+
+// nni_msgq_put_batch performs a non-blocking put of up to the given
+// number of messages, under a single lock acquisition.  Blocked readers
+// are served first.  It returns the number of messages accepted (which
+// are taken in order from the front of the array); the rest remain
+// owned by the caller.  Zero is returned if the queue is full, closed,
+// or has a put error; a subsequent nni_msgq_aio_put will report which.
+extern int nni_msgq_put_batch(nni_msgq *, nni_msg **, int);
+
+// nni_msgq_get_batch performs a non-blocking get of up to the given
+// number of messages, under a single lock acquisition.  It returns the
+// number of messages stored.  Messages are never taken while readers
+// are blocked in nni_msgq_aio_get, and zero is returned if the queue
+// is empty, closed, or has a get error.  The usual pattern is to wait
+// for a first message with nni_msgq_aio_get, and then collect any
+// that are already queued behind it with this.
+extern int nni_msgq_get_batch(nni_msgq *, nni_msg **, int);
+
 // nni_msgq_set_error sets an error condition on the message queue,
 // which causes all current and future readers/writes to return the
 // given error condition (if non-zero).  Threads waiting to put or get
@@ -129,4 +151,15 @@ extern int nni_msgq_cap(nni_msgq *mq);
 // nni_msgq_len returns the number of messages currently in the queue.
 extern int nni_msgq_len(nni_msgq *mq);
 
+// nni_msgq_set_maxbytes sets a budget on the bytes (body plus header)
+// held in the queue, in addition to the limit on the number of messages.
+// Puts block (or fail, for the non-blocking forms) once the budget would
+// be exceeded, except that an empty queue always accepts a message, so
+// that a single message larger than the budget can still pass.  Zero,
+// the default, means no byte limit.
+extern void nni_msgq_set_maxbytes(nni_msgq *, size_t);
+
+// nni_msgq_maxbytes returns the byte budget, or zero if there is none.
+extern size_t nni_msgq_maxbytes(nni_msgq *);
+
 #endif // CORE_MSQUEUE_H
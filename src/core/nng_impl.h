@@ -33,6 +33,7 @@
 #include "core/init.h"
 #include "core/list.h"
 #include "core/message.h"
+#include "core/msgpool.h"
 #include "core/msgqueue.h"
 #include "core/options.h"
 #include "core/panic.h"
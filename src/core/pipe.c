@@ -180,6 +180,224 @@ nni_pipe_send(nni_pipe *p, nni_aio *aio)
 	p->p_tran_ops.p_send(p->p_tran_data, aio);
 }
 
+int
+nni_pipe_send_depth(nni_pipe *p)
+{
+	int n;
+
+	if (p->p_tran_ops.p_send_depth == NULL) {
+		return (1);
+	}
+	n = p->p_tran_ops.p_send_depth(p->p_tran_data);
+	if (n < 1) {
+		n = 1;
+	}
+	if (n > NNI_TRAN_SENDBATCH_MAX) {
+		n = NNI_TRAN_SENDBATCH_MAX;
+	}
+	return (n);
+}
+
+// Each send aio of a sender needs its own callback argument, so that the
+// callback knows which aio to give back.
+typedef struct nni_pipe_send_slot {
+	nni_pipe_sender *ss_sender;
+	nni_aio *        ss_aio;
+} nni_pipe_send_slot;
+
+struct nni_pipe_sender {
+	nni_mtx             ps_mtx;
+	nni_pipe *          ps_pipe;
+	nni_msgq *          ps_mq;
+	nni_aio *           ps_getq;
+	nni_pipe_send_slot *ps_slots;
+	int                 ps_nslots;
+	nni_aio **          ps_idle; // send aios free for use
+	int                 ps_nidle;
+	int                 ps_getting; // ps_getq is outstanding
+	int                 ps_closed;
+	nni_msg *(*ps_prep)(void *, nni_msg *);
+	void *ps_arg;
+};
+
+static void nni_pipe_sender_getq_cb(void *);
+static void nni_pipe_sender_send_cb(void *);
+
+// nni_pipe_sender_send sends the message on an idle aio.  The caller
+// holds the lock, and there must be an idle aio.
+static void
+nni_pipe_sender_send(nni_pipe_sender *ps, nni_msg *msg)
+{
+	nni_aio *aio;
+
+	if ((ps->ps_prep != NULL) &&
+	    ((msg = ps->ps_prep(ps->ps_arg, msg)) == NULL)) {
+		return;
+	}
+	aio = ps->ps_idle[--ps->ps_nidle];
+	nni_aio_set_msg(aio, msg);
+	nni_pipe_send(ps->ps_pipe, aio);
+}
+
+// nni_pipe_sender_pump sends whatever is already queued, as far as there
+// are idle aios, and then waits for more.  No messages may be taken while
+// the wait is outstanding, as that would put them ahead of the one it
+// gets.  The caller holds the lock.
+static void
+nni_pipe_sender_pump(nni_pipe_sender *ps)
+{
+	nni_msg *msgs[NNI_TRAN_SENDBATCH_MAX];
+	int      n;
+
+	while ((!ps->ps_closed) && (!ps->ps_getting) && (ps->ps_nidle > 0)) {
+		n = nni_msgq_get_batch(ps->ps_mq, msgs, ps->ps_nidle);
+		if (n == 0) {
+			ps->ps_getting = 1;
+			nni_msgq_aio_get(ps->ps_mq, ps->ps_getq);
+			break;
+		}
+		for (int i = 0; i < n; i++) {
+			nni_pipe_sender_send(ps, msgs[i]);
+		}
+	}
+}
+
+static void
+nni_pipe_sender_getq_cb(void *arg)
+{
+	nni_pipe_sender *ps = arg;
+	nni_msg *        msg;
+
+	if (nni_aio_result(ps->ps_getq) != 0) {
+		nni_pipe_stop(ps->ps_pipe);
+		return;
+	}
+	msg = nni_aio_get_msg(ps->ps_getq);
+	nni_aio_set_msg(ps->ps_getq, NULL);
+
+	nni_mtx_lock(&ps->ps_mtx);
+	ps->ps_getting = 0;
+	if (ps->ps_closed) {
+		nni_mtx_unlock(&ps->ps_mtx);
+		nni_msg_free(msg);
+		return;
+	}
+	nni_pipe_sender_send(ps, msg);
+	nni_pipe_sender_pump(ps);
+	nni_mtx_unlock(&ps->ps_mtx);
+}
+
+static void
+nni_pipe_sender_send_cb(void *arg)
+{
+	nni_pipe_send_slot *ss  = arg;
+	nni_pipe_sender *   ps  = ss->ss_sender;
+	nni_aio *           aio = ss->ss_aio;
+
+	if (nni_aio_result(aio) != 0) {
+		nni_msg_free(nni_aio_get_msg(aio));
+		nni_aio_set_msg(aio, NULL);
+		nni_pipe_stop(ps->ps_pipe);
+		return;
+	}
+
+	nni_mtx_lock(&ps->ps_mtx);
+	ps->ps_idle[ps->ps_nidle++] = aio;
+	nni_pipe_sender_pump(ps);
+	nni_mtx_unlock(&ps->ps_mtx);
+}
+
+int
+nni_pipe_sender_init(nni_pipe_sender **psp, nni_pipe *p,
+    nni_msg *(*prep)(void *, nni_msg *), void *arg)
+{
+	nni_pipe_sender *ps;
+	int              n;
+	int              rv;
+
+	if ((ps = NNI_ALLOC_STRUCT(ps)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	nni_mtx_init(&ps->ps_mtx);
+	ps->ps_pipe = p;
+	ps->ps_prep = prep;
+	ps->ps_arg  = arg;
+
+	n             = nni_pipe_send_depth(p);
+	ps->ps_nslots = n;
+	if (((ps->ps_slots = nni_alloc(n * sizeof(*ps->ps_slots))) == NULL) ||
+	    ((ps->ps_idle = nni_alloc(n * sizeof(nni_aio *))) == NULL)) {
+		nni_pipe_sender_fini(ps);
+		return (NNG_ENOMEM);
+	}
+	if ((rv = nni_aio_init(&ps->ps_getq, nni_pipe_sender_getq_cb, ps)) !=
+	    0) {
+		nni_pipe_sender_fini(ps);
+		return (rv);
+	}
+	for (int i = 0; i < n; i++) {
+		nni_pipe_send_slot *ss = &ps->ps_slots[i];
+
+		ss->ss_sender = ps;
+		rv = nni_aio_init(&ss->ss_aio, nni_pipe_sender_send_cb, ss);
+		if (rv != 0) {
+			nni_pipe_sender_fini(ps);
+			return (rv);
+		}
+		ps->ps_idle[ps->ps_nidle++] = ss->ss_aio;
+	}
+	*psp = ps;
+	return (0);
+}
+
+void
+nni_pipe_sender_start(nni_pipe_sender *ps, nni_msgq *mq)
+{
+	nni_mtx_lock(&ps->ps_mtx);
+	ps->ps_mq = mq;
+	nni_pipe_sender_pump(ps);
+	nni_mtx_unlock(&ps->ps_mtx);
+}
+
+void
+nni_pipe_sender_stop(nni_pipe_sender *ps)
+{
+	if (ps == NULL) {
+		return;
+	}
+	nni_mtx_lock(&ps->ps_mtx);
+	ps->ps_closed = 1;
+	nni_mtx_unlock(&ps->ps_mtx);
+
+	nni_aio_stop(ps->ps_getq);
+	for (int i = 0; i < ps->ps_nslots; i++) {
+		nni_aio_stop(ps->ps_slots[i].ss_aio);
+	}
+}
+
+void
+nni_pipe_sender_fini(nni_pipe_sender *ps)
+{
+	int n;
+
+	if (ps == NULL) {
+		return;
+	}
+	n = ps->ps_nslots;
+	if (ps->ps_slots != NULL) {
+		for (int i = 0; i < n; i++) {
+			nni_aio_fini(ps->ps_slots[i].ss_aio);
+		}
+		nni_free(ps->ps_slots, n * sizeof(*ps->ps_slots));
+	}
+	if (ps->ps_idle != NULL) {
+		nni_free(ps->ps_idle, n * sizeof(nni_aio *));
+	}
+	nni_aio_fini(ps->ps_getq);
+	nni_mtx_fini(&ps->ps_mtx);
+	NNI_FREE_STRUCT(ps);
+}
+
 // nni_pipe_close closes the underlying connection.  It is expected that
 // subsequent attempts receive or send (including any waiting receive) will
 // simply return NNG_ECLOSED.
@@ -29,6 +29,36 @@ extern void nni_pipe_send(nni_pipe *, nni_aio *);
 // Pipe operations that protocols use.
 extern uint32_t nni_pipe_id(nni_pipe *);
 
+// nni_pipe_send_depth returns the number of sends that the transport
+// can usefully take on the pipe at once.  This is one unless the
+// transport gathers several messages into a single write.
+extern int nni_pipe_send_depth(nni_pipe *);
+
+// nni_pipe_sender moves messages from a message queue onto a pipe, for
+// protocols.  It keeps up to nni_pipe_send_depth sends outstanding, so
+// that a transport which gathers messages into one write can be handed
+// several at a time.  Messages go to the pipe in the order they leave
+// the queue.  If a get or a send fails, the pipe is stopped.
+typedef struct nni_pipe_sender nni_pipe_sender;
+
+// nni_pipe_sender_init creates a sender for the pipe.  If the function
+// is not NULL, it is called with the argument and each message before
+// the message is sent.  It returns the message to send, or NULL if it
+// has disposed of the message itself.  It must not block.
+extern int nni_pipe_sender_init(nni_pipe_sender **, nni_pipe *,
+    nni_msg *(*) (void *, nni_msg *), void *);
+
+// nni_pipe_sender_start starts taking messages from the queue.
+extern void nni_pipe_sender_start(nni_pipe_sender *, nni_msgq *);
+
+// nni_pipe_sender_stop stops taking messages, and waits for the
+// outstanding gets and sends to finish.
+extern void nni_pipe_sender_stop(nni_pipe_sender *);
+
+// nni_pipe_sender_fini stops the sender and frees it.  Like the stop,
+// it does nothing if the sender is NULL.
+extern void nni_pipe_sender_fini(nni_pipe_sender *);
+
 // nni_pipe_close closes the underlying transport for the pipe.  Further
 // operations against will return NNG_ECLOSED.
 extern void nni_pipe_close(nni_pipe *);
@@ -69,6 +69,13 @@ extern const char *nni_plat_strerror(int);
 // to return NULL if memory cannot be allocated.
 extern void *nni_alloc(size_t);
 
+// nni_alloc_uninit is like nni_alloc, except that the memory returned need
+// not be zeroed.  This is used for buffers that are about to be completely
+// overwritten (for example by a read from the network), where clearing the
+// memory first would just waste memory bandwidth.  The memory is freed
+// with nni_free.
+extern void *nni_alloc_uninit(size_t);
+
 // nni_free frees memory allocated with nni_alloc. It takes a size because
 // some allocators do not track size, or can operate more efficiently if
 // the size is provided with the free call.  Examples of this are slab
@@ -80,6 +87,8 @@ extern void nni_free(void *, size_t);
 typedef struct nni_plat_mtx nni_plat_mtx;
 typedef struct nni_plat_cv  nni_plat_cv;
 typedef struct nni_plat_thr nni_plat_thr;
+typedef struct nni_plat_tls nni_plat_tls;
+typedef struct nni_plat_atomic nni_plat_atomic;
 
 //
 // Threading & Synchronization Support
@@ -141,6 +150,52 @@ extern int nni_plat_thr_init(nni_plat_thr *, void (*)(void *), void *);
 // is an error to reference the thread in any further way.
 extern void nni_plat_thr_fini(nni_plat_thr *);
 
+// nni_plat_ncpu returns the number of CPUs available to the process,
+// or 1 if that cannot be determined.
+extern int nni_plat_ncpu(void);
+
+// nni_plat_tls_init creates a thread-local storage slot.  The function
+// supplied (which may be NULL) is called in the context of any thread
+// that exits with a non-NULL value stored in the slot, and is passed
+// that value.  Slots are never destroyed; callers are expected to create
+// them once, and keep them for the life of the process.
+extern int nni_plat_tls_init(nni_plat_tls *, void (*)(void *));
+
+// nni_plat_tls_get returns the value stored in the slot for the calling
+// thread, or NULL if no value has been stored.
+extern void *nni_plat_tls_get(nni_plat_tls *);
+
+// nni_plat_tls_set stores a value in the slot for the calling thread.
+extern void nni_plat_tls_set(nni_plat_tls *, void *);
+
+//
+// Atomic Counters
+//
+
+// These are simple integer counters, suitable for reference counts,
+// that can be modified by multiple threads without any other locking.
+// Platforms should use native atomic operations where possible.
+
+// nni_plat_atomic_init sets the initial value of the counter.  This must
+// be done before the counter is shared with any other thread.
+extern void nni_plat_atomic_init(nni_plat_atomic *, int);
+
+// nni_plat_atomic_get returns the current value of the counter.
+extern int nni_plat_atomic_get(nni_plat_atomic *);
+
+// nni_plat_atomic_set replaces the value of a counter that may be shared.
+// Stores made before are visible to a thread that sees the new value with
+// nni_plat_atomic_get.
+extern void nni_plat_atomic_set(nni_plat_atomic *, int);
+
+// nni_plat_atomic_inc increments the counter.  Stores made before the
+// increment are visible to a thread that sees the new value with
+// nni_plat_atomic_get.
+extern void nni_plat_atomic_inc(nni_plat_atomic *);
+
+// nni_plat_atomic_dec decrements the counter, and returns the new value.
+extern int nni_plat_atomic_dec(nni_plat_atomic *);
+
 //
 // Clock Support
 //
@@ -153,9 +208,26 @@ extern void nni_plat_thr_fini(nni_plat_thr *);
 // of using negative values for other purposes in the future.)
 extern nni_time nni_plat_clock(void);
 
+// nni_plat_clock_coarse is like nni_plat_clock, and uses the same base,
+// but may trade precision for speed.  It is allowed to run ahead of
+// nni_plat_clock by a couple of clock ticks, but never behind, so that
+// deadlines computed from it never expire early.
+extern nni_time nni_plat_clock_coarse(void);
+
 // nni_plat_sleep sleeps for the specified number of milliseconds (at least).
 extern void nni_plat_sleep(nni_duration);
 
+// nni_plat_clock_us returns a monotonic time in microseconds, from some
+// arbitrary base.  It is used to time short busy waits, and need not
+// share a base with nni_plat_clock.
+extern uint64_t nni_plat_clock_us(void);
+
+// nni_plat_busypoll sets the time, in microseconds, that the I/O pollers
+// may spin checking for events before they block.  This applies to all of
+// the pollers, and so to every socket.  Zero, the default, disables
+// spinning.  Platforms that cannot spin ignore this.
+extern void nni_plat_busypoll(int);
+
 //
 // Entropy Support
 //
@@ -242,6 +314,12 @@ extern void nni_plat_tcp_pipe_send(nni_plat_tcp_pipe *, nni_aio *);
 // receive zero bytes.)  The platform may not modify the I/O vector.
 extern void nni_plat_tcp_pipe_recv(nni_plat_tcp_pipe *, nni_aio *);
 
+// nni_plat_tcp_pipe_zerocopy asks that sends of at least the given size
+// be done without copying the data, if the platform can do that.  Such
+// sends complete only once the platform is done with the buffers.  Zero
+// turns this off.  Returns NNG_ENOTSUP if the platform cannot do it.
+extern int nni_plat_tcp_pipe_zerocopy(nni_plat_tcp_pipe *, size_t);
+
 // nni_plat_tcp_pipe_peername gets the peer name.
 extern int nni_plat_tcp_pipe_peername(nni_plat_tcp_pipe *, nni_sockaddr *);
 
@@ -308,6 +386,48 @@ extern void nni_plat_ipc_pipe_send(nni_plat_ipc_pipe *, nni_aio *);
 // The platform may modify the iovs.
 extern void nni_plat_ipc_pipe_recv(nni_plat_ipc_pipe *, nni_aio *);
 
+// nni_plat_ipc_pipe_sameuser returns zero if the peer runs as the same
+// user as we do, or NNG_EPERM if it does not.  Platforms that cannot tell
+// return NNG_ENOTSUP.
+extern int nni_plat_ipc_pipe_sameuser(nni_plat_ipc_pipe *);
+
+//
+// Shared Memory Support.  A segment is created by one process, and
+// attached to by name from another one on the same host.  Platforms
+// without shared memory return NNG_ENOTSUP.
+//
+
+typedef struct nni_plat_shm nni_plat_shm;
+
+// NNI_PLAT_SHM_NAMELEN is the largest segment name, including the
+// terminating NUL.
+#define NNI_PLAT_SHM_NAMELEN 40
+
+// nni_plat_shm_create creates and maps a new segment of the given size,
+// with a unique name that other processes can hardly guess.  It is only
+// accessible to the current user, and it is initially zeroed.
+extern int nni_plat_shm_create(nni_plat_shm **, size_t);
+
+// nni_plat_shm_open maps an existing segment by name.  The segment
+// must be one that nni_plat_shm_create made for the current user, or
+// this fails with NNG_EINVAL or NNG_EPERM, and it must be at least as
+// large as the size given.
+extern int nni_plat_shm_open(nni_plat_shm **, const char *, size_t);
+
+// nni_plat_shm_name returns the name of the segment.
+extern const char *nni_plat_shm_name(nni_plat_shm *);
+
+// nni_plat_shm_addr returns the address of the mapping.
+extern void *nni_plat_shm_addr(nni_plat_shm *);
+
+// nni_plat_shm_unlink removes the name of the segment, so that no
+// further processes can attach to it.  Existing mappings are unaffected.
+extern void nni_plat_shm_unlink(nni_plat_shm *);
+
+// nni_plat_shm_fini unmaps the segment, and unlinks it if we created it
+// and it was not unlinked already.
+extern void nni_plat_shm_fini(nni_plat_shm *);
+
 //
 // UDP support. UDP is not connection oriented, and only has the notion
 // of being bound, sendto, and recvfrom.  (It is possible to set up a
@@ -337,6 +457,14 @@ extern void nni_plat_udp_send(nni_plat_udp *, nni_aio *);
 // NNG_EMSGSIZE results.
 extern void nni_plat_udp_recv(nni_plat_udp *, nni_aio *);
 
+// nni_plat_udp_segment enables segmentation offload.  Once on, a send
+// whose aio has a_segsz set is split by the platform into datagrams of
+// that size (GSO), and a receive may return several datagrams from the
+// same peer coalesced into one buffer (GRO), with a_segsz set to their
+// size.  Receive buffers should then be large enough for a full 64 KB
+// UDP payload.  Returns NNG_ENOTSUP if the platform cannot do this.
+extern int nni_plat_udp_segment(nni_plat_udp *, int);
+
 //
 // Notification Pipe Pairs
 //
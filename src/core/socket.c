@@ -63,6 +63,15 @@ struct nni_socket {
 	nni_list     s_options;   // opts not handled by sock/proto
 	char         s_name[64];  // socket name (legacy compat)
 
+	// Busy-poll budget (usec).  Set under nni_sock_lk, but read
+	// without it by receivers.
+	nni_plat_atomic s_busypoll;
+
+	// busy-poll statistics
+	uint64_t s_bp_hits;   // receives that completed while spinning
+	uint64_t s_bp_misses; // receives that slept after spinning
+	uint64_t s_bp_usec;   // total time spent spinning
+
 	nni_list s_eps;   // active endpoints
 	nni_list s_pipes; // active pipes
 
@@ -232,6 +241,43 @@ nni_sock_getopt_sendbuf(nni_sock *s, void *buf, size_t *szp)
 	return (nni_getopt_buf(s->s_uwq, buf, szp));
 }
 
+static int
+nni_sock_setopt_bufbytes(nni_msgq *mq, const void *buf, size_t sz)
+{
+	size_t val;
+	int    rv;
+
+	if ((rv = nni_setopt_size(&val, buf, sz, 0, NNI_MAXSZ)) != 0) {
+		return (rv);
+	}
+	nni_msgq_set_maxbytes(mq, val);
+	return (0);
+}
+
+static int
+nni_sock_setopt_recvbufbytes(nni_sock *s, const void *buf, size_t sz)
+{
+	return (nni_sock_setopt_bufbytes(s->s_urq, buf, sz));
+}
+
+static int
+nni_sock_getopt_recvbufbytes(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_size(nni_msgq_maxbytes(s->s_urq), buf, szp));
+}
+
+static int
+nni_sock_setopt_sendbufbytes(nni_sock *s, const void *buf, size_t sz)
+{
+	return (nni_sock_setopt_bufbytes(s->s_uwq, buf, sz));
+}
+
+static int
+nni_sock_getopt_sendbufbytes(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_size(nni_msgq_maxbytes(s->s_uwq), buf, szp));
+}
+
 static int
 nni_sock_getopt_sockname(nni_sock *s, void *buf, size_t *szp)
 {
@@ -254,6 +300,65 @@ nni_sock_getopt_domain(nni_sock *s, void *buf, size_t *szp)
 	return (nni_getopt_int(s->s_raw + 1, buf, szp));
 }
 
+// nni_sock_busypoll_update gives the pollers the largest busy-poll budget
+// of any open socket.  The pollers serve every socket, so this is a
+// process wide setting; only the spin in a blocking receive is specific
+// to the socket.  The caller must hold nni_sock_lk.
+static void
+nni_sock_busypoll_update(void)
+{
+	nni_sock *s;
+	int       usec = 0;
+
+	NNI_LIST_FOREACH (&nni_sock_list, s) {
+		int v = nni_plat_atomic_get(&s->s_busypoll);
+		if (v > usec) {
+			usec = v;
+		}
+	}
+	nni_plat_busypoll(usec);
+}
+
+static int
+nni_sock_setopt_busypoll(nni_sock *s, const void *buf, size_t sz)
+{
+	int usec;
+	int rv;
+
+	rv = nni_setopt_int(&usec, buf, sz, 0, NNI_SOCK_BUSYPOLL_MAX);
+	if (rv == 0) {
+		nni_mtx_lock(&nni_sock_lk);
+		nni_plat_atomic_set(&s->s_busypoll, usec);
+		nni_sock_busypoll_update();
+		nni_mtx_unlock(&nni_sock_lk);
+	}
+	return (rv);
+}
+
+static int
+nni_sock_getopt_busypoll(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_int(nni_plat_atomic_get(&s->s_busypoll), buf, szp));
+}
+
+static int
+nni_sock_getopt_busypollhits(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_u64(s->s_bp_hits, buf, szp));
+}
+
+static int
+nni_sock_getopt_busypollmisses(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_u64(s->s_bp_misses, buf, szp));
+}
+
+static int
+nni_sock_getopt_busypolltime(nni_sock *s, void *buf, size_t *szp)
+{
+	return (nni_getopt_u64(s->s_bp_usec, buf, szp));
+}
+
 static const nni_socket_option nni_sock_options[] = {
 	{
 	    .so_name   = NNG_OPT_RECVTIMEO,
@@ -285,6 +390,16 @@ static const nni_socket_option nni_sock_options[] = {
 	    .so_getopt = nni_sock_getopt_sendbuf,
 	    .so_setopt = nni_sock_setopt_sendbuf,
 	},
+	{
+	    .so_name   = NNG_OPT_RECVBUFBYTES,
+	    .so_getopt = nni_sock_getopt_recvbufbytes,
+	    .so_setopt = nni_sock_setopt_recvbufbytes,
+	},
+	{
+	    .so_name   = NNG_OPT_SENDBUFBYTES,
+	    .so_getopt = nni_sock_getopt_sendbufbytes,
+	    .so_setopt = nni_sock_setopt_sendbufbytes,
+	},
 	{
 	    .so_name   = NNG_OPT_RECONNMINT,
 	    .so_getopt = nni_sock_getopt_reconnmint,
@@ -305,6 +420,26 @@ static const nni_socket_option nni_sock_options[] = {
 	    .so_getopt = nni_sock_getopt_domain,
 	    .so_setopt = NULL,
 	},
+	{
+	    .so_name   = NNG_OPT_BUSYPOLL,
+	    .so_getopt = nni_sock_getopt_busypoll,
+	    .so_setopt = nni_sock_setopt_busypoll,
+	},
+	{
+	    .so_name   = NNG_OPT_BUSYPOLLHITS,
+	    .so_getopt = nni_sock_getopt_busypollhits,
+	    .so_setopt = NULL,
+	},
+	{
+	    .so_name   = NNG_OPT_BUSYPOLLMISSES,
+	    .so_getopt = nni_sock_getopt_busypollmisses,
+	    .so_setopt = NULL,
+	},
+	{
+	    .so_name   = NNG_OPT_BUSYPOLLTIME,
+	    .so_getopt = nni_sock_getopt_busypolltime,
+	    .so_setopt = NULL,
+	},
 	// terminate list
 	{ NULL, NULL, NULL },
 };
@@ -496,6 +631,7 @@ nni_sock_create(nni_sock **sp, const nni_proto *proto)
 	s->s_reconn          = NNI_SECOND;
 	s->s_reconnmax       = 0;
 	s->s_rcvmaxsz        = 1024 * 1024; // 1 MB by default
+	nni_plat_atomic_init(&s->s_busypoll, 0);
 	s->s_id              = 0;
 	s->s_refcnt          = 0;
 	s->s_send_fd.sn_init = 0;
@@ -730,6 +866,9 @@ nni_sock_close(nni_sock *s)
 	// We might have been removed from the list already, e.g. by
 	// nni_sock_closeall.  This is idempotent.
 	nni_list_node_remove(&s->s_node);
+	if (nni_plat_atomic_get(&s->s_busypoll) != 0) {
+		nni_sock_busypoll_update();
+	}
 
 	// Wait for all other references to drop.  Note that we
 	// have a reference already (from our caller).
@@ -787,7 +926,8 @@ nni_sock_normalize_expiration(nni_aio *aio, nni_duration def)
 			aio->a_expire = NNI_TIME_NEVER;
 			break;
 		default:
-			aio->a_expire = nni_clock() + aio->a_expire;
+			aio->a_expire =
+			    nni_clock_coarse() + aio->a_expire;
 			break;
 		}
 		aio->a_reltime = 0;
@@ -808,6 +948,30 @@ nni_sock_recv(nni_sock *sock, nni_aio *aio)
 	sock->s_sock_ops.sock_recv(sock->s_data, aio);
 }
 
+void
+nni_sock_recv_spin(nni_sock *sock, nni_aio *aio)
+{
+	int      usec;
+	int      done;
+	uint64_t start;
+
+	if ((usec = nni_plat_atomic_get(&sock->s_busypoll)) == 0) {
+		return;
+	}
+
+	start = nni_plat_clock_us();
+	done  = nni_aio_spin(aio, usec);
+
+	nni_mtx_lock(&sock->s_mx);
+	if (done) {
+		sock->s_bp_hits++;
+	} else {
+		sock->s_bp_misses++;
+	}
+	sock->s_bp_usec += nni_plat_clock_us() - start;
+	nni_mtx_unlock(&sock->s_mx);
+}
+
 // nni_sock_protocol returns the socket's 16-bit protocol number.
 uint16_t
 nni_sock_proto(nni_sock *sock)
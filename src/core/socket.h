@@ -28,6 +28,15 @@ extern int  nni_sock_recvmsg(nni_sock *, nni_msg **, int);
 extern int  nni_sock_sendmsg(nni_sock *, nni_msg *, int);
 extern void nni_sock_send(nni_sock *, nni_aio *);
 extern void nni_sock_recv(nni_sock *, nni_aio *);
+
+// nni_sock_recv_spin busy-waits for a receive started with nni_sock_recv
+// to complete, for up to the socket's NNG_OPT_BUSYPOLL budget, so that a
+// caller about to block on it can often avoid sleeping.
+extern void nni_sock_recv_spin(nni_sock *, nni_aio *);
+
+// NNI_SOCK_BUSYPOLL_MAX is the largest NNG_OPT_BUSYPOLL budget, in
+// microseconds.
+#define NNI_SOCK_BUSYPOLL_MAX 1000000
 extern uint32_t nni_sock_id(nni_sock *);
 
 // nni_sock_pipe_add adds the pipe to the socket. It is called by
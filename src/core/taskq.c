@@ -10,61 +10,232 @@
 
 #include "core/nng_impl.h"
 
-typedef struct nni_taskq_thr nni_taskq_thr;
+#include <stdlib.h>
+
+// Task queues.  Each thread owns a run queue, with its own lock.  A task
+// is always placed on the same queue (its "home", chosen when the task
+// is initialized), which keeps the bookkeeping for waiting, canceling,
+// and collapsing duplicate dispatches local to one lock.  A thread runs
+// work from its own queue first, and when that is empty steals work
+// from the queues of the other threads.  The taskq-wide lock is only
+// used to park and wake idle threads, and then only when a thread is
+// actually idle.  Each wakeup records the queue that the dispatch used,
+// and woken threads look first at the oldest such queue, so that tasks
+// are still started in roughly the order they were dispatched.
+//
+// Which thread is running a task is recorded by that thread under its
+// own tqt_mtx.  The task itself remembers the last thread to pick it up
+// (tracked under the home queue lock), so that waiters can find it
+// without scanning every thread.  Nothing touches the task once its
+// callback returns, as the callback is permitted to free it.
+//
+// Lock order is home queue lock (tqt_qmtx), then thread lock (tqt_mtx),
+// then the taskq lock (tq_mtx).
+
 struct nni_taskq_thr {
 	nni_taskq *tqt_tq;
 	nni_thr    tqt_thread;
-	nni_task * tqt_running;
-	int        tqt_wait;
+	int        tqt_index;
+
+	// Run queue; tqt_qcv is signaled when tasks leave it.
+	nni_mtx  tqt_qmtx;
+	nni_cv   tqt_qcv;
+	nni_list tqt_tasks;
+	int      tqt_qwait;
+
+	// Task being run by this thread; tqt_cv is signaled when it ends.
+	nni_mtx   tqt_mtx;
+	nni_cv    tqt_cv;
+	nni_task *tqt_running;
+	int       tqt_wait;
+
+	// Idle state, protected by the taskq lock.
+	nni_cv        tqt_sched_cv;
+	nni_list_node tqt_idle_node;
 };
+
 struct nni_taskq {
-	nni_list       tq_tasks;
-	nni_mtx        tq_mtx;
-	nni_cv         tq_sched_cv;
-	nni_cv         tq_wait_cv;
-	nni_taskq_thr *tq_threads;
-	int            tq_nthreads;
-	int            tq_run;
-	int            tq_waiting;
+	nni_taskq_thr * tq_threads;
+	int             tq_nthreads;
+	nni_plat_atomic tq_pending; // queued or running tasks
+	nni_plat_atomic tq_nidle;   // threads looking for work
+
+	nni_mtx  tq_mtx;
+	nni_list tq_idle;  // parked threads
+	int *    tq_hints; // queues for woken threads, oldest first
+	int      tq_hint_get;
+	int      tq_nhints;
+	nni_cv   tq_drain_cv;
+	int      tq_kicks; // wakeups not yet taken by a parked thread
+	int      tq_draining;
+	int      tq_run;
 };
 
 static nni_taskq *nni_taskq_systq = NULL;
 
+static nni_taskq_thr *
+nni_task_home(nni_task *task)
+{
+	return (&task->task_tq->tq_threads[task->task_home]);
+}
+
+// nni_taskq_done is called when a task is no longer queued or running.
+static void
+nni_taskq_done(nni_taskq *tq)
+{
+	if (nni_plat_atomic_dec(&tq->tq_pending) == 0) {
+		nni_mtx_lock(&tq->tq_mtx);
+		if (tq->tq_draining) {
+			nni_cv_wake(&tq->tq_drain_cv);
+		}
+		nni_mtx_unlock(&tq->tq_mtx);
+	}
+}
+
+// nni_taskq_take removes the first task from the given queue, and marks
+// it as being run by the calling thread.
+static nni_task *
+nni_taskq_take(nni_taskq_thr *q, nni_taskq_thr *self)
+{
+	nni_task *task;
+
+	nni_mtx_lock(&q->tqt_qmtx);
+	if ((task = nni_list_first(&q->tqt_tasks)) != NULL) {
+		nni_list_remove(&q->tqt_tasks, task);
+		task->task_runner = self;
+		nni_mtx_lock(&self->tqt_mtx);
+		self->tqt_running = task;
+		nni_mtx_unlock(&self->tqt_mtx);
+		if (q->tqt_qwait) {
+			q->tqt_qwait = 0;
+			nni_cv_wake(&q->tqt_qcv);
+		}
+	}
+	nni_mtx_unlock(&q->tqt_qmtx);
+	return (task);
+}
+
+// nni_taskq_find looks for work, starting with the given queue (usually
+// our own), and then on the queues of the other threads.
+static nni_task *
+nni_taskq_find(nni_taskq_thr *thr, int start)
+{
+	nni_taskq *tq = thr->tqt_tq;
+	nni_task * task;
+	int        i;
+
+	for (i = 0; i < tq->tq_nthreads; i++) {
+		int idx = (start + i) % tq->tq_nthreads;
+
+		if ((task = nni_taskq_take(&tq->tq_threads[idx], thr)) !=
+		    NULL) {
+			return (task);
+		}
+	}
+	return (NULL);
+}
+
+static void
+nni_taskq_run(nni_taskq_thr *thr, nni_task *task)
+{
+	nni_aio_inline ai;
+
+	nni_aio_inline_begin(&ai);
+	task->task_cb(task->task_arg);
+
+	// The task may be gone now, so only our own state is touched.
+	nni_mtx_lock(&thr->tqt_mtx);
+	thr->tqt_running = NULL;
+	if (thr->tqt_wait) {
+		thr->tqt_wait = 0;
+		nni_cv_wake(&thr->tqt_cv);
+	}
+	nni_mtx_unlock(&thr->tqt_mtx);
+
+	// Completions the task deferred are run once it is no longer running,
+	// so that they can safely wait for the task that produced them.
+	nni_aio_inline_end(&ai);
+	nni_taskq_done(thr->tqt_tq);
+}
+
+// nni_taskq_hint returns the queue of the oldest dispatch that woke a
+// thread, if any are outstanding, or the default supplied.  It must be
+// called with the taskq lock held.
+static int
+nni_taskq_hint(nni_taskq *tq, int dflt)
+{
+	int idx;
+
+	if (tq->tq_nhints == 0) {
+		return (dflt);
+	}
+	idx = tq->tq_hints[tq->tq_hint_get];
+	tq->tq_hint_get++;
+	tq->tq_hint_get %= tq->tq_nthreads;
+	tq->tq_nhints--;
+	return (idx);
+}
+
 static void
 nni_taskq_thread(void *self)
 {
 	nni_taskq_thr *thr = self;
 	nni_taskq *    tq  = thr->tqt_tq;
 	nni_task *     task;
+	int            start = thr->tqt_index;
+	int            run;
 
-	nni_mtx_lock(&tq->tq_mtx);
 	for (;;) {
-		if ((task = nni_list_first(&tq->tq_tasks)) != NULL) {
-			nni_list_remove(&tq->tq_tasks, task);
-			thr->tqt_running = task;
-			nni_mtx_unlock(&tq->tq_mtx);
-			task->task_cb(task->task_arg);
+		// If threads are being woken for work, that work is older
+		// than anything on our own queue, so help with it first.
+		if (nni_plat_atomic_get(&tq->tq_nidle) > 0) {
 			nni_mtx_lock(&tq->tq_mtx);
-			thr->tqt_running = NULL;
-			if (thr->tqt_wait || tq->tq_waiting) {
-				thr->tqt_wait  = 0;
-				tq->tq_waiting = 0;
-				nni_cv_wake(&tq->tq_wait_cv);
-			}
+			start = nni_taskq_hint(tq, start);
+			nni_mtx_unlock(&tq->tq_mtx);
+		}
+		if ((task = nni_taskq_find(thr, start)) != NULL) {
+			start = thr->tqt_index;
+			nni_taskq_run(thr, task);
+			continue;
+		}
 
+		// Announce that we are idle, and then look once more.  A
+		// dispatch racing with us will either find us idle and kick
+		// us, or will have queued its task where we can see it.
+		nni_plat_atomic_inc(&tq->tq_nidle);
+		if ((task = nni_taskq_find(thr, thr->tqt_index)) != NULL) {
+			(void) nni_plat_atomic_dec(&tq->tq_nidle);
+			nni_taskq_run(thr, task);
 			continue;
 		}
 
-		if (tq->tq_waiting) {
-			tq->tq_waiting = 0;
-			nni_cv_wake(&tq->tq_wait_cv);
+		nni_mtx_lock(&tq->tq_mtx);
+		start = thr->tqt_index;
+		if (tq->tq_kicks > 0) {
+			// A dispatch found nobody parked; take its wakeup.
+			tq->tq_kicks--;
+		} else if (tq->tq_run) {
+			nni_list_append(&tq->tq_idle, thr);
+			while (nni_list_active(&tq->tq_idle, thr) &&
+			    tq->tq_run) {
+				nni_cv_wait(&thr->tqt_sched_cv);
+			}
+			if (nni_list_active(&tq->tq_idle, thr)) {
+				nni_list_remove(&tq->tq_idle, thr);
+			} else {
+				// Woken by a dispatch, which left a hint,
+				// unless a busy thread got to it first.
+				start = nni_taskq_hint(tq, start);
+			}
 		}
-		if (!tq->tq_run) {
+		run = tq->tq_run;
+		nni_mtx_unlock(&tq->tq_mtx);
+		(void) nni_plat_atomic_dec(&tq->tq_nidle);
+
+		if (!run) {
 			break;
 		}
-		nni_cv_wait(&tq->tq_sched_cv);
 	}
-	nni_mtx_unlock(&tq->tq_mtx);
 }
 
 int
@@ -82,16 +253,34 @@ nni_taskq_init(nni_taskq **tqp, int nthr)
 		NNI_FREE_STRUCT(tq);
 		return (NNG_ENOMEM);
 	}
+	if ((tq->tq_hints = nni_alloc(sizeof(int) * nthr)) == NULL) {
+		NNI_FREE_STRUCTS(tq->tq_threads, nthr);
+		NNI_FREE_STRUCT(tq);
+		return (NNG_ENOMEM);
+	}
 	tq->tq_nthreads = nthr;
-	NNI_LIST_INIT(&tq->tq_tasks, nni_task, task_node);
+	nni_plat_atomic_init(&tq->tq_pending, 0);
+	nni_plat_atomic_init(&tq->tq_nidle, 0);
 
 	nni_mtx_init(&tq->tq_mtx);
-	nni_cv_init(&tq->tq_sched_cv, &tq->tq_mtx);
-	nni_cv_init(&tq->tq_wait_cv, &tq->tq_mtx);
+	nni_cv_init(&tq->tq_drain_cv, &tq->tq_mtx);
+	NNI_LIST_INIT(&tq->tq_idle, nni_taskq_thr, tqt_idle_node);
 
 	for (i = 0; i < nthr; i++) {
-		tq->tq_threads[i].tqt_tq      = tq;
-		tq->tq_threads[i].tqt_running = NULL;
+		nni_taskq_thr *thr = &tq->tq_threads[i];
+
+		thr->tqt_tq      = tq;
+		thr->tqt_index   = i;
+		thr->tqt_running = NULL;
+		NNI_LIST_INIT(&thr->tqt_tasks, nni_task, task_node);
+		nni_mtx_init(&thr->tqt_qmtx);
+		nni_cv_init(&thr->tqt_qcv, &thr->tqt_qmtx);
+		nni_mtx_init(&thr->tqt_mtx);
+		nni_cv_init(&thr->tqt_cv, &thr->tqt_mtx);
+		nni_cv_init(&thr->tqt_sched_cv, &tq->tq_mtx);
+		NNI_LIST_NODE_INIT(&thr->tqt_idle_node);
+	}
+	for (i = 0; i < nthr; i++) {
 		rv = nni_thr_init(&tq->tq_threads[i].tqt_thread,
 		    nni_taskq_thread, &tq->tq_threads[i]);
 		if (rv != 0) {
@@ -107,36 +296,15 @@ nni_taskq_init(nni_taskq **tqp, int nthr)
 	return (0);
 }
 
-static void
-nni_taskq_drain_locked(nni_taskq *tq)
-{
-	// We need to first let the taskq completely drain.
-	for (;;) {
-		int busy = 0;
-		if (!nni_list_empty(&tq->tq_tasks)) {
-			busy = 1;
-		} else {
-			int i;
-			for (i = 0; i < tq->tq_nthreads; i++) {
-				if (tq->tq_threads[i].tqt_running != 0) {
-					busy = 1;
-					break;
-				}
-			}
-		}
-		if (!busy) {
-			break;
-		}
-		tq->tq_waiting++;
-		nni_cv_wait(&tq->tq_wait_cv);
-	}
-}
-
 void
 nni_taskq_drain(nni_taskq *tq)
 {
 	nni_mtx_lock(&tq->tq_mtx);
-	nni_taskq_drain_locked(tq);
+	tq->tq_draining++;
+	while (nni_plat_atomic_get(&tq->tq_pending) != 0) {
+		nni_cv_wait(&tq->tq_drain_cv);
+	}
+	tq->tq_draining--;
 	nni_mtx_unlock(&tq->tq_mtx);
 }
 
@@ -150,19 +318,32 @@ nni_taskq_fini(nni_taskq *tq)
 		return;
 	}
 	if (tq->tq_run) {
-		nni_mtx_lock(&tq->tq_mtx);
-		nni_taskq_drain_locked(tq);
+		nni_taskq_drain(tq);
 
+		nni_mtx_lock(&tq->tq_mtx);
 		tq->tq_run = 0;
-		nni_cv_wake(&tq->tq_sched_cv);
+		for (int i = 0; i < tq->tq_nthreads; i++) {
+			nni_cv_wake(&tq->tq_threads[i].tqt_sched_cv);
+		}
 		nni_mtx_unlock(&tq->tq_mtx);
 	}
+	// Threads steal from each other's queues, so all of them must be
+	// gone before any of the queues are torn down.
 	for (int i = 0; i < tq->tq_nthreads; i++) {
 		nni_thr_fini(&tq->tq_threads[i].tqt_thread);
 	}
-	nni_cv_fini(&tq->tq_wait_cv);
-	nni_cv_fini(&tq->tq_sched_cv);
+	for (int i = 0; i < tq->tq_nthreads; i++) {
+		nni_taskq_thr *thr = &tq->tq_threads[i];
+
+		nni_cv_fini(&thr->tqt_sched_cv);
+		nni_cv_fini(&thr->tqt_cv);
+		nni_mtx_fini(&thr->tqt_mtx);
+		nni_cv_fini(&thr->tqt_qcv);
+		nni_mtx_fini(&thr->tqt_qmtx);
+	}
+	nni_cv_fini(&tq->tq_drain_cv);
 	nni_mtx_fini(&tq->tq_mtx);
+	nni_free(tq->tq_hints, sizeof(int) * tq->tq_nthreads);
 	NNI_FREE_STRUCTS(tq->tq_threads, tq->tq_nthreads);
 	NNI_FREE_STRUCT(tq);
 }
@@ -170,106 +351,163 @@ nni_taskq_fini(nni_taskq *tq)
 void
 nni_task_dispatch(nni_task *task)
 {
-	nni_taskq *tq = task->task_tq;
+	nni_taskq *    tq = task->task_tq;
+	nni_taskq_thr *q;
+	nni_taskq_thr *thr;
+	int            queued = 0;
 
 	// If there is no callback to perform, then do nothing!
 	// The user will be none the wiser.
 	if (task->task_cb == NULL) {
 		return;
 	}
-	nni_mtx_lock(&tq->tq_mtx);
+	q = nni_task_home(task);
+	nni_mtx_lock(&q->tqt_qmtx);
 	// It might already be scheduled... if so don't redo it.
-	if (!nni_list_active(&tq->tq_tasks, task)) {
-		nni_list_append(&tq->tq_tasks, task);
+	if (!nni_list_active(&q->tqt_tasks, task)) {
+		nni_list_append(&q->tqt_tasks, task);
+		nni_plat_atomic_inc(&tq->tq_pending);
+		queued = 1;
+	}
+	nni_mtx_unlock(&q->tqt_qmtx);
+
+	// Only bother the taskq lock if somebody is idle.  Otherwise the
+	// threads will find this when they finish their current work.
+	if (queued && (nni_plat_atomic_get(&tq->tq_nidle) > 0)) {
+		nni_mtx_lock(&tq->tq_mtx);
+		if (nni_list_active(&tq->tq_idle, q)) {
+			thr = q;
+		} else {
+			thr = nni_list_first(&tq->tq_idle);
+		}
+		if (thr != NULL) {
+			int i = (tq->tq_hint_get + tq->tq_nhints) %
+			    tq->tq_nthreads;
+			tq->tq_hints[i] = q->tqt_index;
+			tq->tq_nhints++;
+			nni_list_remove(&tq->tq_idle, thr);
+			nni_cv_wake1(&thr->tqt_sched_cv);
+		} else {
+			tq->tq_kicks++;
+		}
+		nni_mtx_unlock(&tq->tq_mtx);
 	}
-	nni_cv_wake1(&tq->tq_sched_cv); // waking just one waiter is adequate
-	nni_mtx_unlock(&tq->tq_mtx);
+}
+
+// nni_task_wait_running waits for the task to finish, if it is running.
+// It is called with the home queue lock held, and always drops it.  It
+// returns zero if the task was not running, or non-zero if it waited (in
+// which case the caller should check the task again).
+static int
+nni_task_wait_running(nni_taskq_thr *home, nni_task *task)
+{
+	nni_taskq_thr *thr;
+
+	if ((thr = task->task_runner) == NULL) {
+		nni_mtx_unlock(&home->tqt_qmtx);
+		return (0);
+	}
+	nni_mtx_lock(&thr->tqt_mtx);
+	nni_mtx_unlock(&home->tqt_qmtx);
+	if (thr->tqt_running != task) {
+		nni_mtx_unlock(&thr->tqt_mtx);
+		return (0);
+	}
+	thr->tqt_wait = 1;
+	nni_cv_wait(&thr->tqt_cv);
+	nni_mtx_unlock(&thr->tqt_mtx);
+	return (1);
 }
 
 void
 nni_task_wait(nni_task *task)
 {
-	nni_taskq *tq = task->task_tq;
-	int        running;
+	nni_taskq_thr *home;
 
 	if (task->task_cb == NULL) {
 		return;
 	}
-	nni_mtx_lock(&tq->tq_mtx);
+	home = nni_task_home(task);
 	for (;;) {
-		running = 0;
-		if (nni_list_active(&tq->tq_tasks, task)) {
-			running = 1;
-		} else {
-			for (int i = 0; i < tq->tq_nthreads; i++) {
-				if (tq->tq_threads[i].tqt_running == task) {
-					running = 1;
-					break;
-				}
-			}
+		nni_mtx_lock(&home->tqt_qmtx);
+		if (nni_list_active(&home->tqt_tasks, task)) {
+			home->tqt_qwait = 1;
+			nni_cv_wait(&home->tqt_qcv);
+			nni_mtx_unlock(&home->tqt_qmtx);
+			continue;
 		}
-		if (!running) {
+		if (!nni_task_wait_running(home, task)) {
 			break;
 		}
-
-		tq->tq_waiting = 1;
-		nni_cv_wait(&tq->tq_wait_cv);
 	}
-	nni_mtx_unlock(&tq->tq_mtx);
 }
 
 int
 nni_task_cancel(nni_task *task)
 {
-	nni_taskq *tq = task->task_tq;
-	int        running;
+	nni_taskq_thr *home;
 
-	nni_mtx_lock(&tq->tq_mtx);
-	running = 1;
+	home = nni_task_home(task);
 	for (;;) {
-		running = 0;
-		for (int i = 0; i < tq->tq_nthreads; i++) {
-			if (tq->tq_threads[i].tqt_running == task) {
-				running = 1;
-				break;
+		nni_mtx_lock(&home->tqt_qmtx);
+		if (nni_list_active(&home->tqt_tasks, task)) {
+			nni_list_remove(&home->tqt_tasks, task);
+			nni_taskq_done(task->task_tq);
+			// Anyone in nni_task_wait is waiting for it to leave.
+			if (home->tqt_qwait) {
+				home->tqt_qwait = 0;
+				nni_cv_wake(&home->tqt_qcv);
 			}
 		}
-
-		if (!running) {
+		if (!nni_task_wait_running(home, task)) {
 			break;
 		}
-		// tq->tq_threads[i].tqt_wait = 1;
-		tq->tq_waiting++;
-		nni_cv_wait(&tq->tq_wait_cv);
-	}
-
-	if (nni_list_active(&tq->tq_tasks, task)) {
-		nni_list_remove(&tq->tq_tasks, task);
 	}
-	nni_mtx_unlock(&tq->tq_mtx);
 	return (0);
 }
 
 void
 nni_task_init(nni_taskq *tq, nni_task *task, nni_cb cb, void *arg)
 {
+	uintptr_t h;
+
 	if (tq == NULL) {
 		tq = nni_taskq_systq;
 	}
 	NNI_LIST_NODE_INIT(&task->task_node);
-	task->task_cb  = cb;
-	task->task_arg = arg;
-	task->task_tq  = tq;
+	task->task_cb     = cb;
+	task->task_arg    = arg;
+	task->task_tq     = tq;
+	task->task_runner = NULL;
+
+	// Spread tasks over the queues by address.  Tasks are embedded in
+	// larger structures, so the low order bits say very little.
+	h               = (uintptr_t) task;
+	h               = (h >> 4) ^ (h >> 12) ^ (h >> 20);
+	task->task_home = (int) (h % (uintptr_t) tq->tq_nthreads);
 }
 
 int
 nni_taskq_sys_init(void)
 {
-	int rv;
+	int   nthr;
+	char *env;
 
-	// XXX: Make the "16" = NCPUs * 2
-	rv = nni_taskq_init(&nni_taskq_systq, 16);
-	return (rv);
+	// By default we run two threads per CPU, as callbacks do sometimes
+	// block briefly.  The floor only guarantees that one blocked
+	// callback cannot stall the rest, so small machines get a small
+	// pool.  NNG_TASKQ_THREADS in the environment overrides this.
+	nthr = nni_plat_ncpu() * 2;
+	if (nthr < NNI_TASKQ_MINTHREADS) {
+		nthr = NNI_TASKQ_MINTHREADS;
+	}
+	if (nthr > NNI_TASKQ_MAXTHREADS) {
+		nthr = NNI_TASKQ_MAXTHREADS;
+	}
+	if (((env = getenv("NNG_TASKQ_THREADS")) != NULL) && (atoi(env) > 0)) {
+		nthr = atoi(env);
+	}
+	return (nni_taskq_init(&nni_taskq_systq, nthr));
 }
 
 void
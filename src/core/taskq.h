@@ -14,18 +14,31 @@
 #include "core/defs.h"
 #include "core/list.h"
 
-typedef struct nni_taskq nni_taskq;
-typedef struct nni_task  nni_task;
+typedef struct nni_taskq     nni_taskq;
+typedef struct nni_taskq_thr nni_taskq_thr;
+typedef struct nni_task      nni_task;
 
 // nni_task is a structure representing a task.  Its intended to inlined
 // into structures so that taskq_dispatch can be a guaranteed operation.
 struct nni_task {
-	nni_list_node task_node;
-	void *        task_arg;
-	nni_cb        task_cb;
-	nni_taskq *   task_tq;
+	nni_list_node  task_node;
+	void *         task_arg;
+	nni_cb         task_cb;
+	nni_taskq *    task_tq;
+	int            task_home;   // index of the queue we are placed on
+	nni_taskq_thr *task_runner; // thread that last picked us up
 };
 
+// Bounds on the default number of threads in the system taskq, which is
+// otherwise twice the number of CPUs.  The NNG_TASKQ_THREADS environment
+// variable, if set, overrides the default without these bounds.
+#ifndef NNI_TASKQ_MINTHREADS
+#define NNI_TASKQ_MINTHREADS 2
+#endif
+#ifndef NNI_TASKQ_MAXTHREADS
+#define NNI_TASKQ_MAXTHREADS 256
+#endif
+
 extern int  nni_taskq_init(nni_taskq **, int);
 extern void nni_taskq_fini(nni_taskq *);
 extern void nni_taskq_drain(nni_taskq *);
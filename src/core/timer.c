@@ -14,23 +14,151 @@
 #include <string.h>
 
 static void nni_timer_loop(void *);
+static void nni_timer_run(void *);
+
+// Pending timers are kept in a pairing heap, which is intrusive (so that
+// scheduling never allocates), and gives O(1) insertion, with O(log n)
+// amortized removal.  Rescheduling a timer, as REQ does for every
+// request, is a removal followed by an insertion.
+// Each callback in progress has one of these, on the stack of the task
+// running it.  It stays with the timer, rather than the node, because
+// the callback may free the node.  So ta_node is only ever compared.
+struct nni_timer_active {
+	nni_timer_node *         ta_node;
+	int                      ta_pending; // fired again while running
+	struct nni_timer_active *ta_next;
+};
+
+typedef struct nni_timer_active nni_timer_active;
 
-// XXX: replace this timer list with a minHeap based priority queue.
 struct nni_timer {
-	nni_mtx         t_mx;
-	nni_cv          t_wait_cv;
-	nni_cv          t_sched_cv;
-	nni_list        t_entries;
-	nni_thr         t_thr;
-	int             t_run;
-	int             t_waiting;
-	nni_timer_node *t_active; // Must never ever be dereferenced!
+	nni_mtx           t_mx;
+	nni_cv            t_sched_cv;
+	nni_timer_node *  t_root;
+	nni_timer_active *t_active;
+	nni_thr           t_thr;
+	int               t_run;
 };
 
 typedef struct nni_timer nni_timer;
 
 static nni_timer nni_global_timer;
 
+// nni_timer_meld merges two heaps, returning the new root.
+static nni_timer_node *
+nni_timer_meld(nni_timer_node *a, nni_timer_node *b)
+{
+	nni_timer_node *t;
+
+	if (a == NULL) {
+		return (b);
+	}
+	if (b == NULL) {
+		return (a);
+	}
+	if (b->t_expire < a->t_expire) {
+		t = a;
+		a = b;
+		b = t;
+	}
+	// b becomes the first child of a.
+	b->t_prev = a;
+	b->t_next = a->t_child;
+	if (a->t_child != NULL) {
+		a->t_child->t_prev = b;
+	}
+	a->t_child = b;
+	a->t_next  = NULL;
+	a->t_prev  = NULL;
+	return (a);
+}
+
+// nni_timer_merge_pairs combines a list of sibling heaps into one, using
+// the usual two pass method: meld pairs from the left, and then meld the
+// results together from the right.
+static nni_timer_node *
+nni_timer_merge_pairs(nni_timer_node *first)
+{
+	nni_timer_node *pairs = NULL;
+	nni_timer_node *a;
+	nni_timer_node *b;
+	nni_timer_node *root;
+
+	// First pass; the melded pairs are chained through t_next, in
+	// reverse order, which is what the second pass wants.
+	while ((a = first) != NULL) {
+		if ((b = a->t_next) != NULL) {
+			first = b->t_next;
+			a     = nni_timer_meld(a, b);
+		} else {
+			first     = NULL;
+			a->t_prev = NULL;
+		}
+		a->t_next = pairs;
+		pairs     = a;
+	}
+
+	root = NULL;
+	while ((a = pairs) != NULL) {
+		pairs     = a->t_next;
+		a->t_next = NULL;
+		root      = nni_timer_meld(root, a);
+	}
+	return (root);
+}
+
+static void
+nni_timer_insert(nni_timer *timer, nni_timer_node *node)
+{
+	node->t_child  = NULL;
+	node->t_next   = NULL;
+	node->t_prev   = NULL;
+	node->t_queued = 1;
+	timer->t_root  = nni_timer_meld(timer->t_root, node);
+}
+
+static void
+nni_timer_remove(nni_timer *timer, nni_timer_node *node)
+{
+	nni_timer_node *sub;
+
+	node->t_queued = 0;
+	sub            = nni_timer_merge_pairs(node->t_child);
+	node->t_child  = NULL;
+	if (node == timer->t_root) {
+		timer->t_root = sub;
+		return;
+	}
+
+	// Detach from our parent or left sibling.
+	if (node->t_prev->t_child == node) {
+		node->t_prev->t_child = node->t_next;
+	} else {
+		node->t_prev->t_next = node->t_next;
+	}
+	if (node->t_next != NULL) {
+		node->t_next->t_prev = node->t_prev;
+	}
+	node->t_next  = NULL;
+	node->t_prev  = NULL;
+	timer->t_root = nni_timer_meld(timer->t_root, sub);
+}
+
+// nni_timer_find_active returns the record of the callback running for
+// the node, if there is one.
+static nni_timer_active *
+nni_timer_find_active(nni_timer *timer, nni_timer_node *node)
+{
+	nni_timer_active *act;
+
+	for (act = timer->t_active; act != NULL; act = act->ta_next) {
+		if (act->ta_node == node) {
+			break;
+		}
+	}
+	return (act);
+}
+
 int
 nni_timer_sys_init(void)
 {
@@ -38,11 +166,9 @@ nni_timer_sys_init(void)
 	nni_timer *timer = &nni_global_timer;
 
 	memset(timer, 0, sizeof(*timer));
-	NNI_LIST_INIT(&timer->t_entries, nni_timer_node, t_node);
 
 	nni_mtx_init(&timer->t_mx);
 	nni_cv_init(&timer->t_sched_cv, &timer->t_mx);
-	nni_cv_init(&timer->t_wait_cv, &timer->t_mx);
 
 	if ((rv = nni_thr_init(&timer->t_thr, nni_timer_loop, timer)) != 0) {
 		nni_timer_sys_fini();
@@ -66,7 +192,6 @@ nni_timer_sys_fini(void)
 	}
 
 	nni_thr_fini(&timer->t_thr);
-	nni_cv_fini(&timer->t_wait_cv);
 	nni_cv_fini(&timer->t_sched_cv);
 	nni_mtx_fini(&timer->t_mx);
 }
@@ -74,8 +199,10 @@ nni_timer_sys_fini(void)
 void
 nni_timer_init(nni_timer_node *node, nni_cb cb, void *arg)
 {
+	memset(node, 0, sizeof(*node));
 	node->t_cb  = cb;
 	node->t_arg = arg;
+	nni_task_init(NULL, &node->t_task, nni_timer_run, node);
 }
 
 void
@@ -87,44 +214,52 @@ nni_timer_fini(nni_timer_node *node)
 void
 nni_timer_cancel(nni_timer_node *node)
 {
-	nni_timer *timer = &nni_global_timer;
+	nni_timer *       timer = &nni_global_timer;
+	nni_timer_active *act;
+	unsigned          fires;
+	int               again;
 
-	nni_mtx_lock(&timer->t_mx);
-	while (timer->t_active == node) {
-		timer->t_waiting = 1;
-		nni_cv_wait(&timer->t_wait_cv);
-	}
-	if (nni_list_active(&timer->t_entries, node)) {
-		nni_list_remove(&timer->t_entries, node);
-	}
-	nni_mtx_unlock(&timer->t_mx);
+	// A callback that is already running may reschedule the timer,
+	// and the timer thread may fire it again while we wait, so keep
+	// at it until nothing has changed.
+	do {
+		nni_mtx_lock(&timer->t_mx);
+		if (node->t_queued) {
+			nni_timer_remove(timer, node);
+		}
+		if ((act = nni_timer_find_active(timer, node)) != NULL) {
+			act->ta_pending = 0;
+		}
+		fires = node->t_fires;
+		nni_mtx_unlock(&timer->t_mx);
+
+		nni_task_cancel(&node->t_task);
+
+		nni_mtx_lock(&timer->t_mx);
+		again = node->t_queued || (node->t_fires != fires);
+		if (!again) {
+			// Nothing is running, and if the task was still
+			// queued, the cancel took it off.
+			node->t_dispatched = 0;
+		}
+		nni_mtx_unlock(&timer->t_mx);
+	} while (again);
 }
 
 void
 nni_timer_schedule(nni_timer_node *node, nni_time when)
 {
-	nni_timer *     timer = &nni_global_timer;
-	nni_timer_node *srch;
-	int             wake = 1;
+	nni_timer *timer = &nni_global_timer;
 
 	nni_mtx_lock(&timer->t_mx);
-	node->t_expire = when;
-
-	if (nni_list_active(&timer->t_entries, node)) {
-		nni_list_remove(&timer->t_entries, node);
+	if (node->t_queued) {
+		nni_timer_remove(timer, node);
 	}
+	node->t_expire = when;
+	nni_timer_insert(timer, node);
 
-	srch = nni_list_first(&timer->t_entries);
-	while ((srch != NULL) && (srch->t_expire < node->t_expire)) {
-		srch = nni_list_next(&timer->t_entries, srch);
-		wake = 0;
-	}
-	if (srch != NULL) {
-		nni_list_insert_before(&timer->t_entries, node, srch);
-	} else {
-		nni_list_append(&timer->t_entries, node);
-	}
-	if (wake) {
+	// If we are the new earliest timer, the timer thread must adjust.
+	if (timer->t_root == node) {
 		nni_cv_wake1(&timer->t_sched_cv);
 	}
 	nni_mtx_unlock(&timer->t_mx);
@@ -133,44 +268,73 @@ nni_timer_schedule(nni_timer_node *node, nni_time when)
 static void
 nni_timer_loop(void *arg)
 {
-	nni_timer *     timer = arg;
-	nni_time        now;
-	nni_timer_node *node;
-
-	for (;;) {
-		nni_mtx_lock(&timer->t_mx);
-		timer->t_active = NULL;
-		if (timer->t_waiting) {
-			timer->t_waiting = 0;
-			nni_cv_wake(&timer->t_wait_cv);
-		}
-		if (!timer->t_run) {
-			nni_mtx_unlock(&timer->t_mx);
-			break;
-		}
+	nni_timer *       timer = arg;
+	nni_time          now;
+	nni_timer_node *  node;
+	nni_timer_active *act;
 
-		now = nni_clock();
-		if ((node = nni_list_first(&timer->t_entries)) == NULL) {
+	nni_mtx_lock(&timer->t_mx);
+	while (timer->t_run) {
+		if ((node = timer->t_root) == NULL) {
 			nni_cv_wait(&timer->t_sched_cv);
-			nni_mtx_unlock(&timer->t_mx);
 			continue;
 		}
+		now = nni_clock();
 		if (now < node->t_expire) {
 			// End of run, we have to wait for next.
 			nni_cv_until(&timer->t_sched_cv, node->t_expire);
-			nni_mtx_unlock(&timer->t_mx);
 			continue;
 		}
 
-		nni_list_remove(&timer->t_entries, node);
+		// Hand it to the taskq.  If it is already waiting there, that
+		// run will do for this fire as well.  If it is still running
+		// from last time, nni_timer_run goes around again instead.
+		nni_timer_remove(timer, node);
+		node->t_fires++;
+		if ((act = nni_timer_find_active(timer, node)) != NULL) {
+			act->ta_pending = 1;
+		} else if (!node->t_dispatched) {
+			node->t_dispatched = 1;
+			nni_task_dispatch(&node->t_task);
+		}
+	}
+	nni_mtx_unlock(&timer->t_mx);
+}
 
-		// Save the active node.  Note that the timer callback can
-		// free this memory or do something else with it, so it is
-		// important that we never dereference this pointer, but
-		// just compare the value of the pointer itself.
-		timer->t_active = node;
-		nni_mtx_unlock(&timer->t_mx);
+// nni_timer_run is the task for a timer node.  It calls the user's
+// callback, and again for as long as the timer fired while it ran.  Once
+// the callback returns, the node is only touched if it fired again, as
+// it must still be live to have been scheduled.
+static void
+nni_timer_run(void *arg)
+{
+	nni_timer_node *   node  = arg;
+	nni_timer *        timer = &nni_global_timer;
+	nni_timer_active   act;
+	nni_timer_active **actp;
 
+	act.ta_node    = node;
+	act.ta_pending = 0;
+	nni_mtx_lock(&timer->t_mx);
+	node->t_dispatched = 0;
+	act.ta_next        = timer->t_active;
+	timer->t_active    = &act;
+	nni_mtx_unlock(&timer->t_mx);
+
+	for (;;) {
 		node->t_cb(node->t_arg);
+
+		nni_mtx_lock(&timer->t_mx);
+		if (!act.ta_pending) {
+			break;
+		}
+		act.ta_pending = 0;
+		nni_mtx_unlock(&timer->t_mx);
 	}
+	for (actp = &timer->t_active; *actp != &act;
+	     actp = &(*actp)->ta_next) {
+		;
+	}
+	*actp = act.ta_next;
+	nni_mtx_unlock(&timer->t_mx);
 }
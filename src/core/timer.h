@@ -11,15 +11,29 @@
 #define CORE_TIMER_H
 
 #include "core/defs.h"
-#include "core/list.h"
+#include "core/taskq.h"
 
-// For the sake of simplicity, we just maintain a single global timer thread.
+// A single global timer thread keeps the pending timers in order, but the
+// callbacks themselves are run on the system taskq, so that a slow
+// callback does not hold up other timers.  A callback never runs
+// concurrently with itself; if the timer fires again while it is still
+// running, it is run once more when it returns.  The node is not touched
+// once the callback returns, so the callback may free it.
 
 struct nni_timer_node {
-	nni_time      t_expire;
-	nni_cb        t_cb;
-	void *        t_arg;
-	nni_list_node t_node;
+	nni_time t_expire;
+	nni_task t_task;
+	nni_cb   t_cb;
+	void *   t_arg;
+	int      t_queued;     // in the heap
+	int      t_dispatched; // on the taskq, and not yet started
+	unsigned t_fires;      // count of fires, for cancel
+
+	// Pairing heap linkage.  t_prev is our parent if we are its first
+	// child, and otherwise our left sibling.
+	struct nni_timer_node *t_child;
+	struct nni_timer_node *t_next;
+	struct nni_timer_node *t_prev;
 };
 
 typedef struct nni_timer_node nni_timer_node;
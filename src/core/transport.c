@@ -11,6 +11,7 @@
 #include "core/nng_impl.h"
 #include "transport/inproc/inproc.h"
 #include "transport/ipc/ipc.h"
+#include "transport/shm/shm.h"
 #include "transport/tcp/tcp.h"
 #include "transport/tls/tls.h"
 #include "transport/zerotier/zerotier.h"
@@ -148,6 +149,9 @@ static nni_tran_ctor nni_tran_ctors[] = {
 #ifdef NNG_HAVE_IPC
 	nng_ipc_register,
 #endif
+#ifdef NNG_HAVE_SHM
+	nng_shm_register,
+#endif
 #ifdef NNG_HAVE_TCP
 	nng_tcp_register,
 #endif
@@ -194,3 +198,274 @@ nni_tran_sys_fini(void)
 	nni_mtx_fini(&nni_tran_lk);
 	nni_tran_inited = 0;
 }
+
+// Stream send batching.
+
+static void nni_tran_batch_cb(void *);
+
+int
+nni_tran_batch_init(nni_tran_batch *b, int maxmsgs, size_t maxbytes,
+    const void *prefix, size_t prefixlen, void (*writefn)(void *, nni_aio *),
+    void (*closefn)(void *), void *arg)
+{
+	int rv;
+
+	NNI_ASSERT(maxmsgs <= NNI_TRAN_SENDBATCH_MAX);
+	NNI_ASSERT(prefixlen <= NNI_TRAN_BATCH_PREFIX);
+
+	nni_mtx_init(&b->tb_mtx);
+	nni_aio_list_init(&b->tb_sendq);
+	if (prefixlen > 0) {
+		memcpy(b->tb_prefix, prefix, prefixlen);
+	}
+	b->tb_hdrlen   = prefixlen + sizeof(uint64_t);
+	b->tb_maxmsgs  = maxmsgs;
+	b->tb_maxbytes = maxbytes;
+	b->tb_write    = writefn;
+	b->tb_close    = closefn;
+	b->tb_arg      = arg;
+	b->tb_naios    = 0;
+	b->tb_err      = 0;
+	b->tb_niov     = maxmsgs * NNI_AIO_MAX_IOV;
+	b->tb_aios     = nni_alloc(maxmsgs * sizeof(nni_aio *));
+	b->tb_hdrs     = nni_alloc(maxmsgs * b->tb_hdrlen);
+	b->tb_iov      = nni_alloc(b->tb_niov * sizeof(nni_iov));
+	if ((b->tb_aios == NULL) || (b->tb_hdrs == NULL) ||
+	    (b->tb_iov == NULL)) {
+		return (NNG_ENOMEM);
+	}
+	if ((rv = nni_aio_init(&b->tb_txaio, nni_tran_batch_cb, b)) != 0) {
+		return (rv);
+	}
+	// The callback only advances the write and completes the sends;
+	// it never blocks.
+	nni_aio_set_inline(b->tb_txaio);
+	return (0);
+}
+
+void
+nni_tran_batch_fini(nni_tran_batch *b)
+{
+	nni_aio *aio;
+	nni_msg *msg;
+
+	// Once the write fails, so has every send; this just waits for
+	// that to be done.
+	nni_aio_stop(b->tb_txaio);
+	nni_aio_fini(b->tb_txaio);
+
+	nni_mtx_lock(&b->tb_mtx);
+	NNI_ASSERT(b->tb_naios == 0);
+	while ((aio = nni_list_first(&b->tb_sendq)) != NULL) {
+		nni_aio_list_remove(aio);
+		nni_mtx_unlock(&b->tb_mtx);
+		msg = nni_aio_get_msg(aio);
+		nni_aio_set_msg(aio, NULL);
+		nni_msg_free(msg);
+		nni_aio_finish_error(aio, NNG_ECLOSED);
+		nni_mtx_lock(&b->tb_mtx);
+	}
+	nni_mtx_unlock(&b->tb_mtx);
+
+	if (b->tb_aios != NULL) {
+		nni_free(b->tb_aios, b->tb_maxmsgs * sizeof(nni_aio *));
+	}
+	if (b->tb_hdrs != NULL) {
+		nni_free(b->tb_hdrs, b->tb_maxmsgs * b->tb_hdrlen);
+	}
+	if (b->tb_iov != NULL) {
+		nni_free(b->tb_iov, b->tb_niov * sizeof(nni_iov));
+	}
+	nni_mtx_fini(&b->tb_mtx);
+}
+
+// nni_tran_batch_start writes as many queued messages as the limits
+// allow, as one gather list.  The caller holds the lock, and no write may
+// be in progress.
+static void
+nni_tran_batch_start(nni_tran_batch *b)
+{
+	nni_aio *txaio = b->tb_txaio;
+	nni_aio *aio;
+	size_t   sz   = 0;
+	int      niov = 0;
+
+	while ((b->tb_naios < b->tb_maxmsgs) &&
+	    ((aio = nni_list_first(&b->tb_sendq)) != NULL)) {
+		nni_msg *msg = nni_aio_get_msg(aio);
+		uint8_t *hdr = &b->tb_hdrs[b->tb_naios * b->tb_hdrlen];
+		size_t   len = nni_msg_len(msg) + nni_msg_header_len(msg);
+		size_t   pfx = b->tb_hdrlen - sizeof(uint64_t);
+		int      n;
+
+		if ((b->tb_naios > 0) && (sz + len > b->tb_maxbytes)) {
+			break;
+		}
+		nni_aio_list_remove(aio);
+		b->tb_aios[b->tb_naios++] = aio;
+		sz += len;
+
+		memcpy(hdr, b->tb_prefix, pfx);
+		NNI_PUT64(hdr + pfx, (uint64_t) len);
+		b->tb_iov[niov].iov_buf = hdr;
+		b->tb_iov[niov].iov_len = b->tb_hdrlen;
+		niov++;
+		if (nni_msg_header_len(msg) > 0) {
+			b->tb_iov[niov].iov_buf = nni_msg_header(msg);
+			b->tb_iov[niov].iov_len = nni_msg_header_len(msg);
+			niov++;
+		}
+		// This cannot fail, as the body was made to fit when the
+		// send was queued.
+		n = NNI_AIO_MAX_IOV - 2;
+		(void) nni_msg_body_iov(msg, &b->tb_iov[niov], &n);
+		niov += n;
+	}
+	if (b->tb_naios == 0) {
+		return;
+	}
+	txaio->a_iov  = b->tb_iov;
+	txaio->a_niov = niov;
+	b->tb_write(b->tb_arg, txaio);
+}
+
+static void
+nni_tran_batch_cb(void *arg)
+{
+	nni_tran_batch *b     = arg;
+	nni_aio *       txaio = b->tb_txaio;
+	nni_aio *       done[NNI_TRAN_SENDBATCH_MAX];
+	nni_aio *       aio;
+	nni_msg *       msg;
+	int             ndone;
+	int             rv;
+	size_t          n;
+
+	nni_mtx_lock(&b->tb_mtx);
+	if ((rv = nni_aio_result(txaio)) == 0) {
+		n = nni_aio_count(txaio);
+		while (n) {
+			NNI_ASSERT(txaio->a_niov != 0);
+			if (txaio->a_iov[0].iov_len > n) {
+				txaio->a_iov[0].iov_len -= n;
+				txaio->a_iov[0].iov_buf += n;
+				break;
+			}
+			n -= txaio->a_iov[0].iov_len;
+			txaio->a_iov++;
+			txaio->a_niov--;
+		}
+		if ((txaio->a_niov != 0) && (txaio->a_iov[0].iov_len != 0)) {
+			b->tb_write(b->tb_arg, txaio);
+			nni_mtx_unlock(&b->tb_mtx);
+			return;
+		}
+	}
+
+	// The write is over, one way or the other, and so are its sends.
+	ndone = b->tb_naios;
+	for (int i = 0; i < ndone; i++) {
+		done[i] = b->tb_aios[i];
+	}
+	b->tb_naios = 0;
+	if (rv == 0) {
+		nni_tran_batch_start(b);
+	} else if (b->tb_err == 0) {
+		b->tb_err = rv;
+	}
+	nni_mtx_unlock(&b->tb_mtx);
+
+	for (int i = 0; i < ndone; i++) {
+		aio = done[i];
+		msg = nni_aio_get_msg(aio);
+		n   = nni_msg_len(msg);
+		nni_aio_set_msg(aio, NULL);
+		nni_msg_free(msg);
+		if (rv != 0) {
+			nni_aio_finish_error(aio, rv);
+		} else {
+			nni_aio_finish(aio, 0, n);
+		}
+	}
+	if (rv == 0) {
+		return;
+	}
+
+	// The connection is no good any more, and nothing else will be
+	// written to it.
+	b->tb_close(b->tb_arg);
+	nni_mtx_lock(&b->tb_mtx);
+	while ((aio = nni_list_first(&b->tb_sendq)) != NULL) {
+		nni_aio_list_remove(aio);
+		nni_mtx_unlock(&b->tb_mtx);
+		msg = nni_aio_get_msg(aio);
+		nni_aio_set_msg(aio, NULL);
+		nni_msg_free(msg);
+		nni_aio_finish_error(aio, rv);
+		nni_mtx_lock(&b->tb_mtx);
+	}
+	nni_mtx_unlock(&b->tb_mtx);
+}
+
+static void
+nni_tran_batch_cancel(nni_aio *aio, int rv)
+{
+	nni_tran_batch *b = aio->a_prov_data;
+	nni_msg *       msg;
+
+	nni_mtx_lock(&b->tb_mtx);
+	if (!nni_aio_list_active(aio)) {
+		for (int i = 0; i < b->tb_naios; i++) {
+			if (b->tb_aios[i] != aio) {
+				continue;
+			}
+			// Part of the message may be on the wire already,
+			// so the only way to stop it is to fail the whole
+			// connection.  The send completes when the write
+			// does.
+			nni_mtx_unlock(&b->tb_mtx);
+			b->tb_close(b->tb_arg);
+			return;
+		}
+		nni_mtx_unlock(&b->tb_mtx);
+		return;
+	}
+	nni_aio_list_remove(aio);
+	nni_mtx_unlock(&b->tb_mtx);
+
+	msg = nni_aio_get_msg(aio);
+	nni_aio_set_msg(aio, NULL);
+	nni_msg_free(msg);
+	nni_aio_finish_error(aio, rv);
+}
+
+void
+nni_tran_batch_send(nni_tran_batch *b, nni_aio *aio)
+{
+	nni_msg *msg = nni_aio_get_msg(aio);
+	nni_iov  iov[NNI_AIO_MAX_IOV];
+	int      n;
+	int      rv;
+
+	nni_mtx_lock(&b->tb_mtx);
+	if (nni_aio_start(aio, nni_tran_batch_cancel, b) != 0) {
+		nni_mtx_unlock(&b->tb_mtx);
+		return;
+	}
+	// Flatten the body now if it has too many segments, so that
+	// building the gather list later cannot fail.
+	n = NNI_AIO_MAX_IOV - 2;
+	if (((rv = b->tb_err) != 0) ||
+	    ((rv = nni_msg_body_iov(msg, iov, &n)) != 0)) {
+		nni_mtx_unlock(&b->tb_mtx);
+		nni_aio_set_msg(aio, NULL);
+		nni_msg_free(msg);
+		nni_aio_finish_error(aio, rv);
+		return;
+	}
+	nni_aio_list_append(&b->tb_sendq, aio);
+	if (b->tb_naios == 0) {
+		nni_tran_batch_start(b);
+	}
+	nni_mtx_unlock(&b->tb_mtx);
+}
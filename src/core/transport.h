@@ -49,6 +49,45 @@ struct nni_tran {
 #define NNI_TRANSPORT_V0 0x54520000
 #define NNI_TRANSPORT_VERSION NNI_TRANSPORT_V0
 
+// Stream transports may gather several queued messages into a single
+// write.  These are the default and upper limits for the number of
+// messages (NNG_OPT_SENDBATCH) and bytes (NNG_OPT_SENDBATCHSZ) in one
+// such write.
+#define NNI_TRAN_SENDBATCH 32
+#define NNI_TRAN_SENDBATCH_MAX 128
+#define NNI_TRAN_SENDBATCHSZ 65536
+
+// nni_tran_batch is the send side of a stream transport that frames each
+// message with an optional fixed prefix (at most NNI_TRAN_BATCH_PREFIX
+// bytes) and a 64-bit length.  Sends are queued, and each time the
+// connection is free for writing, as many queued messages as the limits
+// allow go out in one gather list.  A send completes only when its write
+// does; if the write fails, every send in it fails, and the connection is
+// closed.  Messages only share a write when several sends are outstanding
+// at once.
+typedef struct nni_tran_batch nni_tran_batch;
+
+#define NNI_TRAN_BATCH_PREFIX 8
+
+struct nni_tran_batch {
+	nni_mtx   tb_mtx;
+	nni_list  tb_sendq; // sends waiting for the next write
+	nni_aio **tb_aios;  // sends in the write in progress
+	int       tb_naios;
+	nni_aio * tb_txaio;
+	nni_iov * tb_iov;
+	int       tb_niov;
+	uint8_t * tb_hdrs;
+	size_t    tb_hdrlen;
+	uint8_t   tb_prefix[NNI_TRAN_BATCH_PREFIX];
+	int       tb_maxmsgs;
+	size_t    tb_maxbytes;
+	int       tb_err;
+	void (*tb_write)(void *, nni_aio *);
+	void (*tb_close)(void *);
+	void *tb_arg;
+};
+
 // Endpoint option handlers.
 struct nni_tran_ep_option {
 	// eo_name is the name of the option.
@@ -144,6 +183,11 @@ struct nni_tran_pipe {
 	// it is finished with it.
 	void (*p_send)(void *, nni_aio *);
 
+	// p_send_depth returns the number of sends worth having outstanding
+	// on the pipe at once, such as when the transport gathers queued
+	// messages into one write.  If this member is NULL, it is one.
+	int (*p_send_depth)(void *);
+
 	// p_recv schedules a message receive. This will be performed even for
 	// cases where no data is expected, to allow detection of a remote
 	// disconnect.
@@ -171,4 +215,24 @@ extern int       nni_tran_sys_init(void);
 extern void      nni_tran_sys_fini(void);
 extern int       nni_tran_register(const nni_tran *);
 
+// These APIs are for stream transports to share.
+
+// nni_tran_batch_init sets up the batch.  Each message is framed with
+// the prefix, then its length.  The write function starts writing the
+// aio's gather list on the connection, and close closes the connection;
+// both are passed arg.  At most maxmsgs messages, and maxbytes of
+// message data (unless one message is larger), go out in one write.
+extern int nni_tran_batch_init(nni_tran_batch *, int, size_t, const void *,
+    size_t, void (*)(void *, nni_aio *), void (*)(void *), void *);
+
+// nni_tran_batch_fini waits for the write in progress, which the caller
+// must have caused to finish by closing the connection, and then fails
+// any sends that remain.
+extern void nni_tran_batch_fini(nni_tran_batch *);
+
+// nni_tran_batch_send queues the aio's message for writing.  Once it is
+// part of a write, canceling the send closes the connection, as a partly
+// written message cannot be taken back from the stream.
+extern void nni_tran_batch_send(nni_tran_batch *, nni_aio *);
+
 #endif // CORE_TRANSPORT_H
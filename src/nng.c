@@ -67,6 +67,7 @@ int
 nng_recv(nng_socket sid, void *buf, size_t *szp, int flags)
 {
 	nng_msg *msg;
+	void *   body;
 	int      rv;
 
 	// Note that while it would be nice to make this a zero copy operation,
@@ -74,8 +75,12 @@ nng_recv(nng_socket sid, void *buf, size_t *szp, int flags)
 	if ((rv = nng_recvmsg(sid, &msg, flags & ~(NNG_FLAG_ALLOC))) != 0) {
 		return (rv);
 	}
+	if ((body = nni_msg_body(msg)) == NULL) {
+		nni_msg_free(msg);
+		return (NNG_ENOMEM);
+	}
 	if (!(flags & NNG_FLAG_ALLOC)) {
-		memcpy(buf, nng_msg_body(msg),
+		memcpy(buf, body,
 		    *szp > nng_msg_len(msg) ? nng_msg_len(msg) : *szp);
 		*szp = nng_msg_len(msg);
 	} else {
@@ -92,7 +97,7 @@ nng_recv(nng_socket sid, void *buf, size_t *szp, int flags)
 		}
 
 		*(void **) buf = nbuf;
-		memcpy(nbuf, nni_msg_body(msg), nni_msg_len(msg));
+		memcpy(nbuf, body, nni_msg_len(msg));
 		*szp = nng_msg_len(msg);
 	}
 	nni_msg_free(msg);
@@ -102,8 +107,9 @@ nng_recv(nng_socket sid, void *buf, size_t *szp, int flags)
 int
 nng_recvmsg(nng_socket sid, nng_msg **msgp, int flags)
 {
-	int      rv;
-	nng_aio *ap;
+	int       rv;
+	nng_aio * ap;
+	nni_sock *sock;
 
 	if ((rv = nng_aio_alloc(&ap, NULL, NULL)) != 0) {
 		return (rv);
@@ -114,7 +120,16 @@ nng_recvmsg(nng_socket sid, nng_msg **msgp, int flags)
 		nng_aio_set_timeout(ap, NNG_DURATION_DEFAULT);
 	}
 
-	nng_recv_aio(sid, ap);
+	if ((rv = nni_sock_find(&sock, sid)) != 0) {
+		nng_aio_free(ap);
+		return (rv);
+	}
+	nni_sock_recv(sock, (nni_aio *) ap);
+	if ((flags & NNG_FLAG_NONBLOCK) == 0) {
+		// Spin for a bit first, if the socket asks for it.
+		nni_sock_recv_spin(sock, (nni_aio *) ap);
+	}
+	nni_sock_rele(sock);
 	nng_aio_wait(ap);
 
 	if ((rv = nng_aio_result(ap)) == 0) {
@@ -128,22 +143,35 @@ nng_recvmsg(nng_socket sid, nng_msg **msgp, int flags)
 	return (rv);
 }
 
+static void
+nng_send_free(void *buf, size_t len, void *arg)
+{
+	NNI_ARG_UNUSED(arg);
+	nni_free(buf, len);
+}
+
 int
 nng_send(nng_socket sid, void *buf, size_t len, int flags)
 {
 	nng_msg *msg;
 	int      rv;
 
-	if ((rv = nng_msg_alloc(&msg, len)) != 0) {
-		return (rv);
+	if (flags & NNG_FLAG_ALLOC) {
+		// The buffer was allocated by us, and is ours to free, so we
+		// can send it without copying; it is freed with the message.
+		rv = nni_msg_alloc_external(&msg, buf, len, nng_send_free, NULL);
+		if (rv != 0) {
+			return (rv);
+		}
+	} else {
+		if ((rv = nng_msg_alloc(&msg, len)) != 0) {
+			return (rv);
+		}
+		memcpy(nni_msg_body(msg), buf, len);
 	}
-	memcpy(nng_msg_body(msg), buf, len);
 	if ((rv = nng_sendmsg(sid, msg, flags)) != 0) {
 		nng_msg_free(msg);
 	}
-	if (flags & NNG_FLAG_ALLOC) {
-		nni_free(buf, len);
-	}
 	return (rv);
 }
 
@@ -773,6 +801,13 @@ nng_msg_alloc(nng_msg **msgp, size_t size)
 	return (nni_msg_alloc(msgp, size));
 }
 
+int
+nng_msg_alloc_external(nng_msg **msgp, void *ptr, size_t size,
+    void (*fn)(void *, size_t, void *), void *arg)
+{
+	return (nni_msg_alloc_external(msgp, ptr, size, fn, arg));
+}
+
 int
 nng_msg_realloc(nng_msg *msg, size_t sz)
 {
@@ -788,6 +823,11 @@ nng_msg_free(nng_msg *msg)
 void *
 nng_msg_body(nng_msg *msg)
 {
+	// The caller may write to the body, so it must not be shared with
+	// any other message.
+	if (nni_msg_unshare(msg) != 0) {
+		return (NULL);
+	}
 	return (nni_msg_body(msg));
 }
 
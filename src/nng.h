@@ -320,6 +320,17 @@ NNG_DECL void nng_msg_set_pipe(nng_msg *, nng_pipe);
 NNG_DECL nng_pipe nng_msg_get_pipe(const nng_msg *);
 NNG_DECL int      nng_msg_getopt(nng_msg *, int, void *, size_t *);
 
+// nng_msg_alloc_external allocates a message whose body refers to memory
+// owned by the caller, avoiding a copy of the data.  The memory must not be
+// changed or released until the supplied function is called with the
+// buffer, its length, and the final argument; this happens once the
+// library (including any transport sending the message) is done with it.
+// The library never writes to the buffer; operations that modify the body,
+// or calls to nng_msg_body, first copy the data.  The function may be NULL
+// if the memory does not need to be released (for example static data).
+NNG_DECL int nng_msg_alloc_external(
+    nng_msg **, void *, size_t, void (*)(void *, size_t, void *), void *);
+
 // Pipe API. Generally pipes are only "observable" to applications, but
 // we do permit an application to close a pipe. This can be useful, for
 // example during a connection notification, to disconnect a pipe that
@@ -344,6 +355,8 @@ enum nng_flag_enum {
 #define NNG_OPT_LINGER "linger"
 #define NNG_OPT_RECVBUF "recv-buffer"
 #define NNG_OPT_SENDBUF "send-buffer"
+#define NNG_OPT_RECVBUFBYTES "recv-buffer-bytes"
+#define NNG_OPT_SENDBUFBYTES "send-buffer-bytes"
 #define NNG_OPT_RECVFD "recv-fd"
 #define NNG_OPT_SENDFD "send-fd"
 #define NNG_OPT_RECVTIMEO "recv-timeout"
@@ -355,9 +368,21 @@ enum nng_flag_enum {
 #define NNG_OPT_PROTOCOL "protocol"
 #define NNG_OPT_TRANSPORT "transport"
 #define NNG_OPT_RECVMAXSZ "recv-size-max"
+#define NNG_OPT_SENDBATCH "send-batch"
+#define NNG_OPT_SENDBATCHSZ "send-batch-size"
 #define NNG_OPT_RECONNMINT "reconnect-time-min"
 #define NNG_OPT_RECONNMAXT "reconnect-time-max"
 
+// NNG_OPT_BUSYPOLL is how long, in microseconds, a blocking receive on the
+// socket spins waiting for a message before it sleeps.  It also lets the
+// I/O pollers spin waiting for events; as they are shared, they use the
+// largest budget of any open socket, and so this affects every socket in
+// the process.
+#define NNG_OPT_BUSYPOLL "busy-poll"
+#define NNG_OPT_BUSYPOLLHITS "busy-poll-hits"
+#define NNG_OPT_BUSYPOLLMISSES "busy-poll-misses"
+#define NNG_OPT_BUSYPOLLTIME "busy-poll-time"
+
 // XXX: TBD: priorities, socket names, ipv4only
 
 // Statistics.  These are for informational purposes only, and subject
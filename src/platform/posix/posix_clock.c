@@ -37,6 +37,79 @@ nni_plat_clock(void)
 	return (msec);
 }
 
+// The Linux coarse clocks are read from the vDSO without going to the
+// hardware counter, which makes them several times cheaper, but they
+// only advance once per scheduler tick.  They share a base with the
+// precise clock of the same kind.
+#if defined(CLOCK_MONOTONIC_COARSE) && (NNG_USE_CLOCKID == CLOCK_MONOTONIC)
+#define NNI_POSIX_COARSE_CLOCKID CLOCK_MONOTONIC_COARSE
+#elif defined(CLOCK_REALTIME_COARSE) && (NNG_USE_CLOCKID == CLOCK_REALTIME)
+#define NNI_POSIX_COARSE_CLOCKID CLOCK_REALTIME_COARSE
+#endif
+
+#ifdef NNI_POSIX_COARSE_CLOCKID
+
+// Length of a tick in msec (rounded up), or zero if the coarse clock is
+// not usable.  The coarse time is that of the last timekeeping update,
+// which is itself only accurate to a tick, so it can trail the precise
+// clock by nearly two ticks.  We add that much, so that we are never
+// behind.  Racing to set this is harmless.
+static int nni_posix_clock_tick = -1;
+
+nni_time
+nni_plat_clock_coarse(void)
+{
+	struct timespec ts;
+	nni_time        msec;
+	int             tick;
+
+	if ((tick = nni_posix_clock_tick) < 0) {
+		if ((clock_getres(NNI_POSIX_COARSE_CLOCKID, &ts) != 0) ||
+		    (ts.tv_sec != 0)) {
+			tick = 0;
+		} else {
+			tick = (int) ((ts.tv_nsec + 999999) / 1000000);
+		}
+		nni_posix_clock_tick = tick;
+	}
+	if ((tick == 0) ||
+	    (clock_gettime(NNI_POSIX_COARSE_CLOCKID, &ts) != 0)) {
+		return (nni_plat_clock());
+	}
+
+	msec = ts.tv_sec;
+	msec *= 1000;
+	msec += (ts.tv_nsec / 1000000);
+	return (msec + (2 * tick));
+}
+
+#else // NNI_POSIX_COARSE_CLOCKID
+
+nni_time
+nni_plat_clock_coarse(void)
+{
+	return (nni_plat_clock());
+}
+
+#endif // NNI_POSIX_COARSE_CLOCKID
+
+uint64_t
+nni_plat_clock_us(void)
+{
+	struct timespec ts;
+	uint64_t        usec;
+
+	if (clock_gettime(NNG_USE_CLOCKID, &ts) != 0) {
+		// This should never ever occur.
+		nni_panic("clock_gettime failed: %s", strerror(errno));
+	}
+
+	usec = ts.tv_sec;
+	usec *= 1000000;
+	usec += (ts.tv_nsec / 1000);
+	return (usec);
+}
+
 void
 nni_plat_sleep(nni_duration ms)
 {
@@ -85,6 +158,28 @@ nni_plat_clock(void)
 	return (ms);
 }
 
+nni_time
+nni_plat_clock_coarse(void)
+{
+	return (nni_plat_clock());
+}
+
+uint64_t
+nni_plat_clock_us(void)
+{
+	uint64_t       usec;
+	struct timeval tv;
+
+	if (gettimeofday(&tv, NULL) != 0) {
+		nni_panic("gettimeofday failed: %s", strerror(errno));
+	}
+
+	usec = tv.tv_sec;
+	usec *= 1000000;
+	usec += tv.tv_usec;
+	return (usec);
+}
+
 void
 nni_plat_sleep(nni_duration ms)
 {
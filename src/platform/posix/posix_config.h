@@ -39,6 +39,13 @@
 //	Thesse are options for obtaining entropy to seed the pRNG.
 //	All known modern UNIX variants can support NNG_USE_DEVURANDOM,
 //	but the other options are better still, but not portable.
+//
+// #define NNG_USE_POSIX_POLLQ_POLL
+// #define NNG_USE_POSIX_POLLQ_EPOLL
+//	These select the backend used to wait for I/O readiness.  The
+//	epoll() backend is used when NNG_HAVE_EPOLL is defined (Linux),
+//	unless NNG_USE_POSIX_POLLQ_POLL is defined to force the use of
+//	poll(), which works everywhere.
 
 #include <time.h>
 
@@ -60,7 +67,11 @@
 #define NNG_USE_CLOCKID CLOCK_REALTIME
 #endif // CLOCK_REALTIME
 
+#if defined(NNG_HAVE_EPOLL) && !defined(NNG_USE_POSIX_POLLQ_POLL)
+#define NNG_USE_POSIX_POLLQ_EPOLL 1
+#elif !defined(NNG_USE_POSIX_POLLQ_EPOLL)
 #define NNG_USE_POSIX_POLLQ_POLL 1
+#endif
 #define NNG_USE_POSIX_RESOLV_GAI 1
 
 #endif // NNG_PLATFORM_POSIX
@@ -101,7 +101,8 @@ nni_posix_epdesc_doconnect(nni_posix_epdesc *ed)
 		}
 		switch (rv) {
 		case 0:
-			// Success!
+			// Success!  The descriptor now belongs to the pipe.
+			nni_posix_pollq_detach(&ed->node);
 			nni_posix_epdesc_finish(aio, 0, ed->node.fd);
 			ed->node.fd = -1;
 			continue;
@@ -115,6 +116,7 @@ nni_posix_epdesc_doconnect(nni_posix_epdesc *ed)
 				rv = ECONNREFUSED;
 			}
 			nni_posix_epdesc_finish(aio, nni_plat_errno(rv), 0);
+			nni_posix_pollq_detach(&ed->node);
 			(void) close(ed->node.fd);
 			ed->node.fd = -1;
 			continue;
@@ -208,6 +210,7 @@ nni_posix_epdesc_doclose(nni_posix_epdesc *ed)
 	}
 
 	if ((fd = ed->node.fd) != -1) {
+		nni_posix_pollq_detach(&ed->node);
 		ed->node.fd = -1;
 		(void) shutdown(fd, SHUT_RDWR);
 		(void) close(fd);
@@ -411,9 +414,8 @@ nni_posix_epdesc_init(nni_posix_epdesc **edp)
 
 	nni_mtx_init(&ed->mtx);
 
-	// We could randomly choose a different pollq, or for efficiencies
-	// sake we could take a modulo of the file desc number to choose
-	// one.  For now we just have a global pollq.  Note that by tying
+	// We have no descriptor yet, and will likely use several over
+	// time, so we just choose a pollq at random.  Note that by tying
 	// the ed to a single pollq we may get some kind of cache warmth.
 
 	ed->node.index = 0;
@@ -463,7 +465,6 @@ nni_posix_epdesc_fini(nni_posix_epdesc *ed)
 	int fd;
 	nni_mtx_lock(&ed->mtx);
 	if ((fd = ed->node.fd) != -1) {
-		(void) close(ed->node.fd);
 		nni_posix_epdesc_doclose(ed);
 	}
 	nni_mtx_unlock(&ed->mtx);
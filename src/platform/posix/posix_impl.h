@@ -58,6 +58,9 @@ struct nni_plat_mtx {
 	pthread_mutex_t mtx;
 	int             fallback;
 	int             flags;
+#ifdef NNG_ADAPTIVE_MUTEX
+	int spins; // estimate of spins needed to acquire
+#endif
 };
 
 struct nni_plat_cv {
@@ -75,6 +78,14 @@ struct nni_plat_thr {
 	void *arg;
 };
 
+struct nni_plat_tls {
+	pthread_key_t key;
+};
+
+struct nni_plat_atomic {
+	int v;
+};
+
 #endif
 
 extern int  nni_posix_pollq_sysinit(void);
@@ -170,4 +170,16 @@ nni_plat_ipc_pipe_recv(nni_plat_ipc_pipe *p, nni_aio *aio)
 	nni_posix_pipedesc_recv((void *) p, aio);
 }
 
+int
+nni_plat_ipc_pipe_sameuser(nni_plat_ipc_pipe *p)
+{
+	uint64_t uid;
+	int      rv;
+
+	if ((rv = nni_posix_pipedesc_peeruid((void *) p, &uid)) != 0) {
+		return (rv);
+	}
+	return (uid == (uint64_t) geteuid() ? 0 : NNG_EPERM);
+}
+
 #endif // NNG_PLATFORM_POSIX
@@ -16,6 +16,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <poll.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,6 +25,32 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#endif
+
+// Size of the per-descriptor read-ahead buffer.  Reads pull in up to this
+// many bytes beyond what the caller asked for, and later reads are served
+// from it before going back to the kernel.
+#ifndef NNI_POSIX_PIPEDESC_RXBUF
+#define NNI_POSIX_PIPEDESC_RXBUF 4096
+#endif
+
+// Largest gather list handed to a single writev.  Transports may queue
+// longer lists; anything past this is left for a later call.
+#if defined(IOV_MAX) && (IOV_MAX < 1024)
+#define NNI_POSIX_PIPEDESC_MAXIOV IOV_MAX
+#else
+#define NNI_POSIX_PIPEDESC_MAXIOV 1024
+#endif
+
+// Largest gather list handed to the pollq for a write.  The list lives in
+// the descriptor until the write completes, so this is kept smaller.
+#ifndef NNI_POSIX_PIPEDESC_XFERIOV
+#define NNI_POSIX_PIPEDESC_XFERIOV 64
+#endif
+
 // nni_posix_pipedesc is a descriptor kept one per transport pipe (i.e. open
 // file descriptor for TCP socket, etc.)  This contains the list of pending
 // aios for that underlying socket, as well as the socket itself.
@@ -33,6 +60,41 @@ struct nni_posix_pipedesc {
 	nni_list             writeq;
 	int                  closed;
 	nni_mtx              mtx;
+	size_t               rxoff;
+	size_t               rxlen;
+	uint8_t              rxbuf[NNI_POSIX_PIPEDESC_RXBUF];
+
+	// If the pollq does transfers (see nni_posix_pollq_xfer_start),
+	// reads and writes are handed to it, one of each at a time.  Until
+	// they complete, their aios are held here, rather than on the
+	// queues, and cancellation asks the pollq to stop the transfer,
+	// recording the result wanted.  The descriptor is not closed until
+	// no transfer is left, as one not yet submitted would otherwise find
+	// the number in use by another file.
+	int                  xfer;
+	int                  nxfer;
+	nni_cv               xfercv;
+	int                  xferfd;
+	nni_posix_pollq_xfer rxfer;
+	nni_aio *            rxaio;
+	int                  rxcancel;
+	size_t               rxwant;
+	struct iovec         rxiov[NNI_AIO_MAX_IOV + 1];
+	nni_posix_pollq_xfer txfer;
+	nni_aio *            txaio;
+	int                  txcancel;
+	struct iovec         txiov[NNI_POSIX_PIPEDESC_XFERIOV];
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+	// Writes of at least zcmin bytes are sent with MSG_ZEROCOPY.  Their
+	// aios wait on zcq until the kernel reports, on the socket error
+	// queue, that it no longer needs the caller's buffers; until then
+	// they cannot be canceled.  Every such send gets the next sequence
+	// number, kept in the aio's a_prov_seq.
+	size_t   zcmin;
+	int      zcon;
+	uint32_t zcnext;
+	nni_list zcq;
+#endif
 };
 
 static void
@@ -42,6 +104,9 @@ nni_posix_pipedesc_finish(nni_aio *aio, int rv)
 	nni_aio_finish(aio, rv, aio->a_count);
 }
 
+static void nni_posix_pipedesc_doread(nni_posix_pipedesc *);
+static void nni_posix_pipedesc_dowrite(nni_posix_pipedesc *);
+
 static void
 nni_posix_pipedesc_doclose(nni_posix_pipedesc *pd)
 {
@@ -49,6 +114,12 @@ nni_posix_pipedesc_doclose(nni_posix_pipedesc *pd)
 	int      fd;
 
 	pd->closed = 1;
+	if (pd->rxaio != NULL) {
+		nni_posix_pollq_xfer_cancel(&pd->node, &pd->rxfer);
+	}
+	if (pd->txaio != NULL) {
+		nni_posix_pollq_xfer_cancel(&pd->node, &pd->txfer);
+	}
 	while ((aio = nni_list_first(&pd->readq)) != NULL) {
 		nni_posix_pipedesc_finish(aio, NNG_ECLOSED);
 	}
@@ -56,26 +127,266 @@ nni_posix_pipedesc_doclose(nni_posix_pipedesc *pd)
 		nni_posix_pipedesc_finish(aio, NNG_ECLOSED);
 	}
 	if ((fd = pd->node.fd) != -1) {
-		// Let any peer know we are closing.
+		// The poller must let go of it before it is closed.
+		nni_posix_pollq_detach(&pd->node);
 		pd->node.fd = -1;
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+		if (!nni_list_empty(&pd->zcq)) {
+			// The kernel may still send from the buffers of
+			// zero copy writes.  Resetting the connection makes
+			// it drop them instead.
+			struct linger l;
+
+			l.l_onoff  = 1;
+			l.l_linger = 0;
+			(void) setsockopt(
+			    fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+		}
+#endif
+		// Let any peer know we are closing.
 		(void) shutdown(fd, SHUT_RDWR);
-		(void) close(fd);
+		if (pd->nxfer > 0) {
+			pd->xferfd = fd;
+		} else {
+			(void) close(fd);
+		}
+	}
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+	// Only now that the connection is gone are the buffers free.
+	while ((aio = nni_list_first(&pd->zcq)) != NULL) {
+		nni_posix_pipedesc_finish(aio, NNG_ECLOSED);
 	}
+#endif
+}
+
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+// nni_posix_pipedesc_zcsend tries to send the iovec without copying
+// it.  It returns the number of bytes sent, or -1 with errno set.  If
+// the send was accepted, the aio is moved to the zero copy queue, and
+// completes when the kernel is done with its buffers.
+static int
+nni_posix_pipedesc_zcsend(
+    nni_posix_pipedesc *pd, nni_aio *aio, struct iovec *iovec, int niov)
+{
+	struct msghdr mh;
+	int           n;
+	int           flags = MSG_ZEROCOPY;
+
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov    = iovec;
+	mh.msg_iovlen = niov;
+	if ((n = sendmsg(pd->node.fd, &mh, flags)) < 0) {
+		return (-1);
+	}
+	aio->a_count += n;
+	aio->a_prov_seq = pd->zcnext++;
+	nni_aio_list_append(&pd->zcq, aio);
+	return (n);
+}
+
+// nni_posix_pipedesc_doerrqueue collects zero copy completions from the
+// socket error queue, and finishes the aios that they cover.  It returns
+// zero if there is no other error pending on the socket.
+static int
+nni_posix_pipedesc_doerrqueue(nni_posix_pipedesc *pd)
+{
+	char            cbuf[128];
+	struct msghdr   mh;
+	struct cmsghdr *cm;
+	nni_aio *       aio;
+	int             err;
+	socklen_t       errlen = sizeof(err);
+
+	for (;;) {
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_control    = cbuf;
+		mh.msg_controllen = sizeof(cbuf);
+		if (recvmsg(pd->node.fd, &mh, MSG_ERRQUEUE) < 0) {
+			break;
+		}
+		for (cm = CMSG_FIRSTHDR(&mh); cm != NULL;
+		     cm = CMSG_NXTHDR(&mh, cm)) {
+			struct sock_extended_err *ee;
+			nni_aio *                 next;
+
+			if (!(((cm->cmsg_level == IPPROTO_IP) &&
+			          (cm->cmsg_type == IP_RECVERR)) ||
+			        ((cm->cmsg_level == IPPROTO_IPV6) &&
+			            (cm->cmsg_type == IPV6_RECVERR)))) {
+				continue;
+			}
+			ee = (void *) CMSG_DATA(cm);
+			if ((ee->ee_errno != 0) ||
+			    (ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY)) {
+				continue;
+			}
+			// If the kernel had to copy the data anyway (as it
+			// does over loopback), zero copy only costs us.
+			if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				pd->zcmin = 0;
+			}
+			// Completions cover the sends from ee_info to
+			// ee_data inclusive.
+			aio = nni_list_first(&pd->zcq);
+			while (aio != NULL) {
+				uint32_t seq = aio->a_prov_seq;
+
+				next = nni_list_next(&pd->zcq, aio);
+				if (((int32_t)(seq - ee->ee_info) >= 0) &&
+				    ((int32_t)(ee->ee_data - seq) >= 0)) {
+					nni_posix_pipedesc_finish(aio, 0);
+				}
+				aio = next;
+			}
+		}
+	}
+
+	if ((getsockopt(pd->node.fd, SOL_SOCKET, SO_ERROR, &err, &errlen) !=
+	        0) ||
+	    (err != 0)) {
+		return (-1);
+	}
+	return (0);
+}
+#endif
+
+// nni_posix_pipedesc_xferdone is called when a transfer has completed.
+static void
+nni_posix_pipedesc_xferdone(nni_posix_pipedesc *pd)
+{
+	pd->nxfer--;
+	if (pd->nxfer == 0) {
+		if (pd->xferfd >= 0) {
+			(void) close(pd->xferfd);
+			pd->xferfd = -1;
+		}
+		nni_cv_wake(&pd->xfercv);
+	}
+}
+
+// nni_posix_pipedesc_rxdone handles the completion of a read transfer.
+// It finishes the aio as nni_posix_pipedesc_doread would have.
+static void
+nni_posix_pipedesc_rxdone(void *arg)
+{
+	nni_posix_pipedesc *pd = arg;
+	nni_aio *           aio;
+	int                 n;
+
+	nni_mtx_lock(&pd->mtx);
+	aio       = pd->rxaio;
+	n         = pd->rxfer.px_result;
+	pd->rxaio = NULL;
+
+	if ((n == -EAGAIN) || (n == -EINTR) || (n == -ECANCELED)) {
+		if (pd->rxcancel != 0) {
+			nni_aio_finish_error(aio, pd->rxcancel);
+		} else if (pd->closed) {
+			nni_aio_finish_error(aio, NNG_ECLOSED);
+		} else {
+			// Wait until there is something to read.
+			nni_aio_list_prepend(&pd->readq, aio);
+			nni_posix_pollq_arm(&pd->node, POLLIN);
+		}
+	} else if (n < 0) {
+		nni_aio_finish_error(aio, nni_plat_errno(-n));
+		nni_posix_pipedesc_doclose(pd);
+	} else if (n == 0) {
+		// No bytes indicates a closed descriptor.
+		nni_aio_finish_error(aio, NNG_ECLOSED);
+		nni_posix_pipedesc_doclose(pd);
+	} else {
+		if ((size_t) n > pd->rxwant) {
+			pd->rxoff = 0;
+			pd->rxlen = (size_t) n - pd->rxwant;
+			n         = (int) pd->rxwant;
+		}
+		nni_aio_finish(aio, 0, n);
+	}
+	pd->rxcancel = 0;
+	if (!pd->closed) {
+		nni_posix_pipedesc_doread(pd);
+	}
+	nni_posix_pipedesc_xferdone(pd);
+	nni_mtx_unlock(&pd->mtx);
+}
+
+// nni_posix_pipedesc_txdone handles the completion of a write transfer.
+static void
+nni_posix_pipedesc_txdone(void *arg)
+{
+	nni_posix_pipedesc *pd = arg;
+	nni_aio *           aio;
+	int                 n;
+
+	nni_mtx_lock(&pd->mtx);
+	aio       = pd->txaio;
+	n         = pd->txfer.px_result;
+	pd->txaio = NULL;
+
+	if ((n == -EAGAIN) || (n == -EINTR) || (n == -ECANCELED)) {
+		if (pd->txcancel != 0) {
+			nni_aio_finish_error(aio, pd->txcancel);
+		} else if (pd->closed) {
+			nni_aio_finish_error(aio, NNG_ECLOSED);
+		} else {
+			// Wait until there is room to write.
+			nni_aio_list_prepend(&pd->writeq, aio);
+			nni_posix_pollq_arm(&pd->node, POLLOUT);
+		}
+	} else if (n < 0) {
+		nni_aio_finish_error(aio, nni_plat_errno(-n));
+		nni_posix_pipedesc_doclose(pd);
+	} else {
+		nni_aio_finish(aio, 0, aio->a_count + n);
+	}
+	pd->txcancel = 0;
+	if (!pd->closed) {
+		nni_posix_pipedesc_dowrite(pd);
+	}
+	nni_posix_pipedesc_xferdone(pd);
+	nni_mtx_unlock(&pd->mtx);
+}
+
+// nni_posix_pipedesc_xfer hands the aio's transfer, already set up in
+// x, to the pollq.  It returns zero if it did, and the aio is then held
+// in *aiop until the transfer completes.
+static int
+nni_posix_pipedesc_xfer(nni_posix_pipedesc *pd, nni_aio *aio,
+    nni_aio **aiop, nni_posix_pollq_xfer *x)
+{
+	if (nni_posix_pollq_xfer_start(&pd->node, x) != 0) {
+		return (-1);
+	}
+	nni_aio_list_remove(aio);
+	*aiop = aio;
+	pd->nxfer++;
+	return (0);
 }
 
 static void
 nni_posix_pipedesc_dowrite(nni_posix_pipedesc *pd)
 {
 	int          n;
-	struct iovec iovec[4];
+	struct iovec iovec[NNI_POSIX_PIPEDESC_MAXIOV];
 	nni_aio *    aio;
 	int          niov;
+	int          zc;
+	size_t       len;
 
-	while ((aio = nni_list_first(&pd->writeq)) != NULL) {
+	while (((aio = nni_list_first(&pd->writeq)) != NULL) &&
+	    (pd->txaio == NULL)) {
 		int i;
-		for (niov = 0, i = 0; i < aio->a_niov; i++) {
+		len = 0;
+		for (niov = 0, i = 0;
+		     (i < aio->a_niov) && (niov < NNI_POSIX_PIPEDESC_MAXIOV);
+		     i++) {
 			iovec[niov].iov_len  = aio->a_iov[i].iov_len;
 			iovec[niov].iov_base = aio->a_iov[i].iov_buf;
+			len += iovec[niov].iov_len;
 			niov++;
 		}
 		if (niov == 0) {
@@ -83,7 +394,45 @@ nni_posix_pipedesc_dowrite(nni_posix_pipedesc *pd)
 			continue;
 		}
 
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+		zc = (pd->zcmin != 0) && (len >= pd->zcmin);
+#else
+		NNI_ARG_UNUSED(len);
+		zc = 0;
+#endif
+		// Zero copy sends are always made here, as is anything the
+		// pollq is too busy to take.
+		if (pd->xfer && !zc) {
+			int nx = niov;
+
+			if (nx > NNI_POSIX_PIPEDESC_XFERIOV) {
+				nx = NNI_POSIX_PIPEDESC_XFERIOV;
+			}
+			memcpy(pd->txiov, iovec, nx * sizeof(iovec[0]));
+			pd->txfer.px_niov = nx;
+			if (nni_posix_pipedesc_xfer(
+			        pd, aio, &pd->txaio, &pd->txfer) == 0) {
+				return;
+			}
+		}
+
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+		if (zc) {
+			n = nni_posix_pipedesc_zcsend(pd, aio, iovec, niov);
+			if (n >= 0) {
+				continue;
+			}
+			if (errno == ENOBUFS) {
+				// Out of socket option memory for pinning
+				// pages; this one gets copied after all.
+				n = writev(pd->node.fd, iovec, niov);
+			}
+		} else {
+			n = writev(pd->node.fd, iovec, niov);
+		}
+#else
 		n = writev(pd->node.fd, iovec, niov);
+#endif
 		if (n < 0) {
 			if ((errno == EAGAIN) || (errno == EINTR)) {
 				// Can't write more right now.  We're done
@@ -109,16 +458,22 @@ static void
 nni_posix_pipedesc_doread(nni_posix_pipedesc *pd)
 {
 	int          n;
-	struct iovec iovec[4];
+	struct iovec iovec[NNI_AIO_MAX_IOV + 1];
 	nni_aio *    aio;
 	int          niov;
+	int          first;
+	size_t       want;
+	size_t       copied;
 
-	while ((aio = nni_list_first(&pd->readq)) != NULL) {
+	while (((aio = nni_list_first(&pd->readq)) != NULL) &&
+	    (pd->rxaio == NULL)) {
 		int i;
+		want = 0;
 		for (i = 0, niov = 0; i < aio->a_niov; i++) {
 			if (aio->a_iov[i].iov_len != 0) {
 				iovec[niov].iov_len  = aio->a_iov[i].iov_len;
 				iovec[niov].iov_base = aio->a_iov[i].iov_buf;
+				want += iovec[niov].iov_len;
 				niov++;
 			}
 		}
@@ -127,11 +482,64 @@ nni_posix_pipedesc_doread(nni_posix_pipedesc *pd)
 			continue;
 		}
 
-		n = readv(pd->node.fd, iovec, niov);
+		// Drain anything left over from a previous read first.
+		copied = 0;
+		first  = 0;
+		while ((pd->rxlen > 0) && (first < niov)) {
+			size_t len = iovec[first].iov_len;
+			if (len > pd->rxlen) {
+				len = pd->rxlen;
+			}
+			memcpy(iovec[first].iov_base, pd->rxbuf + pd->rxoff,
+			    len);
+			pd->rxoff += len;
+			pd->rxlen -= len;
+			copied += len;
+			iovec[first].iov_len -= len;
+			iovec[first].iov_base =
+			    (uint8_t *) iovec[first].iov_base + len;
+			if (iovec[first].iov_len == 0) {
+				first++;
+			}
+		}
+		if (first == niov) {
+			aio->a_count += copied;
+			nni_posix_pipedesc_finish(aio, 0);
+			continue;
+		}
+		want -= copied;
+
+		// The buffer is empty now, so read whatever else the
+		// kernel has into it, behind the caller's buffers.  A
+		// small message then costs one readv for both its header
+		// and body, and following messages need none at all.
+		NNI_ASSERT(pd->rxlen == 0);
+		iovec[niov].iov_base = pd->rxbuf;
+		iovec[niov].iov_len  = sizeof(pd->rxbuf);
+		niov++;
+
+		// Unless the buffer gave us something already, in which case
+		// we only take what the kernel has now, the pollq can wait
+		// for the data on our behalf.
+		if (pd->xfer && (copied == 0)) {
+			memcpy(pd->rxiov, iovec, niov * sizeof(iovec[0]));
+			pd->rxfer.px_niov = niov;
+			pd->rxwant        = want;
+			if (nni_posix_pipedesc_xfer(
+			        pd, aio, &pd->rxaio, &pd->rxfer) == 0) {
+				return;
+			}
+		}
+
+		n = readv(pd->node.fd, &iovec[first], niov - first);
 		if (n < 0) {
 			if ((errno == EAGAIN) || (errno == EINTR)) {
-				// Can't write more right now.  We're done
-				// on this fd for now.
+				// Can't read more right now.  Give the
+				// caller what we have, if anything.
+				if (copied != 0) {
+					aio->a_count += copied;
+					nni_posix_pipedesc_finish(aio, 0);
+				}
 				return;
 			}
 			nni_posix_pipedesc_finish(aio, nni_plat_errno(errno));
@@ -139,14 +547,19 @@ nni_posix_pipedesc_doread(nni_posix_pipedesc *pd)
 			return;
 		}
 
-		if (n == 0) {
+		if ((n == 0) && (copied == 0)) {
 			// No bytes indicates a closed descriptor.
 			nni_posix_pipedesc_finish(aio, NNG_ECLOSED);
 			nni_posix_pipedesc_doclose(pd);
 			return;
 		}
 
-		aio->a_count += n;
+		if ((size_t) n > want) {
+			pd->rxoff = 0;
+			pd->rxlen = (size_t) n - want;
+			n         = (int) want;
+		}
+		aio->a_count += copied + n;
 
 		// We completed the entire operation on this aioq.
 		nni_posix_pipedesc_finish(aio, 0);
@@ -163,6 +576,14 @@ nni_posix_pipedesc_cb(void *arg)
 	int                 events = 0;
 
 	nni_mtx_lock(&pd->mtx);
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+	// Zero copy completions are reported as errors; only treat this as
+	// an error if it was something else.
+	if (pd->zcon && (pd->node.revents & POLLERR) &&
+	    (nni_posix_pipedesc_doerrqueue(pd) == 0)) {
+		pd->node.revents &= ~POLLERR;
+	}
+#endif
 	if (pd->node.revents & POLLIN) {
 		nni_posix_pipedesc_doread(pd);
 	}
@@ -178,6 +599,13 @@ nni_posix_pipedesc_cb(void *arg)
 		if (!nni_list_empty(&pd->readq)) {
 			events |= POLLIN;
 		}
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+		// Errors are always reported; asking for them is only
+		// needed to keep the descriptor armed.
+		if (!nni_list_empty(&pd->zcq)) {
+			events |= POLLERR;
+		}
+#endif
 		if (events) {
 			nni_posix_pollq_arm(&pd->node, events);
 		}
@@ -199,9 +627,29 @@ static void
 nni_posix_pipedesc_cancel(nni_aio *aio, int rv)
 {
 	nni_posix_pipedesc *pd = aio->a_prov_data;
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+	nni_aio *zaio;
+#endif
 
 	nni_mtx_lock(&pd->mtx);
-	if (nni_aio_list_active(aio)) {
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+	// A zero copy write is already in the kernel's hands, and
+	// completes only when the kernel is done with its buffers.
+	NNI_LIST_FOREACH (&pd->zcq, zaio) {
+		if (zaio == aio) {
+			nni_mtx_unlock(&pd->mtx);
+			return;
+		}
+	}
+#endif
+	// A transfer with the pollq is finished when it completes.
+	if (aio == pd->rxaio) {
+		pd->rxcancel = rv;
+		nni_posix_pollq_xfer_cancel(&pd->node, &pd->rxfer);
+	} else if (aio == pd->txaio) {
+		pd->txcancel = rv;
+		nni_posix_pollq_xfer_cancel(&pd->node, &pd->txfer);
+	} else if (nni_aio_list_active(aio)) {
 		nni_aio_list_remove(aio);
 		nni_aio_finish_error(aio, rv);
 	}
@@ -263,6 +711,11 @@ nni_posix_pipedesc_send(nni_posix_pipedesc *pd, nni_aio *aio)
 		if (nni_list_first(&pd->writeq) == aio) {
 			nni_posix_pollq_arm(&pd->node, POLLOUT);
 		}
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+		if (!nni_list_empty(&pd->zcq)) {
+			nni_posix_pollq_arm(&pd->node, POLLERR);
+		}
+#endif
 	}
 	nni_mtx_unlock(&pd->mtx);
 }
@@ -291,6 +744,59 @@ nni_posix_pipedesc_sockname(nni_posix_pipedesc *pd, nni_sockaddr *sa)
 	return (nni_posix_sockaddr2nn(sa, &ss));
 }
 
+int
+nni_posix_pipedesc_peeruid(nni_posix_pipedesc *pd, uint64_t *uidp)
+{
+#if defined(SO_PEERCRED)
+	struct ucred uc;
+	socklen_t    len = sizeof(uc);
+
+	if (getsockopt(pd->node.fd, SOL_SOCKET, SO_PEERCRED, &uc, &len) != 0) {
+		return (nni_plat_errno(errno));
+	}
+	*uidp = uc.uid;
+	return (0);
+#elif defined(NNG_HAVE_GETPEEREID)
+	uid_t uid;
+	gid_t gid;
+
+	if (getpeereid(pd->node.fd, &uid, &gid) != 0) {
+		return (nni_plat_errno(errno));
+	}
+	*uidp = uid;
+	return (0);
+#else
+	NNI_ARG_UNUSED(pd);
+	NNI_ARG_UNUSED(uidp);
+	return (NNG_ENOTSUP);
+#endif
+}
+
+int
+nni_posix_pipedesc_zerocopy(nni_posix_pipedesc *pd, size_t zcmin)
+{
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+	int one = 1;
+
+	nni_mtx_lock(&pd->mtx);
+	if ((zcmin != 0) && !pd->zcon) {
+		if (setsockopt(pd->node.fd, SOL_SOCKET, SO_ZEROCOPY, &one,
+		        sizeof(one)) != 0) {
+			nni_mtx_unlock(&pd->mtx);
+			return (NNG_ENOTSUP);
+		}
+		pd->zcon = 1;
+	}
+	pd->zcmin = zcmin;
+	nni_mtx_unlock(&pd->mtx);
+	return (0);
+#else
+	NNI_ARG_UNUSED(pd);
+	NNI_ARG_UNUSED(zcmin);
+	return (NNG_ENOTSUP);
+#endif
+}
+
 int
 nni_posix_pipedesc_init(nni_posix_pipedesc **pdp, int fd)
 {
@@ -301,10 +807,8 @@ nni_posix_pipedesc_init(nni_posix_pipedesc **pdp, int fd)
 		return (NNG_ENOMEM);
 	}
 
-	// We could randomly choose a different pollq, or for efficiencies
-	// sake we could take a modulo of the file desc number to choose
-	// one.  For now we just have a global pollq.  Note that by tying
-	// the pd to a single pollq we may get some kind of cache warmth.
+	// The pollq is chosen by descriptor.  Note that by tying the pd
+	// to a single pollq we may get some kind of cache warmth.
 
 	pd->closed    = 0;
 	pd->node.fd   = fd;
@@ -320,11 +824,27 @@ nni_posix_pipedesc_init(nni_posix_pipedesc **pdp, int fd)
 #endif
 
 	nni_mtx_init(&pd->mtx);
+	nni_cv_init(&pd->xfercv, &pd->mtx);
 	nni_aio_list_init(&pd->readq);
 	nni_aio_list_init(&pd->writeq);
 
+	pd->xfer            = nni_posix_pollq_can_xfer();
+	pd->xferfd          = -1;
+	pd->rxfer.px_iov    = pd->rxiov;
+	pd->rxfer.px_write  = 0;
+	pd->rxfer.px_cb     = nni_posix_pipedesc_rxdone;
+	pd->rxfer.px_arg    = pd;
+	pd->txfer.px_iov    = pd->txiov;
+	pd->txfer.px_write  = 1;
+	pd->txfer.px_cb     = nni_posix_pipedesc_txdone;
+	pd->txfer.px_arg    = pd;
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+	nni_aio_list_init(&pd->zcq);
+#endif
+
 	rv = nni_posix_pollq_add(nni_posix_pollq_get(fd), &pd->node);
 	if (rv != 0) {
+		nni_cv_fini(&pd->xfercv);
 		nni_mtx_fini(&pd->mtx);
 		NNI_FREE_STRUCT(pd);
 		return (rv);
@@ -338,11 +858,17 @@ nni_posix_pipedesc_fini(nni_posix_pipedesc *pd)
 {
 	// Make sure no other polling activity is pending.
 	nni_posix_pipedesc_close(pd);
+	nni_mtx_lock(&pd->mtx);
+	while (pd->nxfer > 0) {
+		nni_cv_wait(&pd->xfercv);
+	}
+	nni_mtx_unlock(&pd->mtx);
 	nni_posix_pollq_remove(&pd->node);
 	if (pd->node.fd >= 0) {
 		(void) close(pd->node.fd);
 	}
 
+	nni_cv_fini(&pd->xfercv);
 	nni_mtx_fini(&pd->mtx);
 
 	NNI_FREE_STRUCT(pd);
@@ -0,0 +1,182 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/nng_impl.h"
+#include "platform/posix/posix_pollq.h"
+
+#ifdef NNG_PLATFORM_POSIX
+
+#include <stdlib.h>
+
+// We run several pollqs, each with its own thread, so that I/O can be
+// spread across cores.  Descriptors are assigned to pollqs by number.
+// The kernel always hands out the lowest free descriptor number, so the
+// numbers in use stay dense, and this balances well in practice.  The
+// pollq for a descriptor never changes, which keeps all of the work
+// for a connection on a single thread.
+static nni_posix_pollq **nni_posix_pollqs;
+static int               nni_posix_npollqs;
+
+// The backend chosen at build time.  Where io_uring is enabled, we try
+// that first, and fall back to this if the kernel refuses it.
+#if defined(NNG_USE_POSIX_POLLQ_EPOLL)
+#define NNI_POSIX_POLLQ_OPS nni_posix_pollq_epoll_ops
+#else
+#define NNI_POSIX_POLLQ_OPS nni_posix_pollq_poll_ops
+#endif
+
+static const nni_posix_pollq_ops *nni_posix_pollq_backend =
+    &NNI_POSIX_POLLQ_OPS;
+
+// The busy-poll budget in microseconds, shared by all of the pollqs.
+static nni_plat_atomic nni_posix_pollq_spinus;
+
+void
+nni_plat_busypoll(int usec)
+{
+	nni_plat_atomic_set(&nni_posix_pollq_spinus, usec);
+}
+
+int
+nni_posix_pollq_spin(void)
+{
+	return (nni_plat_atomic_get(&nni_posix_pollq_spinus));
+}
+
+nni_posix_pollq *
+nni_posix_pollq_get(int fd)
+{
+	return (nni_posix_pollqs[(unsigned) fd % nni_posix_npollqs]);
+}
+
+int
+nni_posix_pollq_add(nni_posix_pollq *pq, nni_posix_pollq_node *node)
+{
+	return (nni_posix_pollq_backend->pq_add(pq, node));
+}
+
+void
+nni_posix_pollq_remove(nni_posix_pollq_node *node)
+{
+	nni_posix_pollq_backend->pq_remove(node);
+}
+
+void
+nni_posix_pollq_detach(nni_posix_pollq_node *node)
+{
+	nni_posix_pollq_backend->pq_detach(node);
+}
+
+void
+nni_posix_pollq_arm(nni_posix_pollq_node *node, int events)
+{
+	nni_posix_pollq_backend->pq_arm(node, events);
+}
+
+void
+nni_posix_pollq_disarm(nni_posix_pollq_node *node, int events)
+{
+	nni_posix_pollq_backend->pq_disarm(node, events);
+}
+
+int
+nni_posix_pollq_can_xfer(void)
+{
+	return (nni_posix_pollq_backend->pq_xfer != NULL);
+}
+
+int
+nni_posix_pollq_xfer_start(
+    nni_posix_pollq_node *node, nni_posix_pollq_xfer *x)
+{
+	if (nni_posix_pollq_backend->pq_xfer == NULL) {
+		return (NNG_ENOTSUP);
+	}
+	return (nni_posix_pollq_backend->pq_xfer(node, x));
+}
+
+void
+nni_posix_pollq_xfer_cancel(
+    nni_posix_pollq_node *node, nni_posix_pollq_xfer *x)
+{
+	if (nni_posix_pollq_backend->pq_xfer_cancel != NULL) {
+		nni_posix_pollq_backend->pq_xfer_cancel(node, x);
+	}
+}
+
+int
+nni_posix_pollq_sysinit(void)
+{
+	int   n;
+	int   rv;
+	char *env;
+
+	// One per CPU, unless NNG_POLLQ_THREADS in the environment says
+	// otherwise.
+	n = nni_plat_ncpu();
+	if (((env = getenv("NNG_POLLQ_THREADS")) != NULL) && (atoi(env) > 0)) {
+		n = atoi(env);
+	}
+	if (n < 1) {
+		n = 1;
+	}
+	if (n > NNI_POSIX_POLLQ_MAXTHREADS) {
+		n = NNI_POSIX_POLLQ_MAXTHREADS;
+	}
+
+	if ((nni_posix_pollqs = nni_alloc(sizeof(*nni_posix_pollqs) * n)) ==
+	    NULL) {
+		return (NNG_ENOMEM);
+	}
+	nni_posix_npollqs = n;
+
+	nni_posix_pollq_backend = &NNI_POSIX_POLLQ_OPS;
+#ifdef NNG_HAVE_IO_URING
+	// NNG_POLLQ_URING=0 in the environment disables io_uring.
+	if (((env = getenv("NNG_POLLQ_URING")) == NULL) || (atoi(env) != 0)) {
+		nni_posix_pollq_backend = &nni_posix_pollq_uring_ops;
+	}
+#endif
+	for (int i = 0; i < n; i++) {
+		rv = nni_posix_pollq_backend->pq_create(&nni_posix_pollqs[i]);
+		if ((rv == NNG_ENOTSUP) && (i == 0) &&
+		    (nni_posix_pollq_backend != &NNI_POSIX_POLLQ_OPS)) {
+			nni_posix_pollq_backend = &NNI_POSIX_POLLQ_OPS;
+			rv = nni_posix_pollq_backend->pq_create(
+			    &nni_posix_pollqs[i]);
+		}
+		if (rv != 0) {
+			nni_posix_pollq_sysfini();
+			return (rv);
+		}
+	}
+	return (0);
+}
+
+void
+nni_posix_pollq_sysfini(void)
+{
+	if (nni_posix_pollqs == NULL) {
+		return;
+	}
+	for (int i = 0; i < nni_posix_npollqs; i++) {
+		nni_posix_pollq *pq;
+
+		if ((pq = nni_posix_pollqs[i]) != NULL) {
+			nni_posix_pollq_backend->pq_destroy(pq);
+		}
+	}
+	nni_free(
+	    nni_posix_pollqs, sizeof(*nni_posix_pollqs) * nni_posix_npollqs);
+	nni_posix_pollqs  = NULL;
+	nni_posix_npollqs = 0;
+}
+
+#endif // NNG_PLATFORM_POSIX
@@ -21,6 +21,7 @@
 
 #include "core/nng_impl.h"
 #include <poll.h>
+#include <sys/uio.h>
 
 typedef struct nni_posix_pollq_node nni_posix_pollq_node;
 typedef struct nni_posix_pollq      nni_posix_pollq;
@@ -37,15 +38,84 @@ struct nni_posix_pollq_node {
 	nni_cb           cb;      // user callback on event
 };
 
+// Some backends (io_uring) can also do the reads and writes for a node,
+// which then cost no system calls of their own.  A transfer reads into,
+// or writes from, the iovec, waiting for the descriptor if need be.  When
+// it is done, cb is called on the pollq thread, with result holding the
+// number of bytes moved, or a negative errno (-ECANCELED if it was
+// canceled first, or -EAGAIN if the kernel would not wait).  A transfer
+// cannot be abandoned, so the iovec and the buffers it names must stay
+// valid until then.
+typedef struct nni_posix_pollq_xfer {
+	struct iovec *px_iov;
+	int           px_niov;
+	int           px_write; // writev, rather than readv
+	int           px_result;
+	int           px_index; // used by the backend
+	nni_cb        px_cb;
+	void *        px_arg;
+} nni_posix_pollq_xfer;
+
+// NNI_POSIX_POLLQ_MAXTHREADS limits the number of pollqs (each of which
+// has its own thread).  By default there is one per CPU.
+#ifndef NNI_POSIX_POLLQ_MAXTHREADS
+#define NNI_POSIX_POLLQ_MAXTHREADS 64
+#endif
+
 extern nni_posix_pollq *nni_posix_pollq_get(int);
 extern int              nni_posix_pollq_sysinit(void);
 extern void             nni_posix_pollq_sysfini(void);
 
+// nni_posix_pollq_spin returns the busy-poll budget (see nni_plat_busypoll).
+// Before blocking, a backend should check for events without waiting
+// until this many microseconds have passed.
+extern int nni_posix_pollq_spin(void);
+
+// Each backend (poll, epoll, etc.) supplies these operations.  The
+// create and destroy operations set up or tear down a single pollq,
+// with its thread.  The rest implement the functions above.  A backend
+// that cannot be used on the running system fails create with
+// NNG_ENOTSUP, and we fall back to the backend selected at build time.
+typedef struct nni_posix_pollq_ops {
+	int (*pq_create)(nni_posix_pollq **);
+	void (*pq_destroy)(nni_posix_pollq *);
+	int (*pq_add)(nni_posix_pollq *, nni_posix_pollq_node *);
+	void (*pq_remove)(nni_posix_pollq_node *);
+	void (*pq_detach)(nni_posix_pollq_node *);
+	void (*pq_arm)(nni_posix_pollq_node *, int);
+	void (*pq_disarm)(nni_posix_pollq_node *, int);
+	int (*pq_xfer)(nni_posix_pollq_node *, nni_posix_pollq_xfer *);
+	void (*pq_xfer_cancel)(nni_posix_pollq_node *, nni_posix_pollq_xfer *);
+} nni_posix_pollq_ops;
+
+extern const nni_posix_pollq_ops nni_posix_pollq_poll_ops;
+extern const nni_posix_pollq_ops nni_posix_pollq_epoll_ops;
+extern const nni_posix_pollq_ops nni_posix_pollq_uring_ops;
+
 extern int  nni_posix_pollq_add(nni_posix_pollq *, nni_posix_pollq_node *);
 extern void nni_posix_pollq_remove(nni_posix_pollq_node *);
 extern void nni_posix_pollq_arm(nni_posix_pollq_node *, int);
+
+// nni_posix_pollq_detach disarms the node, and drops any registration
+// the backend holds for its descriptor.  It must be called before the
+// descriptor is closed (or handed to another node), because a kernel
+// registration can outlive close() when the file is shared, for example
+// after fork() or dup().  The node stays on its pollq, and does not wait
+// for a callback in progress, so it is safe to call from one.
+extern void nni_posix_pollq_detach(nni_posix_pollq_node *);
 extern void nni_posix_pollq_disarm(nni_posix_pollq_node *, int);
 
+// nni_posix_pollq_can_xfer returns nonzero if the backend does transfers.
+// nni_posix_pollq_xfer_start starts one for the node.  It fails (with
+// NNG_EAGAIN if the backend is merely busy) when it cannot, in which case
+// the caller should do the transfer itself.  nni_posix_pollq_xfer_cancel
+// asks for a transfer to be stopped, but it still completes as usual.
+extern int nni_posix_pollq_can_xfer(void);
+extern int nni_posix_pollq_xfer_start(
+    nni_posix_pollq_node *, nni_posix_pollq_xfer *);
+extern void nni_posix_pollq_xfer_cancel(
+    nni_posix_pollq_node *, nni_posix_pollq_xfer *);
+
 #endif // NNG_PLATFORM_POSIX
 
 #endif // PLATFORM_POSIX_POLLQ_H
@@ -0,0 +1,469 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/nng_impl.h"
+#include "platform/posix/posix_pollq.h"
+
+#ifdef NNG_USE_POSIX_POLLQ_EPOLL
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+// POSIX AIO using epoll().  Unlike poll(), the kernel keeps the set of
+// descriptors for us, so each wakeup costs in proportion to the number
+// of descriptors that are actually ready, not the number registered.
+//
+// Descriptors are registered with EPOLLONESHOT.  Once an event has been
+// reported for a descriptor, the kernel reports nothing further for it
+// until we modify the registration again, which we do when the node is
+// rearmed.  This matches the poll() backend, where events are disarmed
+// as the callback is run, and means that the poller never has to chase
+// level-triggered events that a callback has not dealt with yet.
+//
+// Registrations are removed when the node is detached, which its owner
+// does before closing the descriptor or handing it to another node (as
+// happens when a connect completes), and when the node itself is removed.
+// We cannot rely on close() for this: the kernel only drops an epoll
+// registration when the last reference to the open file goes away, and
+// after fork() or dup() that may be never.  Disarming is done lazily;
+// stray events for disarmed nodes are discarded, and the oneshot
+// registration stays quiet after that.  The node index holds the
+// descriptor last registered.
+
+// NNI_POSIX_EPOLL_EVENTS is the most events we collect per epoll_wait.
+#ifndef NNI_POSIX_EPOLL_EVENTS
+#define NNI_POSIX_EPOLL_EVENTS 64
+#endif
+
+struct nni_posix_pollq {
+	nni_mtx               mtx;
+	nni_cv                cv;
+	int                   epfd;    // epoll descriptor
+	int                   wakewfd; // write side of waker (eventfd)
+	int                   wakerfd; // read side of waker
+	int                   close;   // request for worker to exit
+	int                   started;
+	nni_thr               thr;     // worker thread
+	nni_list              nodes;   // all nodes
+	int                   nnodes;  // num of nodes in nodes list
+	int                   nevs;    // events from the last epoll_wait
+	int                   evidx;   // next event to process
+	int                   inwait;  // worker is in epoll_wait
+	int                   rmwait;  // remove waiting for epoll_wait
+	uint64_t              waitgen; // completed epoll_wait calls
+	nni_posix_pollq_node *wait;    // cancel waiting on this
+	nni_posix_pollq_node *active;  // active node (in callback)
+	struct epoll_event    evs[NNI_POSIX_EPOLL_EVENTS];
+};
+
+static uint32_t
+nni_posix_epoll_events(int events)
+{
+	uint32_t ev = 0;
+
+	if (events & POLLIN) {
+		ev |= EPOLLIN;
+	}
+	if (events & POLLOUT) {
+		ev |= EPOLLOUT;
+	}
+	return (ev);
+}
+
+static int
+nni_posix_epoll_revents(uint32_t ev)
+{
+	int revents = 0;
+
+	if (ev & EPOLLIN) {
+		revents |= POLLIN;
+	}
+	if (ev & EPOLLOUT) {
+		revents |= POLLOUT;
+	}
+	if (ev & EPOLLERR) {
+		revents |= POLLERR;
+	}
+	if (ev & EPOLLHUP) {
+		revents |= POLLHUP;
+	}
+	return (revents);
+}
+
+// nni_posix_epoll_update registers the node's descriptor for the node's
+// events.  The caller must hold the pollq lock.
+static void
+nni_posix_epoll_update(nni_posix_pollq *pq, nni_posix_pollq_node *node)
+{
+	struct epoll_event ev;
+
+	if (node->fd < 0) {
+		return;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events   = nni_posix_epoll_events(node->events) | EPOLLONESHOT;
+	ev.data.ptr = node;
+
+	// The descriptor may be new to us, or may have been closed (and
+	// so dropped from the set) since we last registered it, or it may
+	// have been handed to us by another node.  Try whichever is most
+	// likely to work first.
+	if (node->index != node->fd) {
+		if ((epoll_ctl(pq->epfd, EPOLL_CTL_ADD, node->fd, &ev) != 0) &&
+		    (errno == EEXIST)) {
+			(void) epoll_ctl(
+			    pq->epfd, EPOLL_CTL_MOD, node->fd, &ev);
+		}
+	} else {
+		if ((epoll_ctl(pq->epfd, EPOLL_CTL_MOD, node->fd, &ev) != 0) &&
+		    (errno == ENOENT)) {
+			(void) epoll_ctl(
+			    pq->epfd, EPOLL_CTL_ADD, node->fd, &ev);
+		}
+	}
+	node->index = node->fd;
+}
+
+static void
+nni_posix_poll_thr(void *arg)
+{
+	nni_posix_pollq *     pollq = arg;
+	nni_posix_pollq_node *node;
+	nni_aio_inline        ai;
+
+	nni_mtx_lock(&pollq->mtx);
+	for (;;) {
+		int rv;
+		int spin;
+
+		if (pollq->close) {
+			break;
+		}
+
+		// We block indefinitely, since we use separate timeouts to
+		// wake and remove the elements from the list.  Changes to
+		// the registrations take effect while we are waiting, so
+		// there is no need to wake us for them.  With a busy-poll
+		// budget, we spin for a while first.
+		pollq->nevs   = 0;
+		pollq->evidx  = 0;
+		pollq->inwait = 1;
+		nni_mtx_unlock(&pollq->mtx);
+		rv = 0;
+		if ((spin = nni_posix_pollq_spin()) > 0) {
+			uint64_t end = nni_plat_clock_us() + spin;
+
+			while (((rv = epoll_wait(pollq->epfd, pollq->evs,
+			             NNI_POSIX_EPOLL_EVENTS, 0)) == 0) &&
+			    (nni_plat_clock_us() < end)) {
+			}
+		}
+		if (rv == 0) {
+			rv = epoll_wait(pollq->epfd, pollq->evs,
+			    NNI_POSIX_EPOLL_EVENTS, -1);
+		}
+		nni_mtx_lock(&pollq->mtx);
+
+		if (rv < 0) {
+			// EINTR is the only reasonable failure here.
+			rv = 0;
+		}
+		pollq->nevs   = rv;
+		pollq->inwait = 0;
+		pollq->waitgen++;
+		if (pollq->rmwait) {
+			pollq->rmwait = 0;
+			nni_cv_wake(&pollq->cv);
+		}
+
+		// Nodes removed while we are running callbacks are cleared
+		// out of the events array, so that we never touch them.
+		while (pollq->evidx < pollq->nevs) {
+			struct epoll_event *ev;
+			int                 revents;
+
+			ev = &pollq->evs[pollq->evidx++];
+			if (ev->data.ptr == pollq) {
+				nni_plat_pipe_clear(pollq->wakerfd);
+				continue;
+			}
+			if ((node = ev->data.ptr) == NULL) {
+				continue;
+			}
+
+			// Errors are reported whether asked for or not,
+			// as with poll().  Anything that the node has
+			// since disarmed is discarded.
+			revents = nni_posix_epoll_revents(ev->events);
+			revents &= (node->events | POLLERR | POLLHUP);
+			if ((node->events == 0) || (revents == 0)) {
+				if (node->events != 0) {
+					nni_posix_epoll_update(pollq, node);
+				}
+				continue;
+			}
+
+			// We are calling the callback, so disarm the events
+			// that fired; the node can rearm them in its
+			// callback.  Any others must be registered again.
+			node->revents = revents;
+			node->events &= ~revents;
+			if (node->events != 0) {
+				nni_posix_epoll_update(pollq, node);
+			}
+
+			// Save the active node; we can notice this way
+			// when it is busy, and avoid freeing it until
+			// we are sure that it is not in use.
+			pollq->active = node;
+
+			// Execute the callback -- without locks held.
+			nni_mtx_unlock(&pollq->mtx);
+			nni_aio_inline_begin(&ai);
+			node->cb(node->data);
+			nni_mtx_lock(&pollq->mtx);
+
+			// We finished with this node.  If something
+			// was blocked waiting for that, wake it up.
+			pollq->active = NULL;
+			if (pollq->wait == node) {
+				pollq->wait = NULL;
+				nni_cv_wake(&pollq->cv);
+			}
+
+			// Now run any completions that the callback
+			// left for us; these may well close the node.
+			nni_mtx_unlock(&pollq->mtx);
+			nni_aio_inline_end(&ai);
+			nni_mtx_lock(&pollq->mtx);
+		}
+	}
+	nni_mtx_unlock(&pollq->mtx);
+}
+
+static int
+nni_posix_epoll_add(nni_posix_pollq *pq, nni_posix_pollq_node *node)
+{
+	NNI_ASSERT(!nni_list_node_active(&node->node));
+
+	nni_mtx_lock(&pq->mtx);
+	if (pq->close) {
+		// This shouldn't happen!
+		nni_mtx_unlock(&pq->mtx);
+		return (NNG_ECLOSED);
+	}
+	node->pq    = pq;
+	node->index = -1;
+	pq->nnodes++;
+	nni_list_append(&pq->nodes, node);
+	nni_mtx_unlock(&pq->mtx);
+	return (0);
+}
+
+// nni_posix_epoll_unregister drops the node's registration.  With no
+// events, the worker discards (rather than reregisters) anything it still
+// finds for us.  The caller must hold the pollq lock.
+static void
+nni_posix_epoll_unregister(nni_posix_pollq *pq, nni_posix_pollq_node *node)
+{
+	node->events = 0;
+	if ((node->fd >= 0) && (node->index == node->fd)) {
+		(void) epoll_ctl(pq->epfd, EPOLL_CTL_DEL, node->fd, NULL);
+	}
+	node->index = -1;
+}
+
+static void
+nni_posix_epoll_detach(nni_posix_pollq_node *node)
+{
+	nni_posix_pollq *pq = node->pq;
+
+	if (pq == NULL) {
+		return;
+	}
+	nni_mtx_lock(&pq->mtx);
+	nni_posix_epoll_unregister(pq, node);
+	nni_mtx_unlock(&pq->mtx);
+}
+
+static void
+nni_posix_epoll_remove(nni_posix_pollq_node *node)
+{
+	nni_posix_pollq *pq = node->pq;
+
+	if (pq == NULL) {
+		return;
+	}
+	nni_mtx_lock(&pq->mtx);
+	while (pq->active == node) {
+		pq->wait = node;
+		nni_cv_wait(&pq->cv);
+	}
+	nni_posix_epoll_unregister(pq, node);
+
+	// Later calls to epoll_wait cannot report us, but one that is in
+	// progress may have done so already, and its events are not in the
+	// array yet for us to clear out.  Kick the worker out of it, and
+	// wait until it has them.
+	if (pq->inwait) {
+		uint64_t gen = pq->waitgen;
+
+		pq->rmwait = 1;
+		nni_plat_pipe_raise(pq->wakewfd);
+		while (pq->waitgen == gen) {
+			nni_cv_wait(&pq->cv);
+		}
+	}
+	for (int i = pq->evidx; i < pq->nevs; i++) {
+		if (pq->evs[i].data.ptr == node) {
+			pq->evs[i].data.ptr = NULL;
+		}
+	}
+	if (nni_list_node_active(&node->node)) {
+		nni_list_node_remove(&node->node);
+		pq->nnodes--;
+	}
+	if (pq->close) {
+		nni_cv_wake(&pq->cv);
+	}
+	nni_mtx_unlock(&pq->mtx);
+}
+
+static void
+nni_posix_epoll_arm(nni_posix_pollq_node *node, int events)
+{
+	nni_posix_pollq *pq = node->pq;
+	int              oevents;
+
+	if (pq == NULL) {
+		return;
+	}
+
+	nni_mtx_lock(&pq->mtx);
+	oevents = node->events;
+	node->events |= events;
+	if ((node->events != 0) &&
+	    ((node->events != oevents) || (node->index != node->fd))) {
+		nni_posix_epoll_update(pq, node);
+	}
+	nni_mtx_unlock(&pq->mtx);
+}
+
+static void
+nni_posix_epoll_disarm(nni_posix_pollq_node *node, int events)
+{
+	nni_posix_pollq *pq = node->pq;
+
+	if (pq == NULL) {
+		return;
+	}
+
+	// We leave the registration alone; if one of these events shows
+	// up anyway, the poller will discard it.
+	nni_mtx_lock(&pq->mtx);
+	node->events &= ~events;
+	nni_mtx_unlock(&pq->mtx);
+}
+
+static void
+nni_posix_epoll_destroy(nni_posix_pollq *pq)
+{
+	if (pq->started) {
+		nni_mtx_lock(&pq->mtx);
+		pq->close   = 1;
+		pq->started = 0;
+		nni_plat_pipe_raise(pq->wakewfd);
+		nni_mtx_unlock(&pq->mtx);
+	}
+	nni_thr_fini(&pq->thr);
+
+	// All pipes should have been closed before this is called.
+	NNI_ASSERT(nni_list_empty(&pq->nodes));
+	NNI_ASSERT(pq->nnodes == 0);
+
+	if (pq->wakewfd >= 0) {
+		nni_plat_pipe_close(pq->wakewfd, pq->wakerfd);
+		pq->wakewfd = pq->wakerfd = -1;
+	}
+	if (pq->epfd >= 0) {
+		(void) close(pq->epfd);
+		pq->epfd = -1;
+	}
+	nni_cv_fini(&pq->cv);
+	nni_mtx_fini(&pq->mtx);
+	NNI_FREE_STRUCT(pq);
+}
+
+static int
+nni_posix_epoll_create(nni_posix_pollq **pqp)
+{
+	nni_posix_pollq *  pq;
+	struct epoll_event ev;
+	int                rv;
+
+	if ((pq = NNI_ALLOC_STRUCT(pq)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+
+	NNI_LIST_INIT(&pq->nodes, nni_posix_pollq_node, node);
+	pq->wakewfd = -1;
+	pq->wakerfd = -1;
+	pq->close   = 0;
+	pq->nevs    = 0;
+	pq->evidx   = 0;
+
+	nni_mtx_init(&pq->mtx);
+	nni_cv_init(&pq->cv, &pq->mtx);
+
+	if ((pq->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		rv = nni_plat_errno(errno);
+		nni_posix_epoll_destroy(pq);
+		return (rv);
+	}
+	if ((rv = nni_plat_pipe_open(&pq->wakewfd, &pq->wakerfd)) != 0) {
+		nni_posix_epoll_destroy(pq);
+		return (rv);
+	}
+
+	// The waker is level triggered, and stays registered, so that
+	// it always gets our attention.
+	memset(&ev, 0, sizeof(ev));
+	ev.events   = EPOLLIN;
+	ev.data.ptr = pq;
+	if (epoll_ctl(pq->epfd, EPOLL_CTL_ADD, pq->wakerfd, &ev) != 0) {
+		rv = nni_plat_errno(errno);
+		nni_posix_epoll_destroy(pq);
+		return (rv);
+	}
+
+	if ((rv = nni_thr_init(&pq->thr, nni_posix_poll_thr, pq)) != 0) {
+		nni_posix_epoll_destroy(pq);
+		return (rv);
+	}
+	pq->started = 1;
+	nni_thr_run(&pq->thr);
+	*pqp = pq;
+	return (0);
+}
+
+const nni_posix_pollq_ops nni_posix_pollq_epoll_ops = {
+	.pq_create  = nni_posix_epoll_create,
+	.pq_destroy = nni_posix_epoll_destroy,
+	.pq_add     = nni_posix_epoll_add,
+	.pq_remove  = nni_posix_epoll_remove,
+	.pq_detach  = nni_posix_epoll_detach,
+	.pq_arm     = nni_posix_epoll_arm,
+	.pq_disarm  = nni_posix_epoll_disarm,
+};
+
+#endif // NNG_USE_POSIX_POLLQ_EPOLL
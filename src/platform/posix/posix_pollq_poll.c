@@ -23,12 +23,9 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
-// POSIX AIO using poll().  We use a single poll thread to perform
-// I/O operations for the entire system.  This isn't entirely scalable,
-// and it might be a good idea to create a few threads and group the
-// I/O operations into separate pollers to limit the amount of work each
-// thread does, and to scale across multiple cores.  For now we don't
-// worry about it.
+// POSIX AIO using poll().  Each pollq has a single poll thread, which
+// performs I/O operations for the descriptors assigned to it.  (See
+// posix_pollq.c for how descriptors are spread across pollqs.)
 
 // nni_posix_pollq is a work structure used by the poller thread, that keeps
 // track of all the underlying pipe handles and so forth being used by poll().
@@ -81,11 +78,13 @@ nni_posix_poll_thr(void *arg)
 {
 	nni_posix_pollq *     pollq = arg;
 	nni_posix_pollq_node *node;
+	nni_aio_inline        ai;
 
 	nni_mtx_lock(&pollq->mtx);
 	for (;;) {
 		int            rv;
 		int            nfds;
+		int            spin;
 		struct pollfd *fds;
 
 		if (pollq->close) {
@@ -115,9 +114,20 @@ nni_posix_poll_thr(void *arg)
 
 		// Now poll it.  We block indefinitely, since we use separate
 		// timeouts to wake and remove the elements from the list.
+		// With a busy-poll budget, we spin for a while first.
 		pollq->inpoll = 1;
 		nni_mtx_unlock(&pollq->mtx);
-		rv = poll(fds, nfds, -1);
+		rv = 0;
+		if ((spin = nni_posix_pollq_spin()) > 0) {
+			uint64_t end = nni_plat_clock_us() + spin;
+
+			while (((rv = poll(fds, nfds, 0)) == 0) &&
+			    (nni_plat_clock_us() < end)) {
+			}
+		}
+		if (rv == 0) {
+			rv = poll(fds, nfds, -1);
+		}
 		nni_mtx_lock(&pollq->mtx);
 		pollq->inpoll = 0;
 
@@ -173,6 +183,7 @@ nni_posix_poll_thr(void *arg)
 
 			// Execute the callback -- without locks held.
 			nni_mtx_unlock(&pollq->mtx);
+			nni_aio_inline_begin(&ai);
 			node->cb(node->data);
 			nni_mtx_lock(&pollq->mtx);
 
@@ -183,13 +194,19 @@ nni_posix_poll_thr(void *arg)
 				pollq->wait = NULL;
 				nni_cv_wake(&pollq->cv);
 			}
+
+			// Now run any completions that the callback
+			// left for us; these may well close the node.
+			nni_mtx_unlock(&pollq->mtx);
+			nni_aio_inline_end(&ai);
+			nni_mtx_lock(&pollq->mtx);
 		}
 	}
 	nni_mtx_unlock(&pollq->mtx);
 }
 
-int
-nni_posix_pollq_add(nni_posix_pollq *pq, nni_posix_pollq_node *node)
+static int
+nni_posix_poll_add(nni_posix_pollq *pq, nni_posix_pollq_node *node)
 {
 	int rv;
 	NNI_ASSERT(!nni_list_node_active(&node->node));
@@ -211,8 +228,8 @@ nni_posix_pollq_add(nni_posix_pollq *pq, nni_posix_pollq_node *node)
 	return (0);
 }
 
-void
-nni_posix_pollq_remove(nni_posix_pollq_node *node)
+static void
+nni_posix_poll_remove(nni_posix_pollq_node *node)
 {
 	nni_posix_pollq *pq = node->pq;
 
@@ -234,8 +251,8 @@ nni_posix_pollq_remove(nni_posix_pollq_node *node)
 	nni_mtx_unlock(&pq->mtx);
 }
 
-void
-nni_posix_pollq_arm(nni_posix_pollq_node *node, int events)
+static void
+nni_posix_poll_arm(nni_posix_pollq_node *node, int events)
 {
 	nni_posix_pollq *pq = node->pq;
 	int              oevents;
@@ -264,8 +281,8 @@ nni_posix_pollq_arm(nni_posix_pollq_node *node, int events)
 	nni_mtx_unlock(&pq->mtx);
 }
 
-void
-nni_posix_pollq_disarm(nni_posix_pollq_node *node, int events)
+static void
+nni_posix_poll_disarm(nni_posix_pollq_node *node, int events)
 {
 	nni_posix_pollq *pq = node->pq;
 	int              oevents;
@@ -286,8 +303,16 @@ nni_posix_pollq_disarm(nni_posix_pollq_node *node, int events)
 	nni_mtx_unlock(&pq->mtx);
 }
 
+// poll() keeps no registrations of its own, so to detach it is enough to
+// stop asking about the descriptor.
+static void
+nni_posix_poll_detach(nni_posix_pollq_node *node)
+{
+	nni_posix_poll_disarm(node, ~0);
+}
+
 static void
-nni_posix_pollq_fini(nni_posix_pollq *pq)
+nni_posix_poll_destroy(nni_posix_pollq *pq)
 {
 	if (pq->started) {
 		nni_mtx_lock(&pq->mtx);
@@ -313,13 +338,20 @@ nni_posix_pollq_fini(nni_posix_pollq *pq)
 		pq->fds  = NULL;
 		pq->nfds = 0;
 	}
+	nni_cv_fini(&pq->cv);
 	nni_mtx_fini(&pq->mtx);
+	NNI_FREE_STRUCT(pq);
 }
 
 static int
-nni_posix_pollq_init(nni_posix_pollq *pq)
+nni_posix_poll_create(nni_posix_pollq **pqp)
 {
-	int rv;
+	nni_posix_pollq *pq;
+	int              rv;
+
+	if ((pq = NNI_ALLOC_STRUCT(pq)) == NULL) {
+		return (NNG_ENOMEM);
+	}
 
 	NNI_LIST_INIT(&pq->polled, nni_posix_pollq_node, node);
 	NNI_LIST_INIT(&pq->armed, nni_posix_pollq_node, node);
@@ -334,42 +366,23 @@ nni_posix_pollq_init(nni_posix_pollq *pq)
 	if (((rv = nni_posix_pollq_poll_grow(pq)) != 0) ||
 	    ((rv = nni_plat_pipe_open(&pq->wakewfd, &pq->wakerfd)) != 0) ||
 	    ((rv = nni_thr_init(&pq->thr, nni_posix_poll_thr, pq)) != 0)) {
-		nni_posix_pollq_fini(pq);
+		nni_posix_poll_destroy(pq);
 		return (rv);
 	}
 	pq->started = 1;
 	nni_thr_run(&pq->thr);
+	*pqp = pq;
 	return (0);
 }
 
-// We use a single pollq for the entire system, which means only a single
-// thread is polling.  This may be somewhat less than optimally efficient,
-// and it may be worth investigating having multiple threads to improve
-// efficiency and scalability.  (This would shorten the linked lists,
-// improving C10K scalability, and also allow us to engage multiple cores.)
-// It's not entirely clear how many threads are "optimal".
-static nni_posix_pollq nni_posix_global_pollq;
-
-nni_posix_pollq *
-nni_posix_pollq_get(int fd)
-{
-	// This is the point where we could choose a pollq based on FD.
-	return (&nni_posix_global_pollq);
-}
-
-int
-nni_posix_pollq_sysinit(void)
-{
-	int rv;
-
-	rv = nni_posix_pollq_init(&nni_posix_global_pollq);
-	return (rv);
-}
-
-void
-nni_posix_pollq_sysfini(void)
-{
-	nni_posix_pollq_fini(&nni_posix_global_pollq);
-}
+const nni_posix_pollq_ops nni_posix_pollq_poll_ops = {
+	.pq_create  = nni_posix_poll_create,
+	.pq_destroy = nni_posix_poll_destroy,
+	.pq_add     = nni_posix_poll_add,
+	.pq_remove  = nni_posix_poll_remove,
+	.pq_detach  = nni_posix_poll_detach,
+	.pq_arm     = nni_posix_poll_arm,
+	.pq_disarm  = nni_posix_poll_disarm,
+};
 
 #endif // NNG_USE_POSIX_POLLQ_POLL
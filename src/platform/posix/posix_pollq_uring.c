@@ -0,0 +1,767 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/nng_impl.h"
+#include "platform/posix/posix_pollq.h"
+
+#ifdef NNG_HAVE_IO_URING
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// POSIX AIO using Linux io_uring.  Requests to watch descriptors
+// (IORING_OP_POLL_ADD) are queued in the submission ring, and handed to
+// the kernel in batches.  In particular, the rearming done by the
+// callbacks run on the poller thread costs no system calls of its own;
+// it is submitted along with the wait for the next completions.  Threads
+// other than the poller submit their own requests only when the poller
+// is asleep in the kernel.
+//
+// We also do the reads and writes for pipe descriptors (IORING_OP_READV
+// and IORING_OP_WRITEV), which are batched the same way.  The kernel
+// waits for the descriptor itself, so a pipedesc using these needs no
+// polls at all.  Older kernels may return -EAGAIN instead, as the
+// descriptors are non-blocking; the pipedesc then waits for readiness as
+// before, and tries again.  Transfers are stopped with
+// IORING_OP_ASYNC_CANCEL.
+//
+// Polls in io_uring are one shot, much like our nodes.  Each node has at
+// most one poll outstanding.  Each outstanding poll has a slot, and the
+// slot number is the user data for the request, so that a completion
+// for a node that has since been removed finds an empty slot, and never
+// touches the node.  Slots are freed only when their completion arrives.
+// The node index holds the slot for the outstanding poll (or -1), and
+// armed holds the events it watches for, or zero if we have asked for
+// it to be canceled.  Transfers have slots as well.
+//
+// When the submission ring is full, even after handing its contents to
+// the kernel, we do not wait for room, as the poller needs our lock to
+// reap completions, and the kernel may refuse submissions until it does.
+// Instead a poll that cannot be started, or canceled, is left for the
+// poller to sweep up before it next waits, and a transfer fails, so that
+// the pipedesc does it itself.
+//
+// We use the raw system calls, rather than liburing, to avoid the extra
+// dependency.  If the kernel lacks io_uring (or it is disallowed, as it
+// often is in containers), creation fails with NNG_ENOTSUP, and the
+// caller falls back to the default backend.
+
+// NNI_POSIX_URING_ENTRIES is the size of the submission ring.
+#ifndef NNI_POSIX_URING_ENTRIES
+#define NNI_POSIX_URING_ENTRIES 1024
+#endif
+
+// User data for requests that have no slot (wakeups and cancellations).
+#define NNI_POSIX_URING_NOSLOT ((uint64_t) -1)
+
+typedef struct nni_posix_uring_slot {
+	nni_posix_pollq_node *node;   // NULL if removed
+	nni_posix_pollq_xfer *xfer;   // NULL unless a transfer
+	int                   fd;     // descriptor polled
+	int                   cancel; // cancel wanted, but not yet asked
+	int                   next;   // next free slot
+} nni_posix_uring_slot;
+
+struct nni_posix_pollq {
+	nni_mtx               mtx;
+	nni_cv                cv;
+	int                   ringfd;
+	int                   close;   // request for worker to exit
+	int                   started; // worker thread running
+	int                   inwait;  // poller waiting in the kernel
+	int                   sweep;   // polls left for lack of room
+	unsigned              pending; // queued, but not submitted
+	nni_thr               thr;     // worker thread
+	nni_list              nodes;   // all nodes
+	int                   nnodes;  // num of nodes in nodes list
+	nni_posix_pollq_node *wait;    // cancel waiting on this
+	nni_posix_pollq_node *active;  // active node (in callback)
+
+	nni_posix_uring_slot *slots;
+	int                   nslots;
+	int                   freeslot; // first free slot, or -1
+
+	// Ring mappings.
+	void *               ring;
+	size_t               ringsz;
+	struct io_uring_sqe *sqes;
+	size_t               sqesz;
+	unsigned *           sq_head;
+	unsigned *           sq_tail;
+	unsigned *           sq_array;
+	unsigned             sq_mask;
+	unsigned             sq_entries;
+	unsigned *           cq_head;
+	unsigned *           cq_tail;
+	unsigned             cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+static int
+nni_posix_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return ((int) syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int
+nni_posix_uring_enter(int fd, unsigned submit, unsigned wait, unsigned flags)
+{
+	return ((int) syscall(
+	    __NR_io_uring_enter, fd, submit, wait, flags, NULL, 0));
+}
+
+// nni_posix_uring_submit hands everything queued to the kernel.
+static void
+nni_posix_uring_submit(nni_posix_pollq *pq)
+{
+	int rv;
+
+	while (pq->pending > 0) {
+		rv = nni_posix_uring_enter(pq->ringfd, pq->pending, 0, 0);
+		if (rv < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			// Try again later; the poller will submit what is
+			// left when it next waits.
+			return;
+		}
+		pq->pending -= (unsigned) rv;
+	}
+}
+
+// nni_posix_uring_sqe returns the next submission entry, cleared, or NULL
+// if the ring is full.  The caller must fill it in, and then call
+// nni_posix_uring_push.
+static struct io_uring_sqe *
+nni_posix_uring_sqe(nni_posix_pollq *pq)
+{
+	struct io_uring_sqe *sqe;
+	unsigned             tail = *pq->sq_tail;
+	unsigned             idx;
+
+	// The ring is large, so it is rare that it fills.
+	if ((tail - __atomic_load_n(pq->sq_head, __ATOMIC_ACQUIRE)) >=
+	    pq->sq_entries) {
+		nni_posix_uring_submit(pq);
+		if ((tail - __atomic_load_n(pq->sq_head, __ATOMIC_ACQUIRE)) >=
+		    pq->sq_entries) {
+			return (NULL);
+		}
+	}
+	idx = tail & pq->sq_mask;
+	sqe = &pq->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	pq->sq_array[idx] = idx;
+	return (sqe);
+}
+
+static void
+nni_posix_uring_push(nni_posix_pollq *pq)
+{
+	__atomic_store_n(pq->sq_tail, *pq->sq_tail + 1, __ATOMIC_RELEASE);
+	pq->pending++;
+
+	// If the poller is awake, it will submit this before it waits.
+	if (pq->inwait) {
+		nni_posix_uring_submit(pq);
+	}
+}
+
+static int
+nni_posix_uring_slot_alloc(nni_posix_pollq *pq)
+{
+	int slot;
+
+	if (pq->freeslot < 0) {
+		nni_posix_uring_slot *slots;
+		int                   n = pq->nslots ? pq->nslots * 2 : 64;
+
+		if ((slots = NNI_ALLOC_STRUCTS(slots, n)) == NULL) {
+			return (-1);
+		}
+		if (pq->nslots != 0) {
+			memcpy(slots, pq->slots, sizeof(*slots) * pq->nslots);
+			NNI_FREE_STRUCTS(pq->slots, pq->nslots);
+		}
+		for (int i = pq->nslots; i < n; i++) {
+			slots[i].next = (i + 1 < n) ? i + 1 : -1;
+		}
+		pq->freeslot = pq->nslots;
+		pq->slots    = slots;
+		pq->nslots   = n;
+	}
+	slot         = pq->freeslot;
+	pq->freeslot = pq->slots[slot].next;
+	return (slot);
+}
+
+static void
+nni_posix_uring_slot_free(nni_posix_pollq *pq, int slot)
+{
+	pq->slots[slot].node   = NULL;
+	pq->slots[slot].xfer   = NULL;
+	pq->slots[slot].cancel = 0;
+	pq->slots[slot].next   = pq->freeslot;
+	pq->freeslot         = slot;
+}
+
+// nni_posix_uring_post starts a poll for the node's events.  The node
+// must not already have one outstanding.
+static void
+nni_posix_uring_post(nni_posix_pollq *pq, nni_posix_pollq_node *node)
+{
+	struct io_uring_sqe *sqe;
+	int                  slot;
+
+	// A detached node has no events.  Check that first, as its owner
+	// clears the descriptor without holding our lock.
+	if ((node->events == 0) || (node->fd < 0)) {
+		return;
+	}
+	if ((sqe = nni_posix_uring_sqe(pq)) == NULL) {
+		pq->sweep = 1;
+		return;
+	}
+	if ((slot = nni_posix_uring_slot_alloc(pq)) < 0) {
+		// Nothing better to do; the node will not see events
+		// until it is armed again.
+		return;
+	}
+	pq->slots[slot].node = node;
+	pq->slots[slot].fd   = node->fd;
+	node->index          = slot;
+	node->armed          = node->events;
+
+	sqe->opcode      = IORING_OP_POLL_ADD;
+	sqe->fd          = node->fd;
+	sqe->poll_events = (uint16_t) node->events;
+	sqe->user_data   = (uint64_t) slot;
+	nni_posix_uring_push(pq);
+}
+
+// nni_posix_uring_remove_slot asks the kernel to cancel the poll, or
+// transfer, in the slot.  The completion for it arrives as usual.
+static void
+nni_posix_uring_remove_slot(nni_posix_pollq *pq, int slot)
+{
+	struct io_uring_sqe *sqe;
+
+	if ((sqe = nni_posix_uring_sqe(pq)) == NULL) {
+		pq->slots[slot].cancel = 1;
+		pq->sweep              = 1;
+		return;
+	}
+	if (pq->slots[slot].xfer != NULL) {
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	} else {
+		sqe->opcode = IORING_OP_POLL_REMOVE;
+	}
+	sqe->fd                = -1;
+	sqe->addr              = (uint64_t) slot;
+	sqe->user_data         = NNI_POSIX_URING_NOSLOT;
+	pq->slots[slot].cancel = 0;
+	nni_posix_uring_push(pq);
+}
+
+// nni_posix_uring_cancel cancels the node's outstanding poll.
+static void
+nni_posix_uring_cancel(nni_posix_pollq *pq, nni_posix_pollq_node *node)
+{
+	nni_posix_uring_remove_slot(pq, node->index);
+	node->armed = 0;
+}
+
+// nni_posix_uring_sweep starts the polls, and cancellations, that were
+// left for lack of room in the submission ring.
+static void
+nni_posix_uring_sweep(nni_posix_pollq *pq)
+{
+	nni_posix_pollq_node *node;
+
+	pq->sweep = 0;
+	for (int i = 0; (i < pq->nslots) && !pq->sweep; i++) {
+		if (pq->slots[i].cancel) {
+			nni_posix_uring_remove_slot(pq, i);
+		}
+	}
+	NNI_LIST_FOREACH (&pq->nodes, node) {
+		if (pq->sweep) {
+			break;
+		}
+		if (node->index < 0) {
+			nni_posix_uring_post(pq, node);
+		}
+	}
+}
+
+static void
+nni_posix_poll_thr(void *arg)
+{
+	nni_posix_pollq *     pollq = arg;
+	nni_posix_pollq_node *node;
+	nni_posix_pollq_xfer *x;
+	nni_aio_inline        ai;
+	int                   spun = 0; // spun since the last completion
+
+	nni_mtx_lock(&pollq->mtx);
+	for (;;) {
+		struct io_uring_cqe *cqe;
+		unsigned             head;
+		unsigned             tail;
+		uint64_t             ud;
+		int                  res;
+		int                  revents;
+
+		if (pollq->close) {
+			break;
+		}
+
+		head = *pollq->cq_head;
+		tail = __atomic_load_n(pollq->cq_tail, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			unsigned n;
+			int      spin = spun ? 0 : nni_posix_pollq_spin();
+			int      rv;
+
+			if (pollq->sweep) {
+				nni_posix_uring_submit(pollq);
+				nni_posix_uring_sweep(pollq);
+			}
+			n = pollq->pending;
+
+			// Nothing to do; submit whatever has been queued, and
+			// wait for something to complete.  With a busy-poll
+			// budget, we first watch the completion ring for a
+			// while, which needs no system calls at all.
+			pollq->pending = 0;
+			pollq->inwait  = 1;
+			nni_mtx_unlock(&pollq->mtx);
+			if (spin > 0) {
+				uint64_t end = nni_plat_clock_us() + spin;
+
+				rv = nni_posix_uring_enter(
+				    pollq->ringfd, n, 0, 0);
+				while ((__atomic_load_n(pollq->cq_tail,
+				           __ATOMIC_ACQUIRE) == head) &&
+				    (nni_plat_clock_us() < end)) {
+				}
+				spun = 1;
+			} else {
+				rv = nni_posix_uring_enter(pollq->ringfd, n, 1,
+				    IORING_ENTER_GETEVENTS);
+			}
+			nni_mtx_lock(&pollq->mtx);
+			pollq->inwait = 0;
+			if (rv < 0) {
+				// EINTR, or a temporary shortage; nothing
+				// was submitted, so try it all again.
+				pollq->pending += n;
+			} else if ((unsigned) rv < n) {
+				pollq->pending += n - (unsigned) rv;
+			}
+			continue;
+		}
+
+		spun = 0;
+		cqe  = &pollq->cqes[head & pollq->cq_mask];
+		ud   = cqe->user_data;
+		res = cqe->res;
+		__atomic_store_n(pollq->cq_head, head + 1, __ATOMIC_RELEASE);
+
+		if (ud == NNI_POSIX_URING_NOSLOT) {
+			continue;
+		}
+		if ((x = pollq->slots[ud].xfer) != NULL) {
+			// The transfer may be freed by its callback.
+			nni_posix_uring_slot_free(pollq, (int) ud);
+			x->px_index  = -1;
+			x->px_result = res;
+			nni_mtx_unlock(&pollq->mtx);
+			nni_aio_inline_begin(&ai);
+			x->px_cb(x->px_arg);
+			nni_aio_inline_end(&ai);
+			nni_mtx_lock(&pollq->mtx);
+			continue;
+		}
+		node = pollq->slots[ud].node;
+		nni_posix_uring_slot_free(pollq, (int) ud);
+		if (node == NULL) {
+			// Removed while the poll was outstanding.
+			continue;
+		}
+		node->index = -1;
+		node->armed = 0;
+
+		if (res >= 0) {
+			revents = res;
+		} else if (res == -ECANCELED) {
+			revents = 0;
+		} else if (res == -EBADF) {
+			revents = POLLNVAL;
+		} else {
+			revents = POLLERR;
+		}
+
+		// Errors are reported whether asked for or not, as with
+		// poll().  Anything that the node has since disarmed is
+		// discarded.  A canceled poll is simply restarted.
+		revents &= (node->events | POLLERR | POLLHUP | POLLNVAL);
+		if ((node->events == 0) || (revents == 0)) {
+			nni_posix_uring_post(pollq, node);
+			continue;
+		}
+
+		// We are calling the callback, so disarm the events that
+		// fired; the node can rearm them in its callback.  Any
+		// others must be polled for again.
+		node->revents = revents;
+		node->events &= ~revents;
+		nni_posix_uring_post(pollq, node);
+
+		// Save the active node; we can notice this way
+		// when it is busy, and avoid freeing it until
+		// we are sure that it is not in use.
+		pollq->active = node;
+
+		// Execute the callback -- without locks held.
+		nni_mtx_unlock(&pollq->mtx);
+		nni_aio_inline_begin(&ai);
+		node->cb(node->data);
+		nni_mtx_lock(&pollq->mtx);
+
+		// We finished with this node.  If something
+		// was blocked waiting for that, wake it up.
+		pollq->active = NULL;
+		if (pollq->wait == node) {
+			pollq->wait = NULL;
+			nni_cv_wake(&pollq->cv);
+		}
+
+		// Now run any completions that the callback
+		// left for us; these may well close the node.
+		nni_mtx_unlock(&pollq->mtx);
+		nni_aio_inline_end(&ai);
+		nni_mtx_lock(&pollq->mtx);
+	}
+	nni_mtx_unlock(&pollq->mtx);
+}
+
+static int
+nni_posix_uring_add(nni_posix_pollq *pq, nni_posix_pollq_node *node)
+{
+	NNI_ASSERT(!nni_list_node_active(&node->node));
+
+	nni_mtx_lock(&pq->mtx);
+	if (pq->close) {
+		// This shouldn't happen!
+		nni_mtx_unlock(&pq->mtx);
+		return (NNG_ECLOSED);
+	}
+	node->pq    = pq;
+	node->index = -1;
+	node->armed = 0;
+	pq->nnodes++;
+	nni_list_append(&pq->nodes, node);
+	nni_mtx_unlock(&pq->mtx);
+	return (0);
+}
+
+static void
+nni_posix_uring_remove(nni_posix_pollq_node *node)
+{
+	nni_posix_pollq *pq = node->pq;
+
+	if (pq == NULL) {
+		return;
+	}
+	nni_mtx_lock(&pq->mtx);
+	while (pq->active == node) {
+		pq->wait = node;
+		nni_cv_wait(&pq->cv);
+	}
+	if (node->index >= 0) {
+		// The slot is released when the completion arrives.
+		pq->slots[node->index].node = NULL;
+		if (node->armed != 0) {
+			nni_posix_uring_cancel(pq, node);
+		}
+		node->index = -1;
+	}
+	if (nni_list_node_active(&node->node)) {
+		nni_list_node_remove(&node->node);
+		pq->nnodes--;
+	}
+	if (pq->close) {
+		nni_cv_wake(&pq->cv);
+	}
+	nni_mtx_unlock(&pq->mtx);
+}
+
+static void
+nni_posix_uring_arm(nni_posix_pollq_node *node, int events)
+{
+	nni_posix_pollq *pq = node->pq;
+
+	if (pq == NULL) {
+		return;
+	}
+
+	nni_mtx_lock(&pq->mtx);
+	node->events |= events;
+	if (node->events == 0) {
+		// Nothing to do.
+	} else if (node->index < 0) {
+		nni_posix_uring_post(pq, node);
+	} else if ((node->armed != 0) &&
+	    (((node->events & ~node->armed) != 0) ||
+	        (pq->slots[node->index].fd != node->fd))) {
+		// The outstanding poll is not enough.  Once it is
+		// canceled, its completion will start a new one.
+		nni_posix_uring_cancel(pq, node);
+	}
+	nni_mtx_unlock(&pq->mtx);
+}
+
+static void
+nni_posix_uring_disarm(nni_posix_pollq_node *node, int events)
+{
+	nni_posix_pollq *pq = node->pq;
+
+	if (pq == NULL) {
+		return;
+	}
+
+	// We leave any outstanding poll alone; if one of these events
+	// shows up anyway, the poller will discard it.
+	nni_mtx_lock(&pq->mtx);
+	node->events &= ~events;
+	nni_mtx_unlock(&pq->mtx);
+}
+
+// nni_posix_uring_detach cancels any outstanding poll, which otherwise
+// keeps the file open in the kernel.  Its slot is kept until the
+// completion arrives, as for a rearm.
+static void
+nni_posix_uring_detach(nni_posix_pollq_node *node)
+{
+	nni_posix_pollq *pq = node->pq;
+
+	if (pq == NULL) {
+		return;
+	}
+
+	nni_mtx_lock(&pq->mtx);
+	node->events = 0;
+	if ((node->index >= 0) && (node->armed != 0)) {
+		nni_posix_uring_cancel(pq, node);
+	}
+	nni_mtx_unlock(&pq->mtx);
+}
+
+// nni_posix_uring_xfer queues a transfer for the node's descriptor.
+static int
+nni_posix_uring_xfer(nni_posix_pollq_node *node, nni_posix_pollq_xfer *x)
+{
+	nni_posix_pollq *    pq = node->pq;
+	struct io_uring_sqe *sqe;
+	int                  slot;
+
+	if (pq == NULL) {
+		return (NNG_ECLOSED);
+	}
+
+	nni_mtx_lock(&pq->mtx);
+	if (pq->close || (node->fd < 0)) {
+		nni_mtx_unlock(&pq->mtx);
+		return (NNG_ECLOSED);
+	}
+	if ((sqe = nni_posix_uring_sqe(pq)) == NULL) {
+		nni_mtx_unlock(&pq->mtx);
+		return (NNG_EAGAIN);
+	}
+	if ((slot = nni_posix_uring_slot_alloc(pq)) < 0) {
+		nni_mtx_unlock(&pq->mtx);
+		return (NNG_ENOMEM);
+	}
+	pq->slots[slot].xfer = x;
+	pq->slots[slot].fd   = node->fd;
+	x->px_index          = slot;
+
+	sqe->opcode    = x->px_write ? IORING_OP_WRITEV : IORING_OP_READV;
+	sqe->fd        = node->fd;
+	sqe->addr      = (uint64_t)(uintptr_t) x->px_iov;
+	sqe->len       = (unsigned) x->px_niov;
+	sqe->user_data = (uint64_t) slot;
+	nni_posix_uring_push(pq);
+	nni_mtx_unlock(&pq->mtx);
+	return (0);
+}
+
+static void
+nni_posix_uring_xfer_cancel(
+    nni_posix_pollq_node *node, nni_posix_pollq_xfer *x)
+{
+	nni_posix_pollq *pq = node->pq;
+
+	if (pq == NULL) {
+		return;
+	}
+
+	nni_mtx_lock(&pq->mtx);
+	if ((x->px_index >= 0) && !pq->slots[x->px_index].cancel) {
+		nni_posix_uring_remove_slot(pq, x->px_index);
+	}
+	nni_mtx_unlock(&pq->mtx);
+}
+
+static void
+nni_posix_uring_destroy(nni_posix_pollq *pq)
+{
+	if (pq->started) {
+		struct io_uring_sqe *sqe;
+
+		// A no-op is enough to wake the poller.  This is no hot
+		// path, so we can wait for the poller to make room.
+		nni_mtx_lock(&pq->mtx);
+		while ((sqe = nni_posix_uring_sqe(pq)) == NULL) {
+			nni_mtx_unlock(&pq->mtx);
+			nni_msleep(1);
+			nni_mtx_lock(&pq->mtx);
+		}
+		pq->close      = 1;
+		pq->started    = 0;
+		sqe->opcode    = IORING_OP_NOP;
+		sqe->user_data = NNI_POSIX_URING_NOSLOT;
+		nni_posix_uring_push(pq);
+		nni_mtx_unlock(&pq->mtx);
+	}
+	nni_thr_fini(&pq->thr);
+
+	// All pipes should have been closed before this is called.
+	NNI_ASSERT(nni_list_empty(&pq->nodes));
+	NNI_ASSERT(pq->nnodes == 0);
+
+	if (pq->sqes != NULL) {
+		(void) munmap(pq->sqes, pq->sqesz);
+	}
+	if (pq->ring != NULL) {
+		(void) munmap(pq->ring, pq->ringsz);
+	}
+	if (pq->ringfd >= 0) {
+		(void) close(pq->ringfd);
+	}
+	if (pq->nslots != 0) {
+		NNI_FREE_STRUCTS(pq->slots, pq->nslots);
+	}
+	nni_cv_fini(&pq->cv);
+	nni_mtx_fini(&pq->mtx);
+	NNI_FREE_STRUCT(pq);
+}
+
+static int
+nni_posix_uring_create(nni_posix_pollq **pqp)
+{
+	nni_posix_pollq *      pq;
+	struct io_uring_params p;
+	char *                 ring;
+	size_t                 sz;
+	size_t                 cqsz;
+	int                    rv;
+
+	if ((pq = NNI_ALLOC_STRUCT(pq)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+
+	NNI_LIST_INIT(&pq->nodes, nni_posix_pollq_node, node);
+	pq->freeslot = -1;
+	pq->close    = 0;
+
+	nni_mtx_init(&pq->mtx);
+	nni_cv_init(&pq->cv, &pq->mtx);
+
+	memset(&p, 0, sizeof(p));
+	if ((pq->ringfd = nni_posix_uring_setup(NNI_POSIX_URING_ENTRIES, &p)) <
+	    0) {
+		rv = (errno == ENOMEM) ? NNG_ENOMEM : NNG_ENOTSUP;
+		nni_posix_uring_destroy(pq);
+		return (rv);
+	}
+
+	// We rely on completions never being dropped, and on the rings
+	// sharing a single mapping, which newer kernels all have.
+	if (((p.features & IORING_FEAT_NODROP) == 0) ||
+	    ((p.features & IORING_FEAT_SINGLE_MMAP) == 0)) {
+		nni_posix_uring_destroy(pq);
+		return (NNG_ENOTSUP);
+	}
+
+	sz   = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cqsz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (sz < cqsz) {
+		sz = cqsz;
+	}
+	ring = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, pq->ringfd, IORING_OFF_SQ_RING);
+	if (ring == MAP_FAILED) {
+		nni_posix_uring_destroy(pq);
+		return (NNG_ENOMEM);
+	}
+	pq->ring   = ring;
+	pq->ringsz = sz;
+
+	sz       = p.sq_entries * sizeof(struct io_uring_sqe);
+	pq->sqes = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, pq->ringfd, IORING_OFF_SQES);
+	if (pq->sqes == MAP_FAILED) {
+		pq->sqes = NULL;
+		nni_posix_uring_destroy(pq);
+		return (NNG_ENOMEM);
+	}
+	pq->sqesz = sz;
+
+	pq->sq_head    = (void *) (ring + p.sq_off.head);
+	pq->sq_tail    = (void *) (ring + p.sq_off.tail);
+	pq->sq_array   = (void *) (ring + p.sq_off.array);
+	pq->sq_mask    = *(unsigned *) (void *) (ring + p.sq_off.ring_mask);
+	pq->sq_entries = p.sq_entries;
+	pq->cq_head    = (void *) (ring + p.cq_off.head);
+	pq->cq_tail    = (void *) (ring + p.cq_off.tail);
+	pq->cq_mask    = *(unsigned *) (void *) (ring + p.cq_off.ring_mask);
+	pq->cqes       = (void *) (ring + p.cq_off.cqes);
+
+	if ((rv = nni_thr_init(&pq->thr, nni_posix_poll_thr, pq)) != 0) {
+		nni_posix_uring_destroy(pq);
+		return (rv);
+	}
+	pq->started = 1;
+	nni_thr_run(&pq->thr);
+	*pqp = pq;
+	return (0);
+}
+
+const nni_posix_pollq_ops nni_posix_pollq_uring_ops = {
+	.pq_create      = nni_posix_uring_create,
+	.pq_destroy     = nni_posix_uring_destroy,
+	.pq_add         = nni_posix_uring_add,
+	.pq_remove      = nni_posix_uring_remove,
+	.pq_detach      = nni_posix_uring_detach,
+	.pq_arm         = nni_posix_uring_arm,
+	.pq_disarm      = nni_posix_uring_disarm,
+	.pq_xfer        = nni_posix_uring_xfer,
+	.pq_xfer_cancel = nni_posix_uring_xfer_cancel,
+};
+
+#endif // NNG_HAVE_IO_URING
@@ -0,0 +1,224 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "core/nng_impl.h"
+
+#ifdef NNG_PLATFORM_POSIX
+
+#ifdef NNG_HAVE_SHM_OPEN
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Shared memory support, using POSIX shared memory objects.  All of our
+// segment names start with this prefix.
+#define NNI_PLAT_SHM_PREFIX "/nng-"
+
+struct nni_plat_shm {
+	char   name[NNI_PLAT_SHM_NAMELEN];
+	void * addr;
+	size_t size;
+	int    linked;
+};
+
+static int
+nni_plat_shm_map(nni_plat_shm *shm, int fd)
+{
+	void *addr;
+
+	addr = mmap(
+	    NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		return (nni_plat_errno(errno));
+	}
+	shm->addr = addr;
+	return (0);
+}
+
+int
+nni_plat_shm_create(nni_plat_shm **shmp, size_t size)
+{
+	nni_plat_shm *shm;
+	int           fd;
+	int           rv;
+
+	if ((shm = NNI_ALLOC_STRUCT(shm)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	shm->size = size;
+
+	// We insist on creating the object ourself, so that nobody else
+	// can have it open already.  The odds of a collision are tiny,
+	// but we try a few times just in case.
+	for (int i = 0;; i++) {
+		(void) snprintf(shm->name, sizeof(shm->name),
+		    NNI_PLAT_SHM_PREFIX "%u-%08x%08x", (unsigned) getpid(),
+		    nni_random(), nni_random());
+		fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0) {
+			break;
+		}
+		if ((errno != EEXIST) || (i >= 8)) {
+			rv = nni_plat_errno(errno);
+			NNI_FREE_STRUCT(shm);
+			return (rv);
+		}
+	}
+
+	if (ftruncate(fd, (off_t) size) != 0) {
+		rv = nni_plat_errno(errno);
+	} else {
+		rv = nni_plat_shm_map(shm, fd);
+	}
+	(void) close(fd);
+	if (rv != 0) {
+		(void) shm_unlink(shm->name);
+		NNI_FREE_STRUCT(shm);
+		return (rv);
+	}
+	shm->linked = 1;
+	*shmp       = shm;
+	return (0);
+}
+
+int
+nni_plat_shm_open(nni_plat_shm **shmp, const char *name, size_t size)
+{
+	nni_plat_shm *shm;
+	struct stat   st;
+	int           fd;
+	int           rv;
+
+	// Only open segments that we could have created, and not some
+	// other object that the peer names.
+	if (strncmp(name, NNI_PLAT_SHM_PREFIX, strlen(NNI_PLAT_SHM_PREFIX)) !=
+	    0) {
+		return (NNG_EINVAL);
+	}
+	if ((shm = NNI_ALLOC_STRUCT(shm)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	shm->size = size;
+	if (nni_strlcpy(shm->name, name, sizeof(shm->name)) >=
+	    sizeof(shm->name)) {
+		NNI_FREE_STRUCT(shm);
+		return (NNG_EINVAL);
+	}
+	if ((fd = shm_open(shm->name, O_RDWR, 0)) < 0) {
+		rv = nni_plat_errno(errno);
+		NNI_FREE_STRUCT(shm);
+		return (rv);
+	}
+
+	// It must have been created by our user, as nni_plat_shm_create
+	// does, so that nobody else can have it mapped.  A segment that is
+	// too short would fault when we touch the end.
+	if (fstat(fd, &st) != 0) {
+		rv = nni_plat_errno(errno);
+	} else if ((st.st_uid != geteuid()) ||
+	    ((st.st_mode & 0777) != 0600)) {
+		rv = NNG_EPERM;
+	} else if ((size_t) st.st_size < size) {
+		rv = NNG_EINVAL;
+	} else {
+		rv = nni_plat_shm_map(shm, fd);
+	}
+	(void) close(fd);
+	if (rv != 0) {
+		NNI_FREE_STRUCT(shm);
+		return (rv);
+	}
+	*shmp = shm;
+	return (0);
+}
+
+const char *
+nni_plat_shm_name(nni_plat_shm *shm)
+{
+	return (shm->name);
+}
+
+void *
+nni_plat_shm_addr(nni_plat_shm *shm)
+{
+	return (shm->addr);
+}
+
+void
+nni_plat_shm_unlink(nni_plat_shm *shm)
+{
+	if (shm->linked) {
+		(void) shm_unlink(shm->name);
+		shm->linked = 0;
+	}
+}
+
+void
+nni_plat_shm_fini(nni_plat_shm *shm)
+{
+	(void) munmap(shm->addr, shm->size);
+	nni_plat_shm_unlink(shm);
+	NNI_FREE_STRUCT(shm);
+}
+
+#else // NNG_HAVE_SHM_OPEN
+
+int
+nni_plat_shm_create(nni_plat_shm **shmp, size_t size)
+{
+	NNI_ARG_UNUSED(shmp);
+	NNI_ARG_UNUSED(size);
+	return (NNG_ENOTSUP);
+}
+
+int
+nni_plat_shm_open(nni_plat_shm **shmp, const char *name, size_t size)
+{
+	NNI_ARG_UNUSED(shmp);
+	NNI_ARG_UNUSED(name);
+	NNI_ARG_UNUSED(size);
+	return (NNG_ENOTSUP);
+}
+
+const char *
+nni_plat_shm_name(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+	return (NULL);
+}
+
+void *
+nni_plat_shm_addr(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+	return (NULL);
+}
+
+void
+nni_plat_shm_unlink(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+}
+
+void
+nni_plat_shm_fini(nni_plat_shm *shm)
+{
+	NNI_ARG_UNUSED(shm);
+}
+
+#endif // NNG_HAVE_SHM_OPEN
+
+#endif // NNG_PLATFORM_POSIX
@@ -105,6 +105,12 @@ nni_plat_tcp_pipe_recv(nni_plat_tcp_pipe *p, nni_aio *aio)
 	nni_posix_pipedesc_recv((void *) p, aio);
 }
 
+int
+nni_plat_tcp_pipe_zerocopy(nni_plat_tcp_pipe *p, size_t zcmin)
+{
+	return (nni_posix_pipedesc_zerocopy((void *) p, zcmin));
+}
+
 int
 nni_plat_tcp_pipe_peername(nni_plat_tcp_pipe *p, nni_sockaddr *sa)
 {
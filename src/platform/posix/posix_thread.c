@@ -38,6 +38,33 @@ pthread_mutexattr_t nni_mxattr;
 int nni_plat_sync_fallback = 0;
 #endif
 
+#ifdef NNG_ADAPTIVE_MUTEX
+// Adaptive mutexes try the lock for a while before sleeping in the
+// kernel.  Our critical sections are short, so the holder of a contended
+// lock, if it is running on another CPU, is likely to release it well
+// before a sleep and wakeup would complete.  As with glibc's adaptive
+// mutexes, each mutex keeps a running average of the spins it took to
+// get the lock, and spins for at most twice that (plus a little) before
+// giving up, so that locks with long hold times stop wasting CPU.
+#ifndef NNI_PLAT_MTX_MAXSPIN
+#define NNI_PLAT_MTX_MAXSPIN 100
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define NNI_PLAT_CPU_RELAX() __builtin_ia32_pause()
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+#define NNI_PLAT_CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define NNI_PLAT_CPU_RELAX()
+#endif
+
+// The spin limit is zero until we are initialized, and on uniprocessors,
+// where spinning cannot help.  The mtx_contend perf program may change it,
+// to compare.
+int nni_plat_mtx_maxspin = 0;
+#endif
+
 enum nni_plat_sync_flags {
 	NNI_PLAT_SYNC_INIT   = 0x01,
 	NNI_PLAT_SYNC_LOCKED = 0x04,
@@ -47,6 +74,12 @@ enum nni_plat_sync_flags {
 void
 nni_plat_mtx_init(nni_plat_mtx *mtx)
 {
+	// Callers may use storage that was not zeroed (e.g. the stack).
+	mtx->fallback = 0;
+	mtx->flags    = 0;
+#ifdef NNG_ADAPTIVE_MUTEX
+	mtx->spins = 0;
+#endif
 	if (pthread_mutex_init(&mtx->mtx, &nni_mxattr) != 0) {
 		mtx->fallback = 1;
 	} else {
@@ -259,13 +292,46 @@ nni_plat_cv_until_fallback(nni_cv *cv, struct timespec *ts)
 	return (rv);
 }
 
+#ifdef NNG_ADAPTIVE_MUTEX
+static void
+nni_plat_mtx_spinlock(nni_plat_mtx *mtx)
+{
+	int max;
+	int cnt;
+
+	if (pthread_mutex_trylock(&mtx->mtx) == 0) {
+		return;
+	}
+
+	// The estimate is only updated while holding the lock, so reading
+	// it here is racy, but that only affects how long we spin.
+	max = mtx->spins * 2 + 10;
+	if (max > nni_plat_mtx_maxspin) {
+		max = nni_plat_mtx_maxspin;
+	}
+	for (cnt = 0; cnt < max; cnt++) {
+		NNI_PLAT_CPU_RELAX();
+		if (pthread_mutex_trylock(&mtx->mtx) == 0) {
+			mtx->spins += (cnt - mtx->spins) / 8;
+			return;
+		}
+	}
+	nni_pthread_mutex_lock(&mtx->mtx);
+	mtx->spins += (cnt - mtx->spins) / 8;
+}
+#endif
+
 void
 nni_plat_mtx_lock(nni_plat_mtx *mtx)
 {
 	int rv;
 
 	if (!mtx->fallback) {
+#ifdef NNG_ADAPTIVE_MUTEX
+		nni_plat_mtx_spinlock(mtx);
+#else
 		nni_pthread_mutex_lock(&mtx->mtx);
+#endif
 
 		// We might have changed to a fallback lock; make
 		// sure this did not occur.  Note that transitions to
@@ -299,6 +365,10 @@ nni_plat_mtx_unlock(nni_plat_mtx *mtx)
 void
 nni_plat_cv_init(nni_plat_cv *cv, nni_plat_mtx *mtx)
 {
+	cv->fallback = 0;
+	cv->flags    = 0;
+	cv->gen      = 0;
+	cv->wake     = 0;
 	if (mtx->fallback || (pthread_cond_init(&cv->cv, &nni_cvattr) != 0)) {
 		cv->fallback = 1;
 	} else {
@@ -422,6 +492,120 @@ nni_plat_thr_fini(nni_plat_thr *thr)
 	}
 }
 
+int
+nni_plat_ncpu(void)
+{
+	long n;
+
+	if ((n = sysconf(_SC_NPROCESSORS_ONLN)) < 1) {
+		return (1);
+	}
+	return ((int) n);
+}
+
+int
+nni_plat_tls_init(nni_plat_tls *tls, void (*fn)(void *))
+{
+	if (pthread_key_create(&tls->key, fn) != 0) {
+		return (NNG_ENOMEM);
+	}
+	return (0);
+}
+
+void *
+nni_plat_tls_get(nni_plat_tls *tls)
+{
+	return (pthread_getspecific(tls->key));
+}
+
+void
+nni_plat_tls_set(nni_plat_tls *tls, void *val)
+{
+	(void) pthread_setspecific(tls->key, val);
+}
+
+// We use the compiler's atomic builtins if we can.  Otherwise we just
+// fall back to a global lock, which is slow, but correct.
+#if defined(__GNUC__) || defined(__clang__)
+
+void
+nni_plat_atomic_init(nni_plat_atomic *a, int v)
+{
+	__atomic_store_n(&a->v, v, __ATOMIC_RELAXED);
+}
+
+int
+nni_plat_atomic_get(nni_plat_atomic *a)
+{
+	return (__atomic_load_n(&a->v, __ATOMIC_ACQUIRE));
+}
+
+void
+nni_plat_atomic_set(nni_plat_atomic *a, int v)
+{
+	__atomic_store_n(&a->v, v, __ATOMIC_RELEASE);
+}
+
+void
+nni_plat_atomic_inc(nni_plat_atomic *a)
+{
+	(void) __atomic_add_fetch(&a->v, 1, __ATOMIC_RELEASE);
+}
+
+int
+nni_plat_atomic_dec(nni_plat_atomic *a)
+{
+	return (__atomic_sub_fetch(&a->v, 1, __ATOMIC_ACQ_REL));
+}
+
+#else
+
+static pthread_mutex_t nni_plat_atomic_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void
+nni_plat_atomic_init(nni_plat_atomic *a, int v)
+{
+	a->v = v;
+}
+
+int
+nni_plat_atomic_get(nni_plat_atomic *a)
+{
+	int v;
+	pthread_mutex_lock(&nni_plat_atomic_lock);
+	v = a->v;
+	pthread_mutex_unlock(&nni_plat_atomic_lock);
+	return (v);
+}
+
+void
+nni_plat_atomic_set(nni_plat_atomic *a, int v)
+{
+	pthread_mutex_lock(&nni_plat_atomic_lock);
+	a->v = v;
+	pthread_mutex_unlock(&nni_plat_atomic_lock);
+}
+
+void
+nni_plat_atomic_inc(nni_plat_atomic *a)
+{
+	pthread_mutex_lock(&nni_plat_atomic_lock);
+	a->v++;
+	pthread_mutex_unlock(&nni_plat_atomic_lock);
+}
+
+int
+nni_plat_atomic_dec(nni_plat_atomic *a)
+{
+	int v;
+	pthread_mutex_lock(&nni_plat_atomic_lock);
+	v = --a->v;
+	pthread_mutex_unlock(&nni_plat_atomic_lock);
+	return (v);
+}
+
+#endif
+
 void
 nni_atfork_child(void)
 {
@@ -466,6 +650,12 @@ nni_plat_init(int (*helper)(void))
 	(void) pthread_mutexattr_settype(
 	    &nni_mxattr, PTHREAD_MUTEX_ERRORCHECK);
 
+#ifdef NNG_ADAPTIVE_MUTEX
+	if (nni_plat_ncpu() > 1) {
+		nni_plat_mtx_maxspin = NNI_PLAT_MTX_MAXSPIN;
+	}
+#endif
+
 	if ((rv = nni_posix_pollq_sysinit()) != 0) {
 		pthread_mutex_unlock(&nni_plat_init_lock);
 		pthread_mutexattr_destroy(&nni_mxattr);
@@ -25,6 +25,11 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#if defined(NNG_HAVE_UDP_SEGMENT) && defined(NNG_HAVE_UDP_GRO)
+#include <netinet/udp.h>
+#define NNI_POSIX_UDP_GSO
+#endif
+
 // UDP support.
 
 // If we can suppress SIGPIPE on send, please do so.
@@ -40,8 +45,89 @@ struct nni_plat_udp {
 	nni_list             udp_recvq;
 	nni_list             udp_sendq;
 	nni_mtx              udp_mtx;
+	int                  udp_segment; // GSO on send, GRO on recv
 };
 
+// Control message storage for the segment size of a send (UDP_SEGMENT)
+// or receive (UDP_GRO).  The union keeps it aligned for cmsghdr.
+typedef union {
+	struct cmsghdr cm;
+#ifdef NNI_POSIX_UDP_GSO
+	char buf[CMSG_SPACE(sizeof(int))];
+#endif
+} nni_posix_udp_ctl;
+
+// nni_posix_udp_sendctl attaches the aio's segment size, if it has one,
+// so that the kernel splits the payload into datagrams of that size.
+static void
+nni_posix_udp_sendctl(
+    struct msghdr *hdr, nni_posix_udp_ctl *ctl, nni_aio *aio)
+{
+	hdr->msg_control    = NULL;
+	hdr->msg_controllen = 0;
+#ifdef NNI_POSIX_UDP_GSO
+	if (aio->a_segsz != 0) {
+		uint16_t        segsz = (uint16_t) aio->a_segsz;
+		struct cmsghdr *cm;
+
+		hdr->msg_control    = ctl->buf;
+		hdr->msg_controllen = CMSG_SPACE(sizeof(segsz));
+		cm                  = CMSG_FIRSTHDR(hdr);
+		cm->cmsg_level      = SOL_UDP;
+		cm->cmsg_type       = UDP_SEGMENT;
+		cm->cmsg_len        = CMSG_LEN(sizeof(segsz));
+		memcpy(CMSG_DATA(cm), &segsz, sizeof(segsz));
+	}
+#else
+	NNI_ARG_UNUSED(ctl);
+	NNI_ARG_UNUSED(aio);
+#endif
+}
+
+// nni_posix_udp_recvctl makes room for a coalesced segment size when the
+// socket has receive offload enabled.
+static void
+nni_posix_udp_recvctl(
+    nni_plat_udp *udp, struct msghdr *hdr, nni_posix_udp_ctl *ctl)
+{
+	hdr->msg_control    = NULL;
+	hdr->msg_controllen = 0;
+#ifdef NNI_POSIX_UDP_GSO
+	if (udp->udp_segment) {
+		hdr->msg_control    = ctl->buf;
+		hdr->msg_controllen = sizeof(ctl->buf);
+	}
+#else
+	NNI_ARG_UNUSED(udp);
+	NNI_ARG_UNUSED(ctl);
+#endif
+}
+
+// nni_posix_udp_segsz returns the size of the datagrams the kernel
+// coalesced into a receive, or zero if it holds just one.
+static size_t
+nni_posix_udp_segsz(struct msghdr *hdr)
+{
+#ifdef NNI_POSIX_UDP_GSO
+	struct cmsghdr *cm;
+
+	if (hdr->msg_controllen == 0) {
+		return (0);
+	}
+	for (cm = CMSG_FIRSTHDR(hdr); cm != NULL; cm = CMSG_NXTHDR(hdr, cm)) {
+		if ((cm->cmsg_level == SOL_UDP) &&
+		    (cm->cmsg_type == UDP_GRO)) {
+			int segsz;
+			memcpy(&segsz, CMSG_DATA(cm), sizeof(segsz));
+			return ((size_t) segsz);
+		}
+	}
+#else
+	NNI_ARG_UNUSED(hdr);
+#endif
+	return (0);
+}
+
 static void
 nni_posix_udp_doclose(nni_plat_udp *udp)
 {
@@ -55,6 +141,151 @@ nni_posix_udp_doclose(nni_plat_udp *udp)
 	// Underlying socket left open until close API called.
 }
 
+#if defined(NNG_HAVE_RECVMMSG) && defined(NNG_HAVE_SENDMMSG)
+
+// With recvmmsg and sendmmsg we move up to this many datagrams, one per
+// queued aio, with a single system call.
+#ifndef NNI_POSIX_UDP_BATCH
+#define NNI_POSIX_UDP_BATCH 32
+#endif
+
+// nni_posix_udp_setiov fills in the iovs for the aio, returning the count.
+static int
+nni_posix_udp_setiov(struct iovec *iov, nni_aio *aio)
+{
+	int niov;
+
+	for (niov = 0; (niov < aio->a_niov) && (niov < NNI_AIO_MAX_IOV);
+	     niov++) {
+		iov[niov].iov_base = aio->a_iov[niov].iov_buf;
+		iov[niov].iov_len  = aio->a_iov[niov].iov_len;
+	}
+	return (niov);
+}
+
+static void
+nni_posix_udp_dorecv(nni_plat_udp *udp)
+{
+	nni_aio *               aio;
+	nni_list *              q = &udp->udp_recvq;
+	struct mmsghdr          mm[NNI_POSIX_UDP_BATCH];
+	struct iovec            iov[NNI_POSIX_UDP_BATCH][NNI_AIO_MAX_IOV];
+	struct sockaddr_storage ss[NNI_POSIX_UDP_BATCH];
+	nni_posix_udp_ctl       ctl[NNI_POSIX_UDP_BATCH];
+
+	// While we're able to recv, do so.
+	while ((aio = nni_list_first(q)) != NULL) {
+		int n;
+		int cnt;
+
+		// Post a receive for every waiting aio, in queue order.
+		for (n = 0; (aio != NULL) && (n < NNI_POSIX_UDP_BATCH);
+		     n++, aio = nni_list_next(q, aio)) {
+			struct msghdr *hdr = &mm[n].msg_hdr;
+
+			memset(hdr, 0, sizeof(*hdr));
+			hdr->msg_iov     = iov[n];
+			hdr->msg_iovlen  = nni_posix_udp_setiov(iov[n], aio);
+			hdr->msg_name    = &ss[n];
+			hdr->msg_namelen = sizeof(ss[n]);
+			nni_posix_udp_recvctl(udp, hdr, &ctl[n]);
+		}
+
+		if ((cnt = recvmmsg(udp->udp_fd, mm, n, 0, NULL)) < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				// No data available at socket.  Leave
+				// the AIOs at the head of the queue.
+				return;
+			}
+			aio = nni_list_first(q);
+			nni_list_remove(q, aio);
+			nni_aio_finish_error(aio, nni_plat_errno(errno));
+			continue;
+		}
+
+		for (int i = 0; i < cnt; i++) {
+			aio = nni_list_first(q);
+			if (aio->a_addr != NULL) {
+				// We need to store the address information.
+				// It is incumbent on the AIO submitter to
+				// supply storage for the address.
+				nni_posix_sockaddr2nn(
+				    aio->a_addr, (void *) &ss[i]);
+			}
+			aio->a_segsz = nni_posix_udp_segsz(&mm[i].msg_hdr);
+			nni_list_remove(q, aio);
+			nni_aio_finish(aio, 0, mm[i].msg_len);
+		}
+		if (cnt < n) {
+			// The socket has been drained.
+			return;
+		}
+	}
+}
+
+static void
+nni_posix_udp_dosend(nni_plat_udp *udp)
+{
+	nni_aio *               aio;
+	nni_list *              q = &udp->udp_sendq;
+	struct mmsghdr          mm[NNI_POSIX_UDP_BATCH];
+	struct iovec            iov[NNI_POSIX_UDP_BATCH][NNI_AIO_MAX_IOV];
+	struct sockaddr_storage ss[NNI_POSIX_UDP_BATCH];
+	nni_posix_udp_ctl       ctl[NNI_POSIX_UDP_BATCH];
+
+	// While we're able to send, do so.
+	while ((aio = nni_list_first(q)) != NULL) {
+		int n;
+		int cnt;
+
+		// Gather waiting aios, stopping at the first one with a bad
+		// address; if that is the first one, fail it now.
+		for (n = 0; (aio != NULL) && (n < NNI_POSIX_UDP_BATCH);
+		     n++, aio = nni_list_next(q, aio)) {
+			struct msghdr *hdr = &mm[n].msg_hdr;
+			int            len;
+
+			len = nni_posix_nn2sockaddr(&ss[n], aio->a_addr);
+			if (len < 0) {
+				break;
+			}
+			memset(hdr, 0, sizeof(*hdr));
+			hdr->msg_iov     = iov[n];
+			hdr->msg_iovlen  = nni_posix_udp_setiov(iov[n], aio);
+			hdr->msg_name    = &ss[n];
+			hdr->msg_namelen = len;
+			nni_posix_udp_sendctl(hdr, &ctl[n], aio);
+		}
+		if (n == 0) {
+			nni_list_remove(q, aio);
+			nni_aio_finish_error(aio, NNG_EADDRINVAL);
+			continue;
+		}
+
+		if ((cnt = sendmmsg(udp->udp_fd, mm, n, NNI_MSG_NOSIGNAL)) <
+		    0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				// Cannot send now, leave at head.
+				return;
+			}
+			aio = nni_list_first(q);
+			nni_list_remove(q, aio);
+			nni_aio_finish_error(aio, nni_plat_errno(errno));
+			continue;
+		}
+
+		// If fewer went than we asked for, the next call reports
+		// why (or sends the rest).
+		for (int i = 0; i < cnt; i++) {
+			aio = nni_list_first(q);
+			nni_list_remove(q, aio);
+			nni_aio_finish(aio, 0, mm[i].msg_len);
+		}
+	}
+}
+
+#else // NNG_HAVE_RECVMMSG && NNG_HAVE_SENDMMSG
+
 static void
 nni_posix_udp_dorecv(nni_plat_udp *udp)
 {
@@ -62,10 +293,11 @@ nni_posix_udp_dorecv(nni_plat_udp *udp)
 	nni_list *q = &udp->udp_recvq;
 	// While we're able to recv, do so.
 	while ((aio = nni_list_first(q)) != NULL) {
-		struct iovec            iov[4]; // never have more than 4
+		struct iovec            iov[NNI_AIO_MAX_IOV];
 		int                     niov;
 		struct sockaddr_storage ss;
 		struct msghdr           hdr;
+		nni_posix_udp_ctl       ctl;
 		int                     rv  = 0;
 		int                     cnt = 0;
 
@@ -73,13 +305,12 @@ nni_posix_udp_dorecv(nni_plat_udp *udp)
 			iov[niov].iov_base = aio->a_iov[niov].iov_buf;
 			iov[niov].iov_len  = aio->a_iov[niov].iov_len;
 		}
-		hdr.msg_iov        = iov;
-		hdr.msg_iovlen     = niov;
-		hdr.msg_name       = &ss;
-		hdr.msg_namelen    = sizeof(ss);
-		hdr.msg_flags      = 0;
-		hdr.msg_control    = NULL;
-		hdr.msg_controllen = 0;
+		hdr.msg_iov     = iov;
+		hdr.msg_iovlen  = niov;
+		hdr.msg_name    = &ss;
+		hdr.msg_namelen = sizeof(ss);
+		hdr.msg_flags   = 0;
+		nni_posix_udp_recvctl(udp, &hdr, &ctl);
 
 		if ((cnt = recvmsg(udp->udp_fd, &hdr, 0)) < 0) {
 			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
@@ -88,11 +319,15 @@ nni_posix_udp_dorecv(nni_plat_udp *udp)
 				return;
 			}
 			rv = nni_plat_errno(errno);
-		} else if (aio->a_addr != NULL) {
-			// We need to store the address information.
-			// It is incumbent on the AIO submitter to supply
-			// storage for the address.
-			nni_posix_sockaddr2nn(aio->a_addr, (void *) &ss);
+		} else {
+			if (aio->a_addr != NULL) {
+				// We need to store the address information.
+				// It is incumbent on the AIO submitter to
+				// supply storage for the address.
+				nni_posix_sockaddr2nn(
+				    aio->a_addr, (void *) &ss);
+			}
+			aio->a_segsz = nni_posix_udp_segsz(&hdr);
 		}
 		nni_list_remove(q, aio);
 		nni_aio_finish(aio, rv, cnt);
@@ -110,7 +345,8 @@ nni_posix_udp_dosend(nni_plat_udp *udp)
 	while ((aio = nni_list_first(q)) != NULL) {
 		struct sockaddr_storage ss;
 		struct msghdr           hdr;
-		struct iovec            iov[4];
+		struct iovec            iov[NNI_AIO_MAX_IOV];
+		nni_posix_udp_ctl       ctl;
 		int                     niov;
 		int                     len;
 		int                     rv  = 0;
@@ -123,13 +359,12 @@ nni_posix_udp_dosend(nni_plat_udp *udp)
 				iov[niov].iov_base = aio->a_iov[niov].iov_buf;
 				iov[niov].iov_len  = aio->a_iov[niov].iov_len;
 			}
-			hdr.msg_iov        = iov;
-			hdr.msg_iovlen     = niov;
-			hdr.msg_name       = &ss;
-			hdr.msg_namelen    = len;
-			hdr.msg_flags      = NNI_MSG_NOSIGNAL;
-			hdr.msg_control    = NULL;
-			hdr.msg_controllen = 0;
+			hdr.msg_iov     = iov;
+			hdr.msg_iovlen  = niov;
+			hdr.msg_name    = &ss;
+			hdr.msg_namelen = len;
+			hdr.msg_flags   = NNI_MSG_NOSIGNAL;
+			nni_posix_udp_sendctl(&hdr, &ctl, aio);
 
 			if ((cnt = sendmsg(udp->udp_fd, &hdr, 0)) < 0) {
 				if ((errno == EAGAIN) ||
@@ -146,6 +381,8 @@ nni_posix_udp_dosend(nni_plat_udp *udp)
 	}
 }
 
+#endif // NNG_HAVE_RECVMMSG && NNG_HAVE_SENDMMSG
+
 // This function is called by the poller on activity on the FD.
 static void
 nni_posix_udp_cb(void *arg)
@@ -279,10 +516,36 @@ nni_plat_udp_send(nni_plat_udp *udp, nni_aio *aio)
 {
 	nni_mtx_lock(&udp->udp_mtx);
 	if (nni_aio_start(aio, nni_plat_udp_cancel, udp) == 0) {
+		if ((aio->a_segsz != 0) && (!udp->udp_segment)) {
+			nni_aio_finish_error(aio, NNG_ENOTSUP);
+			nni_mtx_unlock(&udp->udp_mtx);
+			return;
+		}
 		nni_list_append(&udp->udp_sendq, aio);
 		nni_posix_pollq_arm(&udp->udp_pitem, POLLOUT);
 	}
 	nni_mtx_unlock(&udp->udp_mtx);
 }
 
+int
+nni_plat_udp_segment(nni_plat_udp *udp, int on)
+{
+#ifdef NNI_POSIX_UDP_GSO
+	int val = on ? 1 : 0;
+
+	if (setsockopt(udp->udp_fd, SOL_UDP, UDP_GRO, &val, sizeof(val)) !=
+	    0) {
+		return (nni_plat_errno(errno));
+	}
+	nni_mtx_lock(&udp->udp_mtx);
+	udp->udp_segment = val;
+	nni_mtx_unlock(&udp->udp_mtx);
+	return (0);
+#else
+	NNI_ARG_UNUSED(udp);
+	NNI_ARG_UNUSED(on);
+	return (NNG_ENOTSUP);
+#endif
+}
+
 #endif // NNG_PLATFORM_POSIX
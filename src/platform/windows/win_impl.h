@@ -36,6 +36,15 @@ struct nni_plat_thr {
 	HANDLE handle;
 };
 
+struct nni_plat_tls {
+	DWORD index;
+	void (*func)(void *);
+};
+
+struct nni_plat_atomic {
+	LONG volatile v;
+};
+
 struct nni_plat_mtx {
 	SRWLOCK srl;
 	DWORD   owner;
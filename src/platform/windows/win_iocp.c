@@ -307,4 +307,12 @@ nni_win_iocp_sysfini(void)
 	nni_mtx_fini(&nni_win_iocp_mtx);
 }
 
+// nni_plat_busypoll is a no-op; the completion port threads always
+// block in GetQueuedCompletionStatus.
+void
+nni_plat_busypoll(int usec)
+{
+	NNI_ARG_UNUSED(usec);
+}
+
 #endif // NNG_PLATFORM_WINDOWS
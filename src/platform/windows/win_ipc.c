@@ -163,6 +163,13 @@ nni_plat_ipc_pipe_recv(nni_plat_ipc_pipe *pipe, nni_aio *aio)
 	nni_win_event_submit(&pipe->rcv_ev, aio);
 }
 
+int
+nni_plat_ipc_pipe_sameuser(nni_plat_ipc_pipe *pipe)
+{
+	NNI_ARG_UNUSED(pipe);
+	return (NNG_ENOTSUP);
+}
+
 void
 nni_plat_ipc_pipe_close(nni_plat_ipc_pipe *pipe)
 {
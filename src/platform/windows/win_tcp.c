@@ -101,19 +101,20 @@ nni_win_tcp_pipe_start(nni_win_event *evt, nni_aio *aio)
 {
 	int                rv;
 	SOCKET             s;
-	WSABUF             iov[4];
+	WSABUF             iov[NNI_AIO_MAX_IOV];
 	DWORD              niov;
 	DWORD              flags;
 	nni_plat_tcp_pipe *pipe = evt->ptr;
 	int                i;
 
 	NNI_ASSERT(aio->a_niov > 0);
-	NNI_ASSERT(aio->a_niov <= 4);
 	NNI_ASSERT(aio->a_iov[0].iov_len > 0);
 	NNI_ASSERT(aio->a_iov[0].iov_buf != NULL);
 
-	// Put the AIOs in Windows form.
-	for (niov = 0, i = 0; i < aio->a_niov; i++) {
+	// Put the AIOs in Windows form.  Transports may supply longer
+	// gather lists than we take here; the rest goes in a later call.
+	for (niov = 0, i = 0; (i < aio->a_niov) && (niov < NNI_AIO_MAX_IOV);
+	     i++) {
 		if (aio->a_iov[i].iov_len != 0) {
 			iov[niov].buf = aio->a_iov[i].iov_buf;
 			iov[niov].len = (ULONG) aio->a_iov[i].iov_len;
@@ -225,6 +226,14 @@ nni_plat_tcp_pipe_peername(nni_plat_tcp_pipe *pipe, nni_sockaddr *sa)
 	return (0);
 }
 
+int
+nni_plat_tcp_pipe_zerocopy(nni_plat_tcp_pipe *pipe, size_t zcmin)
+{
+	NNI_ARG_UNUSED(pipe);
+	NNI_ARG_UNUSED(zcmin);
+	return (NNG_ENOTSUP);
+}
+
 int
 nni_plat_tcp_pipe_sockname(nni_plat_tcp_pipe *pipe, nni_sockaddr *sa)
 {
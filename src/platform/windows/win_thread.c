@@ -23,6 +23,12 @@ nni_alloc(size_t sz)
 	return (v);
 }
 
+void *
+nni_alloc_uninit(size_t sz)
+{
+	return (HeapAlloc(GetProcessHeap(), 0, sz));
+}
+
 void
 nni_free(void *b, size_t z)
 {
@@ -138,6 +144,113 @@ nni_plat_thr_fini(nni_plat_thr *thr)
 	}
 }
 
+// Fiber local storage callbacks are only handed the stored value, so we
+// store a small wrapper that remembers which slot (and hence which
+// destructor) the value belongs to.
+typedef struct {
+	nni_plat_tls *tls;
+	void *        val;
+} nni_win_tls_ent;
+
+static VOID WINAPI
+nni_win_tls_cb(PVOID arg)
+{
+	nni_win_tls_ent *ent = arg;
+
+	if (ent == NULL) {
+		return;
+	}
+	if ((ent->val != NULL) && (ent->tls->func != NULL)) {
+		ent->tls->func(ent->val);
+	}
+	HeapFree(GetProcessHeap(), 0, ent);
+}
+
+int
+nni_plat_ncpu(void)
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	if (info.dwNumberOfProcessors < 1) {
+		return (1);
+	}
+	return ((int) info.dwNumberOfProcessors);
+}
+
+int
+nni_plat_tls_init(nni_plat_tls *tls, void (*fn)(void *))
+{
+	tls->func = fn;
+	if ((tls->index = FlsAlloc(nni_win_tls_cb)) == FLS_OUT_OF_INDEXES) {
+		return (NNG_ENOMEM);
+	}
+	return (0);
+}
+
+void *
+nni_plat_tls_get(nni_plat_tls *tls)
+{
+	nni_win_tls_ent *ent;
+
+	if ((ent = FlsGetValue(tls->index)) == NULL) {
+		return (NULL);
+	}
+	return (ent->val);
+}
+
+void
+nni_plat_tls_set(nni_plat_tls *tls, void *val)
+{
+	nni_win_tls_ent *ent;
+
+	if ((ent = FlsGetValue(tls->index)) == NULL) {
+		if (val == NULL) {
+			return;
+		}
+		ent = HeapAlloc(GetProcessHeap(), 0, sizeof(*ent));
+		if (ent == NULL) {
+			return;
+		}
+		ent->tls = tls;
+		if (!FlsSetValue(tls->index, ent)) {
+			HeapFree(GetProcessHeap(), 0, ent);
+			return;
+		}
+	}
+	ent->val = val;
+}
+
+void
+nni_plat_atomic_init(nni_plat_atomic *a, int v)
+{
+	a->v = v;
+}
+
+int
+nni_plat_atomic_get(nni_plat_atomic *a)
+{
+	return ((int) InterlockedCompareExchange(&a->v, 0, 0));
+}
+
+void
+nni_plat_atomic_set(nni_plat_atomic *a, int v)
+{
+	(void) InterlockedExchange(&a->v, v);
+}
+
+void
+nni_plat_atomic_inc(nni_plat_atomic *a)
+{
+	(void) InterlockedIncrement(&a->v);
+}
+
+int
+nni_plat_atomic_dec(nni_plat_atomic *a)
+{
+	return ((int) InterlockedDecrement(&a->v));
+}
+
 static LONG plat_inited = 0;
 
 int
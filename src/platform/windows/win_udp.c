@@ -129,12 +129,22 @@ nni_plat_udp_recv(nni_plat_udp *u, nni_aio *aio)
 	nni_win_event_submit(&u->rxev, aio);
 }
 
+// nni_plat_udp_segment is not supported; Windows has USO and URO, but
+// they are only available on recent releases.
+int
+nni_plat_udp_segment(nni_plat_udp *u, int on)
+{
+	NNI_ARG_UNUSED(u);
+	NNI_ARG_UNUSED(on);
+	return (NNG_ENOTSUP);
+}
+
 static int
 nni_win_udp_start_rx(nni_win_event *evt, nni_aio *aio)
 {
 	int           rv;
 	SOCKET        s;
-	WSABUF        iov[4];
+	WSABUF        iov[NNI_AIO_MAX_IOV];
 	DWORD         niov;
 	DWORD         flags;
 	nni_plat_udp *u = evt->ptr;
@@ -147,7 +157,7 @@ nni_win_udp_start_rx(nni_win_event *evt, nni_aio *aio)
 
 	u->rxsalen = sizeof(SOCKADDR_STORAGE);
 	NNI_ASSERT(aio->a_niov > 0);
-	NNI_ASSERT(aio->a_niov <= 4);
+	NNI_ASSERT(aio->a_niov <= NNI_AIO_MAX_IOV);
 	NNI_ASSERT(aio->a_iov[0].iov_len > 0);
 	NNI_ASSERT(aio->a_iov[0].iov_buf != NULL);
 
@@ -187,7 +197,7 @@ nni_win_udp_start_tx(nni_win_event *evt, nni_aio *aio)
 {
 	int           rv;
 	SOCKET        s;
-	WSABUF        iov[4];
+	WSABUF        iov[NNI_AIO_MAX_IOV];
 	DWORD         niov;
 	nni_plat_udp *u = evt->ptr;
 	int           salen;
@@ -206,7 +216,7 @@ nni_win_udp_start_tx(nni_win_event *evt, nni_aio *aio)
 
 	NNI_ASSERT(aio->a_addr != NULL);
 	NNI_ASSERT(aio->a_niov > 0);
-	NNI_ASSERT(aio->a_niov <= 4);
+	NNI_ASSERT(aio->a_niov <= NNI_AIO_MAX_IOV);
 	NNI_ASSERT(aio->a_iov[0].iov_len > 0);
 	NNI_ASSERT(aio->a_iov[0].iov_buf != NULL);
 
@@ -24,9 +24,7 @@
 typedef struct pair0_pipe pair0_pipe;
 typedef struct pair0_sock pair0_sock;
 
-static void pair0_send_cb(void *);
 static void pair0_recv_cb(void *);
-static void pair0_getq_cb(void *);
 static void pair0_putq_cb(void *);
 static void pair0_pipe_fini(void *);
 
@@ -45,11 +43,10 @@ struct pair0_sock {
 // manage multiple pipes.
 struct pair0_pipe {
 	nni_pipe *  npipe;
-	pair0_sock *psock;
-	nni_aio *   aio_send;
-	nni_aio *   aio_recv;
-	nni_aio *   aio_getq;
-	nni_aio *   aio_putq;
+	pair0_sock *     psock;
+	nni_pipe_sender *sender;
+	nni_aio *        aio_recv;
+	nni_aio *        aio_putq;
 };
 
 static int
@@ -83,10 +80,9 @@ pair0_pipe_fini(void *arg)
 {
 	pair0_pipe *p = arg;
 
-	nni_aio_fini(p->aio_send);
+	nni_pipe_sender_fini(p->sender);
 	nni_aio_fini(p->aio_recv);
 	nni_aio_fini(p->aio_putq);
-	nni_aio_fini(p->aio_getq);
 	NNI_FREE_STRUCT(p);
 }
 
@@ -99,10 +95,10 @@ pair0_pipe_init(void **pp, nni_pipe *npipe, void *psock)
 	if ((p = NNI_ALLOC_STRUCT(p)) == NULL) {
 		return (NNG_ENOMEM);
 	}
-	if (((rv = nni_aio_init(&p->aio_send, pair0_send_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_recv, pair0_recv_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_getq, pair0_getq_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_putq, pair0_putq_cb, p)) != 0)) {
+	if (((rv = nni_aio_init(&p->aio_recv, pair0_recv_cb, p)) != 0) ||
+	    ((rv = nni_aio_init(&p->aio_putq, pair0_putq_cb, p)) != 0) ||
+	    ((rv = nni_pipe_sender_init(&p->sender, npipe, NULL, NULL)) !=
+	        0)) {
 		pair0_pipe_fini(p);
 		return (rv);
 	}
@@ -127,9 +123,8 @@ pair0_pipe_start(void *arg)
 	s->ppipe = p;
 	nni_mtx_unlock(&s->mtx);
 
-	// Schedule a getq on the upper, and a read from the pipe.
-	// Each of these also sets up another hold on the pipe itself.
-	nni_msgq_aio_get(s->uwq, p->aio_getq);
+	// Start taking messages from the upper, and a read from the pipe.
+	nni_pipe_sender_start(p->sender, s->uwq);
 	nni_pipe_recv(p->npipe, p->aio_recv);
 
 	return (0);
@@ -141,10 +136,9 @@ pair0_pipe_stop(void *arg)
 	pair0_pipe *p = arg;
 	pair0_sock *s = p->psock;
 
-	nni_aio_stop(p->aio_send);
+	nni_pipe_sender_stop(p->sender);
 	nni_aio_stop(p->aio_recv);
 	nni_aio_stop(p->aio_putq);
-	nni_aio_stop(p->aio_getq);
 
 	nni_mtx_lock(&s->mtx);
 	if (s->ppipe == p) {
@@ -187,38 +181,6 @@ pair0_putq_cb(void *arg)
 	nni_pipe_recv(p->npipe, p->aio_recv);
 }
 
-static void
-pair0_getq_cb(void *arg)
-{
-	pair0_pipe *p = arg;
-	pair0_sock *s = p->psock;
-
-	if (nni_aio_result(p->aio_getq) != 0) {
-		nni_pipe_stop(p->npipe);
-		return;
-	}
-
-	nni_aio_set_msg(p->aio_send, nni_aio_get_msg(p->aio_getq));
-	nni_aio_set_msg(p->aio_getq, NULL);
-	nni_pipe_send(p->npipe, p->aio_send);
-}
-
-static void
-pair0_send_cb(void *arg)
-{
-	pair0_pipe *p = arg;
-	pair0_sock *s = p->psock;
-
-	if (nni_aio_result(p->aio_send) != 0) {
-		nni_msg_free(nni_aio_get_msg(p->aio_send));
-		nni_aio_set_msg(p->aio_send, NULL);
-		nni_pipe_stop(p->npipe);
-		return;
-	}
-
-	nni_msgq_aio_get(s->uwq, p->aio_getq);
-}
-
 static void
 pair0_sock_open(void *arg)
 {
@@ -27,10 +27,9 @@ typedef struct pair1_pipe pair1_pipe;
 typedef struct pair1_sock pair1_sock;
 
 static void pair1_sock_getq_cb(void *);
-static void pair1_pipe_send_cb(void *);
 static void pair1_pipe_recv_cb(void *);
-static void pair1_pipe_getq_cb(void *);
 static void pair1_pipe_putq_cb(void *);
+static nni_msg *pair1_pipe_prep(void *, nni_msg *);
 static void pair1_pipe_fini(void *);
 
 // pair1_sock is our per-socket protocol private structure.
@@ -49,14 +48,13 @@ struct pair1_sock {
 
 // pair1_pipe is our per-pipe protocol private structure.
 struct pair1_pipe {
-	nni_pipe *    npipe;
-	pair1_sock *  psock;
-	nni_msgq *    sendq;
-	nni_aio *     aio_send;
-	nni_aio *     aio_recv;
-	nni_aio *     aio_getq;
-	nni_aio *     aio_putq;
-	nni_list_node node;
+	nni_pipe *       npipe;
+	pair1_sock *     psock;
+	nni_msgq *       sendq;
+	nni_pipe_sender *sender;
+	nni_aio *        aio_recv;
+	nni_aio *        aio_putq;
+	nni_list_node    node;
 };
 
 static void
@@ -108,10 +106,9 @@ static void
 pair1_pipe_fini(void *arg)
 {
 	pair1_pipe *p = arg;
-	nni_aio_fini(p->aio_send);
+	nni_pipe_sender_fini(p->sender);
 	nni_aio_fini(p->aio_recv);
 	nni_aio_fini(p->aio_putq);
-	nni_aio_fini(p->aio_getq);
 	nni_msgq_fini(p->sendq);
 	NNI_FREE_STRUCT(p);
 }
@@ -126,13 +123,14 @@ pair1_pipe_init(void **pp, nni_pipe *npipe, void *psock)
 		return (NNG_ENOMEM);
 	}
 	if (((rv = nni_msgq_init(&p->sendq, 2)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_send, pair1_pipe_send_cb, p)) != 0) ||
+	    ((rv = nni_pipe_sender_init(
+	          &p->sender, npipe, pair1_pipe_prep, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->aio_recv, pair1_pipe_recv_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_getq, pair1_pipe_getq_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->aio_putq, pair1_pipe_putq_cb, p)) != 0)) {
 		pair1_pipe_fini(p);
 		return (NNG_ENOMEM);
 	}
+	nni_aio_set_inline(p->aio_recv);
 
 	p->npipe = npipe;
 	p->psock = psock;
@@ -170,15 +168,11 @@ pair1_pipe_start(void *arg)
 	s->started = 1;
 	nni_mtx_unlock(&s->mtx);
 
-	// Schedule a getq.  In polyamorous mode we get on the per pipe
+	// Start sending.  In polyamorous mode we get on the per pipe
 	// sendq, as the socket distributes to us. In monogamous mode
 	// we bypass and get from the upper writeq directly (saving a
 	// set of context switches).
-	if (s->poly) {
-		nni_msgq_aio_get(p->sendq, p->aio_getq);
-	} else {
-		nni_msgq_aio_get(s->uwq, p->aio_getq);
-	}
+	nni_pipe_sender_start(p->sender, s->poly ? p->sendq : s->uwq);
 	// And the pipe read of course.
 	nni_pipe_recv(p->npipe, p->aio_recv);
 
@@ -197,10 +191,9 @@ pair1_pipe_stop(void *arg)
 	nni_mtx_unlock(&s->mtx);
 
 	nni_msgq_close(p->sendq);
-	nni_aio_stop(p->aio_send);
+	nni_pipe_sender_stop(p->sender);
 	nni_aio_stop(p->aio_recv);
 	nni_aio_stop(p->aio_putq);
-	nni_aio_stop(p->aio_getq);
 }
 
 static void
@@ -252,7 +245,12 @@ pair1_pipe_recv_cb(void *arg)
 		return;
 	}
 
-	// Send the message up.
+	// Send the message up.  If it can be taken right away, we skip
+	// the asynchronous put and just go back to receiving.
+	if (nni_msgq_tryput(s->urq, msg) == 0) {
+		nni_pipe_recv(npipe, p->aio_recv);
+		return;
+	}
 	nni_aio_set_msg(p->aio_putq, msg);
 	nni_msgq_aio_put(s->urq, p->aio_putq);
 }
@@ -262,46 +260,59 @@ pair1_sock_getq_cb(void *arg)
 {
 	pair1_pipe *p;
 	pair1_sock *s = arg;
-	nni_msg *   msg;
+	nni_msg *   msgs[NNI_MSGQ_BATCH];
 	uint32_t    id;
+	int         nmsgs;
+	int         i;
+	int         n;
+	int         sent;
 
 	if (nni_aio_result(s->aio_getq) != 0) {
 		// Socket closing...
 		return;
 	}
 
-	msg = nni_aio_get_msg(s->aio_getq);
+	msgs[0] = nni_aio_get_msg(s->aio_getq);
 	nni_aio_set_msg(s->aio_getq, NULL);
 
+	// Collect anything else already waiting, so that runs of
+	// messages for the same pipe are handed over together.
+	nmsgs = 1 + nni_msgq_get_batch(s->uwq, &msgs[1], NNI_MSGQ_BATCH - 1);
+
 	// By definition we are in polyamorous mode.
 	NNI_ASSERT(s->poly);
 
-	p = NULL;
 	nni_mtx_lock(&s->mtx);
-	// If no pipe was requested, we look for any connected peer.
-	if (((id = nni_msg_get_pipe(msg)) == 0) &&
-	    (!nni_list_empty(&s->plist))) {
-		p = nni_list_first(&s->plist);
-	} else {
-		nni_idhash_find(s->pipes, id, (void **) &p);
-	}
-	if (p == NULL) {
-		// Pipe not present!
-		nni_mtx_unlock(&s->mtx);
-		nni_msg_free(msg);
-		nni_msgq_aio_get(s->uwq, s->aio_getq);
-		return;
-	}
+	for (i = 0; i < nmsgs; i += n) {
+		id = nni_msg_get_pipe(msgs[i]);
+		for (n = 1; (i + n) < nmsgs; n++) {
+			if (nni_msg_get_pipe(msgs[i + n]) != id) {
+				break;
+			}
+		}
 
-	// Try a non-blocking send.  If this fails we just discard the
-	// message.  We have to do this to avoid head-of-line blocking
-	// for messages sent to other pipes.  Note that there is some
-	// buffering in the sendq.
-	if (nni_msgq_tryput(p->sendq, msg) != 0) {
-		nni_msg_free(msg);
-	}
+		p = NULL;
+		// If no pipe was requested, we look for any connected peer.
+		if ((id == 0) && (!nni_list_empty(&s->plist))) {
+			p = nni_list_first(&s->plist);
+		} else {
+			nni_idhash_find(s->pipes, id, (void **) &p);
+		}
 
+		// Try a non-blocking send.  If this fails we just discard
+		// the messages.  We have to do this to avoid head-of-line
+		// blocking for messages sent to other pipes.  Note that
+		// there is some buffering in the sendq.  (If the pipe is not
+		// present, everything is discarded.)
+		sent = (p != NULL) ? nni_msgq_put_batch(p->sendq, &msgs[i], n)
+		                   : 0;
+		while (sent < n) {
+			nni_msg_free(msgs[i + sent]);
+			sent++;
+		}
+	}
 	nni_mtx_unlock(&s->mtx);
+
 	nni_msgq_aio_get(s->uwq, s->aio_getq);
 }
 
@@ -319,22 +330,15 @@ pair1_pipe_putq_cb(void *arg)
 	nni_pipe_recv(p->npipe, p->aio_recv);
 }
 
-static void
-pair1_pipe_getq_cb(void *arg)
+// pair1_pipe_prep adds the hop count header to a message on its way
+// down to the pipe.
+static nni_msg *
+pair1_pipe_prep(void *arg, nni_msg *msg)
 {
 	pair1_pipe *p = arg;
 	pair1_sock *s = p->psock;
-	nni_msg *   msg;
 	uint32_t    hops;
 
-	if (nni_aio_result(p->aio_getq) != 0) {
-		nni_pipe_stop(p->npipe);
-		return;
-	}
-
-	msg = nni_aio_get_msg(p->aio_getq);
-	nni_aio_set_msg(p->aio_getq, NULL);
-
 	// Raw mode messages have the header already formed, with
 	// a hop count.  Cooked mode messages have no
 	// header so we have to add one.
@@ -356,32 +360,11 @@ pair1_pipe_getq_cb(void *arg)
 	if (nni_msg_header_append_u32(msg, hops) != 0) {
 		goto badmsg;
 	}
-
-	nni_aio_set_msg(p->aio_send, msg);
-	nni_pipe_send(p->npipe, p->aio_send);
-	return;
+	return (msg);
 
 badmsg:
 	nni_msg_free(msg);
-	nni_msgq_aio_get(s->poly ? p->sendq : s->uwq, p->aio_getq);
-}
-
-static void
-pair1_pipe_send_cb(void *arg)
-{
-	pair1_pipe *p = arg;
-	pair1_sock *s = p->psock;
-
-	if (nni_aio_result(p->aio_send) != 0) {
-		nni_msg_free(nni_aio_get_msg(p->aio_send));
-		nni_aio_set_msg(p->aio_send, NULL);
-		nni_pipe_stop(p->npipe);
-		return;
-	}
-
-	// In polyamorous mode, we want to get from the sendq; in
-	// monogamous we get from upper writeq.
-	nni_msgq_aio_get(s->poly ? p->sendq : s->uwq, p->aio_getq);
+	return (NULL);
 }
 
 static void
@@ -91,6 +91,7 @@ pull0_pipe_init(void **pp, nni_pipe *pipe, void *s)
 		pull0_pipe_fini(p);
 		return (rv);
 	}
+	nni_aio_set_inline(p->recv_aio);
 
 	p->pipe = pipe;
 	p->pull = s;
@@ -162,6 +163,14 @@ pull0_putq(pull0_pipe *p, nni_msg *msg)
 {
 	pull0_sock *s = p->pull;
 
+	// If the message can be taken right away, skip the asynchronous
+	// put (and its completion dispatch) and go straight back to
+	// receiving.
+	if (nni_msgq_tryput(s->urq, msg) == 0) {
+		nni_pipe_recv(p->pipe, p->recv_aio);
+		return;
+	}
+
 	nni_aio_set_msg(p->putq_aio, msg);
 
 	nni_msgq_aio_put(s->urq, p->putq_aio);
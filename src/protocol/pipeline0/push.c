@@ -109,6 +109,7 @@ push0_pipe_init(void **pp, nni_pipe *pipe, void *s)
 		push0_pipe_fini(p);
 		return (rv);
 	}
+	nni_aio_set_inline(p->aio_send);
 	NNI_LIST_NODE_INIT(&p->node);
 	p->pipe = pipe;
 	p->push = s;
@@ -167,6 +168,7 @@ push0_send_cb(void *arg)
 {
 	push0_pipe *p = arg;
 	push0_sock *s = p->push;
+	nni_msg *   msg;
 
 	if (nni_aio_result(p->aio_send) != 0) {
 		nni_msg_free(nni_aio_get_msg(p->aio_send));
@@ -175,6 +177,18 @@ push0_send_cb(void *arg)
 		return;
 	}
 
+	// If another message is already queued, take it directly rather
+	// than paying for an asynchronous get and its dispatch.  This never
+	// takes messages while other pipes are waiting, so it does not upset
+	// the round-robin distribution.  (For the same reason we keep just
+	// one send per pipe, rather than using nni_pipe_sender; a pipe
+	// holding several would take messages from the next ready pipe.)
+	if (nni_msgq_get_batch(s->uwq, &msg, 1) == 1) {
+		nni_aio_set_msg(p->aio_send, msg);
+		nni_pipe_send(p->pipe, p->aio_send);
+		return;
+	}
+
 	nni_msgq_aio_get(s->uwq, p->aio_getq);
 }
 
@@ -318,8 +318,13 @@ sub0_sock_filter(void *arg, nni_msg *msg)
 		return (msg);
 	}
 
-	body = nni_msg_body(msg);
-	len  = nni_msg_len(msg);
+	if ((body = nni_msg_body(msg)) == NULL) {
+		// Could not make the body contiguous; treat as no match.
+		nni_mtx_unlock(&s->lk);
+		nni_msg_free(msg);
+		return (NULL);
+	}
+	len = nni_msg_len(msg);
 
 	match = 0;
 	// Check to see if the message matches one of our subscriptions.
@@ -30,9 +30,7 @@ typedef struct rep0_pipe rep0_pipe;
 typedef struct rep0_sock rep0_sock;
 
 static void rep0_sock_getq_cb(void *);
-static void rep0_pipe_getq_cb(void *);
 static void rep0_pipe_putq_cb(void *);
-static void rep0_pipe_send_cb(void *);
 static void rep0_pipe_recv_cb(void *);
 static void rep0_pipe_fini(void *);
 
@@ -51,13 +49,12 @@ struct rep0_sock {
 
 // rep0_pipe is our per-pipe protocol private structure.
 struct rep0_pipe {
-	nni_pipe * pipe;
-	rep0_sock *rep;
-	nni_msgq * sendq;
-	nni_aio *  aio_getq;
-	nni_aio *  aio_send;
-	nni_aio *  aio_recv;
-	nni_aio *  aio_putq;
+	nni_pipe *       pipe;
+	rep0_sock *      rep;
+	nni_msgq *       sendq;
+	nni_pipe_sender *sender;
+	nni_aio *        aio_recv;
+	nni_aio *        aio_putq;
 };
 
 static void
@@ -124,8 +121,7 @@ rep0_pipe_fini(void *arg)
 {
 	rep0_pipe *p = arg;
 
-	nni_aio_fini(p->aio_getq);
-	nni_aio_fini(p->aio_send);
+	nni_pipe_sender_fini(p->sender);
 	nni_aio_fini(p->aio_recv);
 	nni_aio_fini(p->aio_putq);
 	nni_msgq_fini(p->sendq);
@@ -142,8 +138,7 @@ rep0_pipe_init(void **pp, nni_pipe *pipe, void *s)
 		return (NNG_ENOMEM);
 	}
 	if (((rv = nni_msgq_init(&p->sendq, 2)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_getq, rep0_pipe_getq_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_send, rep0_pipe_send_cb, p)) != 0) ||
+	    ((rv = nni_pipe_sender_init(&p->sender, pipe, NULL, NULL)) != 0) ||
 	    ((rv = nni_aio_init(&p->aio_recv, rep0_pipe_recv_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->aio_putq, rep0_pipe_putq_cb, p)) != 0)) {
 		rep0_pipe_fini(p);
@@ -167,7 +162,7 @@ rep0_pipe_start(void *arg)
 		return (rv);
 	}
 
-	nni_msgq_aio_get(p->sendq, p->aio_getq);
+	nni_pipe_sender_start(p->sender, p->sendq);
 	nni_pipe_recv(p->pipe, p->aio_recv);
 	return (0);
 }
@@ -179,8 +174,7 @@ rep0_pipe_stop(void *arg)
 	rep0_sock *s = p->rep;
 
 	nni_msgq_close(p->sendq);
-	nni_aio_stop(p->aio_getq);
-	nni_aio_stop(p->aio_send);
+	nni_pipe_sender_stop(p->sender);
 	nni_aio_stop(p->aio_recv);
 	nni_aio_stop(p->aio_putq);
 
@@ -236,37 +230,6 @@ rep0_sock_getq_cb(void *arg)
 	nni_msgq_aio_get(uwq, s->aio_getq);
 }
 
-static void
-rep0_pipe_getq_cb(void *arg)
-{
-	rep0_pipe *p = arg;
-
-	if (nni_aio_result(p->aio_getq) != 0) {
-		nni_pipe_stop(p->pipe);
-		return;
-	}
-
-	nni_aio_set_msg(p->aio_send, nni_aio_get_msg(p->aio_getq));
-	nni_aio_set_msg(p->aio_getq, NULL);
-
-	nni_pipe_send(p->pipe, p->aio_send);
-}
-
-static void
-rep0_pipe_send_cb(void *arg)
-{
-	rep0_pipe *p = arg;
-
-	if (nni_aio_result(p->aio_send) != 0) {
-		nni_msg_free(nni_aio_get_msg(p->aio_send));
-		nni_aio_set_msg(p->aio_send, NULL);
-		nni_pipe_stop(p->pipe);
-		return;
-	}
-
-	nni_msgq_aio_get(p->sendq, p->aio_getq);
-}
-
 static void
 rep0_pipe_recv_cb(void *arg)
 {
@@ -311,9 +274,12 @@ rep0_pipe_recv_cb(void *arg)
 			nni_pipe_stop(p->pipe);
 			return;
 		}
-		body = nni_msg_body(msg);
-		end  = (body[0] & 0x80) ? 1 : 0;
-		rv   = nni_msg_header_append(msg, body, 4);
+		if ((body = nni_msg_body(msg)) == NULL) {
+			// Out of memory making the body contiguous.
+			goto drop;
+		}
+		end = (body[0] & 0x80) ? 1 : 0;
+		rv  = nni_msg_header_append(msg, body, 4);
 		if (rv != 0) {
 			// Presumably this is due to out of memory.
 			// We could just discard and try again, but we
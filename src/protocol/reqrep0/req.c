@@ -404,6 +404,7 @@ req0_recv_cb(void *arg)
 {
 	req0_pipe *p = arg;
 	nni_msg *  msg;
+	void *     body;
 
 	if (nni_aio_result(p->aio_recv) != 0) {
 		nni_pipe_stop(p->pipe);
@@ -419,7 +420,9 @@ req0_recv_cb(void *arg)
 		// Malformed message.
 		goto malformed;
 	}
-	if (nni_msg_header_append(msg, nni_msg_body(msg), 4) != 0) {
+	// Getting the body can fail if it has to be made contiguous.
+	if (((body = nni_msg_body(msg)) == NULL) ||
+	    (nni_msg_header_append(msg, body, 4) != 0)) {
 		// Arguably we could just discard and carry on.  But
 		// dropping the connection is probably more helpful since
 		// it lets the other side see that a problem occurred.
@@ -476,7 +479,8 @@ req0_resend(req0_sock *s)
 			// mark that we have a message we want to resend,
 			// in case something comes available.
 			s->wantw = 1;
-			nni_timer_schedule(&s->timer, nni_clock() + s->retry);
+			nni_timer_schedule(
+			    &s->timer, nni_clock_coarse() + s->retry);
 			return;
 		}
 
@@ -494,7 +498,7 @@ req0_resend(req0_sock *s)
 		nni_list_append(&s->busypipes, p);
 
 		s->pendpipe = p;
-		s->resend   = nni_clock() + s->retry;
+		s->resend   = nni_clock_coarse() + s->retry;
 		nni_aio_set_msg(p->aio_sendcooked, msg);
 
 		// Note that because we were ready rather than busy, we
@@ -31,8 +31,6 @@ typedef struct resp0_sock resp0_sock;
 
 static void resp0_recv_cb(void *);
 static void resp0_putq_cb(void *);
-static void resp0_getq_cb(void *);
-static void resp0_send_cb(void *);
 static void resp0_sock_getq_cb(void *);
 static void resp0_pipe_fini(void *);
 
@@ -51,14 +49,13 @@ struct resp0_sock {
 
 // resp0_pipe is our per-pipe protocol private structure.
 struct resp0_pipe {
-	nni_pipe *  npipe;
-	resp0_sock *psock;
-	uint32_t    id;
-	nni_msgq *  sendq;
-	nni_aio *   aio_getq;
-	nni_aio *   aio_putq;
-	nni_aio *   aio_send;
-	nni_aio *   aio_recv;
+	nni_pipe *       npipe;
+	resp0_sock *     psock;
+	uint32_t         id;
+	nni_msgq *       sendq;
+	nni_pipe_sender *sender;
+	nni_aio *        aio_putq;
+	nni_aio *        aio_recv;
 };
 
 static void
@@ -125,8 +122,7 @@ resp0_pipe_fini(void *arg)
 	resp0_pipe *p = arg;
 
 	nni_aio_fini(p->aio_putq);
-	nni_aio_fini(p->aio_getq);
-	nni_aio_fini(p->aio_send);
+	nni_pipe_sender_fini(p->sender);
 	nni_aio_fini(p->aio_recv);
 	nni_msgq_fini(p->sendq);
 	NNI_FREE_STRUCT(p);
@@ -144,8 +140,8 @@ resp0_pipe_init(void **pp, nni_pipe *npipe, void *s)
 	if (((rv = nni_msgq_init(&p->sendq, 2)) != 0) ||
 	    ((rv = nni_aio_init(&p->aio_putq, resp0_putq_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->aio_recv, resp0_recv_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_getq, resp0_getq_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_send, resp0_send_cb, p)) != 0)) {
+	    ((rv = nni_pipe_sender_init(&p->sender, npipe, NULL, NULL)) !=
+	        0)) {
 		resp0_pipe_fini(p);
 		return (rv);
 	}
@@ -173,7 +169,7 @@ resp0_pipe_start(void *arg)
 	}
 
 	nni_pipe_recv(p->npipe, p->aio_recv);
-	nni_msgq_aio_get(p->sendq, p->aio_getq);
+	nni_pipe_sender_start(p->sender, p->sendq);
 
 	return (rv);
 }
@@ -186,8 +182,7 @@ resp0_pipe_stop(void *arg)
 
 	nni_msgq_close(p->sendq);
 	nni_aio_stop(p->aio_putq);
-	nni_aio_stop(p->aio_getq);
-	nni_aio_stop(p->aio_send);
+	nni_pipe_sender_stop(p->sender);
 	nni_aio_stop(p->aio_recv);
 
 	if (p->id != 0) {
@@ -241,37 +236,6 @@ resp0_sock_getq_cb(void *arg)
 	nni_mtx_unlock(&s->mtx);
 }
 
-void
-resp0_getq_cb(void *arg)
-{
-	resp0_pipe *p = arg;
-
-	if (nni_aio_result(p->aio_getq) != 0) {
-		nni_pipe_stop(p->npipe);
-		return;
-	}
-
-	nni_aio_set_msg(p->aio_send, nni_aio_get_msg(p->aio_getq));
-	nni_aio_set_msg(p->aio_getq, NULL);
-
-	nni_pipe_send(p->npipe, p->aio_send);
-}
-
-void
-resp0_send_cb(void *arg)
-{
-	resp0_pipe *p = arg;
-
-	if (nni_aio_result(p->aio_send) != 0) {
-		nni_msg_free(nni_aio_get_msg(p->aio_send));
-		nni_aio_set_msg(p->aio_send, NULL);
-		nni_pipe_stop(p->npipe);
-		return;
-	}
-
-	nni_msgq_aio_get(p->sendq, p->aio_getq);
-}
-
 static void
 resp0_recv_cb(void *arg)
 {
@@ -310,9 +274,12 @@ resp0_recv_cb(void *arg)
 			nni_msg_free(msg);
 			goto error;
 		}
-		body = nni_msg_body(msg);
-		end  = (body[0] & 0x80) ? 1 : 0;
-		rv   = nni_msg_header_append(msg, body, 4);
+		if ((body = nni_msg_body(msg)) == NULL) {
+			nni_msg_free(msg);
+			goto error;
+		}
+		end = (body[0] & 0x80) ? 1 : 0;
+		rv  = nni_msg_header_append(msg, body, 4);
 		if (rv != 0) {
 			nni_msg_free(msg);
 			goto error;
@@ -29,9 +29,7 @@ typedef struct surv0_pipe surv0_pipe;
 typedef struct surv0_sock surv0_sock;
 
 static void surv0_sock_getq_cb(void *);
-static void surv0_getq_cb(void *);
 static void surv0_putq_cb(void *);
-static void surv0_send_cb(void *);
 static void surv0_recv_cb(void *);
 static void surv0_timeout(void *);
 
@@ -54,14 +52,13 @@ struct surv0_sock {
 
 // surv0_pipe is our per-pipe protocol private structure.
 struct surv0_pipe {
-	nni_pipe *    npipe;
-	surv0_sock *  psock;
-	nni_msgq *    sendq;
-	nni_list_node node;
-	nni_aio *     aio_getq;
-	nni_aio *     aio_putq;
-	nni_aio *     aio_send;
-	nni_aio *     aio_recv;
+	nni_pipe *       npipe;
+	surv0_sock *     psock;
+	nni_msgq *       sendq;
+	nni_list_node    node;
+	nni_pipe_sender *sender;
+	nni_aio *        aio_putq;
+	nni_aio *        aio_recv;
 };
 
 static void
@@ -126,8 +123,7 @@ surv0_pipe_fini(void *arg)
 {
 	surv0_pipe *p = arg;
 
-	nni_aio_fini(p->aio_getq);
-	nni_aio_fini(p->aio_send);
+	nni_pipe_sender_fini(p->sender);
 	nni_aio_fini(p->aio_recv);
 	nni_aio_fini(p->aio_putq);
 	nni_msgq_fini(p->sendq);
@@ -145,9 +141,9 @@ surv0_pipe_init(void **pp, nni_pipe *npipe, void *s)
 	}
 	// This depth could be tunable.
 	if (((rv = nni_msgq_init(&p->sendq, 16)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_getq, surv0_getq_cb, p)) != 0) ||
+	    ((rv = nni_pipe_sender_init(&p->sender, npipe, NULL, NULL)) !=
+	        0) ||
 	    ((rv = nni_aio_init(&p->aio_putq, surv0_putq_cb, p)) != 0) ||
-	    ((rv = nni_aio_init(&p->aio_send, surv0_send_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->aio_recv, surv0_recv_cb, p)) != 0)) {
 		surv0_pipe_fini(p);
 		return (rv);
@@ -169,7 +165,7 @@ surv0_pipe_start(void *arg)
 	nni_list_append(&s->pipes, p);
 	nni_mtx_unlock(&s->mtx);
 
-	nni_msgq_aio_get(p->sendq, p->aio_getq);
+	nni_pipe_sender_start(p->sender, p->sendq);
 	nni_pipe_recv(p->npipe, p->aio_recv);
 	return (0);
 }
@@ -180,8 +176,7 @@ surv0_pipe_stop(void *arg)
 	surv0_pipe *p = arg;
 	surv0_sock *s = p->psock;
 
-	nni_aio_stop(p->aio_getq);
-	nni_aio_stop(p->aio_send);
+	nni_pipe_sender_stop(p->sender);
 	nni_aio_stop(p->aio_recv);
 	nni_aio_stop(p->aio_putq);
 
@@ -194,37 +189,6 @@ surv0_pipe_stop(void *arg)
 	nni_mtx_unlock(&s->mtx);
 }
 
-static void
-surv0_getq_cb(void *arg)
-{
-	surv0_pipe *p = arg;
-
-	if (nni_aio_result(p->aio_getq) != 0) {
-		nni_pipe_stop(p->npipe);
-		return;
-	}
-
-	nni_aio_set_msg(p->aio_send, nni_aio_get_msg(p->aio_getq));
-	nni_aio_set_msg(p->aio_getq, NULL);
-
-	nni_pipe_send(p->npipe, p->aio_send);
-}
-
-static void
-surv0_send_cb(void *arg)
-{
-	surv0_pipe *p = arg;
-
-	if (nni_aio_result(p->aio_send) != 0) {
-		nni_msg_free(nni_aio_get_msg(p->aio_send));
-		nni_aio_set_msg(p->aio_send, NULL);
-		nni_pipe_stop(p->npipe);
-		return;
-	}
-
-	nni_msgq_aio_get(p->psock->uwq, p->aio_getq);
-}
-
 static void
 surv0_putq_cb(void *arg)
 {
@@ -245,6 +209,7 @@ surv0_recv_cb(void *arg)
 {
 	surv0_pipe *p = arg;
 	nni_msg *   msg;
+	void *      body;
 
 	if (nni_aio_result(p->aio_recv) != 0) {
 		goto failed;
@@ -260,7 +225,8 @@ surv0_recv_cb(void *arg)
 		nni_msg_free(msg);
 		goto failed;
 	}
-	if (nni_msg_header_append(msg, nni_msg_body(msg), 4) != 0) {
+	if (((body = nni_msg_body(msg)) == NULL) ||
+	    (nni_msg_header_append(msg, body, 4) != 0)) {
 		// Should be NNG_ENOMEM
 		nni_msg_free(msg);
 		goto failed;
@@ -360,6 +326,8 @@ surv0_sock_getq_cb(void *arg)
 		// If there were no pipes to send on, just toss the message.
 		nni_msg_free(msg);
 	}
+
+	nni_msgq_aio_get(s->uwq, s->aio_getq);
 }
 
 static void
@@ -420,7 +388,7 @@ surv0_sock_send(void *arg, nni_aio *aio)
 	// If another message is there, this cancels it.  We move the
 	// survey expiration out.  The timeout thread will wake up in
 	// the wake below, and reschedule itself appropriately.
-	s->expire = nni_clock() + s->survtime;
+	s->expire = nni_clock_coarse() + s->survtime;
 	nni_timer_schedule(&s->timer, s->expire);
 
 	nni_mtx_unlock(&s->mtx);
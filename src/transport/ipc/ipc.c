@@ -37,14 +37,14 @@ struct nni_ipc_pipe {
 	size_t  wanttxhead;
 	size_t  wantrxhead;
 
-	nni_aio *user_txaio;
 	nni_aio *user_rxaio;
 	nni_aio *user_negaio;
-	nni_aio *txaio;
 	nni_aio *rxaio;
 	nni_aio *negaio;
 	nni_msg *rxmsg;
 	nni_mtx  mtx;
+
+	nni_tran_batch txb;
 };
 
 struct nni_ipc_ep {
@@ -52,16 +52,21 @@ struct nni_ipc_ep {
 	nni_plat_ipc_ep *iep;
 	uint16_t         proto;
 	size_t           rcvmax;
+	int              sndbatch;
+	size_t           sndbatchsz;
 	nni_aio *        aio;
 	nni_aio *        user_aio;
 	nni_mtx          mtx;
 };
 
-static void nni_ipc_pipe_send_cb(void *);
 static void nni_ipc_pipe_recv_cb(void *);
 static void nni_ipc_pipe_nego_cb(void *);
 static void nni_ipc_ep_cb(void *);
 
+// Every message on the wire starts with its type, which is always 1,
+// followed by the 64-bit length.
+static const uint8_t nni_ipc_msgtype[1] = { 1 };
+
 static int
 nni_ipc_tran_init(void)
 {
@@ -81,17 +86,24 @@ nni_ipc_pipe_close(void *arg)
 	nni_plat_ipc_pipe_close(pipe->ipp);
 }
 
+static void
+nni_ipc_pipe_write(void *arg, nni_aio *aio)
+{
+	nni_ipc_pipe *pipe = arg;
+
+	nni_plat_ipc_pipe_send(pipe->ipp, aio);
+}
+
 static void
 nni_ipc_pipe_fini(void *arg)
 {
 	nni_ipc_pipe *pipe = arg;
 
 	nni_aio_stop(pipe->rxaio);
-	nni_aio_stop(pipe->txaio);
 	nni_aio_stop(pipe->negaio);
+	nni_tran_batch_fini(&pipe->txb);
 
 	nni_aio_fini(pipe->rxaio);
-	nni_aio_fini(pipe->txaio);
 	nni_aio_fini(pipe->negaio);
 	if (pipe->ipp != NULL) {
 		nni_plat_ipc_pipe_fini(pipe->ipp);
@@ -113,12 +125,18 @@ nni_ipc_pipe_init(nni_ipc_pipe **pipep, nni_ipc_ep *ep, void *ipp)
 		return (NNG_ENOMEM);
 	}
 	nni_mtx_init(&p->mtx);
-	if (((rv = nni_aio_init(&p->txaio, nni_ipc_pipe_send_cb, p)) != 0) ||
+	rv = nni_tran_batch_init(&p->txb, ep->sndbatch, ep->sndbatchsz,
+	    nni_ipc_msgtype, sizeof(nni_ipc_msgtype), nni_ipc_pipe_write,
+	    nni_ipc_pipe_close, p);
+	if ((rv != 0) ||
 	    ((rv = nni_aio_init(&p->rxaio, nni_ipc_pipe_recv_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->negaio, nni_ipc_pipe_nego_cb, p)) != 0)) {
 		nni_ipc_pipe_fini(p);
 		return (rv);
 	}
+	// The receive callback just advances the transfer, or hands the
+	// message to the user aio; it never blocks.
+	nni_aio_set_inline(p->rxaio);
 
 	p->proto                    = ep->proto;
 	p->rcvmax                   = ep->rcvmax;
@@ -202,59 +220,6 @@ done:
 	nni_mtx_unlock(&pipe->mtx);
 }
 
-static void
-nni_ipc_pipe_send_cb(void *arg)
-{
-	nni_ipc_pipe *pipe = arg;
-	nni_aio *     aio;
-	nni_aio *     txaio = pipe->txaio;
-	nni_msg *     msg;
-	int           rv;
-	size_t        n;
-
-	nni_mtx_lock(&pipe->mtx);
-	if ((aio = pipe->user_txaio) == NULL) {
-		nni_mtx_unlock(&pipe->mtx);
-		return;
-	}
-
-	if ((rv = nni_aio_result(txaio)) != 0) {
-		pipe->user_txaio = NULL;
-		nni_mtx_unlock(&pipe->mtx);
-		msg = nni_aio_get_msg(aio);
-		nni_aio_set_msg(aio, NULL);
-		nni_msg_free(msg);
-		nni_aio_finish_error(aio, rv);
-		return;
-	}
-
-	n = nni_aio_count(txaio);
-	while (n) {
-		NNI_ASSERT(txaio->a_niov != 0);
-		if (txaio->a_iov[0].iov_len > n) {
-			txaio->a_iov[0].iov_len -= n;
-			txaio->a_iov[0].iov_buf += n;
-			break;
-		}
-		n -= txaio->a_iov[0].iov_len;
-		for (int i = 0; i < txaio->a_niov; i++) {
-			txaio->a_iov[i] = txaio->a_iov[i + 1];
-		}
-		txaio->a_niov--;
-	}
-	if ((txaio->a_niov != 0) && (txaio->a_iov[0].iov_len != 0)) {
-		nni_plat_ipc_pipe_send(pipe->ipp, txaio);
-		nni_mtx_unlock(&pipe->mtx);
-		return;
-	}
-
-	nni_mtx_unlock(&pipe->mtx);
-	msg = nni_aio_get_msg(aio);
-	n   = nni_msg_len(msg);
-	nni_aio_set_msg(aio, NULL);
-	nni_aio_finish(aio, 0, n);
-}
-
 static void
 nni_ipc_pipe_recv_cb(void *arg)
 {
@@ -327,8 +292,10 @@ nni_ipc_pipe_recv_cb(void *arg)
 		// allocation.  We could possibly look at using a separate
 		// lock for the read side in the future, so that we allow
 		// transmits to proceed normally.  In practice this is
-		// unlikely to be much of an issue though.
-		if ((rv = nng_msg_alloc(&pipe->rxmsg, (size_t) len)) != 0) {
+		// unlikely to be much of an issue though.  The body is about
+		// to be overwritten by the read, so we do not zero it.
+		rv = nni_msg_alloc_uninit(&pipe->rxmsg, (size_t) len);
+		if (rv != 0) {
 			goto recv_error;
 		}
 
@@ -365,63 +332,20 @@ recv_error:
 }
 
 static void
-nni_ipc_cancel_tx(nni_aio *aio, int rv)
+nni_ipc_pipe_send(void *arg, nni_aio *aio)
 {
-	nni_ipc_pipe *pipe = aio->a_prov_data;
-
-	nni_mtx_lock(&pipe->mtx);
-	if (pipe->user_txaio != aio) {
-		nni_mtx_unlock(&pipe->mtx);
-		return;
-	}
-	pipe->user_txaio = NULL;
-	nni_mtx_unlock(&pipe->mtx);
+	nni_ipc_pipe *pipe = arg;
 
-	nni_aio_cancel(pipe->txaio, rv);
-	nni_aio_finish_error(aio, rv);
+	nni_tran_batch_send(&pipe->txb, aio);
 }
 
-static void
-nni_ipc_pipe_send(void *arg, nni_aio *aio)
+static int
+nni_ipc_pipe_send_depth(void *arg)
 {
 	nni_ipc_pipe *pipe = arg;
-	nni_msg *     msg  = nni_aio_get_msg(aio);
-	uint64_t      len;
-	nni_aio *     txaio;
-	int           niov;
-
-	len = nni_msg_len(msg) + nni_msg_header_len(msg);
-
-	nni_mtx_lock(&pipe->mtx);
-	if (nni_aio_start(aio, nni_ipc_cancel_tx, pipe) != 0) {
-		nni_mtx_unlock(&pipe->mtx);
-		return;
-	}
-
-	pipe->user_txaio = aio;
-
-	pipe->txhead[0] = 1; // message type, 1.
-	NNI_PUT64(pipe->txhead + 1, len);
 
-	txaio                      = pipe->txaio;
-	niov                       = 0;
-	txaio->a_iov[niov].iov_buf = pipe->txhead;
-	txaio->a_iov[niov].iov_len = sizeof(pipe->txhead);
-	niov++;
-	if (nni_msg_header_len(msg) > 0) {
-		txaio->a_iov[niov].iov_buf = nni_msg_header(msg);
-		txaio->a_iov[niov].iov_len = nni_msg_header_len(msg);
-		niov++;
-	}
-	if (nni_msg_len(msg) > 0) {
-		txaio->a_iov[niov].iov_buf = nni_msg_body(msg);
-		txaio->a_iov[niov].iov_len = nni_msg_len(msg);
-		niov++;
-	}
-	txaio->a_niov = niov;
-
-	nni_plat_ipc_pipe_send(pipe->ipp, txaio);
-	nni_mtx_unlock(&pipe->mtx);
+	// Every send that can join the next write is worth having queued.
+	return (pipe->txb.tb_maxmsgs);
 }
 
 static void
@@ -559,7 +483,9 @@ nni_ipc_ep_init(void **epp, const char *url, nni_sock *sock, int mode)
 	nni_mtx_init(&ep->mtx);
 	nni_aio_init(&ep->aio, nni_ipc_ep_cb, ep);
 
-	ep->proto = nni_sock_proto(sock);
+	ep->proto      = nni_sock_proto(sock);
+	ep->sndbatch   = NNI_TRAN_SENDBATCH;
+	ep->sndbatchsz = NNI_TRAN_SENDBATCHSZ;
 
 	*epp = ep;
 	return (0);
@@ -713,6 +639,43 @@ nni_ipc_ep_getopt_recvmaxsz(void *arg, void *data, size_t *szp)
 	return (nni_getopt_size(ep->rcvmax, data, szp));
 }
 
+static int
+nni_ipc_ep_setopt_sendbatch(void *arg, const void *data, size_t sz)
+{
+	nni_ipc_ep *ep = arg;
+
+	if (ep == NULL) {
+		return (nni_chkopt_int(data, sz, 1, NNI_TRAN_SENDBATCH_MAX));
+	}
+	return (nni_setopt_int(
+	    &ep->sndbatch, data, sz, 1, NNI_TRAN_SENDBATCH_MAX));
+}
+
+static int
+nni_ipc_ep_getopt_sendbatch(void *arg, void *data, size_t *szp)
+{
+	nni_ipc_ep *ep = arg;
+	return (nni_getopt_int(ep->sndbatch, data, szp));
+}
+
+static int
+nni_ipc_ep_setopt_sendbatchsz(void *arg, const void *data, size_t sz)
+{
+	nni_ipc_ep *ep = arg;
+
+	if (ep == NULL) {
+		return (nni_chkopt_size(data, sz, 0, NNI_MAXSZ));
+	}
+	return (nni_setopt_size(&ep->sndbatchsz, data, sz, 0, NNI_MAXSZ));
+}
+
+static int
+nni_ipc_ep_getopt_sendbatchsz(void *arg, void *data, size_t *szp)
+{
+	nni_ipc_ep *ep = arg;
+	return (nni_getopt_size(ep->sndbatchsz, data, szp));
+}
+
 static int
 nni_ipc_ep_get_addr(void *arg, void *data, size_t *szp)
 {
@@ -728,13 +691,14 @@ static nni_tran_pipe_option nni_ipc_pipe_options[] = {
 };
 
 static nni_tran_pipe nni_ipc_pipe_ops = {
-	.p_fini    = nni_ipc_pipe_fini,
-	.p_start   = nni_ipc_pipe_start,
-	.p_send    = nni_ipc_pipe_send,
-	.p_recv    = nni_ipc_pipe_recv,
-	.p_close   = nni_ipc_pipe_close,
-	.p_peer    = nni_ipc_pipe_peer,
-	.p_options = nni_ipc_pipe_options,
+	.p_fini       = nni_ipc_pipe_fini,
+	.p_start      = nni_ipc_pipe_start,
+	.p_send       = nni_ipc_pipe_send,
+	.p_send_depth = nni_ipc_pipe_send_depth,
+	.p_recv       = nni_ipc_pipe_recv,
+	.p_close      = nni_ipc_pipe_close,
+	.p_peer       = nni_ipc_pipe_peer,
+	.p_options    = nni_ipc_pipe_options,
 };
 
 static nni_tran_ep_option nni_ipc_ep_options[] = {
@@ -743,6 +707,16 @@ static nni_tran_ep_option nni_ipc_ep_options[] = {
 	    .eo_getopt = nni_ipc_ep_getopt_recvmaxsz,
 	    .eo_setopt = nni_ipc_ep_setopt_recvmaxsz,
 	},
+	{
+	    .eo_name   = NNG_OPT_SENDBATCH,
+	    .eo_getopt = nni_ipc_ep_getopt_sendbatch,
+	    .eo_setopt = nni_ipc_ep_setopt_sendbatch,
+	},
+	{
+	    .eo_name   = NNG_OPT_SENDBATCHSZ,
+	    .eo_getopt = nni_ipc_ep_getopt_sendbatchsz,
+	    .eo_setopt = nni_ipc_ep_setopt_sendbatchsz,
+	},
 	{
 	    .eo_name   = NNG_OPT_LOCADDR,
 	    .eo_getopt = nni_ipc_ep_get_addr,
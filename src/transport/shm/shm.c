@@ -0,0 +1,1212 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/nng_impl.h"
+
+// Shared memory transport.  Peers on the same host connect over IPC,
+// exactly as the IPC transport does, but after the SP header exchange
+// the listener creates a shared memory segment holding a pair of rings,
+// one for each direction, and hands its name to the dialer.  Messages
+// are then copied through the rings, and the IPC connection is only used
+// to wake a peer that is waiting for data or for room, and to notice when
+// the peer goes away.
+//
+// The wakeups could instead be eventfds, passed over the connection with
+// SCM_RIGHTS and polled like any other descriptor.  We use a one byte
+// write on the connection itself for these reasons.  First, eventfd and
+// futex are only on Linux, while this transport builds wherever shm_open
+// does.  Second, the connection must be watched anyway, since an eventfd
+// does not tell us when the peer process exits; one descriptor per pipe
+// covers both jobs.  Third, nni_plat_ipc_pipe only moves bytes, and has
+// no way to pass descriptors.  A wakeup costs one system call either way,
+// and is only sent when the peer has said it is about to sleep.
+//
+// Each ring is a byte stream.  Every message is an 8 byte length in
+// network byte order, followed by the header and body.  Messages larger
+// than the ring are simply streamed through it.
+
+typedef struct nni_shm_pipe nni_shm_pipe;
+typedef struct nni_shm_ep   nni_shm_ep;
+
+// NNI_SHM_RINGSZ is the size of each ring.  It must be a power of two.
+#define NNI_SHM_RINGSZ (256 * 1024)
+#define NNI_SHM_RINGMIN 4096
+#define NNI_SHM_RINGMAX (64 * 1024 * 1024)
+
+#define NNI_SHM_MAGIC "NNGSHM1"
+
+// The setup record, sent by the listener after the SP header, holds the
+// ring size and the name of the segment.
+#define NNI_SHM_SETUPSZ (8 + NNI_PLAT_SHM_NAMELEN)
+
+// A ring is owned by its producer, which advances the head, and its
+// consumer, which advances the tail.  Both are free running byte counts,
+// so the amount of data in the ring is head - tail.  A consumer that
+// finds the ring empty sets wantdata before it sleeps, and a producer
+// that finds it full sets wantroom; whoever clears the flag of the other
+// side must wake it.  The two sides are kept on separate cache lines.
+typedef struct {
+	uint32_t r_head;
+	uint32_t r_wantroom;
+	uint8_t  r_pad1[56];
+	uint32_t r_tail;
+	uint32_t r_wantdata;
+	uint8_t  r_pad2[56];
+} nni_shm_ring;
+
+// The segment starts with this header.  The ring data follows, listener
+// to dialer first.
+typedef struct {
+	char         s_magic[8];
+	uint32_t     s_ringsz;
+	uint8_t      s_pad[52];
+	nni_shm_ring s_rings[2];
+} nni_shm_hdr;
+
+enum nni_shm_negstep {
+	NNI_SHM_NEG_HELLO,
+	NNI_SHM_NEG_SETUP,
+	NNI_SHM_NEG_ACK,
+};
+
+// nni_shm_pipe is one end of a shared memory connection.
+struct nni_shm_pipe {
+	nni_plat_ipc_pipe *ipp;
+	nni_plat_shm *     shm;
+	uint16_t           peer;
+	uint16_t           proto;
+	size_t             rcvmax;
+	int                listener;
+	nng_sockaddr       sa;
+	int                err;
+	int                closed;
+
+	nni_shm_ring *txr;
+	nni_shm_ring *rxr;
+	uint8_t *     txbuf;
+	uint8_t *     rxbuf;
+	uint32_t      ringsz;
+
+	uint8_t txhead[8];
+	uint8_t rxhead[8];
+	uint8_t txsetup[NNI_SHM_SETUPSZ];
+	uint8_t rxsetup[NNI_SHM_SETUPSZ];
+	uint8_t ack;
+	int     negstep;
+	int     negsend;
+	nni_iov negiov[2];
+
+	nni_aio *user_txaio;
+	nni_aio *user_rxaio;
+	nni_aio *user_negaio;
+	nni_aio *negaio;
+	nni_aio *bellaio;
+	nni_aio *kickaio;
+	nni_mtx  mtx;
+
+	// Doorbells.  The peer's arrive on bellaio, and ours go out on
+	// kickaio, one at a time.  A kick that is needed while one is
+	// already in flight is sent when that one finishes.
+	uint8_t bellbuf[64];
+	uint8_t kickbuf[1];
+	int     kickbusy;
+	int     kickpend;
+
+	// Send side.  The message stays with the user aio, and txiov
+	// describes the part not yet copied into the ring.
+	uint32_t txpos;
+	uint8_t  txlen[sizeof(uint64_t)];
+	nni_iov  txiov[NNI_AIO_MAX_IOV];
+	nni_iov *txiovp;
+	int      ntxiov;
+	size_t   txsent;
+
+	// Receive side.  A message that is partly copied out of the ring
+	// is kept here, even if the user gives up waiting for it.
+	uint32_t rxpos;
+	uint8_t  rxlen[sizeof(uint64_t)];
+	size_t   gotrxlen;
+	size_t   gotrx;
+	nni_msg *rxmsg;
+};
+
+struct nni_shm_ep {
+	nni_sockaddr     sa;
+	nni_plat_ipc_ep *iep;
+	uint16_t         proto;
+	size_t           rcvmax;
+	int              mode;
+	nni_aio *        aio;
+	nni_aio *        user_aio;
+	nni_mtx          mtx;
+};
+
+static void nni_shm_pipe_nego_cb(void *);
+static void nni_shm_pipe_bell_cb(void *);
+static void nni_shm_pipe_kick_cb(void *);
+static void nni_shm_ep_cb(void *);
+
+static int
+nni_shm_tran_init(void)
+{
+	return (0);
+}
+
+static void
+nni_shm_tran_fini(void)
+{
+}
+
+// nni_shm_pipe_fail marks the connection as broken.  The peer may not be
+// able to make sense of the rings any more, so we also hang up on it.
+// The caller holds the pipe lock.
+static void
+nni_shm_pipe_fail(nni_shm_pipe *p, int rv)
+{
+	if (p->err == 0) {
+		p->err = rv;
+	}
+	nni_plat_ipc_pipe_close(p->ipp);
+}
+
+static void
+nni_shm_pipe_close(void *arg)
+{
+	nni_shm_pipe *p = arg;
+
+	nni_mtx_lock(&p->mtx);
+	p->closed = 1;
+	nni_shm_pipe_fail(p, NNG_ECLOSED);
+	nni_mtx_unlock(&p->mtx);
+}
+
+static void
+nni_shm_pipe_fini(void *arg)
+{
+	nni_shm_pipe *p = arg;
+
+	nni_aio_stop(p->negaio);
+	nni_aio_stop(p->bellaio);
+	nni_aio_stop(p->kickaio);
+
+	nni_aio_fini(p->negaio);
+	nni_aio_fini(p->bellaio);
+	nni_aio_fini(p->kickaio);
+	if (p->ipp != NULL) {
+		nni_plat_ipc_pipe_fini(p->ipp);
+	}
+	if (p->shm != NULL) {
+		nni_plat_shm_fini(p->shm);
+	}
+	if (p->rxmsg != NULL) {
+		nni_msg_free(p->rxmsg);
+	}
+	nni_mtx_fini(&p->mtx);
+	NNI_FREE_STRUCT(p);
+}
+
+static int
+nni_shm_pipe_init(nni_shm_pipe **pipep, nni_shm_ep *ep, void *ipp)
+{
+	nni_shm_pipe *p;
+	int           rv;
+
+	if ((p = NNI_ALLOC_STRUCT(p)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+	nni_mtx_init(&p->mtx);
+	if (((rv = nni_aio_init(&p->negaio, nni_shm_pipe_nego_cb, p)) != 0) ||
+	    ((rv = nni_aio_init(&p->bellaio, nni_shm_pipe_bell_cb, p)) != 0) ||
+	    ((rv = nni_aio_init(&p->kickaio, nni_shm_pipe_kick_cb, p)) != 0)) {
+		nni_shm_pipe_fini(p);
+		return (rv);
+	}
+	// The doorbell callbacks just move data through the rings; they
+	// never block.
+	nni_aio_set_inline(p->bellaio);
+	nni_aio_set_inline(p->kickaio);
+
+	p->proto    = ep->proto;
+	p->rcvmax   = ep->rcvmax;
+	p->ipp      = ipp;
+	p->listener = (ep->mode == NNI_EP_MODE_LISTEN);
+	p->sa       = ep->sa;
+
+	*pipep = p;
+	return (0);
+}
+
+// nni_shm_pipe_kick wakes the peer.  The caller holds the pipe lock.
+static void
+nni_shm_pipe_kick(nni_shm_pipe *p)
+{
+	nni_aio *aio = p->kickaio;
+
+	if (p->kickbusy) {
+		p->kickpend = 1;
+		return;
+	}
+	p->kickbusy           = 1;
+	p->kickbuf[0]         = 1;
+	aio->a_niov           = 1;
+	aio->a_iov[0].iov_buf = p->kickbuf;
+	aio->a_iov[0].iov_len = sizeof(p->kickbuf);
+	nni_plat_ipc_pipe_send(p->ipp, aio);
+}
+
+static void
+nni_shm_pipe_kick_cb(void *arg)
+{
+	nni_shm_pipe *p = arg;
+
+	nni_mtx_lock(&p->mtx);
+	p->kickbusy = 0;
+	if (nni_aio_result(p->kickaio) != 0) {
+		// The doorbell will see the error too, and clean up.
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	if (p->kickpend) {
+		p->kickpend = 0;
+		nni_shm_pipe_kick(p);
+	}
+	nni_mtx_unlock(&p->mtx);
+}
+
+static void
+nni_shm_ring_put(nni_shm_pipe *p, uint32_t pos, const uint8_t *src, size_t n)
+{
+	size_t off = pos & (p->ringsz - 1);
+	size_t n1  = p->ringsz - off;
+
+	if (n1 > n) {
+		n1 = n;
+	}
+	memcpy(p->txbuf + off, src, n1);
+	memcpy(p->txbuf, src + n1, n - n1);
+}
+
+static void
+nni_shm_ring_get(nni_shm_pipe *p, uint32_t pos, uint8_t *dst, size_t n)
+{
+	size_t off = pos & (p->ringsz - 1);
+	size_t n1  = p->ringsz - off;
+
+	if (n1 > n) {
+		n1 = n;
+	}
+	memcpy(dst, p->rxbuf + off, n1);
+	memcpy(dst + n1, p->rxbuf, n - n1);
+}
+
+// nni_shm_pipe_txcopy copies as much of the message being sent into the
+// ring as will fit.  It returns 0 once all of it is there, or NNG_EAGAIN
+// if the ring filled up first; in that case the consumer will wake us
+// when it makes room.  The caller holds the pipe lock.
+static int
+nni_shm_pipe_txcopy(nni_shm_pipe *p)
+{
+	nni_shm_ring *r = p->txr;
+	uint32_t      tail;
+	uint32_t      room;
+	uint32_t      start;
+
+	tail = __atomic_load_n(&r->r_tail, __ATOMIC_SEQ_CST);
+	for (;;) {
+		// The peer could scribble on the ring, so check it.
+		if ((p->txpos - tail) > p->ringsz) {
+			return (NNG_EPROTO);
+		}
+		room  = p->ringsz - (p->txpos - tail);
+		start = p->txpos;
+		while ((room > 0) && (p->ntxiov > 0)) {
+			nni_iov *iov = p->txiovp;
+			size_t   n   = iov->iov_len;
+
+			if (n > room) {
+				n = room;
+			}
+			nni_shm_ring_put(p, p->txpos, iov->iov_buf, n);
+			p->txpos += (uint32_t) n;
+			p->txsent += n;
+			room -= (uint32_t) n;
+			iov->iov_buf += n;
+			iov->iov_len -= n;
+			if (iov->iov_len == 0) {
+				p->txiovp++;
+				p->ntxiov--;
+			}
+		}
+
+		if (p->txpos != start) {
+			__atomic_store_n(
+			    &r->r_head, p->txpos, __ATOMIC_SEQ_CST);
+			if (__atomic_exchange_n(
+			        &r->r_wantdata, 0, __ATOMIC_SEQ_CST)) {
+				nni_shm_pipe_kick(p);
+			}
+		}
+		if (p->ntxiov == 0) {
+			return (0);
+		}
+
+		// The ring is full.  Ask to be woken, and then look again,
+		// in case the consumer made room before it saw our request.
+		__atomic_store_n(&r->r_wantroom, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&r->r_tail, __ATOMIC_SEQ_CST) == tail) {
+			return (NNG_EAGAIN);
+		}
+		__atomic_store_n(&r->r_wantroom, 0, __ATOMIC_SEQ_CST);
+		tail = __atomic_load_n(&r->r_tail, __ATOMIC_SEQ_CST);
+	}
+}
+
+// nni_shm_pipe_rxcopy copies data out of the ring into the message being
+// received.  It returns 0 once the message is complete, or NNG_EAGAIN if
+// the ring ran dry first; in that case the producer will wake us when it
+// adds more.  The caller holds the pipe lock.
+static int
+nni_shm_pipe_rxcopy(nni_shm_pipe *p)
+{
+	nni_shm_ring *r = p->rxr;
+	uint32_t      head;
+	uint32_t      avail;
+	uint32_t      start;
+	size_t        n;
+	int           rv;
+
+	head = __atomic_load_n(&r->r_head, __ATOMIC_SEQ_CST);
+	for (;;) {
+		if ((head - p->rxpos) > p->ringsz) {
+			return (NNG_EPROTO);
+		}
+		avail = head - p->rxpos;
+		start = p->rxpos;
+
+		if ((p->rxmsg == NULL) && (avail > 0)) {
+			uint64_t len;
+
+			n = sizeof(p->rxlen) - p->gotrxlen;
+			if (n > avail) {
+				n = avail;
+			}
+			nni_shm_ring_get(
+			    p, p->rxpos, p->rxlen + p->gotrxlen, n);
+			p->rxpos += (uint32_t) n;
+			p->gotrxlen += n;
+			avail -= (uint32_t) n;
+
+			if (p->gotrxlen == sizeof(p->rxlen)) {
+				NNI_GET64(p->rxlen, len);
+				// Make sure the message payload is not too
+				// big.  If it is the caller will shut down
+				// the pipe.
+				if (len > p->rcvmax) {
+					return (NNG_EMSGSIZE);
+				}
+				// The body is about to be overwritten from the
+				// ring, so we do not zero it.
+				rv = nni_msg_alloc_uninit(
+				    &p->rxmsg, (size_t) len);
+				if (rv != 0) {
+					return (rv);
+				}
+				p->gotrx = 0;
+			}
+		}
+		if ((p->rxmsg != NULL) && (avail > 0)) {
+			n = nni_msg_len(p->rxmsg) - p->gotrx;
+			if (n > avail) {
+				n = avail;
+			}
+			nni_shm_ring_get(p, p->rxpos,
+			    (uint8_t *) nni_msg_body(p->rxmsg) + p->gotrx, n);
+			p->rxpos += (uint32_t) n;
+			p->gotrx += n;
+		}
+
+		if (p->rxpos != start) {
+			__atomic_store_n(
+			    &r->r_tail, p->rxpos, __ATOMIC_SEQ_CST);
+			if (__atomic_exchange_n(
+			        &r->r_wantroom, 0, __ATOMIC_SEQ_CST)) {
+				nni_shm_pipe_kick(p);
+			}
+		}
+		if ((p->rxmsg != NULL) &&
+		    (p->gotrx == nni_msg_len(p->rxmsg))) {
+			return (0);
+		}
+		if (p->rxpos != head) {
+			// More of this message (its length, at least) is
+			// already in the ring.
+			continue;
+		}
+
+		// The ring is empty.  Ask to be woken, and then look again,
+		// in case the producer added data before it saw our request.
+		__atomic_store_n(&r->r_wantdata, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&r->r_head, __ATOMIC_SEQ_CST) == head) {
+			return (NNG_EAGAIN);
+		}
+		__atomic_store_n(&r->r_wantdata, 0, __ATOMIC_SEQ_CST);
+		head = __atomic_load_n(&r->r_head, __ATOMIC_SEQ_CST);
+	}
+}
+
+// nni_shm_pipe_dosend advances the pending send, if any.  If it is done,
+// one way or the other, the user aio is detached and returned, with the
+// result, to be completed once the caller drops the pipe lock.
+static nni_aio *
+nni_shm_pipe_dosend(nni_shm_pipe *p, int *rvp)
+{
+	nni_aio *aio;
+	int      rv;
+
+	if ((aio = p->user_txaio) == NULL) {
+		return (NULL);
+	}
+	if ((rv = p->err) == 0) {
+		if ((rv = nni_shm_pipe_txcopy(p)) == NNG_EAGAIN) {
+			return (NULL);
+		}
+		if (rv != 0) {
+			nni_shm_pipe_fail(p, rv);
+		}
+	}
+	p->user_txaio = NULL;
+	*rvp          = rv;
+	return (aio);
+}
+
+static void
+nni_shm_pipe_send_done(nni_aio *aio, int rv)
+{
+	nni_msg *msg;
+	size_t   n;
+
+	if (rv != 0) {
+		nni_aio_finish_error(aio, rv);
+		return;
+	}
+	msg = nni_aio_get_msg(aio);
+	n   = nni_msg_len(msg);
+	nni_aio_set_msg(aio, NULL);
+	nni_msg_free(msg);
+	nni_aio_finish(aio, 0, n);
+}
+
+// nni_shm_pipe_dorecv is the receive side counterpart of dosend.  On
+// success, the received message is returned as well.  Messages that the
+// peer sent before it went away can still be received, until we close.
+static nni_aio *
+nni_shm_pipe_dorecv(nni_shm_pipe *p, nni_msg **msgp, int *rvp)
+{
+	nni_aio *aio;
+	int      rv;
+
+	if ((aio = p->user_rxaio) == NULL) {
+		return (NULL);
+	}
+	if (((rv = p->err) == 0) || !p->closed) {
+		rv = nni_shm_pipe_rxcopy(p);
+		if ((rv == NNG_EAGAIN) && (p->err != 0)) {
+			rv = p->err;
+		}
+		if (rv == NNG_EAGAIN) {
+			return (NULL);
+		}
+		if (rv != 0) {
+			nni_shm_pipe_fail(p, rv);
+		}
+	}
+	p->user_rxaio = NULL;
+	if (rv == 0) {
+		*msgp       = p->rxmsg;
+		p->rxmsg    = NULL;
+		p->gotrxlen = 0;
+	}
+	*rvp = rv;
+	return (aio);
+}
+
+static void
+nni_shm_pipe_recv_done(nni_aio *aio, nni_msg *msg, int rv)
+{
+	if (rv != 0) {
+		nni_aio_finish_error(aio, rv);
+		return;
+	}
+	nni_aio_finish_msg(aio, msg);
+}
+
+static void
+nni_shm_pipe_bell(nni_shm_pipe *p)
+{
+	nni_aio *aio = p->bellaio;
+
+	aio->a_niov           = 1;
+	aio->a_iov[0].iov_buf = p->bellbuf;
+	aio->a_iov[0].iov_len = sizeof(p->bellbuf);
+	nni_plat_ipc_pipe_recv(p->ipp, aio);
+}
+
+static void
+nni_shm_pipe_bell_cb(void *arg)
+{
+	nni_shm_pipe *p = arg;
+	nni_aio *     txaio;
+	nni_aio *     rxaio;
+	nni_msg *     msg = NULL;
+	int           txrv;
+	int           rxrv;
+	int           rv;
+
+	// We do not care what the peer sent; any doorbell just means
+	// that one of the rings has changed.
+	nni_mtx_lock(&p->mtx);
+	if ((rv = nni_aio_result(p->bellaio)) != 0) {
+		nni_shm_pipe_fail(p, rv);
+	}
+	txaio = nni_shm_pipe_dosend(p, &txrv);
+	rxaio = nni_shm_pipe_dorecv(p, &msg, &rxrv);
+	if (p->err == 0) {
+		nni_shm_pipe_bell(p);
+	}
+	nni_mtx_unlock(&p->mtx);
+
+	if (txaio != NULL) {
+		nni_shm_pipe_send_done(txaio, txrv);
+	}
+	if (rxaio != NULL) {
+		nni_shm_pipe_recv_done(rxaio, msg, rxrv);
+	}
+}
+
+static void
+nni_shm_cancel_tx(nni_aio *aio, int rv)
+{
+	nni_shm_pipe *p = aio->a_prov_data;
+
+	nni_mtx_lock(&p->mtx);
+	if (p->user_txaio != aio) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	p->user_txaio = NULL;
+
+	// If part of the message is in the ring already, the peer expects
+	// the rest, which we can no longer give it.
+	if (p->txsent != 0) {
+		nni_shm_pipe_fail(p, rv);
+	}
+	nni_mtx_unlock(&p->mtx);
+
+	nni_aio_finish_error(aio, rv);
+}
+
+static void
+nni_shm_pipe_send(void *arg, nni_aio *aio)
+{
+	nni_shm_pipe *p   = arg;
+	nni_msg *     msg = nni_aio_get_msg(aio);
+	uint64_t      len;
+	int           niov;
+	int           n;
+	int           rv;
+
+	nni_mtx_lock(&p->mtx);
+	if (nni_aio_start(aio, nni_shm_cancel_tx, p) != 0) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+
+	len = nni_msg_len(msg) + nni_msg_header_len(msg);
+	NNI_PUT64(p->txlen, len);
+	niov                = 0;
+	p->txiov[0].iov_buf = p->txlen;
+	p->txiov[0].iov_len = sizeof(p->txlen);
+	niov++;
+	if (nni_msg_header_len(msg) > 0) {
+		p->txiov[niov].iov_buf = nni_msg_header(msg);
+		p->txiov[niov].iov_len = nni_msg_header_len(msg);
+		niov++;
+	}
+	n = NNI_AIO_MAX_IOV - niov;
+	if ((rv = nni_msg_body_iov(msg, &p->txiov[niov], &n)) != 0) {
+		nni_mtx_unlock(&p->mtx);
+		nni_aio_finish_error(aio, rv);
+		return;
+	}
+	p->txiovp     = p->txiov;
+	p->ntxiov     = niov + n;
+	p->txsent     = 0;
+	p->user_txaio = aio;
+
+	// Usually the whole message fits, and we are done right away.
+	aio = nni_shm_pipe_dosend(p, &rv);
+	nni_mtx_unlock(&p->mtx);
+
+	if (aio != NULL) {
+		nni_shm_pipe_send_done(aio, rv);
+	}
+}
+
+static void
+nni_shm_cancel_rx(nni_aio *aio, int rv)
+{
+	nni_shm_pipe *p = aio->a_prov_data;
+
+	nni_mtx_lock(&p->mtx);
+	if (p->user_rxaio != aio) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	p->user_rxaio = NULL;
+	nni_mtx_unlock(&p->mtx);
+
+	nni_aio_finish_error(aio, rv);
+}
+
+static void
+nni_shm_pipe_recv(void *arg, nni_aio *aio)
+{
+	nni_shm_pipe *p   = arg;
+	nni_msg *     msg = NULL;
+	int           rv;
+
+	nni_mtx_lock(&p->mtx);
+	if (nni_aio_start(aio, nni_shm_cancel_rx, p) != 0) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	p->user_rxaio = aio;
+
+	aio = nni_shm_pipe_dorecv(p, &msg, &rv);
+	nni_mtx_unlock(&p->mtx);
+
+	if (aio != NULL) {
+		nni_shm_pipe_recv_done(aio, msg, rv);
+	}
+}
+
+// nni_shm_pipe_rings points our rings into the segment.  The listener
+// sends on the first ring, and the dialer on the second.
+static void
+nni_shm_pipe_rings(nni_shm_pipe *p, uint32_t ringsz)
+{
+	nni_shm_hdr *hdr  = nni_plat_shm_addr(p->shm);
+	uint8_t *    data = (uint8_t *) (hdr + 1);
+	int          tx   = p->listener ? 0 : 1;
+
+	p->ringsz = ringsz;
+	p->txr    = &hdr->s_rings[tx];
+	p->rxr    = &hdr->s_rings[1 - tx];
+	p->txbuf  = data + (tx * ringsz);
+	p->rxbuf  = data + ((1 - tx) * ringsz);
+}
+
+// nni_shm_pipe_create is used by the listener to set up the segment, and
+// the setup record describing it.
+static int
+nni_shm_pipe_create(nni_shm_pipe *p)
+{
+	nni_shm_hdr *hdr;
+	size_t       sz = sizeof(nni_shm_hdr) + 2 * NNI_SHM_RINGSZ;
+	int          rv;
+
+	if ((rv = nni_plat_shm_create(&p->shm, sz)) != 0) {
+		return (rv);
+	}
+	hdr = nni_plat_shm_addr(p->shm);
+	memcpy(hdr->s_magic, NNI_SHM_MAGIC, sizeof(hdr->s_magic));
+	hdr->s_ringsz = NNI_SHM_RINGSZ;
+	nni_shm_pipe_rings(p, NNI_SHM_RINGSZ);
+
+	memset(p->txsetup, 0, sizeof(p->txsetup));
+	NNI_PUT32(&p->txsetup[0], NNI_SHM_RINGSZ);
+	(void) nni_strlcpy((char *) &p->txsetup[8], nni_plat_shm_name(p->shm),
+	    NNI_PLAT_SHM_NAMELEN);
+	return (0);
+}
+
+// nni_shm_pipe_attach is used by the dialer to map the segment described
+// by the setup record the listener sent.
+static int
+nni_shm_pipe_attach(nni_shm_pipe *p)
+{
+	nni_shm_hdr *hdr;
+	uint32_t     ringsz;
+	char *       name = (char *) &p->rxsetup[8];
+	int          rv;
+
+	NNI_GET32(&p->rxsetup[0], ringsz);
+	if ((ringsz < NNI_SHM_RINGMIN) || (ringsz > NNI_SHM_RINGMAX) ||
+	    ((ringsz & (ringsz - 1)) != 0) ||
+	    (name[NNI_PLAT_SHM_NAMELEN - 1] != '\0')) {
+		return (NNG_EPROTO);
+	}
+	rv = nni_plat_shm_open(
+	    &p->shm, name, sizeof(nni_shm_hdr) + 2 * (size_t) ringsz);
+	if (rv != 0) {
+		return (rv);
+	}
+	hdr = nni_plat_shm_addr(p->shm);
+	if ((memcmp(hdr->s_magic, NNI_SHM_MAGIC, sizeof(hdr->s_magic)) != 0) ||
+	    (hdr->s_ringsz != ringsz)) {
+		return (NNG_EPROTO);
+	}
+	nni_shm_pipe_rings(p, ringsz);
+	return (0);
+}
+
+// nni_shm_pipe_nego starts the next transfer of the negotiation.  The
+// caller holds the pipe lock.
+static void
+nni_shm_pipe_nego(nni_shm_pipe *p, int send, int niov)
+{
+	nni_aio *aio = p->negaio;
+
+	p->negsend  = send;
+	aio->a_iov  = p->negiov;
+	aio->a_niov = niov;
+	if (send) {
+		nni_plat_ipc_pipe_send(p->ipp, aio);
+	} else {
+		nni_plat_ipc_pipe_recv(p->ipp, aio);
+	}
+}
+
+static void
+nni_shm_cancel_start(nni_aio *aio, int rv)
+{
+	nni_shm_pipe *p = aio->a_prov_data;
+
+	nni_mtx_lock(&p->mtx);
+	if (p->user_negaio != aio) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	p->user_negaio = NULL;
+	nni_mtx_unlock(&p->mtx);
+
+	nni_aio_cancel(p->negaio, rv);
+	nni_aio_finish_error(aio, rv);
+}
+
+// The negotiation starts with the usual SP header exchange.  The
+// listener sends the setup record along with its header, and waits for
+// the dialer to acknowledge that it has mapped the segment, after which
+// the name is no longer needed.
+static void
+nni_shm_pipe_nego_cb(void *arg)
+{
+	nni_shm_pipe *p   = arg;
+	nni_aio *     aio = p->negaio;
+	size_t        n;
+	int           rv;
+
+	nni_mtx_lock(&p->mtx);
+	if ((rv = nni_aio_result(aio)) != 0) {
+		goto done;
+	}
+
+	n = nni_aio_count(aio);
+	while (n) {
+		NNI_ASSERT(aio->a_niov != 0);
+		if (aio->a_iov[0].iov_len > n) {
+			aio->a_iov[0].iov_len -= n;
+			aio->a_iov[0].iov_buf += n;
+			break;
+		}
+		n -= aio->a_iov[0].iov_len;
+		aio->a_iov++;
+		aio->a_niov--;
+	}
+	if ((aio->a_niov != 0) && (aio->a_iov[0].iov_len != 0)) {
+		if (p->negsend) {
+			nni_plat_ipc_pipe_send(p->ipp, aio);
+		} else {
+			nni_plat_ipc_pipe_recv(p->ipp, aio);
+		}
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+
+	switch (p->negstep) {
+	case NNI_SHM_NEG_HELLO:
+		p->negstep           = NNI_SHM_NEG_SETUP;
+		p->negiov[0].iov_buf = p->rxhead;
+		p->negiov[0].iov_len = sizeof(p->rxhead);
+		p->negiov[1].iov_buf = p->rxsetup;
+		p->negiov[1].iov_len = sizeof(p->rxsetup);
+		nni_shm_pipe_nego(p, 0, p->listener ? 1 : 2);
+		nni_mtx_unlock(&p->mtx);
+		return;
+
+	case NNI_SHM_NEG_SETUP:
+		if ((p->rxhead[0] != 0) || (p->rxhead[1] != 'S') ||
+		    (p->rxhead[2] != 'P') || (p->rxhead[3] != 0) ||
+		    (p->rxhead[6] != 0) || (p->rxhead[7] != 0)) {
+			rv = NNG_EPROTO;
+			goto done;
+		}
+		NNI_GET16(&p->rxhead[4], p->peer);
+		if ((!p->listener) && ((rv = nni_shm_pipe_attach(p)) != 0)) {
+			goto done;
+		}
+		p->negstep           = NNI_SHM_NEG_ACK;
+		p->ack               = p->listener ? 0 : 1;
+		p->negiov[0].iov_buf = &p->ack;
+		p->negiov[0].iov_len = sizeof(p->ack);
+		nni_shm_pipe_nego(p, !p->listener, 1);
+		nni_mtx_unlock(&p->mtx);
+		return;
+
+	case NNI_SHM_NEG_ACK:
+		if (p->ack != 1) {
+			rv = NNG_EPROTO;
+			goto done;
+		}
+		if (p->listener) {
+			nni_plat_shm_unlink(p->shm);
+		}
+		break;
+	}
+
+	// From here on the IPC connection just carries doorbells.
+	nni_shm_pipe_bell(p);
+
+done:
+	if ((aio = p->user_negaio) != NULL) {
+		p->user_negaio = NULL;
+		nni_aio_finish(aio, rv, 0);
+	}
+	nni_mtx_unlock(&p->mtx);
+}
+
+static void
+nni_shm_pipe_start(void *arg, nni_aio *aio)
+{
+	nni_shm_pipe *p = arg;
+	int           rv;
+
+	nni_mtx_lock(&p->mtx);
+	p->txhead[0] = 0;
+	p->txhead[1] = 'S';
+	p->txhead[2] = 'P';
+	p->txhead[3] = 0;
+	NNI_PUT16(&p->txhead[4], p->proto);
+	NNI_PUT16(&p->txhead[6], 0);
+
+	if (nni_aio_start(aio, nni_shm_cancel_start, p) != 0) {
+		nni_mtx_unlock(&p->mtx);
+		return;
+	}
+	// The segment name is as good as access to our memory, so it is
+	// only given to, or taken from, a peer running as the same user.
+	if (((rv = nni_plat_ipc_pipe_sameuser(p->ipp)) != 0) ||
+	    (p->listener && ((rv = nni_shm_pipe_create(p)) != 0))) {
+		nni_mtx_unlock(&p->mtx);
+		nni_aio_finish_error(aio, rv);
+		return;
+	}
+
+	p->user_negaio       = aio;
+	p->negstep           = NNI_SHM_NEG_HELLO;
+	p->negiov[0].iov_buf = p->txhead;
+	p->negiov[0].iov_len = sizeof(p->txhead);
+	p->negiov[1].iov_buf = p->txsetup;
+	p->negiov[1].iov_len = sizeof(p->txsetup);
+	nni_shm_pipe_nego(p, 1, p->listener ? 2 : 1);
+	nni_mtx_unlock(&p->mtx);
+}
+
+static uint16_t
+nni_shm_pipe_peer(void *arg)
+{
+	nni_shm_pipe *p = arg;
+
+	return (p->peer);
+}
+
+static int
+nni_shm_pipe_get_addr(void *arg, void *buf, size_t *szp)
+{
+	nni_shm_pipe *p = arg;
+	return (nni_getopt_sockaddr(&p->sa, buf, szp));
+}
+
+static void
+nni_shm_ep_fini(void *arg)
+{
+	nni_shm_ep *ep = arg;
+
+	nni_aio_stop(ep->aio);
+	nni_plat_ipc_ep_fini(ep->iep);
+	nni_aio_fini(ep->aio);
+	nni_mtx_fini(&ep->mtx);
+	NNI_FREE_STRUCT(ep);
+}
+
+static int
+nni_shm_ep_init(void **epp, const char *url, nni_sock *sock, int mode)
+{
+	nni_shm_ep *ep;
+	int         rv;
+	size_t      sz;
+
+	if (strncmp(url, "shm://", strlen("shm://")) != 0) {
+		return (NNG_EADDRINVAL);
+	}
+	url += strlen("shm://");
+
+	if ((ep = NNI_ALLOC_STRUCT(ep)) == NULL) {
+		return (NNG_ENOMEM);
+	}
+
+	sz                           = sizeof(ep->sa.s_un.s_path.sa_path);
+	ep->sa.s_un.s_path.sa_family = NNG_AF_IPC;
+
+	if (nni_strlcpy(ep->sa.s_un.s_path.sa_path, url, sz) >= sz) {
+		NNI_FREE_STRUCT(ep);
+		return (NNG_EADDRINVAL);
+	}
+
+	if ((rv = nni_plat_ipc_ep_init(&ep->iep, &ep->sa, mode)) != 0) {
+		NNI_FREE_STRUCT(ep);
+		return (rv);
+	}
+
+	nni_mtx_init(&ep->mtx);
+	nni_aio_init(&ep->aio, nni_shm_ep_cb, ep);
+
+	ep->proto = nni_sock_proto(sock);
+	ep->mode  = mode;
+
+	*epp = ep;
+	return (0);
+}
+
+static void
+nni_shm_ep_close(void *arg)
+{
+	nni_shm_ep *ep = arg;
+
+	nni_mtx_lock(&ep->mtx);
+	nni_plat_ipc_ep_close(ep->iep);
+	nni_mtx_unlock(&ep->mtx);
+
+	nni_aio_stop(ep->aio);
+}
+
+static int
+nni_shm_ep_bind(void *arg)
+{
+	nni_shm_ep *ep = arg;
+	int         rv;
+
+	nni_mtx_lock(&ep->mtx);
+	rv = nni_plat_ipc_ep_listen(ep->iep);
+	nni_mtx_unlock(&ep->mtx);
+	return (rv);
+}
+
+static void
+nni_shm_ep_finish(nni_shm_ep *ep)
+{
+	nni_aio *     aio;
+	int           rv;
+	nni_shm_pipe *pipe = NULL;
+
+	if ((rv = nni_aio_result(ep->aio)) != 0) {
+		goto done;
+	}
+	NNI_ASSERT(nni_aio_get_pipe(ep->aio) != NULL);
+
+	// Attempt to allocate the parent pipe.  If this fails we'll
+	// drop the connection (ENOMEM probably).
+	rv = nni_shm_pipe_init(&pipe, ep, nni_aio_get_pipe(ep->aio));
+
+done:
+	nni_aio_set_pipe(ep->aio, NULL);
+	aio          = ep->user_aio;
+	ep->user_aio = NULL;
+
+	if ((aio != NULL) && (rv == 0)) {
+		NNI_ASSERT(pipe != NULL);
+		nni_aio_finish_pipe(aio, pipe);
+		return;
+	}
+
+	if (pipe != NULL) {
+		nni_shm_pipe_fini(pipe);
+	}
+	if (aio != NULL) {
+		NNI_ASSERT(rv != 0);
+		nni_aio_finish_error(aio, rv);
+	}
+}
+
+static void
+nni_shm_ep_cb(void *arg)
+{
+	nni_shm_ep *ep = arg;
+
+	nni_mtx_lock(&ep->mtx);
+	nni_shm_ep_finish(ep);
+	nni_mtx_unlock(&ep->mtx);
+}
+
+static void
+nni_shm_cancel_ep(nni_aio *aio, int rv)
+{
+	nni_shm_ep *ep = aio->a_prov_data;
+
+	NNI_ASSERT(rv != 0);
+	nni_mtx_lock(&ep->mtx);
+	if (ep->user_aio != aio) {
+		nni_mtx_unlock(&ep->mtx);
+		return;
+	}
+	ep->user_aio = NULL;
+	nni_mtx_unlock(&ep->mtx);
+
+	nni_aio_cancel(ep->aio, rv);
+	nni_aio_finish_error(aio, rv);
+}
+
+static void
+nni_shm_ep_accept(void *arg, nni_aio *aio)
+{
+	nni_shm_ep *ep = arg;
+	int         rv;
+
+	nni_mtx_lock(&ep->mtx);
+	NNI_ASSERT(ep->user_aio == NULL);
+
+	if ((rv = nni_aio_start(aio, nni_shm_cancel_ep, ep)) != 0) {
+		nni_mtx_unlock(&ep->mtx);
+		return;
+	}
+
+	ep->user_aio = aio;
+
+	nni_plat_ipc_ep_accept(ep->iep, ep->aio);
+	nni_mtx_unlock(&ep->mtx);
+}
+
+static void
+nni_shm_ep_connect(void *arg, nni_aio *aio)
+{
+	nni_shm_ep *ep = arg;
+	int         rv;
+
+	nni_mtx_lock(&ep->mtx);
+	NNI_ASSERT(ep->user_aio == NULL);
+
+	// If we can't start, then its dying and we can't report
+	// either.
+	if ((rv = nni_aio_start(aio, nni_shm_cancel_ep, ep)) != 0) {
+		nni_mtx_unlock(&ep->mtx);
+		return;
+	}
+
+	ep->user_aio = aio;
+
+	nni_plat_ipc_ep_connect(ep->iep, ep->aio);
+	nni_mtx_unlock(&ep->mtx);
+}
+
+static int
+nni_shm_ep_setopt_recvmaxsz(void *arg, const void *data, size_t sz)
+{
+	nni_shm_ep *ep = arg;
+
+	if (ep == NULL) {
+		return (nni_chkopt_size(data, sz, 0, NNI_MAXSZ));
+	}
+	return (nni_setopt_size(&ep->rcvmax, data, sz, 0, NNI_MAXSZ));
+}
+
+static int
+nni_shm_ep_getopt_recvmaxsz(void *arg, void *data, size_t *szp)
+{
+	nni_shm_ep *ep = arg;
+	return (nni_getopt_size(ep->rcvmax, data, szp));
+}
+
+static int
+nni_shm_ep_get_addr(void *arg, void *data, size_t *szp)
+{
+	nni_shm_ep *ep = arg;
+	return (nni_getopt_sockaddr(&ep->sa, data, szp));
+}
+
+static nni_tran_pipe_option nni_shm_pipe_options[] = {
+	{ NNG_OPT_REMADDR, nni_shm_pipe_get_addr },
+	{ NNG_OPT_LOCADDR, nni_shm_pipe_get_addr },
+	// terminate list
+	{ NULL, NULL },
+};
+
+static nni_tran_pipe nni_shm_pipe_ops = {
+	.p_fini    = nni_shm_pipe_fini,
+	.p_start   = nni_shm_pipe_start,
+	.p_send    = nni_shm_pipe_send,
+	.p_recv    = nni_shm_pipe_recv,
+	.p_close   = nni_shm_pipe_close,
+	.p_peer    = nni_shm_pipe_peer,
+	.p_options = nni_shm_pipe_options,
+};
+
+static nni_tran_ep_option nni_shm_ep_options[] = {
+	{
+	    .eo_name   = NNG_OPT_RECVMAXSZ,
+	    .eo_getopt = nni_shm_ep_getopt_recvmaxsz,
+	    .eo_setopt = nni_shm_ep_setopt_recvmaxsz,
+	},
+	{
+	    .eo_name   = NNG_OPT_LOCADDR,
+	    .eo_getopt = nni_shm_ep_get_addr,
+	    .eo_setopt = NULL,
+	},
+	// terminate list
+	{ NULL, NULL, NULL },
+};
+
+static nni_tran_ep nni_shm_ep_ops = {
+	.ep_init    = nni_shm_ep_init,
+	.ep_fini    = nni_shm_ep_fini,
+	.ep_connect = nni_shm_ep_connect,
+	.ep_bind    = nni_shm_ep_bind,
+	.ep_accept  = nni_shm_ep_accept,
+	.ep_close   = nni_shm_ep_close,
+	.ep_options = nni_shm_ep_options,
+};
+
+static nni_tran nni_shm_tran = {
+	.tran_version = NNI_TRANSPORT_VERSION,
+	.tran_scheme  = "shm",
+	.tran_ep      = &nni_shm_ep_ops,
+	.tran_pipe    = &nni_shm_pipe_ops,
+	.tran_init    = nni_shm_tran_init,
+	.tran_fini    = nni_shm_tran_fini,
+};
+
+int
+nng_shm_register(void)
+{
+	return (nni_tran_register(&nni_shm_tran));
+}
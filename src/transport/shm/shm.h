@@ -0,0 +1,20 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#ifndef NNG_TRANSPORT_SHM_SHM_H
+#define NNG_TRANSPORT_SHM_SHM_H
+
+// shm transport.  This is used for communication between processes on
+// the same host computer, through rings in shared memory.  An IPC
+// connection is used to set up the rings, and to wake the peer.
+
+NNG_DECL int nng_shm_register(void);
+
+#endif // NNG_TRANSPORT_SHM_SHM_H
@@ -13,6 +13,7 @@
 #include <string.h>
 
 #include "core/nng_impl.h"
+#include "tcp.h"
 
 // TCP transport.   Platform specific TCP operations must be
 // supplied as well.
@@ -28,7 +29,6 @@ struct nni_tcp_pipe {
 	uint16_t           proto;
 	size_t             rcvmax;
 
-	nni_aio *user_txaio;
 	nni_aio *user_rxaio;
 	nni_aio *user_negaio;
 
@@ -38,11 +38,12 @@ struct nni_tcp_pipe {
 	size_t   gotrxhead;
 	size_t   wanttxhead;
 	size_t   wantrxhead;
-	nni_aio *txaio;
 	nni_aio *rxaio;
 	nni_aio *negaio;
 	nni_msg *rxmsg;
 	nni_mtx  mtx;
+
+	nni_tran_batch txb;
 };
 
 struct nni_tcp_ep {
@@ -50,6 +51,9 @@ struct nni_tcp_ep {
 	nni_plat_tcp_ep *tep;
 	uint16_t         proto;
 	size_t           rcvmax;
+	int              sndbatch;
+	size_t           sndbatchsz;
+	size_t           zcmin;
 	nni_duration     linger;
 	int              ipv4only;
 	nni_aio *        aio;
@@ -57,7 +61,6 @@ struct nni_tcp_ep {
 	nni_mtx          mtx;
 };
 
-static void nni_tcp_pipe_send_cb(void *);
 static void nni_tcp_pipe_recv_cb(void *);
 static void nni_tcp_pipe_nego_cb(void *);
 static void nni_tcp_ep_cb(void *arg);
@@ -81,17 +84,24 @@ nni_tcp_pipe_close(void *arg)
 	nni_plat_tcp_pipe_close(pipe->tpp);
 }
 
+static void
+nni_tcp_pipe_write(void *arg, nni_aio *aio)
+{
+	nni_tcp_pipe *p = arg;
+
+	nni_plat_tcp_pipe_send(p->tpp, aio);
+}
+
 static void
 nni_tcp_pipe_fini(void *arg)
 {
 	nni_tcp_pipe *p = arg;
 
 	nni_aio_stop(p->rxaio);
-	nni_aio_stop(p->txaio);
 	nni_aio_stop(p->negaio);
+	nni_tran_batch_fini(&p->txb);
 
 	nni_aio_fini(p->rxaio);
-	nni_aio_fini(p->txaio);
 	nni_aio_fini(p->negaio);
 	if (p->tpp != NULL) {
 		nni_plat_tcp_pipe_fini(p->tpp);
@@ -99,6 +109,7 @@ nni_tcp_pipe_fini(void *arg)
 	if (p->rxmsg) {
 		nni_msg_free(p->rxmsg);
 	}
+	nni_mtx_fini(&p->mtx);
 
 	NNI_FREE_STRUCT(p);
 }
@@ -113,18 +124,29 @@ nni_tcp_pipe_init(nni_tcp_pipe **pipep, nni_tcp_ep *ep, void *tpp)
 		return (NNG_ENOMEM);
 	}
 	nni_mtx_init(&p->mtx);
-	if (((rv = nni_aio_init(&p->txaio, nni_tcp_pipe_send_cb, p)) != 0) ||
+	rv = nni_tran_batch_init(&p->txb, ep->sndbatch, ep->sndbatchsz, NULL,
+	    0, nni_tcp_pipe_write, nni_tcp_pipe_close, p);
+	if ((rv != 0) ||
 	    ((rv = nni_aio_init(&p->rxaio, nni_tcp_pipe_recv_cb, p)) != 0) ||
 	    ((rv = nni_aio_init(&p->negaio, nni_tcp_pipe_nego_cb, p)) != 0)) {
 		nni_tcp_pipe_fini(p);
 		return (rv);
 	}
+	// The receive callback just advances the transfer, or hands the
+	// message to the user aio; it never blocks.
+	nni_aio_set_inline(p->rxaio);
 
 	p->proto  = ep->proto;
 	p->rcvmax = ep->rcvmax;
 	p->tpp    = tpp;
 	p->addr   = ep->addr;
 
+	// Zero copy is only an optimization; carry on without it if the
+	// platform cannot do it.
+	if (ep->zcmin != 0) {
+		(void) nni_plat_tcp_pipe_zerocopy(tpp, ep->zcmin);
+	}
+
 	*pipep = p;
 	return (0);
 }
@@ -201,59 +223,6 @@ done:
 	nni_mtx_unlock(&p->mtx);
 }
 
-static void
-nni_tcp_pipe_send_cb(void *arg)
-{
-	nni_tcp_pipe *p = arg;
-	int           rv;
-	nni_aio *     aio;
-	size_t        n;
-	nng_msg *     msg;
-	nni_aio *     txaio = p->txaio;
-
-	nni_mtx_lock(&p->mtx);
-	if ((aio = p->user_txaio) == NULL) {
-		nni_mtx_unlock(&p->mtx);
-		return;
-	}
-
-	if ((rv = nni_aio_result(txaio)) != 0) {
-		p->user_txaio = NULL;
-		nni_mtx_unlock(&p->mtx);
-		msg = nni_aio_get_msg(aio);
-		nni_aio_set_msg(aio, NULL);
-		nni_msg_free(msg);
-		nni_aio_finish_error(aio, rv);
-		return;
-	}
-
-	n = nni_aio_count(txaio);
-	while (n) {
-		NNI_ASSERT(txaio->a_niov != 0);
-		if (txaio->a_iov[0].iov_len > n) {
-			txaio->a_iov[0].iov_len -= n;
-			txaio->a_iov[0].iov_buf += n;
-			break;
-		}
-		n -= txaio->a_iov[0].iov_len;
-		for (int i = 0; i < txaio->a_niov; i++) {
-			txaio->a_iov[i] = txaio->a_iov[i + 1];
-		}
-		txaio->a_niov--;
-	}
-	if ((txaio->a_niov != 0) && (txaio->a_iov[0].iov_len != 0)) {
-		nni_plat_tcp_pipe_send(p->tpp, txaio);
-		nni_mtx_unlock(&p->mtx);
-		return;
-	}
-
-	nni_mtx_unlock(&p->mtx);
-	msg = nni_aio_get_msg(aio);
-	n   = nni_msg_len(msg);
-	nni_aio_set_msg(aio, NULL);
-	nni_aio_finish(aio, 0, n);
-}
-
 static void
 nni_tcp_pipe_recv_cb(void *arg)
 {
@@ -312,7 +281,10 @@ nni_tcp_pipe_recv_cb(void *arg)
 			goto recv_error;
 		}
 
-		if ((rv = nng_msg_alloc(&p->rxmsg, (size_t) len)) != 0) {
+		// The body is about to be overwritten by the read, so there
+		// is no point in zeroing it first.
+		rv = nni_msg_alloc_uninit(&p->rxmsg, (size_t) len);
+		if (rv != 0) {
 			goto recv_error;
 		}
 
@@ -347,64 +319,20 @@ recv_error:
 }
 
 static void
-nni_tcp_cancel_tx(nni_aio *aio, int rv)
+nni_tcp_pipe_send(void *arg, nni_aio *aio)
 {
-	nni_tcp_pipe *p = aio->a_prov_data;
-
-	nni_mtx_lock(&p->mtx);
-	if (p->user_txaio != aio) {
-		nni_mtx_unlock(&p->mtx);
-		return;
-	}
-	p->user_txaio = NULL;
-	nni_mtx_unlock(&p->mtx);
+	nni_tcp_pipe *p = arg;
 
-	// cancel the underlying operation.
-	nni_aio_cancel(p->txaio, rv);
-	nni_aio_finish_error(aio, rv);
+	nni_tran_batch_send(&p->txb, aio);
 }
 
-static void
-nni_tcp_pipe_send(void *arg, nni_aio *aio)
+static int
+nni_tcp_pipe_send_depth(void *arg)
 {
-	nni_tcp_pipe *p   = arg;
-	nni_msg *     msg = nni_aio_get_msg(aio);
-	uint64_t      len;
-	nni_aio *     txaio;
-	int           niov;
-
-	len = nni_msg_len(msg) + nni_msg_header_len(msg);
-
-	nni_mtx_lock(&p->mtx);
-
-	if (nni_aio_start(aio, nni_tcp_cancel_tx, p) != 0) {
-		nni_mtx_unlock(&p->mtx);
-		return;
-	}
-
-	p->user_txaio = aio;
-
-	NNI_PUT64(p->txlen, len);
-
-	niov                       = 0;
-	txaio                      = p->txaio;
-	txaio->a_iov[niov].iov_buf = p->txlen;
-	txaio->a_iov[niov].iov_len = sizeof(p->txlen);
-	niov++;
-	if (nni_msg_header_len(msg) > 0) {
-		txaio->a_iov[niov].iov_buf = nni_msg_header(msg);
-		txaio->a_iov[niov].iov_len = nni_msg_header_len(msg);
-		niov++;
-	}
-	if (nni_msg_len(msg) > 0) {
-		txaio->a_iov[niov].iov_buf = nni_msg_body(msg);
-		txaio->a_iov[niov].iov_len = nni_msg_len(msg);
-		niov++;
-	}
-	txaio->a_niov = niov;
+	nni_tcp_pipe *p = arg;
 
-	nni_plat_tcp_pipe_send(p->tpp, txaio);
-	nni_mtx_unlock(&p->mtx);
+	// Every send that can join the next write is worth having queued.
+	return (p->txb.tb_maxmsgs);
 }
 
 static void
@@ -698,7 +626,9 @@ nni_tcp_ep_init(void **epp, const char *url, nni_sock *sock, int mode)
 		nni_tcp_ep_fini(ep);
 		return (rv);
 	}
-	ep->proto = nni_sock_proto(sock);
+	ep->proto      = nni_sock_proto(sock);
+	ep->sndbatch   = NNI_TRAN_SENDBATCH;
+	ep->sndbatchsz = NNI_TRAN_SENDBATCHSZ;
 
 	*epp = ep;
 	return (0);
@@ -848,6 +778,58 @@ nni_tcp_ep_getopt_recvmaxsz(void *arg, void *v, size_t *szp)
 	return (nni_getopt_size(ep->rcvmax, v, szp));
 }
 
+static int
+nni_tcp_ep_setopt_sendbatch(void *arg, const void *v, size_t sz)
+{
+	nni_tcp_ep *ep = arg;
+	if (ep == NULL) {
+		return (nni_chkopt_int(v, sz, 1, NNI_TRAN_SENDBATCH_MAX));
+	}
+	return (
+	    nni_setopt_int(&ep->sndbatch, v, sz, 1, NNI_TRAN_SENDBATCH_MAX));
+}
+
+static int
+nni_tcp_ep_getopt_sendbatch(void *arg, void *v, size_t *szp)
+{
+	nni_tcp_ep *ep = arg;
+	return (nni_getopt_int(ep->sndbatch, v, szp));
+}
+
+static int
+nni_tcp_ep_setopt_sendbatchsz(void *arg, const void *v, size_t sz)
+{
+	nni_tcp_ep *ep = arg;
+	if (ep == NULL) {
+		return (nni_chkopt_size(v, sz, 0, NNI_MAXSZ));
+	}
+	return (nni_setopt_size(&ep->sndbatchsz, v, sz, 0, NNI_MAXSZ));
+}
+
+static int
+nni_tcp_ep_getopt_sendbatchsz(void *arg, void *v, size_t *szp)
+{
+	nni_tcp_ep *ep = arg;
+	return (nni_getopt_size(ep->sndbatchsz, v, szp));
+}
+
+static int
+nni_tcp_ep_setopt_zerocopy(void *arg, const void *v, size_t sz)
+{
+	nni_tcp_ep *ep = arg;
+	if (ep == NULL) {
+		return (nni_chkopt_size(v, sz, 0, NNI_MAXSZ));
+	}
+	return (nni_setopt_size(&ep->zcmin, v, sz, 0, NNI_MAXSZ));
+}
+
+static int
+nni_tcp_ep_getopt_zerocopy(void *arg, void *v, size_t *szp)
+{
+	nni_tcp_ep *ep = arg;
+	return (nni_getopt_size(ep->zcmin, v, szp));
+}
+
 static int
 nni_tcp_ep_setopt_linger(void *arg, const void *v, size_t sz)
 {
@@ -873,13 +855,14 @@ static nni_tran_pipe_option nni_tcp_pipe_options[] = {
 };
 
 static nni_tran_pipe nni_tcp_pipe_ops = {
-	.p_fini    = nni_tcp_pipe_fini,
-	.p_start   = nni_tcp_pipe_start,
-	.p_send    = nni_tcp_pipe_send,
-	.p_recv    = nni_tcp_pipe_recv,
-	.p_close   = nni_tcp_pipe_close,
-	.p_peer    = nni_tcp_pipe_peer,
-	.p_options = nni_tcp_pipe_options,
+	.p_fini       = nni_tcp_pipe_fini,
+	.p_start      = nni_tcp_pipe_start,
+	.p_send       = nni_tcp_pipe_send,
+	.p_send_depth = nni_tcp_pipe_send_depth,
+	.p_recv       = nni_tcp_pipe_recv,
+	.p_close      = nni_tcp_pipe_close,
+	.p_peer       = nni_tcp_pipe_peer,
+	.p_options    = nni_tcp_pipe_options,
 };
 
 static nni_tran_ep_option nni_tcp_ep_options[] = {
@@ -888,6 +871,21 @@ static nni_tran_ep_option nni_tcp_ep_options[] = {
 	    .eo_getopt = nni_tcp_ep_getopt_recvmaxsz,
 	    .eo_setopt = nni_tcp_ep_setopt_recvmaxsz,
 	},
+	{
+	    .eo_name   = NNG_OPT_SENDBATCH,
+	    .eo_getopt = nni_tcp_ep_getopt_sendbatch,
+	    .eo_setopt = nni_tcp_ep_setopt_sendbatch,
+	},
+	{
+	    .eo_name   = NNG_OPT_SENDBATCHSZ,
+	    .eo_getopt = nni_tcp_ep_getopt_sendbatchsz,
+	    .eo_setopt = nni_tcp_ep_setopt_sendbatchsz,
+	},
+	{
+	    .eo_name   = NNG_OPT_TCP_ZEROCOPY,
+	    .eo_getopt = nni_tcp_ep_getopt_zerocopy,
+	    .eo_setopt = nni_tcp_ep_setopt_zerocopy,
+	},
 	{
 	    .eo_name   = NNG_OPT_LINGER,
 	    .eo_getopt = nni_tcp_ep_getopt_linger,
@@ -15,4 +15,12 @@
 
 NNG_DECL int nng_tcp_register(void);
 
+// NNG_OPT_TCP_ZEROCOPY is the write size, in bytes, from which writes
+// avoid copying the data into the kernel.  Batched messages count
+// together.  The messages are then held, and their sends cannot be
+// canceled, until the kernel is done with them.  Zero, the default,
+// disables this.  It is only supported on Linux; elsewhere the option
+// has no effect.
+#define NNG_OPT_TCP_ZEROCOPY "tcp:zerocopy"
+
 #endif // NNG_TRANSPORT_TCP_TCP_H
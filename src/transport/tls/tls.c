@@ -323,7 +323,10 @@ nni_tls_pipe_recv_cb(void *arg)
 			goto recv_error;
 		}
 
-		if ((rv = nng_msg_alloc(&p->rxmsg, (size_t) len)) != 0) {
+		// The body is about to be overwritten by the read, so there
+		// is no point in zeroing it first.
+		rv = nni_msg_alloc_uninit(&p->rxmsg, (size_t) len);
+		if (rv != 0) {
 			goto recv_error;
 		}
 
@@ -383,6 +386,8 @@ nni_tls_pipe_send(void *arg, nni_aio *aio)
 	uint64_t      len;
 	nni_aio *     txaio;
 	int           niov;
+	int           n;
+	int           rv;
 
 	len = nni_msg_len(msg) + nni_msg_header_len(msg);
 
@@ -407,12 +412,16 @@ nni_tls_pipe_send(void *arg, nni_aio *aio)
 		txaio->a_iov[niov].iov_len = nni_msg_header_len(msg);
 		niov++;
 	}
-	if (nni_msg_len(msg) > 0) {
-		txaio->a_iov[niov].iov_buf = nni_msg_body(msg);
-		txaio->a_iov[niov].iov_len = nni_msg_len(msg);
-		niov++;
+	n = NNI_AIO_MAX_IOV - niov;
+	if ((rv = nni_msg_body_iov(msg, &txaio->a_iov[niov], &n)) != 0) {
+		p->user_txaio = NULL;
+		nni_mtx_unlock(&p->mtx);
+		nni_aio_set_msg(aio, NULL);
+		nni_msg_free(msg);
+		nni_aio_finish_error(aio, rv);
+		return;
 	}
-	txaio->a_niov = niov;
+	txaio->a_niov = niov + n;
 
 	nni_tls_send(p->tls, txaio);
 	nni_mtx_unlock(&p->mtx);
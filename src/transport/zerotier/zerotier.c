@@ -93,6 +93,9 @@ enum zt_tunables {
 	zt_listenq       = 128,            // backlog queue length
 	zt_listen_expire = 60000,          // maximum time in backlog (msec)
 	zt_rcv_bufsize   = ZT_MAX_PHYSMTU, // max UDP recv
+	zt_gro_bufsize   = 65536,          // max UDP recv (with GRO)
+	zt_gso_maxsz     = 65000,          // max bytes per GSO send
+	zt_gso_maxseg    = 64,             // max packets per GSO send
 	zt_conn_attempts = 12,             // connection attempts (default)
 	zt_conn_interval = 5000,           // between attempts (msec)
 	zt_udp_sendq     = 16,             // outgoing UDP queue length
@@ -174,6 +177,14 @@ struct zt_node {
 	nni_aio *     zn_rcv6_aio;
 	char *        zn_rcv6_buf;
 	nng_sockaddr  zn_rcv6_addr;
+	size_t        zn_rcv_bufsize;
+	int           zn_segment; // UDP segmentation offload enabled
+	int           zn_batch;   // nesting depth of send batches
+	nni_aio *     zn_gso_aio; // pending train of physical packets
+	nni_plat_udp *zn_gso_udp;
+	size_t        zn_gso_len;
+	size_t        zn_gso_segsz;
+	int           zn_gso_nseg;
 	nni_thr       zn_bgthr;
 	nni_time      zn_bgtime;
 	nni_cv        zn_bgcv;
@@ -288,6 +299,8 @@ static int  zt_pipe_init(zt_pipe **, zt_ep *, uint64_t, uint64_t);
 static void zt_pipe_ping_cb(void *);
 static void zt_fraglist_clear(zt_fraglist *);
 static void zt_fraglist_free(zt_fraglist *);
+static void zt_node_batch_begin(zt_node *);
+static void zt_node_batch_end(zt_node *);
 static void zt_virtual_recv(ZT_Node *, void *, void *, uint64_t, void **,
     uint64_t, uint64_t, unsigned int, unsigned int, const void *,
     unsigned int);
@@ -295,8 +308,8 @@ static void zt_virtual_recv(ZT_Node *, void *, void *, uint64_t, void **,
 static int64_t
 zt_now(void)
 {
-	// We return msec
-	return ((int64_t) nni_clock());
+	// We return msec; the core does not need better than that.
+	return ((int64_t) nni_clock_coarse());
 }
 
 static void
@@ -319,7 +332,9 @@ zt_bgthr(void *arg)
 		}
 
 		ztn->zn_bgtime = 0;
+		zt_node_batch_begin(ztn);
 		ZT_Node_processBackgroundTasks(ztn->zn_znode, NULL, now, &now);
+		zt_node_batch_end(ztn);
 
 		ztn->zn_bgtime = now;
 	}
@@ -336,6 +351,33 @@ zt_node_resched(zt_node *ztn, int64_t msec)
 	nni_cv_wake1(&ztn->zn_bgcv);
 }
 
+// zt_node_rcv_wire passes a received UDP payload to the ZeroTier core.
+// With receive offload the buffer may hold several physical packets from
+// the same peer, each a_segsz bytes long (the last may be shorter).
+static void
+zt_node_rcv_wire(zt_node *ztn, nni_aio *aio, struct sockaddr_storage *sa,
+    const char *buf, int64_t *nowp)
+{
+	size_t segsz = aio->a_segsz ? aio->a_segsz : aio->a_count;
+
+	// We are not going to perform any validation of the data; we
+	// just pass this straight into the ZeroTier core.  Replies are
+	// batched, so that they can go out segmented as well.
+	zt_node_batch_begin(ztn);
+	for (size_t off = 0; off < aio->a_count; off += segsz) {
+		size_t len = aio->a_count - off;
+
+		if (len > segsz) {
+			len = segsz;
+		}
+		// XXX: CHECK THIS, if it fails then we have a fatal error
+		// with the znode, and have to shut everything down.
+		ZT_Node_processWirePacket(ztn->zn_znode, NULL, *nowp, 0,
+		    (void *) sa, buf + off, (unsigned) len, nowp);
+	}
+	zt_node_batch_end(ztn);
+}
+
 static void
 zt_node_rcv4_cb(void *arg)
 {
@@ -364,12 +406,7 @@ zt_node_rcv4_cb(void *arg)
 	nni_mtx_lock(&zt_lk);
 	now = zt_now();
 
-	// We are not going to perform any validation of the data; we
-	// just pass this straight into the ZeroTier core.
-	// XXX: CHECK THIS, if it fails then we have a fatal error with
-	// the znode, and have to shut everything down.
-	ZT_Node_processWirePacket(ztn->zn_znode, NULL, now, 0, (void *) &sa,
-	    ztn->zn_rcv4_buf, aio->a_count, &now);
+	zt_node_rcv_wire(ztn, aio, &sa, ztn->zn_rcv4_buf, &now);
 
 	// Schedule background work
 	zt_node_resched(ztn, now);
@@ -378,7 +415,7 @@ zt_node_rcv4_cb(void *arg)
 	if (ztn->zn_udp4 != NULL) {
 		aio->a_niov           = 1;
 		aio->a_iov[0].iov_buf = ztn->zn_rcv4_buf;
-		aio->a_iov[0].iov_len = zt_rcv_bufsize;
+		aio->a_iov[0].iov_len = ztn->zn_rcv_bufsize;
 		aio->a_addr           = &ztn->zn_rcv4_addr;
 		aio->a_count          = 0;
 
@@ -415,10 +452,7 @@ zt_node_rcv6_cb(void *arg)
 	nni_mtx_lock(&zt_lk);
 	now = zt_now(); // msec
 
-	// We are not going to perform any validation of the data; we
-	// just pass this straight into the ZeroTier core.
-	ZT_Node_processWirePacket(ztn->zn_znode, NULL, now, 0, (void *) &sa,
-	    ztn->zn_rcv6_buf, aio->a_count, &now);
+	zt_node_rcv_wire(ztn, aio, &sa, ztn->zn_rcv6_buf, &now);
 
 	// Schedule background work
 	zt_node_resched(ztn, now);
@@ -427,7 +461,7 @@ zt_node_rcv6_cb(void *arg)
 	if (ztn->zn_udp6 != NULL) {
 		aio->a_niov           = 1;
 		aio->a_iov[0].iov_buf = ztn->zn_rcv6_buf;
-		aio->a_iov[0].iov_len = zt_rcv_bufsize;
+		aio->a_iov[0].iov_len = ztn->zn_rcv_bufsize;
 		aio->a_addr           = &ztn->zn_rcv6_addr;
 		aio->a_count          = 0;
 		nni_plat_udp_recv(ztn->zn_udp6, aio);
@@ -739,7 +773,7 @@ zt_ep_recv_conn_req(zt_ep *ep, uint64_t raddr, const uint8_t *data, size_t len)
 
 	NNI_GET16(data + zt_offset_creq_proto, ep->ze_creqs[i].cr_proto);
 	ep->ze_creqs[i].cr_raddr  = raddr;
-	ep->ze_creqs[i].cr_expire = nni_clock() + zt_listen_expire;
+	ep->ze_creqs[i].cr_expire = nni_clock_coarse() + zt_listen_expire;
 	ep->ze_creq_head++;
 
 	zt_ep_doaccept(ep);
@@ -907,7 +941,7 @@ zt_pipe_recv_data(zt_pipe *p, const uint8_t *data, size_t len)
 		fl->fl_nfrags = nfrags;
 		fl->fl_fragsz = fragsz;
 		fl->fl_msgid  = msgid;
-		fl->fl_time   = nni_clock();
+		fl->fl_time   = nni_clock_coarse();
 
 		// Set the missing mask.
 		memset(fl->fl_missing, 0xff, nfrags / 8);
@@ -930,8 +964,11 @@ zt_pipe_recv_data(zt_pipe *p, const uint8_t *data, size_t len)
 		return;
 	}
 
+	if ((body = nni_msg_body(fl->fl_msg)) == NULL) {
+		zt_fraglist_clear(fl);
+		return;
+	}
 	fl->fl_missing[fragno / 8] &= ~(bit);
-	body = nni_msg_body(fl->fl_msg);
 	body += fragno * fragsz;
 	memcpy(body, data, len);
 	if (fragno == (nfrags - 1)) {
@@ -1012,7 +1049,7 @@ static void
 zt_pipe_virtual_recv(zt_pipe *p, uint8_t op, const uint8_t *data, size_t len)
 {
 	// We got data, so update our recv time.
-	p->zp_last_recv = nni_clock();
+	p->zp_last_recv = nni_clock_coarse();
 	p->zp_ping_try  = 0;
 
 	switch (op) {
@@ -1297,6 +1334,56 @@ zt_wire_packet_send_cb(void *arg)
 	nni_aio_fini_cb(aio);
 }
 
+// zt_node_flush sends the pending train of physical packets, if any.
+static void
+zt_node_flush(zt_node *ztn)
+{
+	nni_aio *aio;
+
+	if ((aio = ztn->zn_gso_aio) == NULL) {
+		return;
+	}
+	ztn->zn_gso_aio       = NULL;
+	aio->a_iov[0].iov_len = ztn->zn_gso_len;
+	aio->a_segsz = (ztn->zn_gso_nseg > 1) ? ztn->zn_gso_segsz : 0;
+
+	// This should be non-blocking/best-effort, so while
+	// not great that we're holding the lock, also not tragic.
+	nni_aio_set_synch(aio);
+	nni_plat_udp_send(ztn->zn_gso_udp, aio);
+}
+
+// Physical packets sent between zt_node_batch_begin and zt_node_batch_end
+// are gathered into trains of equal sized packets to the same peer, each
+// sent with a single segmented UDP send.  Outside of a batch, or without
+// segmentation offload, every packet goes out on its own right away.
+static void
+zt_node_batch_begin(zt_node *ztn)
+{
+	ztn->zn_batch++;
+}
+
+static void
+zt_node_batch_end(zt_node *ztn)
+{
+	if (--ztn->zn_batch == 0) {
+		zt_node_flush(ztn);
+	}
+}
+
+// zt_node_gso_fits returns true if the packet can join the pending train.
+// Only the last packet of a train may be shorter than the others.
+static int
+zt_node_gso_fits(
+    zt_node *ztn, nni_plat_udp *udp, nni_sockaddr *sa, unsigned int len)
+{
+	zt_send_hdr *hdr = nni_aio_get_data(ztn->zn_gso_aio);
+
+	return ((udp == ztn->zn_gso_udp) && (len <= ztn->zn_gso_segsz) &&
+	    (ztn->zn_gso_len + len <= hdr->len) &&
+	    (memcmp(sa, &hdr->sa, sizeof(*sa)) == 0));
+}
+
 // This function is called when ZeroTier desires to send a
 // physical frame. The data is a UDP payload, the rest of the
 // payload should be set over vanilla UDP.
@@ -1314,6 +1401,7 @@ zt_wire_packet_send(ZT_Node *node, void *userptr, void *thr, int64_t socket,
 	uint16_t             port;
 	char *               buf;
 	zt_send_hdr *        hdr;
+	size_t               size;
 
 	NNI_ARG_UNUSED(thr);
 	NNI_ARG_UNUSED(socket);
@@ -1321,7 +1409,9 @@ zt_wire_packet_send(ZT_Node *node, void *userptr, void *thr, int64_t socket,
 
 	// Kind of unfortunate, but we have to convert the
 	// sockaddr to a neutral form, and then back again in
-	// the platform layer.
+	// the platform layer.  The address is cleared first, so
+	// that trains can compare it as a whole.
+	memset(&addr, 0, sizeof(addr));
 	switch (sin->sin_family) {
 	case AF_INET:
 		addr.s_un.s_in.sa_family = NNG_AF_INET;
@@ -1342,32 +1432,56 @@ zt_wire_packet_send(ZT_Node *node, void *userptr, void *thr, int64_t socket,
 		return (-1);
 	}
 
-	if (nni_aio_init(&aio, zt_wire_packet_send_cb, NULL) != 0) {
-		// Out of memory
-		return (-1);
-	}
-	if ((buf = nni_alloc(sizeof(*hdr) + len)) == NULL) {
-		nni_aio_fini(aio);
-		return (-1);
+	if ((ztn->zn_gso_aio != NULL) &&
+	    (!zt_node_gso_fits(ztn, udp, &addr, len))) {
+		zt_node_flush(ztn);
 	}
 
-	hdr = (void *) buf;
-	buf += sizeof(*hdr);
+	if ((aio = ztn->zn_gso_aio) == NULL) {
+		// Start a new train.  Only make room for more packets
+		// if there is a chance of sending them together.
+		size = len;
+		if (ztn->zn_segment && (ztn->zn_batch > 0) &&
+		    (len < zt_gso_maxsz)) {
+			size = zt_gso_maxsz;
+		}
+		if (nni_aio_init(&aio, zt_wire_packet_send_cb, NULL) != 0) {
+			// Out of memory
+			return (-1);
+		}
+		if ((buf = nni_alloc(sizeof(*hdr) + size)) == NULL) {
+			nni_aio_fini(aio);
+			return (-1);
+		}
 
-	memcpy(buf, data, len);
-	nni_aio_set_data(aio, hdr);
-	hdr->sa  = addr;
-	hdr->len = len;
+		hdr = (void *) buf;
+		buf += sizeof(*hdr);
 
-	aio->a_addr           = &hdr->sa;
-	aio->a_niov           = 1;
-	aio->a_iov[0].iov_buf = buf;
-	aio->a_iov[0].iov_len = len;
+		nni_aio_set_data(aio, hdr);
+		hdr->sa  = addr;
+		hdr->len = size;
 
-	// This should be non-blocking/best-effort, so while
-	// not great that we're holding the lock, also not tragic.
-	nni_aio_set_synch(aio);
-	nni_plat_udp_send(udp, aio);
+		aio->a_addr           = &hdr->sa;
+		aio->a_niov           = 1;
+		aio->a_iov[0].iov_buf = buf;
+		aio->a_iov[0].iov_len = 0;
+
+		ztn->zn_gso_aio   = aio;
+		ztn->zn_gso_udp   = udp;
+		ztn->zn_gso_len   = 0;
+		ztn->zn_gso_segsz = len;
+		ztn->zn_gso_nseg  = 0;
+	}
+
+	memcpy(aio->a_iov[0].iov_buf + ztn->zn_gso_len, data, len);
+	ztn->zn_gso_len += len;
+	ztn->zn_gso_nseg++;
+
+	if ((ztn->zn_batch == 0) || (!ztn->zn_segment) ||
+	    (len < ztn->zn_gso_segsz) ||
+	    (ztn->zn_gso_nseg == zt_gso_maxseg)) {
+		zt_node_flush(ztn);
+	}
 
 	return (0);
 }
@@ -1405,10 +1519,10 @@ zt_node_destroy(zt_node *ztn)
 	}
 
 	if (ztn->zn_rcv4_buf != NULL) {
-		nni_free(ztn->zn_rcv4_buf, zt_rcv_bufsize);
+		nni_free(ztn->zn_rcv4_buf, ztn->zn_rcv_bufsize);
 	}
 	if (ztn->zn_rcv6_buf != NULL) {
-		nni_free(ztn->zn_rcv6_buf, zt_rcv_bufsize);
+		nni_free(ztn->zn_rcv6_buf, ztn->zn_rcv_bufsize);
 	}
 	nni_aio_fini(ztn->zn_rcv4_aio);
 	nni_aio_fini(ztn->zn_rcv6_aio);
@@ -1450,11 +1564,6 @@ zt_node_create(zt_node **ztnp, const char *path)
 	nni_aio_init(&ztn->zn_rcv4_aio, zt_node_rcv4_cb, ztn);
 	nni_aio_init(&ztn->zn_rcv6_aio, zt_node_rcv6_cb, ztn);
 
-	if (((ztn->zn_rcv4_buf = nni_alloc(zt_rcv_bufsize)) == NULL) ||
-	    ((ztn->zn_rcv6_buf = nni_alloc(zt_rcv_bufsize)) == NULL)) {
-		zt_node_destroy(ztn);
-		return (NNG_ENOMEM);
-	}
 	if (((rv = nni_idhash_init(&ztn->zn_ports)) != 0) ||
 	    ((rv = nni_idhash_init(&ztn->zn_eps)) != 0) ||
 	    ((rv = nni_idhash_init(&ztn->zn_lpipes)) != 0) ||
@@ -1467,6 +1576,23 @@ zt_node_create(zt_node **ztnp, const char *path)
 		return (rv);
 	}
 
+	// Segmentation offload lets bulk transfers move many physical
+	// packets per system call.  Only use it if both sockets have it,
+	// and then receive buffers must hold a whole coalesced payload.
+	ztn->zn_rcv_bufsize = zt_rcv_bufsize;
+	if ((nni_plat_udp_segment(ztn->zn_udp4, 1) == 0) &&
+	    (nni_plat_udp_segment(ztn->zn_udp6, 1) == 0)) {
+		ztn->zn_segment     = 1;
+		ztn->zn_rcv_bufsize = zt_gro_bufsize;
+	} else {
+		(void) nni_plat_udp_segment(ztn->zn_udp4, 0);
+	}
+	if (((ztn->zn_rcv4_buf = nni_alloc(ztn->zn_rcv_bufsize)) == NULL) ||
+	    ((ztn->zn_rcv6_buf = nni_alloc(ztn->zn_rcv_bufsize)) == NULL)) {
+		zt_node_destroy(ztn);
+		return (NNG_ENOMEM);
+	}
+
 	// Setup for dynamic ephemeral port allocations.  We
 	// set the range to allow for ephemeral ports, but not
 	// higher than the max port, and starting with an
@@ -1497,12 +1623,12 @@ zt_node_create(zt_node **ztnp, const char *path)
 	// Schedule receive
 	ztn->zn_rcv4_aio->a_niov           = 1;
 	ztn->zn_rcv4_aio->a_iov[0].iov_buf = ztn->zn_rcv4_buf;
-	ztn->zn_rcv4_aio->a_iov[0].iov_len = zt_rcv_bufsize;
+	ztn->zn_rcv4_aio->a_iov[0].iov_len = ztn->zn_rcv_bufsize;
 	ztn->zn_rcv4_aio->a_addr           = &ztn->zn_rcv4_addr;
 	ztn->zn_rcv4_aio->a_count          = 0;
 	ztn->zn_rcv6_aio->a_niov           = 1;
 	ztn->zn_rcv6_aio->a_iov[0].iov_buf = ztn->zn_rcv6_buf;
-	ztn->zn_rcv6_aio->a_iov[0].iov_len = zt_rcv_bufsize;
+	ztn->zn_rcv6_aio->a_iov[0].iov_len = ztn->zn_rcv_bufsize;
 	ztn->zn_rcv6_aio->a_addr           = &ztn->zn_rcv6_addr;
 	ztn->zn_rcv6_aio->a_count          = 0;
 
@@ -1727,6 +1853,7 @@ zt_pipe_send(void *arg, nni_aio *aio)
 	uint16_t fragsz;
 	size_t   bytes;
 	nni_msg *m;
+	uint8_t *body;
 
 	nni_mtx_lock(&zt_lk);
 	if (nni_aio_start(aio, NULL, p) != 0) {
@@ -1762,6 +1889,9 @@ zt_pipe_send(void *arg, nni_aio *aio)
 		id = p->zp_next_msgid++;
 	}
 
+	// Batch the fragments, so that the physical packets carrying
+	// them can leave together.
+	zt_node_batch_begin(p->zp_ztn);
 	offset = 0;
 	fragno = 0;
 	do {
@@ -1775,6 +1905,7 @@ zt_pipe_send(void *arg, nni_aio *aio)
 			if (len > fragsz) {
 				// This shouldn't happen!  SP headers are
 				// supposed to be quite small.
+				zt_node_batch_end(p->zp_ztn);
 				nni_aio_finish_error(aio, NNG_EMSGSIZE);
 				nni_mtx_unlock(&zt_lk);
 				return;
@@ -1787,11 +1918,17 @@ zt_pipe_send(void *arg, nni_aio *aio)
 			nni_msg_header_clear(m);
 		}
 
+		if ((body = nni_msg_body(m)) == NULL) {
+			zt_node_batch_end(p->zp_ztn);
+			nni_aio_finish_error(aio, NNG_ENOMEM);
+			nni_mtx_unlock(&zt_lk);
+			return;
+		}
 		len = nni_msg_len(m);
 		if (len > room) {
 			len = room;
 		}
-		memcpy(dest, nni_msg_body(m), len);
+		memcpy(dest, body, len);
 
 		nng_msg_trim(m, len);
 		NNI_PUT16(data + zt_offset_data_id, id);
@@ -1804,6 +1941,7 @@ zt_pipe_send(void *arg, nni_aio *aio)
 		zt_send(p->zp_ztn, p->zp_nwid, zt_op_data, p->zp_raddr,
 		    p->zp_laddr, data, fraglen + zt_offset_data_data);
 	} while (nni_msg_len(m) != 0);
+	zt_node_batch_end(p->zp_ztn);
 
 	nni_aio_set_msg(aio, NULL);
 	nni_msg_free(m);
@@ -1850,7 +1988,7 @@ static void
 zt_pipe_dorecv(zt_pipe *p)
 {
 	nni_aio *aio = p->zp_user_rxaio;
-	nni_time now = nni_clock();
+	nni_time now = nni_clock_coarse();
 
 	if (aio == NULL) {
 		return;
@@ -2000,7 +2138,7 @@ zt_pipe_ping_cb(void *arg)
 		return;
 	}
 	if (p->zp_ping_try < p->zp_ping_count) {
-		nni_time now = nni_clock();
+		nni_time now = nni_clock_coarse();
 		nni_aio_set_timeout(aio, now + p->zp_ping_time);
 		// We want pings.  We only send one if needed, but we
 		// use the the timer to wake us up even if we aren't
@@ -2034,7 +2172,7 @@ zt_pipe_start(void *arg, nni_aio *aio)
 	if ((p->zp_ping_count > 0) && (p->zp_ping_time != NNI_TIME_ZERO) &&
 	    (p->zp_ping_time != NNI_TIME_NEVER) && (p->zp_ping_aio != NULL)) {
 		p->zp_ping_try = 0;
-		nni_aio_set_timeout(aio, nni_clock() + p->zp_ping_time);
+		nni_aio_set_timeout(aio, nni_clock_coarse() + p->zp_ping_time);
 		if (nni_aio_start(p->zp_ping_aio, zt_pipe_cancel_ping, p) ==
 		    0) {
 			p->zp_ping_active = 1;
@@ -2456,7 +2594,8 @@ zt_ep_conn_req_cb(void *arg)
 	}
 
 	if (nni_list_first(&ep->ze_aios) != NULL) {
-		nni_aio_set_timeout(aio, nni_clock() + zt_conn_interval);
+		nni_aio_set_timeout(
+		    aio, nni_clock_coarse() + zt_conn_interval);
 		if (nni_aio_start(aio, zt_ep_conn_req_cancel, ep) == 0) {
 			ep->ze_creq_active = 1;
 			ep->ze_creq_try++;
@@ -28,6 +28,16 @@ cbdone(void *p)
 	(*(int *) p)++;
 }
 
+// NTIMEO timeouts are started together, spaced so that they fall into
+// several different timer slots and levels.
+#define NTIMEO 16
+
+void
+cbstamp(void *p)
+{
+	*(uint64_t *) p = getms();
+}
+
 Main({
 
 	Test("AIO operations", {
@@ -119,6 +129,50 @@ Main({
 				So(done == 1);
 				So(nng_aio_result(a) == NNG_ETIMEDOUT);
 			});
+			Convey("Many timeouts expire in time", {
+				nng_aio *aios[NTIMEO];
+				uint64_t fired[NTIMEO];
+				uint64_t start;
+				int      tmo;
+				int      rv;
+				int      early = 0;
+				int      late  = 0;
+				int      err   = 0;
+				int      i;
+
+				for (i = 0; i < NTIMEO; i++) {
+					fired[i] = 0;
+					rv = nng_aio_alloc(
+					    &aios[i], cbstamp, &fired[i]);
+					So(rv == 0);
+				}
+				start = getms();
+				// Start the longest ones first.
+				for (i = NTIMEO - 1; i >= 0; i--) {
+					tmo = 10 + i * 15;
+					nng_aio_set_timeout(aios[i], tmo);
+					nng_recv_aio(s, aios[i]);
+				}
+				for (i = 0; i < NTIMEO; i++) {
+					tmo = 10 + i * 15;
+					nng_aio_wait(aios[i]);
+					rv = nng_aio_result(aios[i]);
+					if (rv != NNG_ETIMEDOUT) {
+						err++;
+					}
+					// Allow for clock granularity.
+					if (fired[i] + 1 < start + tmo) {
+						early++;
+					}
+					if (fired[i] > start + tmo + 1000) {
+						late++;
+					}
+					nng_aio_free(aios[i]);
+				}
+				So(err == 0);
+				So(early == 0);
+				So(late == 0);
+			});
 			Convey("Cancellation works", {
 				nng_aio_set_timeout(a, NNG_DURATION_INFINITE);
 				nng_recv_aio(s, a);
@@ -14,6 +14,16 @@
 #include <string.h>
 static uint8_t dat123[] = { 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 3 };
 
+static int extfreed;
+
+static void
+extfree(void *ptr, size_t len, void *arg)
+{
+	(void) ptr;
+	(void) len;
+	(*(int *) arg)++;
+}
+
 TestMain("Message Tests", {
 	nng_msg *msg;
 
@@ -177,6 +187,122 @@ TestMain("Message Tests", {
 			So(strcmp(nng_msg_body(m2), "back2basics") == 0);
 		});
 
+		Convey("Duplicated bodies are copied on write", {
+			nng_msg *m2;
+			nng_msg *m3;
+			char *   body;
+
+			So(nng_msg_append(msg, "shared", strlen("shared") + 1) ==
+			    0);
+			So(nng_msg_dup(&m2, msg) == 0);
+			So(nng_msg_dup(&m3, msg) == 0);
+			Reset({
+				nng_msg_free(m2);
+				nng_msg_free(m3);
+			});
+
+			So(nng_msg_trim(m2, 3) == 0);
+			So(strcmp(nng_msg_body(m2), "red") == 0);
+			So(strcmp(nng_msg_body(msg), "shared") == 0);
+
+			body    = nng_msg_body(m3);
+			body[0] = 'S';
+			So(strcmp(nng_msg_body(m3), "Shared") == 0);
+			So(strcmp(nng_msg_body(msg), "shared") == 0);
+			So(strcmp(nng_msg_body(m2), "red") == 0);
+
+			So(nng_msg_insert(m2, "-", 1) == 0);
+			So(strcmp(nng_msg_body(m2), "-red") == 0);
+			So(strcmp(nng_msg_body(msg), "shared") == 0);
+		});
+
+		Convey("Duplicates outlive the original", {
+			nng_msg *m2;
+
+			So(nng_msg_append(msg, "orig", strlen("orig") + 1) == 0);
+			So(nng_msg_dup(&m2, msg) == 0);
+			nng_msg_free(msg);
+			msg = m2;
+			So(nng_msg_chop(msg, 1) == 0);
+			So(nng_msg_append(msg, "inal", strlen("inal") + 1) == 0);
+			So(strcmp(nng_msg_body(msg), "original") == 0);
+		});
+
+		Convey("External bodies are not copied", {
+			nng_msg *m2;
+			nng_msg *m3;
+			char     ext[] = "external";
+
+			extfreed = 0;
+			So(nng_msg_alloc_external(
+			       &m2, ext, sizeof(ext), extfree, &extfreed) == 0);
+			So(nng_msg_len(m2) == sizeof(ext));
+			So(nng_msg_dup(&m3, m2) == 0);
+			So(nng_msg_trim(m3, 2) == 0);
+			nng_msg_free(m2);
+			So(extfreed == 0);
+
+			// Modifying the body copies the data.
+			So(nng_msg_insert(m3, "E", 1) == 0);
+			So(strcmp(nng_msg_body(m3), "Eternal") == 0);
+			So(strcmp(ext, "external") == 0);
+			So(extfreed == 1);
+			nng_msg_free(m3);
+			So(extfreed == 1);
+		});
+
+		Convey("External bodies may be static", {
+			nng_msg *m2;
+
+			So(nng_msg_alloc_external(
+			       &m2, "static", 7, NULL, NULL) == 0);
+			So(nng_msg_append(m2, "!", 1) == 0);
+			So(nng_msg_len(m2) == 8);
+			nng_msg_free(m2);
+		});
+
+		Convey("Large bodies can be built by appending", {
+			size_t   size = 300000;
+			size_t   i;
+			uint8_t  b;
+			uint8_t *body;
+			uint32_t v;
+			nng_msg *m2;
+			int      rv;
+
+			rv = 0;
+			for (i = 0; (i < size) && (rv == 0); i++) {
+				b  = i & 0xff;
+				rv = nng_msg_append(msg, &b, 1);
+			}
+			So(rv == 0);
+			So(nng_msg_len(msg) == size);
+			So(nng_msg_append_u32(msg, 0x01020304) == 0);
+			So(nng_msg_chop_u32(msg, &v) == 0);
+			So(v == 0x01020304);
+			So(nng_msg_dup(&m2, msg) == 0);
+			Reset({ nng_msg_free(m2); });
+
+			So(nng_msg_chop(msg, 70000) == 0);
+			So(nng_msg_trim(msg, 70001) == 0);
+			So(nng_msg_len(msg) == size - 140001);
+			So(nng_msg_trim_u32(msg, &v) == 0);
+			size -= 140005;
+			So(nng_msg_len(msg) == size);
+			So((body = nng_msg_body(msg)) != NULL);
+			for (i = 0; i < size; i++) {
+				if (body[i] != ((i + 70005) & 0xff)) {
+					break;
+				}
+			}
+			So(i == size);
+
+			So(nng_msg_len(m2) == 300000);
+			So(nng_msg_realloc(m2, 10) == 0);
+			So(nng_msg_len(m2) == 10);
+			So(((uint8_t *) nng_msg_body(m2))[9] == 9);
+		});
+
 		Convey("Missing option fails properly", {
 			char   buf[128];
 			size_t sz = sizeof(buf);
@@ -0,0 +1,189 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+
+#include "core/nng_impl.h"
+
+#include <string.h>
+
+static int
+classof(size_t sz)
+{
+	int      i;
+	size_t   csz;
+	uint64_t h, m;
+
+	for (i = 0; nni_msgpool_stat(i, &csz, &h, &m) == 0; i++) {
+		if (csz == sz) {
+			return (i);
+		}
+	}
+	return (-1);
+}
+
+static uint64_t
+hits(int cls)
+{
+	size_t   sz;
+	uint64_t h, m;
+
+	(void) nni_msgpool_stat(cls, &sz, &h, &m);
+	return (h);
+}
+
+static uint64_t
+misses(int cls)
+{
+	size_t   sz;
+	uint64_t h, m;
+
+	(void) nni_msgpool_stat(cls, &sz, &h, &m);
+	return (m);
+}
+
+#define NBUFS 1000
+
+static void *bufs[NBUFS];
+
+static void
+freeall(void *arg)
+{
+	int i;
+	NNI_ARG_UNUSED(arg);
+
+	for (i = 0; i < NBUFS; i++) {
+		nni_msgpool_free(bufs[i], 256);
+		bufs[i] = NULL;
+	}
+}
+
+Main({
+	nni_init();
+	atexit(nni_fini);
+
+	Test("Message pool", {
+		size_t   sz;
+		uint64_t h;
+		uint64_t m;
+
+		if (nni_msgpool_stat(0, &sz, &h, &m) == NNG_ENOTSUP) {
+			ConveySkip("Message pool disabled");
+		}
+
+		Convey("Sizes round up to classes", {
+			So(nni_msgpool_size(0) == 64);
+			So(nni_msgpool_size(64) == 64);
+			So(nni_msgpool_size(65) == 128);
+			So(nni_msgpool_size(1000) == 1024);
+			So(nni_msgpool_size(65536) == 65536);
+			So(nni_msgpool_size(65537) == 65537);
+			So(classof(64) == 0);
+			So(classof(65536) >= 0);
+			So(nni_msgpool_stat(-1, &sz, &h, &m) == NNG_ENOENT);
+			So(nni_msgpool_stat(1000, &sz, &h, &m) == NNG_ENOENT);
+		});
+
+		Convey("Freed buffers are reused and zeroed", {
+			int      cls = classof(512);
+			uint64_t h0;
+			uint8_t *b1;
+			uint8_t *b2;
+			int      i;
+
+			So(cls >= 0);
+			So((b1 = nni_msgpool_alloc(500)) != NULL);
+			memset(b1, 0xff, 512);
+			nni_msgpool_free(b1, 500);
+
+			h0 = hits(cls);
+			So((b2 = nni_msgpool_alloc(512)) == b1);
+			So(hits(cls) == h0 + 1);
+			for (i = 0; i < 512; i++) {
+				if (b2[i] != 0) {
+					break;
+				}
+			}
+			So(i == 512);
+			nni_msgpool_free(b2, 512);
+		});
+
+		Convey("Large allocations bypass the pool", {
+			void *b;
+			So((b = nni_msgpool_alloc(100000)) != NULL);
+			nni_msgpool_free(b, 100000);
+		});
+
+		Convey("Messages use the pool", {
+			nni_msg *msg;
+			int      cls = classof(128);
+			uint64_t h0;
+			uint64_t m0;
+
+			So(nng_msg_alloc(&msg, 10) == 0);
+			nng_msg_free(msg);
+
+			h0 = hits(cls);
+			m0 = misses(cls);
+			So(nng_msg_alloc(&msg, 10) == 0);
+			So((hits(cls) + misses(cls)) > (h0 + m0));
+			So(hits(cls) > h0);
+			nng_msg_free(msg);
+		});
+
+		Convey("Message bodies are zeroed unless asked otherwise", {
+			nni_msg *msg;
+			uint8_t *body;
+			size_t   i;
+
+			So(nni_msg_alloc_uninit(&msg, 200) == 0);
+			So(nni_msg_len(msg) == 200);
+			memset(nni_msg_body(msg), 0xff, 200);
+			nni_msg_free(msg);
+
+			So(nni_msg_alloc(&msg, 200) == 0);
+			body = nni_msg_body(msg);
+			for (i = 0; i < 200; i++) {
+				if (body[i] != 0) {
+					break;
+				}
+			}
+			So(i == 200);
+			nni_msg_free(msg);
+		});
+
+		Convey("Buffers may be freed on another thread", {
+			nni_thr  thr;
+			int      i;
+			int      cls = classof(256);
+			uint64_t m0  = misses(cls);
+
+			for (i = 0; i < NBUFS; i++) {
+				bufs[i] = nni_msgpool_alloc(256);
+				So(bufs[i] != NULL);
+			}
+			So(misses(cls) > m0);
+
+			So(nni_thr_init(&thr, freeall, NULL) == 0);
+			nni_thr_run(&thr);
+			nni_thr_fini(&thr);
+			So(bufs[NBUFS - 1] == NULL);
+
+			// The other thread returned its magazine to the
+			// depot when it exited, so we should get hits now.
+			m0 = hits(cls);
+			bufs[0] = nni_msgpool_alloc(256);
+			So(bufs[0] != NULL);
+			So(hits(cls) == m0 + 1);
+			nni_msgpool_free(bufs[0], 256);
+			bufs[0] = NULL;
+		});
+	});
+})
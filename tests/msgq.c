@@ -0,0 +1,316 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+
+#include "core/nng_impl.h"
+
+#include <string.h>
+
+#define NPUT 10000
+
+static void
+nop(void *arg)
+{
+	NNI_ARG_UNUSED(arg);
+}
+
+static nni_msg *
+mkmsg(uint32_t val)
+{
+	nni_msg *msg;
+
+	if (nni_msg_alloc(&msg, 0) != 0) {
+		return (NULL);
+	}
+	if (nni_msg_append_u32(msg, val) != 0) {
+		nni_msg_free(msg);
+		return (NULL);
+	}
+	return (msg);
+}
+
+// getmsg does a synchronous get, and returns the message value, or
+// a negative error number.
+static int64_t
+getmsg(nni_msgq *mq, nni_aio *aio)
+{
+	nni_msg *msg;
+	uint32_t val;
+	int      rv;
+
+	nni_msgq_aio_get(mq, aio);
+	nni_aio_wait(aio);
+	if ((rv = nni_aio_result(aio)) != 0) {
+		return (-rv);
+	}
+	msg = nni_aio_get_msg(aio);
+	nni_aio_set_msg(aio, NULL);
+	val = nni_msg_trim_u32(msg);
+	nni_msg_free(msg);
+	return (val);
+}
+
+static void
+count(void *arg)
+{
+	(*(int *) arg)++;
+}
+
+// For inline completion tests; the task completes an inline aio, and
+// optionally waits for it from the same thread.
+struct inline_arg {
+	nni_msgq *mq;
+	nni_aio * aio;
+	int       wait;
+	int       rv;
+};
+
+static void
+inline_task(void *arg)
+{
+	struct inline_arg *ia = arg;
+
+	ia->rv = nni_msgq_tryput(ia->mq, mkmsg(9));
+	if (ia->wait) {
+		nni_aio_wait(ia->aio);
+	}
+}
+
+static void
+producer(void *arg)
+{
+	nni_msgq *mq = arg;
+	nni_msg * msg;
+	uint32_t  i;
+
+	for (i = 0; i < NPUT; i++) {
+		msg = mkmsg(i);
+		while (nni_msgq_tryput(mq, msg) == NNG_EAGAIN) {
+			nni_msleep(1);
+		}
+	}
+}
+
+Main({
+	nni_init();
+	atexit(nni_fini);
+
+	Test("Message queue", {
+		Convey("Given a message queue", {
+			nni_msgq *mq;
+			nni_aio * aio;
+
+			So(nni_msgq_init(&mq, 4) == 0);
+			So(nni_aio_init(&aio, nop, NULL) == 0);
+
+			Reset({
+				nni_aio_fini(aio);
+				nni_msgq_fini(mq);
+			});
+
+			Convey("Tryput fills to capacity", {
+				int i;
+				for (i = 0; i < 4; i++) {
+					So(nni_msgq_tryput(mq, mkmsg(i)) == 0);
+				}
+				nni_msg *msg = mkmsg(4);
+				So(nni_msgq_tryput(mq, msg) == NNG_EAGAIN);
+				nni_msg_free(msg);
+				So(nni_msgq_len(mq) == 4);
+
+				// And gets come back in order.
+				for (i = 0; i < 4; i++) {
+					So(getmsg(mq, aio) == i);
+				}
+				So(nni_msgq_len(mq) == 0);
+			});
+
+			Convey("Tryput hands off to a waiting getter", {
+				nni_msg *msg;
+				uint32_t val;
+
+				nni_msgq_aio_get(mq, aio);
+				So(nni_msgq_tryput(mq, mkmsg(77)) == 0);
+				nni_aio_wait(aio);
+				So(nni_aio_result(aio) == 0);
+				msg = nni_aio_get_msg(aio);
+				nni_aio_set_msg(aio, NULL);
+				val = nni_msg_trim_u32(msg);
+				So(val == 77);
+				nni_msg_free(msg);
+
+				// No waiter left, so the ring is used.
+				So(nni_msgq_tryput(mq, mkmsg(78)) == 0);
+				So(nni_msgq_len(mq) == 1);
+				So(getmsg(mq, aio) == 78);
+			});
+
+			Convey("Closed queues refuse puts and gets", {
+				nni_msg *msg = mkmsg(1);
+				nni_msgq_close(mq);
+				So(nni_msgq_tryput(mq, msg) == NNG_ECLOSED);
+				nni_msg_free(msg);
+				So(getmsg(mq, aio) == -NNG_ECLOSED);
+			});
+
+			Convey("Get errors are honored", {
+				So(nni_msgq_tryput(mq, mkmsg(1)) == 0);
+				nni_msgq_set_get_error(mq, NNG_ESTATE);
+				So(getmsg(mq, aio) == -NNG_ESTATE);
+				nni_msgq_set_get_error(mq, 0);
+				So(getmsg(mq, aio) == 1);
+			});
+
+			Convey("Resize keeps queued messages", {
+				So(nni_msgq_tryput(mq, mkmsg(1)) == 0);
+				So(nni_msgq_tryput(mq, mkmsg(2)) == 0);
+				So(nni_msgq_resize(mq, 16) == 0);
+				So(nni_msgq_cap(mq) == 16);
+				So(getmsg(mq, aio) == 1);
+				So(getmsg(mq, aio) == 2);
+			});
+
+			Convey("Batches move several messages at once", {
+				nni_msg *msgs[6];
+				int      i;
+				int      rv;
+
+				for (i = 0; i < 6; i++) {
+					msgs[i] = mkmsg(i);
+				}
+				So(nni_msgq_put_batch(mq, msgs, 6) == 4);
+				nni_msg_free(msgs[4]);
+				nni_msg_free(msgs[5]);
+				So(nni_msgq_len(mq) == 4);
+
+				So(nni_msgq_get_batch(mq, msgs, 3) == 3);
+				rv = 0;
+				for (i = 0; i < 3; i++) {
+					if (nni_msg_trim_u32(msgs[i]) != i) {
+						rv = 1;
+					}
+					nni_msg_free(msgs[i]);
+				}
+				So(rv == 0);
+				So(getmsg(mq, aio) == 3);
+				So(nni_msgq_get_batch(mq, msgs, 3) == 0);
+			});
+
+			Convey("Batch put serves a waiting getter", {
+				nni_msg *msgs[2];
+
+				msgs[0] = mkmsg(5);
+				msgs[1] = mkmsg(6);
+				nni_msgq_aio_get(mq, aio);
+				So(nni_msgq_put_batch(mq, msgs, 2) == 2);
+				nni_aio_wait(aio);
+				So(nni_aio_result(aio) == 0);
+				msgs[0] = nni_aio_get_msg(aio);
+				nni_aio_set_msg(aio, NULL);
+				So(nni_msg_trim_u32(msgs[0]) == 5);
+				nni_msg_free(msgs[0]);
+				So(nni_msgq_len(mq) == 1);
+				So(getmsg(mq, aio) == 6);
+			});
+
+			Convey("Batches are refused when closed", {
+				nni_msg *msg = mkmsg(1);
+				nni_msgq_close(mq);
+				So(nni_msgq_put_batch(mq, &msg, 1) == 0);
+				So(nni_msgq_get_batch(mq, &msg, 1) == 0);
+				nni_msg_free(msg);
+			});
+
+			Convey("Byte budgets limit the queue", {
+				nni_msg *big;
+				nni_msg *msg;
+
+				nni_msgq_set_maxbytes(mq, 10);
+				So(nni_msgq_maxbytes(mq) == 10);
+
+				// An empty queue takes an oversize message.
+				So(nni_msg_alloc(&big, 64) == 0);
+				So(nni_msgq_tryput(mq, big) == 0);
+				msg = mkmsg(1);
+				So(nni_msgq_tryput(mq, msg) == NNG_EAGAIN);
+
+				nni_msgq_set_maxbytes(mq, 0);
+				So(nni_msgq_tryput(mq, msg) == 0);
+				So(nni_msgq_len(mq) == 2);
+
+				nni_msgq_set_maxbytes(mq, 10);
+				So(getmsg(mq, aio) >= 0);
+				So(getmsg(mq, aio) == 1);
+
+				// Small messages fit until the bytes run out.
+				So(nni_msgq_tryput(mq, mkmsg(2)) == 0);
+				So(nni_msgq_tryput(mq, mkmsg(3)) == 0);
+				msg = mkmsg(4);
+				So(nni_msgq_tryput(mq, msg) == NNG_EAGAIN);
+				So(getmsg(mq, aio) == 2);
+				So(nni_msgq_tryput(mq, msg) == 0);
+			});
+
+			Convey("Inline completions run once", {
+				nni_aio *         iaio;
+				nni_task          task;
+				struct inline_arg ia;
+				int               done = 0;
+				int               pass;
+
+				So(nni_aio_init(&iaio, count, &done) == 0);
+				nni_aio_set_inline(iaio);
+				for (pass = 0; pass < 2; pass++) {
+					ia.mq   = mq;
+					ia.aio  = iaio;
+					ia.wait = pass;
+					ia.rv   = -1;
+					nni_msgq_aio_get(mq, iaio);
+					nni_task_init(
+					    NULL, &task, inline_task, &ia);
+					nni_task_dispatch(&task);
+					nni_task_wait(&task);
+					nni_aio_wait(iaio);
+					nni_msg_free(nni_aio_get_msg(iaio));
+					nni_aio_set_msg(iaio, NULL);
+					if (ia.rv != 0) {
+						break;
+					}
+				}
+				So(ia.rv == 0);
+				So(done == 2);
+				nni_aio_fini(iaio);
+			});
+
+			Convey("Concurrent put and get stay ordered", {
+				nni_thr  thr;
+				int64_t  expect;
+				int64_t  val;
+				uint32_t i;
+
+				So(nni_msgq_resize(mq, 64) == 0);
+				So(nni_thr_init(&thr, producer, mq) == 0);
+				nni_thr_run(&thr);
+				expect = 0;
+				for (i = 0; i < NPUT; i++) {
+					val = getmsg(mq, aio);
+					if (val != expect) {
+						break;
+					}
+					expect++;
+				}
+				nni_thr_fini(&thr);
+				So(expect == NPUT);
+				So(nni_msgq_len(mq) == 0);
+			});
+		});
+	});
+})
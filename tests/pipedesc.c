@@ -0,0 +1,327 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+
+#include "core/nng_impl.h"
+
+#include <string.h>
+
+// These drive the POSIX pipe descriptor directly, over a socket pair or a
+// loopback TCP connection, so that we can see what it takes from (and
+// gives to) the kernel.
+
+#ifdef NNG_PLATFORM_POSIX
+
+#include "platform/posix/posix_aio.h"
+
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int
+pd_recv(nni_posix_pipedesc *pd, void *buf, size_t len, size_t *cnt, int ms)
+{
+	nni_aio *aio;
+	int      rv;
+
+	if ((rv = nni_aio_init(&aio, NULL, NULL)) != 0) {
+		return (rv);
+	}
+	aio->a_niov           = 1;
+	aio->a_iov[0].iov_buf = buf;
+	aio->a_iov[0].iov_len = len;
+	nni_aio_set_timeout(aio, nni_clock() + ms);
+	nni_posix_pipedesc_recv(pd, aio);
+	nni_aio_wait(aio);
+	rv   = nni_aio_result(aio);
+	*cnt = nni_aio_count(aio);
+	nni_aio_fini(aio);
+	return (rv);
+}
+
+// queued returns the number of bytes the kernel holds for reading.
+static int
+queued(int fd)
+{
+	int n;
+
+	if (ioctl(fd, FIONREAD, &n) != 0) {
+		return (-1);
+	}
+	return (n);
+}
+
+static void
+count_done(void *arg)
+{
+	nni_plat_atomic_inc(arg);
+}
+
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+// tcp_pair connects two TCP sockets over loopback.  The accepted side,
+// sv[1], gets a small receive buffer, so that a large write stays mostly
+// in the sender's queue until it is read.
+static int
+tcp_pair(int sv[2])
+{
+	struct sockaddr_in sin;
+	socklen_t          len   = sizeof(sin);
+	int                small = 4096;
+	int                l;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family      = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((l = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+		return (-1);
+	}
+	if ((setsockopt(l, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small)) !=
+	        0) ||
+	    (bind(l, (void *) &sin, sizeof(sin)) != 0) ||
+	    (listen(l, 1) != 0) ||
+	    (getsockname(l, (void *) &sin, &len) != 0) ||
+	    ((sv[0] = socket(AF_INET, SOCK_STREAM, 0)) < 0)) {
+		(void) close(l);
+		return (-1);
+	}
+	if ((connect(sv[0], (void *) &sin, len) != 0) ||
+	    ((sv[1] = accept(l, NULL, NULL)) < 0)) {
+		(void) close(sv[0]);
+		(void) close(l);
+		return (-1);
+	}
+	(void) close(l);
+	return (0);
+}
+#endif
+
+Main({
+	nni_init();
+	atexit(nni_fini);
+
+	Test("POSIX pipe descriptors", {
+		Convey("Given a pipe descriptor on a socket pair", {
+			nni_posix_pipedesc *pd;
+			int                 sv[2];
+
+			So(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+			So(nni_posix_pipedesc_init(&pd, sv[0]) == 0);
+			Reset({
+				nni_posix_pipedesc_fini(pd);
+				if (sv[1] >= 0) {
+					(void) close(sv[1]);
+				}
+			});
+
+			Convey("One read takes everything queued", {
+				uint8_t out[64];
+				uint8_t in[64];
+				size_t  cnt;
+
+				for (int i = 0; i < (int) sizeof(out); i++) {
+					out[i] = (uint8_t) i;
+				}
+				So(write(sv[1], out, sizeof(out)) ==
+				    sizeof(out));
+				So(queued(sv[0]) == sizeof(out));
+
+				// A small read drains the socket into the
+				// read-ahead buffer.
+				So(pd_recv(pd, in, 4, &cnt, 1000) == 0);
+				So(cnt == 4);
+				So(queued(sv[0]) == 0);
+
+				// So the rest comes without asking the
+				// kernel, which would now report end of file.
+				(void) close(sv[1]);
+				sv[1] = -1;
+				So(pd_recv(pd, in + 4, 60, &cnt, 1000) == 0);
+				So(cnt == 60);
+				So(memcmp(in, out, sizeof(out)) == 0);
+			});
+
+			Convey("A read waits for data, and can time out", {
+				uint8_t in[8];
+				size_t  cnt;
+
+				So(pd_recv(pd, in, sizeof(in), &cnt, 50) ==
+				    NNG_ETIMEDOUT);
+				So(write(sv[1], "abcdefgh", 8) == 8);
+				So(pd_recv(pd, in, sizeof(in), &cnt, 1000) ==
+				    0);
+				So(cnt == 8);
+				So(memcmp(in, "abcdefgh", 8) == 0);
+			});
+
+			Convey("Closing finishes a read in progress", {
+				nni_aio *aio;
+				uint8_t  in[8];
+
+				So(nni_aio_init(&aio, NULL, NULL) == 0);
+				aio->a_niov           = 1;
+				aio->a_iov[0].iov_buf = in;
+				aio->a_iov[0].iov_len = sizeof(in);
+				nni_posix_pipedesc_recv(pd, aio);
+				nni_msleep(50);
+				nni_posix_pipedesc_close(pd);
+				nni_aio_wait(aio);
+				So(nni_aio_result(aio) == NNG_ECLOSED);
+				nni_aio_fini(aio);
+			});
+
+			Convey("Writes larger than the socket buffer finish", {
+				nni_aio *       aio;
+				nni_plat_atomic done;
+				uint8_t *       buf;
+				uint8_t         in[65536];
+				size_t          len  = 1024 * 1024;
+				size_t          sent = 0;
+				size_t          got  = 0;
+				int             bad  = 0;
+				ssize_t         n;
+
+				nni_plat_atomic_init(&done, 0);
+				So(nni_aio_init(&aio, count_done, &done) == 0);
+				So((buf = nni_alloc(len)) != NULL);
+				for (size_t i = 0; i < len; i++) {
+					buf[i] = (uint8_t)(i * 7);
+				}
+
+				// The write may come back short, in which case
+				// we send the rest, as a transport would.
+				aio->a_niov           = 1;
+				aio->a_iov[0].iov_buf = buf;
+				aio->a_iov[0].iov_len = len;
+				nni_posix_pipedesc_send(pd, aio);
+				for (int i = 0; i < 10000; i++) {
+					if (got == len) {
+						break;
+					}
+					n = recv(sv[1], in, sizeof(in),
+					    MSG_DONTWAIT);
+					if (n > 0) {
+						if (memcmp(in, buf + got, n) !=
+						    0) {
+							bad++;
+						}
+						got += n;
+						continue;
+					}
+					if (nni_plat_atomic_get(&done) == 0) {
+						nni_msleep(1);
+						continue;
+					}
+					nni_plat_atomic_set(&done, 0);
+					So(nni_aio_result(aio) == 0);
+					sent += nni_aio_count(aio);
+					if (sent < len) {
+						aio->a_iov[0].iov_buf =
+						    buf + sent;
+						aio->a_iov[0].iov_len =
+						    len - sent;
+						nni_posix_pipedesc_send(
+						    pd, aio);
+					}
+				}
+				nni_aio_wait(aio);
+				So(got == len);
+				So(bad == 0);
+				nni_aio_fini(aio);
+				nni_free(buf, len);
+			});
+		});
+
+#ifdef NNG_HAVE_MSG_ZEROCOPY
+		Convey("Given a zero copy send on a TCP connection", {
+			nni_posix_pipedesc *pd;
+			nni_aio *           aio;
+			nni_plat_atomic     done;
+			uint8_t *           buf;
+			size_t              len = 4 * 1024 * 1024;
+			int                 sv[2];
+
+			So(tcp_pair(sv) == 0);
+			So(nni_posix_pipedesc_init(&pd, sv[0]) == 0);
+			nni_plat_atomic_init(&done, 0);
+			So(nni_aio_init(&aio, count_done, &done) == 0);
+			So((buf = nni_alloc(len)) != NULL);
+			Reset({
+				nni_posix_pipedesc_fini(pd);
+				nni_aio_fini(aio);
+				nni_free(buf, len);
+				(void) close(sv[1]);
+			});
+			So(nni_posix_pipedesc_zerocopy(pd, 1) == 0);
+			for (size_t i = 0; i < len; i++) {
+				buf[i] = (uint8_t)(i * 7);
+			}
+			aio->a_niov           = 1;
+			aio->a_iov[0].iov_buf = buf;
+			aio->a_iov[0].iov_len = len;
+			nni_posix_pipedesc_send(pd, aio);
+
+			Convey("It waits for the kernel to let go", {
+				uint8_t in[65536];
+				size_t  got = 0;
+				int     bad = 0;
+				ssize_t n;
+
+				// The peer is not reading, so the kernel still
+				// has our buffer, and canceling cannot take it
+				// back.
+				nni_msleep(100);
+				nni_aio_cancel(aio, NNG_ECANCELED);
+				nni_msleep(100);
+				So(nni_plat_atomic_get(&done) == 0);
+
+				// Reading lets the kernel finish with it.
+				// Over loopback the data is copied after
+				// all, which the kernel reports with the
+				// completion, so the descriptor then stops
+				// using zero copy.
+				for (int i = 0; i < 1000; i++) {
+					n = recv(sv[1], in, sizeof(in),
+					    MSG_DONTWAIT);
+					if (n > 0) {
+						if (memcmp(in, buf + got, n) !=
+						    0) {
+							bad++;
+						}
+						got += n;
+					} else if (nni_plat_atomic_get(
+					               &done) != 0) {
+						break;
+					} else {
+						nni_msleep(5);
+					}
+				}
+				nni_aio_wait(aio);
+				So(nni_aio_result(aio) == 0);
+				So(nni_aio_count(aio) == got);
+				So(bad == 0);
+			});
+
+			Convey("Closing resets the connection", {
+				nni_posix_pipedesc_close(pd);
+				nni_aio_wait(aio);
+				So(nni_aio_result(aio) == NNG_ECLOSED);
+			});
+		});
+#endif
+	});
+})
+
+#else
+
+TestMain("POSIX pipe descriptors", {})
+
+#endif
@@ -137,16 +137,19 @@ TestMain("PIPELINE (PUSH/PULL) pattern", {
 		So(nng_setopt_ms(pull2, NNG_OPT_RECVTIMEO, msecs) == 0);
 		So(nng_setopt_ms(pull3, NNG_OPT_RECVTIMEO, msecs) == 0);
 		So(nng_listen(push, addr, NULL, 0) == 0);
+
+		// The pipes are started on the taskq, which does not keep
+		// them in order, so let each one settle before the next.
 		So(nng_dial(pull1, addr, NULL, 0) == 0);
+		nng_msleep(100);
 		So(nng_dial(pull2, addr, NULL, 0) == 0);
+		nng_msleep(100);
 		So(nng_dial(pull3, addr, NULL, 0) == 0);
 		So(nng_close(pull3) == 0);
 
 		// So pull3 might not be done accepting yet, but pull1
-		// and pull2 definitely are, because otherwise the
-		// server couldn't have gotten to the accept.  (The
-		// accept logic is single threaded.)  Let's wait a bit
-		// though, to ensure that stuff has settled.
+		// and pull2 definitely are.  Let's wait a bit though, to
+		// ensure that stuff has settled.
 		nng_msleep(100);
 
 		So(nng_sendmsg(push, abc, 0) == 0);
@@ -72,6 +72,15 @@ TestMain("Platform Operations", {
 			So(usdelta < 220);
 			So(abs(msdelta - usdelta) < 20);
 		});
+		Convey("coarse times are never behind", {
+			for (int i = 0; i < 1000; i++) {
+				nni_time precise = nni_clock();
+				nni_time coarse  = nni_clock_coarse();
+
+				So(coarse >= precise);
+				So(coarse < precise + 50);
+			}
+		});
 	});
 	Convey("Mutexes work", {
 		static nni_mtx mx;
@@ -0,0 +1,163 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+#include "core/nng_impl.h"
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+#include "trantest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// This checks, from end to end, that messages queued on a socket leave
+// the stream transports several to a write.  We stand in for the C
+// library's writev, to see how much each call really writes.
+
+#ifdef NNG_PLATFORM_POSIX
+
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define MSGSZ 1000
+#define NMSGS 1000
+
+static size_t maxwrite; // most bytes written by any one writev
+
+ssize_t
+writev(int fd, const struct iovec *iov, int niov)
+{
+	ssize_t n = syscall(SYS_writev, fd, iov, niov);
+	size_t  old;
+
+	old = __atomic_load_n(&maxwrite, __ATOMIC_RELAXED);
+	while ((n > 0) && ((size_t) n > old)) {
+		if (__atomic_compare_exchange_n(&maxwrite, &old, (size_t) n,
+		        0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+	return (n);
+}
+
+TestMain("Send batching", {
+	// With io_uring, writes are submitted to the ring rather than made
+	// with writev, so we keep to readiness polling.
+	setenv("NNG_POLLQ_URING", "0", 1);
+	atexit(nng_fini);
+
+	Convey("Given a connected pair over IPC", {
+		char       addr[NNG_MAXADDRLEN + 1];
+		nng_socket s1;
+		nng_socket s2;
+		char *     buf;
+		size_t     sz;
+
+		trantest_next_address(addr, "ipc:///tmp/nng_sendbatch_%u");
+		So(nng_pair1_open(&s1) == 0);
+		So(nng_pair1_open(&s2) == 0);
+		Reset({
+			nng_close(s1);
+			nng_close(s2);
+		});
+		So(nng_setopt_ms(s1, NNG_OPT_SENDTIMEO, 5000) == 0);
+		So(nng_setopt_ms(s2, NNG_OPT_RECVTIMEO, 5000) == 0);
+		So(nng_setopt_int(s1, NNG_OPT_SENDBUF, NMSGS) == 0);
+		// The receiver holds little, so the connection backs up.
+		So(nng_setopt_int(s2, NNG_OPT_RECVBUF, 1) == 0);
+		So(nng_listen(s2, addr, NULL, 0) == 0);
+		So(nng_dial(s1, addr, NULL, 0) == 0);
+
+		// A round trip shows the pipe is up.
+		So(nng_send(s1, "ping", 5, 0) == 0);
+		So(nng_recv(s2, &buf, &sz, NNG_FLAG_ALLOC) == 0);
+		So(sz == 5);
+		nng_free(buf, sz);
+
+		Convey("Queued messages share writes, in order", {
+			char msg[MSGSZ];
+			int  i;
+
+			__atomic_store_n(&maxwrite, 0, __ATOMIC_RELAXED);
+			memset(msg, 'x', sizeof(msg));
+			for (i = 0; i < NMSGS; i++) {
+				memcpy(msg, &i, sizeof(i));
+				if (nng_send(s1, msg, sizeof(msg), 0) != 0) {
+					break;
+				}
+			}
+			So(i == NMSGS);
+
+			for (i = 0; i < NMSGS; i++) {
+				int v;
+
+				if (nng_recv(s2, &buf, &sz, NNG_FLAG_ALLOC) !=
+				    0) {
+					break;
+				}
+				memcpy(&v, buf, sizeof(v));
+				nng_free(buf, sz);
+				if ((sz != MSGSZ) || (v != i)) {
+					break;
+				}
+			}
+			So(i == NMSGS);
+			So(__atomic_load_n(&maxwrite, __ATOMIC_RELAXED) >=
+			    2 * MSGSZ);
+		});
+
+		Convey("A batch of one writes one message at a time", {
+			nng_socket s3;
+			nng_socket s4;
+			char       msg[MSGSZ];
+			int        i;
+
+			// The option is taken when the pipe is made, so this
+			// needs a connection of its own.
+			trantest_next_address(
+			    addr, "ipc:///tmp/nng_sendbatch_%u");
+			So(nng_pair1_open(&s3) == 0);
+			So(nng_pair1_open(&s4) == 0);
+			Reset({
+				nng_close(s3);
+				nng_close(s4);
+			});
+			So(nng_setopt_int(s3, NNG_OPT_SENDBATCH, 1) == 0);
+			So(nng_setopt_int(s3, NNG_OPT_SENDBUF, NMSGS) == 0);
+			So(nng_setopt_ms(s4, NNG_OPT_RECVTIMEO, 5000) == 0);
+			So(nng_setopt_int(s4, NNG_OPT_RECVBUF, 1) == 0);
+			So(nng_listen(s4, addr, NULL, 0) == 0);
+			So(nng_dial(s3, addr, NULL, 0) == 0);
+			So(nng_send(s3, "ping", 5, 0) == 0);
+			So(nng_recv(s4, &buf, &sz, NNG_FLAG_ALLOC) == 0);
+			nng_free(buf, sz);
+
+			__atomic_store_n(&maxwrite, 0, __ATOMIC_RELAXED);
+			memset(msg, 'x', sizeof(msg));
+			for (i = 0; i < 100; i++) {
+				So(nng_send(s3, msg, sizeof(msg), 0) == 0);
+			}
+			for (i = 0; i < 100; i++) {
+				So(nng_recv(s4, &buf, &sz, NNG_FLAG_ALLOC) ==
+				    0);
+				nng_free(buf, sz);
+			}
+			So(__atomic_load_n(&maxwrite, __ATOMIC_RELAXED) <
+			    2 * MSGSZ);
+		});
+	});
+})
+
+#else
+
+TestMain("Send batching", {})
+
+#endif
@@ -0,0 +1,108 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+#include "nng.h"
+#include "protocol/pair1/pair.h"
+#include "trantest.h"
+
+// Shared memory tests.
+
+TestMain("Shared Memory Transport", {
+	trantest_test_all("shm:///tmp/nng_shm_test_%u");
+
+	Convey("Given a connected pair", {
+		nng_socket s1;
+		nng_socket s2;
+		char       addr[NNG_MAXADDRLEN];
+		nng_msg *  msg;
+		uint8_t *  body;
+		char *     buf;
+		size_t     sz;
+		int        ok;
+
+		trantest_checktran("shm:");
+		So(nng_pair_open(&s1) == 0);
+		So(nng_pair_open(&s2) == 0);
+		Reset({
+			nng_close(s1);
+			nng_close(s2);
+		});
+		So(nng_setopt_ms(s1, NNG_OPT_SENDTIMEO, 1000) == 0);
+		So(nng_setopt_ms(s2, NNG_OPT_RECVTIMEO, 1000) == 0);
+		trantest_next_address(addr, "shm:///tmp/nng_shm_test_%u");
+		So(nng_listen(s2, addr, NULL, 0) == 0);
+		So(nng_dial(s1, addr, NULL, 0) == 0);
+
+		// A round trip shows the rings are mapped on both sides.
+		So(nng_send(s1, "ping", 5, 0) == 0);
+		So(nng_recv(s2, &buf, &sz, NNG_FLAG_ALLOC) == 0);
+		So(sz == 5);
+		nng_free(buf, sz);
+
+		Convey("A message can wrap around the end of the ring", {
+			size_t sizes[2];
+
+			sizes[0] = 200 * 1024;
+			sizes[1] = 100 * 1024;
+
+			// The ring holds 256 KB.  The first message fills
+			// most of it, and is received before the second is
+			// sent, so the second starts near the end of the
+			// ring and its body runs over onto the start.
+			for (int i = 0; i < 2; i++) {
+				So(nng_msg_alloc(&msg, sizes[i]) == 0);
+				body = nng_msg_body(msg);
+				for (size_t j = 0; j < sizes[i]; j++) {
+					body[j] = (uint8_t)((j + i) % 251);
+				}
+				So(nng_sendmsg(s1, msg, 0) == 0);
+				So(nng_recvmsg(s2, &msg, 0) == 0);
+				So(nng_msg_len(msg) == sizes[i]);
+				body = nng_msg_body(msg);
+				ok   = 1;
+				for (size_t j = 0; j < sizes[i]; j++) {
+					if (body[j] !=
+					    (uint8_t)((j + i) % 251)) {
+						ok = 0;
+						break;
+					}
+				}
+				So(ok);
+				nng_msg_free(msg);
+			}
+		});
+
+		Convey("Messages larger than the ring work", {
+			size_t size = 900 * 1024;
+
+			So(nng_msg_alloc(&msg, size) == 0);
+			body = nng_msg_body(msg);
+			for (size_t i = 0; i < size; i++) {
+				body[i] = (uint8_t)(i % 251);
+			}
+			So(nng_sendmsg(s1, msg, 0) == 0);
+			So(nng_recvmsg(s2, &msg, 0) == 0);
+			So(nng_msg_len(msg) == size);
+			body = nng_msg_body(msg);
+			ok   = 1;
+			for (size_t i = 0; i < size; i++) {
+				if (body[i] != (uint8_t)(i % 251)) {
+					ok = 0;
+					break;
+				}
+			}
+			So(ok);
+			nng_msg_free(msg);
+		});
+	});
+
+	nng_fini();
+})
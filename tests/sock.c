@@ -447,6 +447,86 @@ TestMain("Socket Operations", {
 
 		});
 
+		Convey("Byte budgets limit buffered sends", {
+			char   buf[100];
+			size_t v;
+
+			memset(buf, 'x', sizeof(buf));
+			So(nng_setopt_int(s1, NNG_OPT_SENDBUF, 8) == 0);
+			So(nng_getopt_size(s1, NNG_OPT_SENDBUFBYTES, &v) == 0);
+			So(v == 0);
+			So(nng_setopt_size(
+			       s1, NNG_OPT_SENDBUFBYTES, 250) == 0);
+			So(nng_getopt_size(s1, NNG_OPT_SENDBUFBYTES, &v) == 0);
+			So(v == 250);
+			So(nng_setopt_size(
+			       s1, NNG_OPT_RECVBUFBYTES, 1000) == 0);
+			So(nng_getopt_size(s1, NNG_OPT_RECVBUFBYTES, &v) == 0);
+			So(v == 1000);
+
+			// Nobody is connected, so sends just accumulate.
+			So(nng_send(s1, buf, sizeof(buf), NNG_FLAG_NONBLOCK) ==
+			    0);
+			So(nng_send(s1, buf, sizeof(buf), NNG_FLAG_NONBLOCK) ==
+			    0);
+			So(nng_send(s1, buf, sizeof(buf), NNG_FLAG_NONBLOCK) ==
+			    NNG_EAGAIN);
+
+			// Raising the budget makes room again.
+			So(nng_setopt_size(
+			       s1, NNG_OPT_SENDBUFBYTES, 300) == 0);
+			So(nng_send(s1, buf, sizeof(buf), NNG_FLAG_NONBLOCK) ==
+			    0);
+		});
+
+		Convey("Busy polling works", {
+			nng_socket s2;
+			int        usec;
+			uint64_t   hits;
+			uint64_t   misses;
+			uint64_t   spent;
+			char *     a = "inproc://busypoll";
+			char *     buf;
+			size_t     sz;
+
+			So(nng_getopt_int(s1, NNG_OPT_BUSYPOLL, &usec) == 0);
+			So(usec == 0);
+			So(nng_setopt_int(s1, NNG_OPT_BUSYPOLL, -1) ==
+			    NNG_EINVAL);
+			So(nng_setopt_int(s1, NNG_OPT_BUSYPOLL, 2000000) ==
+			    NNG_EINVAL);
+			So(nng_setopt_uint64(s1, NNG_OPT_BUSYPOLLHITS, 0) ==
+			    NNG_EREADONLY);
+			So(nng_setopt_int(s1, NNG_OPT_BUSYPOLL, 1000) == 0);
+			So(nng_getopt_int(s1, NNG_OPT_BUSYPOLL, &usec) == 0);
+			So(usec == 1000);
+
+			So(nng_pair_open(&s2) == 0);
+			Reset({ nng_close(s2); });
+			So(nng_setopt_ms(s1, NNG_OPT_RECVTIMEO, 100) == 0);
+			So(nng_listen(s1, a, NULL, 0) == 0);
+			So(nng_dial(s2, a, NULL, 0) == 0);
+
+			// One receive that finds a message, and one that
+			// runs out of budget and then times out.
+			So(nng_send(s2, "abc", 4, 0) == 0);
+			So(nng_recv(s1, &buf, &sz, NNG_FLAG_ALLOC) == 0);
+			So(sz == 4);
+			nng_free(buf, sz);
+			So(nng_recv(s1, &buf, &sz, NNG_FLAG_ALLOC) ==
+			    NNG_ETIMEDOUT);
+
+			So(nng_getopt_uint64(
+			       s1, NNG_OPT_BUSYPOLLHITS, &hits) == 0);
+			So(nng_getopt_uint64(
+			       s1, NNG_OPT_BUSYPOLLMISSES, &misses) == 0);
+			So(nng_getopt_uint64(
+			       s1, NNG_OPT_BUSYPOLLTIME, &spent) == 0);
+			So(hits + misses == 2);
+			So(misses >= 1);
+			So(spent >= 1000);
+		});
+
 		Convey("We can send and receive messages", {
 			nng_socket   s2;
 			int          len;
@@ -11,9 +11,13 @@
 #include "convey.h"
 #include "nng.h"
 #include "protocol/pair1/pair.h"
+#include "transport/tcp/tcp.h"
 #include "trantest.h"
 
 #include "stubs.h"
+
+#include <string.h>
+
 // TCP tests.
 
 #ifndef _WIN32
@@ -52,10 +56,113 @@ check_props_v4(nng_msg *msg, nng_listener l, nng_dialer d)
 	return (0);
 }
 
+// batch_conn stands in for a connection, holding each write until the
+// test finishes it.
+typedef struct {
+	nni_aio *aio;
+	int      nwrites;
+	size_t   len;
+	uint8_t  buf[256];
+	int      closed;
+} batch_conn;
+
+static void
+batch_cancel(nni_aio *aio, int rv)
+{
+	nni_aio_finish_error(aio, rv);
+}
+
+static void
+batch_write(void *arg, nni_aio *aio)
+{
+	batch_conn *c = arg;
+
+	if (nni_aio_start(aio, batch_cancel, c) != 0) {
+		return;
+	}
+	c->aio = aio;
+	c->len = 0;
+	c->nwrites++;
+	for (int i = 0; i < aio->a_niov; i++) {
+		memcpy(c->buf + c->len, aio->a_iov[i].iov_buf,
+		    aio->a_iov[i].iov_len);
+		c->len += aio->a_iov[i].iov_len;
+	}
+}
+
+static void
+batch_close(void *arg)
+{
+	batch_conn *c = arg;
+
+	c->closed++;
+}
+
 TestMain("TCP Transport", {
 
 	trantest_test_extended("tcp://127.0.0.1:%u", check_props_v4);
 
+	Convey("Queued sends share one write", {
+		nni_tran_batch b;
+		batch_conn     c;
+		nni_aio *      aios[4];
+		uint64_t       len;
+
+		memset(&c, 0, sizeof(c));
+		nni_init();
+		So(nni_tran_batch_init(&b, 2, 65536, NULL, 0, batch_write,
+		       batch_close, &c) == 0);
+		for (int i = 0; i < 4; i++) {
+			nni_msg *msg;
+			So(nni_aio_init(&aios[i], NULL, NULL) == 0);
+			So(nni_msg_alloc(&msg, 10 * (i + 1)) == 0);
+			memset(nni_msg_body(msg), i, nni_msg_len(msg));
+			nni_aio_set_msg(aios[i], msg);
+		}
+		Reset({
+			nni_tran_batch_fini(&b);
+			for (int i = 0; i < 4; i++) {
+				nni_msg_free(nni_aio_get_msg(aios[i]));
+				nni_aio_fini(aios[i]);
+			}
+		});
+
+		// The first send is written by itself, and the rest wait
+		// for it.  Nothing completes until its write does.
+		for (int i = 0; i < 4; i++) {
+			nni_tran_batch_send(&b, aios[i]);
+		}
+		So(c.nwrites == 1);
+		So(c.len == 8 + 10);
+		So(nni_aio_get_msg(aios[0]) != NULL);
+
+		// Then as many as the batch allows go out together.
+		nni_aio_finish(c.aio, 0, c.len);
+		nni_aio_wait(aios[0]);
+		So(nni_aio_result(aios[0]) == 0);
+		So(nni_aio_get_msg(aios[0]) == NULL);
+		So(c.nwrites == 2);
+		So(c.len == 8 + 20 + 8 + 30);
+		NNI_GET64(c.buf, len);
+		So(len == 20);
+		So(c.buf[8] == 1);
+		NNI_GET64(c.buf + 8 + 20, len);
+		So(len == 30);
+		So(c.buf[8 + 20 + 8] == 2);
+		So(nni_aio_get_msg(aios[1]) != NULL);
+		So(nni_aio_get_msg(aios[2]) != NULL);
+
+		Convey("And they fail together", {
+			nni_aio_finish_error(c.aio, NNG_ECONNRESET);
+			for (int i = 1; i < 4; i++) {
+				nni_aio_wait(aios[i]);
+				So(nni_aio_result(aios[i]) == NNG_ECONNRESET);
+			}
+			So(c.nwrites == 2);
+			So(c.closed == 1);
+		});
+	});
+
 	Convey("We cannot connect to wild cards", {
 		nng_socket s;
 		char       addr[NNG_MAXADDRLEN];
@@ -0,0 +1,196 @@
+//
+// Copyright 2017 Garrett D'Amore <garrett@damore.org>
+// Copyright 2017 Capitar IT Group BV <info@capitar.com>
+//
+// This software is supplied under the terms of the MIT License, a
+// copy of which should be located in the distribution where this
+// file was obtained (LICENSE.txt).  A copy of the license may also be
+// found online at https://opensource.org/licenses/MIT.
+//
+
+#include "convey.h"
+
+#include "core/nng_impl.h"
+
+#include <string.h>
+
+#define NTIMERS 64
+
+struct tstamp {
+	nni_timer_node node;
+	nni_mtx *      mtx;
+	nni_time       when;
+	nni_time       fired;
+	int            count;
+	int            active;
+	int            overlap;
+};
+
+static void
+stamp(void *arg)
+{
+	struct tstamp *ts = arg;
+
+	nni_mtx_lock(ts->mtx);
+	ts->fired = nni_clock();
+	ts->count++;
+	nni_mtx_unlock(ts->mtx);
+}
+
+// slow reschedules itself immediately, and then takes a while to return,
+// so the timer fires again while it is still running.
+static void
+slow(void *arg)
+{
+	struct tstamp *ts = arg;
+
+	nni_mtx_lock(ts->mtx);
+	if (ts->active++ != 0) {
+		ts->overlap++;
+	}
+	ts->count++;
+	nni_mtx_unlock(ts->mtx);
+
+	nni_timer_schedule(&ts->node, nni_clock());
+	nni_msleep(5);
+
+	nni_mtx_lock(ts->mtx);
+	ts->active--;
+	nni_mtx_unlock(ts->mtx);
+}
+
+// tfree is a timer that frees itself when it fires.
+struct tfree {
+	nni_timer_node node;
+	nni_mtx *      mtx;
+	int *          count;
+};
+
+static void
+freeself(void *arg)
+{
+	struct tfree *tf    = arg;
+	nni_mtx *     mtx   = tf->mtx;
+	int *         count = tf->count;
+
+	nni_timer_fini(&tf->node);
+	nni_free(tf, sizeof(*tf));
+
+	nni_mtx_lock(mtx);
+	(*count)++;
+	nni_mtx_unlock(mtx);
+}
+
+Main({
+	nni_init();
+	atexit(nni_fini);
+
+	Test("Timers", {
+		Convey("Given a set of timers", {
+			struct tstamp *ts;
+			nni_mtx        mtx;
+			int            i;
+
+			nni_mtx_init(&mtx);
+			ts = nni_alloc(sizeof(*ts) * NTIMERS);
+			So(ts != NULL);
+			memset(ts, 0, sizeof(*ts) * NTIMERS);
+			for (i = 0; i < NTIMERS; i++) {
+				ts[i].mtx = &mtx;
+				nni_timer_init(&ts[i].node, stamp, &ts[i]);
+			}
+
+			Reset({
+				for (i = 0; i < NTIMERS; i++) {
+					nni_timer_cancel(&ts[i].node);
+					nni_timer_fini(&ts[i].node);
+				}
+				nni_free(ts, sizeof(*ts) * NTIMERS);
+				nni_mtx_fini(&mtx);
+			});
+
+			Convey("They fire once, and not early", {
+				nni_time now = nni_clock();
+
+				// Scramble the order of insertion.
+				for (i = 0; i < NTIMERS; i++) {
+					int j      = (i * 37) % NTIMERS;
+					ts[j].when = now + 10 + (j * 3);
+					nni_timer_schedule(
+					    &ts[j].node, ts[j].when);
+				}
+				nni_msleep(10 + (NTIMERS * 3) + 200);
+				nni_mtx_lock(&mtx);
+				for (i = 0; i < NTIMERS; i++) {
+					So(ts[i].count == 1);
+					So(ts[i].fired >= ts[i].when);
+				}
+				nni_mtx_unlock(&mtx);
+			});
+
+			Convey("Cancelled timers do not fire", {
+				nni_time now = nni_clock();
+
+				for (i = 0; i < NTIMERS; i++) {
+					ts[i].when = now + 50 + i;
+					nni_timer_schedule(
+					    &ts[i].node, ts[i].when);
+				}
+				for (i = 0; i < NTIMERS; i += 2) {
+					nni_timer_cancel(&ts[i].node);
+				}
+				nni_msleep(50 + NTIMERS + 200);
+				nni_mtx_lock(&mtx);
+				for (i = 0; i < NTIMERS; i++) {
+					So(ts[i].count == (i % 2));
+				}
+				nni_mtx_unlock(&mtx);
+			});
+
+			Convey("Rescheduling moves the expiration", {
+				nni_time now = nni_clock();
+
+				nni_timer_schedule(&ts[0].node, now + 100000);
+				nni_timer_schedule(&ts[1].node, now + 100000);
+				nni_timer_schedule(&ts[0].node, now + 10);
+				nni_msleep(300);
+				nni_mtx_lock(&mtx);
+				So(ts[0].count == 1);
+				So(ts[1].count == 0);
+				nni_mtx_unlock(&mtx);
+			});
+
+			Convey("A callback never overlaps itself", {
+				nni_timer_init(&ts[0].node, slow, &ts[0]);
+				nni_timer_schedule(&ts[0].node, nni_clock());
+				nni_msleep(100);
+				nni_timer_cancel(&ts[0].node);
+				nni_mtx_lock(&mtx);
+				So(ts[0].count > 1);
+				So(ts[0].overlap == 0);
+				So(ts[0].active == 0);
+				nni_mtx_unlock(&mtx);
+			});
+
+			Convey("A callback may free its node", {
+				struct tfree *tf;
+				int           count = 0;
+
+				for (i = 0; i < NTIMERS; i++) {
+					tf = nni_alloc(sizeof(*tf));
+					So(tf != NULL);
+					tf->mtx   = &mtx;
+					tf->count = &count;
+					nni_timer_init(
+					    &tf->node, freeself, tf);
+					nni_timer_schedule(
+					    &tf->node, nni_clock() + (i % 4));
+				}
+				nni_msleep(200);
+				nni_mtx_lock(&mtx);
+				So(count == NTIMERS);
+				nni_mtx_unlock(&mtx);
+			});
+		});
+	});
+})
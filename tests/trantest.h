@@ -52,6 +52,9 @@ unsigned trantest_port = 0;
 #ifndef NNG_HAVE_IPC
 #define nng_ipc_register notransport
 #endif
+#ifndef NNG_HAVE_SHM
+#define nng_shm_register notransport
+#endif
 #ifndef NNG_HAVE_TCP
 #define nng_tcp_register notransport
 #endif
@@ -82,6 +85,9 @@ trantest_checktran(const char *url)
 #ifndef NNG_HAVE_IPC
 	CHKTRAN(url, "ipc:");
 #endif
+#ifndef NNG_HAVE_SHM
+	CHKTRAN(url, "shm:");
+#endif
 #ifndef NNG_HAVE_TCP
 	CHKTRAN(url, "tcp:");
 #endif
@@ -294,6 +300,7 @@ trantest_send_recv_large(trantest *tt)
 		nng_msg *    recv;
 		char *       data;
 		size_t       size;
+		int          rv;
 
 		size = 1024 * 128; // bigger than any transport segment
 		So((data = nng_alloc(size)) != NULL);
@@ -333,6 +340,24 @@ trantest_send_recv_large(trantest *tt)
 		So(memcmp(nng_msg_body(recv), data, size) == 0);
 		nng_msg_free(recv);
 
+		// Build one up in pieces, so that it is not contiguous.
+		for (int i = 0; (size_t) i < size; i++) {
+			data[i] = i & 0xff;
+		}
+		So(nng_msg_alloc(&send, 0) == 0);
+		rv = 0;
+		for (size_t off = 0; (off < size) && (rv == 0); off += 1000) {
+			size_t n = (size - off) < 1000 ? (size - off) : 1000;
+			rv       = nng_msg_append(send, data + off, n);
+		}
+		So(rv == 0);
+		So(nng_sendmsg(tt->reqsock, send, 0) == 0);
+		So(nng_recvmsg(tt->repsock, &recv, 0) == 0);
+		So(recv != NULL);
+		So(nng_msg_len(recv) == size);
+		So(memcmp(nng_msg_body(recv), data, size) == 0);
+		nng_msg_free(recv);
+
 		nng_free(data, size);
 	})
 }
@@ -18,6 +18,92 @@
 // Basic UDP tests.
 #include "core/nng_impl.h"
 
+#define NOPS 40  // more than the platform takes in one batch
+#define BADOP 20 // the one send queued without an address
+
+#if defined(NNG_HAVE_RECVMMSG) && defined(NNG_HAVE_SENDMMSG)
+
+// Where the platform moves datagrams in batches, we stand in for the C
+// library's sendmmsg and recvmmsg.  This lets us see how many datagrams
+// each call is given, hold sends back until several are queued, and
+// make sendmmsg send fewer than asked, as a busy kernel may.
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define UDP_SENDCAP 4 // most datagrams one sendmmsg will take
+
+static int udp_hold;    // sendmmsg reports EAGAIN while set
+static int udp_partial; // sendmmsg calls that sent fewer than asked
+static int udp_maxrecv; // most datagrams any one recvmmsg was offered
+
+int
+sendmmsg(int fd, struct mmsghdr *mm, unsigned int n, int flags)
+{
+	unsigned int cnt = n < UDP_SENDCAP ? n : UDP_SENDCAP;
+
+	if (__atomic_load_n(&udp_hold, __ATOMIC_ACQUIRE)) {
+		errno = EAGAIN;
+		return (-1);
+	}
+	if (cnt < n) {
+		__atomic_fetch_add(&udp_partial, 1, __ATOMIC_RELAXED);
+	}
+	return ((int) syscall(SYS_sendmmsg, fd, mm, cnt, flags));
+}
+
+int
+recvmmsg(int fd, struct mmsghdr *mm, unsigned int n, int flags,
+    struct timespec *tmo)
+{
+	int old = __atomic_load_n(&udp_maxrecv, __ATOMIC_RELAXED);
+
+	while (((int) n > old) &&
+	    (!__atomic_compare_exchange_n(&udp_maxrecv, &old, (int) n, 0,
+	        __ATOMIC_RELAXED, __ATOMIC_RELAXED))) {
+		;
+	}
+	return ((int) syscall(SYS_recvmmsg, fd, mm, n, flags, tmo));
+}
+
+static void
+udp_batch_hold(int on)
+{
+	if (on) {
+		__atomic_store_n(&udp_partial, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&udp_maxrecv, 0, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&udp_hold, on, __ATOMIC_RELEASE);
+}
+
+// Returns true if the batched calls were seen to carry several datagrams,
+// and sendmmsg had to pick up where a short send left off.
+static int
+udp_batch_seen(void)
+{
+	return ((__atomic_load_n(&udp_partial, __ATOMIC_RELAXED) > 0) &&
+	    (__atomic_load_n(&udp_maxrecv, __ATOMIC_RELAXED) > 1));
+}
+
+#else // NNG_HAVE_RECVMMSG && NNG_HAVE_SENDMMSG
+
+// Datagrams go one at a time here, so there is nothing to watch.
+static void
+udp_batch_hold(int on)
+{
+	NNI_ARG_UNUSED(on);
+}
+
+static int
+udp_batch_seen(void)
+{
+	return (1);
+}
+
+#endif // NNG_HAVE_RECVMMSG && NNG_HAVE_SENDMMSG
+
 TestMain("UDP support", {
 
 	nni_init();
@@ -186,6 +272,73 @@ TestMain("UDP support", {
 			nni_aio_fini(aio4);
 		});
 
+		Convey("Queued operations complete in order", {
+			nni_aio *    saio[NOPS];
+			nni_aio *    raio[NOPS];
+			int          sbuf[NOPS];
+			int          rbuf[NOPS];
+			nng_sockaddr to;
+			nng_sockaddr from[NOPS];
+			int          i;
+
+			// The send at BADOP has no address, so a batch stops
+			// short of it; it fails alone, and the rest still go.
+			to = sa2;
+			for (i = 0; i < NOPS; i++) {
+				nni_aio_init(&saio[i], NULL, NULL);
+				nni_aio_init(&raio[i], NULL, NULL);
+				sbuf[i]                   = i;
+				rbuf[i]                   = -1;
+				saio[i]->a_niov           = 1;
+				saio[i]->a_iov[0].iov_buf = (void *) &sbuf[i];
+				saio[i]->a_iov[0].iov_len = sizeof(sbuf[i]);
+				saio[i]->a_addr = i == BADOP ? NULL : &to;
+				raio[i]->a_niov           = 1;
+				raio[i]->a_iov[0].iov_buf = (void *) &rbuf[i];
+				raio[i]->a_iov[0].iov_len = sizeof(rbuf[i]);
+				raio[i]->a_addr           = &from[i];
+			}
+
+			// Every receive is waiting before anything is sent,
+			// and the sends are held until all are queued.
+			udp_batch_hold(1);
+			for (i = 0; i < NOPS - 1; i++) {
+				nni_plat_udp_recv(u2, raio[i]);
+			}
+			for (i = 0; i < NOPS; i++) {
+				nni_plat_udp_send(u1, saio[i]);
+			}
+			udp_batch_hold(0);
+
+			for (i = 0; i < NOPS; i++) {
+				nni_aio_wait(saio[i]);
+				if (nni_aio_result(saio[i]) !=
+				    (i == BADOP ? NNG_EADDRINVAL : 0)) {
+					break;
+				}
+			}
+			So(i == NOPS);
+
+			// One datagram fewer arrives, as one was refused.
+			for (i = 0; i < NOPS - 1; i++) {
+				nni_aio_wait(raio[i]);
+				if ((nni_aio_result(raio[i]) != 0) ||
+				    (nni_aio_count(raio[i]) != sizeof(int)) ||
+				    (rbuf[i] != (i < BADOP ? i : i + 1)) ||
+				    (from[i].s_un.s_in.sa_port !=
+				        sa1.s_un.s_in.sa_port)) {
+					break;
+				}
+			}
+			So(i == NOPS - 1);
+			So(udp_batch_seen());
+
+			for (i = 0; i < NOPS; i++) {
+				nni_aio_fini(saio[i]);
+				nni_aio_fini(raio[i]);
+			}
+		});
+
 		Convey("Sending without an address fails", {
 			nni_aio *aio1;
 			char *   msg = "nope";
@@ -251,6 +404,86 @@ TestMain("UDP support", {
 			nni_aio_fini(aio1);
 		});
 
+		Convey("Segmented sends work", {
+			char         sbuf[4000];
+			char         rbuf[65536];
+			size_t       total;
+			nng_sockaddr to;
+			nng_sockaddr from;
+			nni_aio *    aio1;
+			nni_aio *    aio2;
+
+			if ((nni_plat_udp_segment(u1, 1) == NNG_ENOTSUP) ||
+			    (nni_plat_udp_segment(u2, 1) == NNG_ENOTSUP)) {
+				ConveySkip("Segmentation offload unsupported");
+			}
+			for (int i = 0; i < (int) sizeof(sbuf); i++) {
+				sbuf[i] = (char) (i / 1000);
+			}
+
+			nni_aio_init(&aio1, NULL, NULL);
+			nni_aio_init(&aio2, NULL, NULL);
+
+			to                     = sa2;
+			aio1->a_niov           = 1;
+			aio1->a_iov[0].iov_buf = (void *) sbuf;
+			aio1->a_iov[0].iov_len = sizeof(sbuf);
+			aio1->a_addr           = &to;
+			aio1->a_segsz          = 1000;
+			nni_plat_udp_send(u1, aio1);
+			nni_aio_wait(aio1);
+			So(nni_aio_result(aio1) == 0);
+			So(nni_aio_count(aio1) == sizeof(sbuf));
+
+			// The receiver may get the datagrams coalesced or
+			// one at a time; either way each is 1000 bytes.
+			total = 0;
+			while (total < sizeof(sbuf)) {
+				size_t segsz;
+
+				aio2->a_niov           = 1;
+				aio2->a_iov[0].iov_buf = (void *) rbuf;
+				aio2->a_iov[0].iov_len = sizeof(rbuf);
+				aio2->a_addr           = &from;
+				nni_plat_udp_recv(u2, aio2);
+				nni_aio_wait(aio2);
+				So(nni_aio_result(aio2) == 0);
+				segsz = aio2->a_segsz;
+				if (segsz == 0) {
+					segsz = nni_aio_count(aio2);
+				}
+				So(segsz == 1000);
+				So(nni_aio_count(aio2) % 1000 == 0);
+				So(memcmp(rbuf, sbuf + total,
+				       nni_aio_count(aio2)) == 0);
+				total += nni_aio_count(aio2);
+			}
+			So(total == sizeof(sbuf));
+			So(from.s_un.s_in.sa_port == sa1.s_un.s_in.sa_port);
+
+			nni_aio_fini(aio1);
+			nni_aio_fini(aio2);
+		});
+
+		Convey("Segmented sends need offload enabled", {
+			char         msg[2000];
+			nng_sockaddr to;
+			nni_aio *    aio1;
+
+			memset(msg, 0, sizeof(msg));
+			nni_aio_init(&aio1, NULL, NULL);
+			to                     = sa2;
+			aio1->a_niov           = 1;
+			aio1->a_iov[0].iov_buf = (void *) msg;
+			aio1->a_iov[0].iov_len = sizeof(msg);
+			aio1->a_addr           = &to;
+			aio1->a_segsz          = 1000;
+			nni_plat_udp_send(u1, aio1);
+			nni_aio_wait(aio1);
+			So(nni_aio_result(aio1) == NNG_ENOTSUP);
+			nni_aio_fini(aio1);
+		});
+
 	});
 
 	Convey("Cannot open using bogus sockaddr", {